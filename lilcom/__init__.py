@@ -1,2 +1,6 @@
-# import 'compress' and 'decompress' from lilcom_interface
-from .lilcom_interface import compress, decompress
+# import the public functions from lilcom_interface
+from .lilcom_interface import compress, decompress, decompress_quantized, peek_shape
+from .lilcom_interface import compress_async, decompress_async, set_executor
+from .lilcom_interface import Loader
+from .lilcom_interface import compress_batch, decompress_batch, batch_shapes
+from .lilcom_interface import concatenate, layer_sizes
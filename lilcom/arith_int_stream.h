@@ -0,0 +1,395 @@
+#ifndef __LILCOM__ARITH_INT_STREAM_H_
+#define __LILCOM__ARITH_INT_STREAM_H_ 1
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string.h>
+#include <vector>
+#include "int_math_utils.h"  /* for num_bits() */
+
+
+/**
+   This header contains ArithIntStream and ReverseArithIntStream, which
+   provide an alternative to IntStream and ReverseIntStream (with the same
+   interface) that uses adaptive binary arithmetic coding.  It is slower
+   than IntStream but gives smaller output, because the probabilities of
+   the codes are learned from the data rather than being fixed.
+
+   The arithmetic coder itself is a binary range coder of the type used in
+   LZMA (BinaryRangeEncoder and BinaryRangeDecoder); the modeling of the
+   integers is done by class ArithIntModel.
+*/
+
+
+/*
+  Probabilities are stored as uint16_t with kArithProbBits bits of precision;
+  each one is the probability that the next bit is zero.  They adapt by
+  moving 1/2^kArithAdaptShift of the way toward the observed bit.
+ */
+static const int kArithProbBits = 11,
+    kArithProbInit = (1 << kArithProbBits) / 2,
+    kArithAdaptShift = 5;
+static const uint32_t kArithTopValue = (1 << 24);
+
+
+/**
+   class BinaryRangeEncoder encodes a sequence of bits, each either with an
+   adaptive probability or with probability 1/2 ("direct" bits).
+
+   See also class BinaryRangeDecoder.
+ */
+class BinaryRangeEncoder {
+ public:
+  BinaryRangeEncoder(): low_(0), range_(0xFFFFFFFF), cache_(0),
+                        cache_size_(1), first_byte_(true), flushed_(false) { }
+
+  /*
+    Encode one bit with the adaptive probability `*prob`, which will be
+    updated.
+       @param [in] bit   The bit to encode, 0 or 1
+       @param [in,out] prob  The probability that the bit is 0, with
+                    kArithProbBits of precision; will be updated.
+  */
+  inline void Encode(int bit, uint16_t *prob) {
+    assert(!flushed_);
+    uint32_t bound = (range_ >> kArithProbBits) * *prob;
+    if (bit == 0) {
+      range_ = bound;
+      *prob += ((1 << kArithProbBits) - *prob) >> kArithAdaptShift;
+    } else {
+      low_ += bound;
+      range_ -= bound;
+      *prob -= *prob >> kArithAdaptShift;
+    }
+    while (range_ < kArithTopValue) {
+      range_ <<= 8;
+      ShiftLow();
+    }
+  }
+
+  /*
+    Encode the lower-order `num_bits` bits of `bits`, each with probability
+    1/2, most significant first.  num_bits must be in [0,32].
+  */
+  inline void EncodeDirect(int num_bits, uint32_t bits) {
+    assert(!flushed_);
+    for (int i = num_bits - 1; i >= 0; i--) {
+      range_ >>= 1;
+      if ((bits >> i) & 1)
+        low_ += range_;
+      while (range_ < kArithTopValue) {
+        range_ <<= 8;
+        ShiftLow();
+      }
+    }
+  }
+
+  /* Gets the code that was written.  After calling this, you cannot
+     call Encode() or EncodeDirect() any more. */
+  std::vector<char> &Code() {
+    if (!flushed_) Flush();
+    return code_;
+  }
+
+  /* Returns the number of bytes in the code; flushes, like Code(). */
+  size_t NumBytes() {
+    if (!flushed_) Flush();
+    return code_.size();
+  }
+
+  /* Exchanges the vector that the code is appended to with `*code`; see
+     BitStream::SwapCode(). */
+  void SwapCode(std::vector<char> *code) { code_.swap(*code); }
+
+ private:
+
+  void Flush() {
+    assert(!flushed_);
+    flushed_ = true;
+    for (int i = 0; i < 5; i++)
+      ShiftLow();
+  }
+
+  /* Outputs the top byte of low_, taking care of carry propagation:
+     bytes equal to 0xFF are held back (counted in cache_size_) until we know
+     whether a carry will propagate into them. */
+  inline void ShiftLow() {
+    if ((uint32_t)low_ < 0xFF000000 || (low_ >> 32) != 0) {
+      uint8_t carry = (uint8_t)(low_ >> 32),
+          temp = cache_;
+      do {
+        /* The very first byte output is always zero, so we don't write
+           it; the decoder knows about this. */
+        if (!first_byte_)
+          code_.push_back((char)(uint8_t)(temp + carry));
+        first_byte_ = false;
+        temp = 0xFF;
+      } while (--cache_size_ != 0);
+      cache_ = (uint8_t)(low_ >> 24);
+    }
+    cache_size_++;
+    low_ = (low_ & 0x00FFFFFF) << 8;
+  }
+
+  std::vector<char> code_;
+  uint64_t low_;
+  uint32_t range_;
+  uint8_t cache_;
+  uint64_t cache_size_;
+  bool first_byte_;
+  bool flushed_;
+};
+
+
+class BinaryRangeDecoder {
+ public:
+  /*
+     Constructor
+         @param [in] code  First byte of the code to be read.
+         @param [in] code_memory_end  Pointer to one past the end of the
+                          memory region allocated for `code`, to prevent
+                          segmentation faults with corrupted input.
+   */
+  BinaryRangeDecoder(const char *code,
+                     const char *code_memory_end):
+      next_code_(code),
+      code_memory_end_(code_memory_end),
+      range_(0xFFFFFFFF),
+      code_(0),
+      overflowed_(false) {
+    for (int i = 0; i < 4; i++)
+      code_ = (code_ << 8) | NextByte();
+  }
+
+  /* Decodes a bit that was encoded with BinaryRangeEncoder::Encode().
+     Returns the bit (0 or 1). */
+  inline int Decode(uint16_t *prob) {
+    uint32_t bound = (range_ >> kArithProbBits) * *prob;
+    int bit;
+    if (code_ < bound) {
+      range_ = bound;
+      *prob += ((1 << kArithProbBits) - *prob) >> kArithAdaptShift;
+      bit = 0;
+    } else {
+      code_ -= bound;
+      range_ -= bound;
+      *prob -= *prob >> kArithAdaptShift;
+      bit = 1;
+    }
+    while (range_ < kArithTopValue) {
+      range_ <<= 8;
+      code_ = (code_ << 8) | NextByte();
+    }
+    return bit;
+  }
+
+  /* Decodes `num_bits` bits written by BinaryRangeEncoder::EncodeDirect(). */
+  inline uint32_t DecodeDirect(int num_bits) {
+    uint32_t ans = 0;
+    for (int i = 0; i < num_bits; i++) {
+      range_ >>= 1;
+      uint32_t bit = (code_ >= range_);
+      if (bit)
+        code_ -= range_;
+      ans = (ans << 1) | bit;
+      while (range_ < kArithTopValue) {
+        range_ <<= 8;
+        code_ = (code_ << 8) | NextByte();
+      }
+    }
+    return ans;
+  }
+
+  /* Returns true if we attempted to read past the end of the code (which
+     would indicate a truncated or corrupted code). */
+  bool Overflowed() const { return overflowed_; }
+
+  /* Returns a pointer to one past the end of the last byte read. */
+  const char *NextCode() const { return next_code_; }
+
+ private:
+  inline uint32_t NextByte() {
+    if (next_code_ >= code_memory_end_) {
+      overflowed_ = true;
+      return 0;
+    }
+    return (unsigned char)*(next_code_++);
+  }
+
+  const char *next_code_;
+  const char *code_memory_end_;
+  uint32_t range_;
+  uint32_t code_;
+  bool overflowed_;
+};
+
+
+/**
+   class ArithIntModel contains the adaptive probabilities used to code a
+   stream of integers, shared by ArithIntStream and ReverseArithIntStream.
+
+   Each (zigzag-encoded, see IntStream) integer i is coded as its num_bits
+   (0..32) followed by its bits below the most significant one.  The
+   num_bits is coded with a binary tree of adaptive probabilities, in a
+   context given by the num_bits of the previous two integers; the next
+   kArithHighBits bits are coded adaptively in a context given by the
+   num_bits; and the remaining bits are coded directly (probability 1/2).
+ */
+static const int kArithHighBits = 2;
+
+class ArithIntModel {
+ public:
+  ArithIntModel(): prev_num_bits_(0), prev_prev_num_bits_(0) {
+    for (size_t i = 0; i < sizeof(num_bits_probs_) / sizeof(uint16_t); i++)
+      (&num_bits_probs_[0][0])[i] = kArithProbInit;
+    for (size_t i = 0; i < sizeof(high_bits_probs_) / sizeof(uint16_t); i++)
+      (&high_bits_probs_[0][0])[i] = kArithProbInit;
+  }
+
+  /* Returns the probabilities (a binary tree of 64 nodes, of which elements
+     1..63 are used) for coding the num_bits of the next integer. */
+  inline uint16_t *NumBitsProbs() {
+    return num_bits_probs_[Context()];
+  }
+
+  /* Returns the probabilities for coding the high-order bits (below the top
+     bit) of an integer with `num_bits` bits. */
+  inline uint16_t *HighBitsProbs(int num_bits) {
+    return high_bits_probs_[num_bits];
+  }
+
+  /* To be called after coding each integer. */
+  inline void Update(int num_bits) {
+    prev_prev_num_bits_ = prev_num_bits_;
+    prev_num_bits_ = num_bits;
+  }
+
+ private:
+  /* The context is the previous num_bits plus a 3-way "trend" given by the
+     comparison with the one before that. */
+  inline int Context() const {
+    int trend = (prev_num_bits_ > prev_prev_num_bits_ ? 2 :
+                 (prev_num_bits_ == prev_prev_num_bits_ ? 1 : 0));
+    return prev_num_bits_ * 3 + trend;
+  }
+
+  int prev_num_bits_;
+  int prev_prev_num_bits_;
+  uint16_t num_bits_probs_[33 * 3][64];
+  uint16_t high_bits_probs_[33][1 << kArithHighBits];
+};
+
+
+/**
+   class ArithIntStream encodes signed integers with adaptive arithmetic
+   coding.  It has the same interface as class IntStream.
+
+   See also class ReverseArithIntStream.
+ */
+class ArithIntStream {
+ public:
+  ArithIntStream() { }
+
+  inline void Write(int32_t value) {
+    uint32_t i = (value >= 0 ? 2 * (uint32_t)value : -(2 * (uint32_t)value) - 1);
+    int num_bits = int_math::num_bits(i);
+
+    /* Code num_bits (a 6-bit number) with the binary tree, most significant
+       bit first. */
+    uint16_t *probs = model_.NumBitsProbs();
+    int node = 1;
+    for (int b = 5; b >= 0; b--) {
+      int bit = (num_bits >> b) & 1;
+      encoder_.Encode(bit, probs + node);
+      node = (node << 1) | bit;
+    }
+
+    if (num_bits > 1) {
+      /* The top bit is known to be 1; code the remaining num_bits - 1. */
+      int remaining_bits = num_bits - 1,
+          num_high_bits = int_math::int_math_min(remaining_bits, kArithHighBits);
+      uint16_t *high_probs = model_.HighBitsProbs(num_bits);
+      node = 1;
+      for (int b = 0; b < num_high_bits; b++) {
+        remaining_bits--;
+        int bit = (i >> remaining_bits) & 1;
+        encoder_.Encode(bit, high_probs + node);
+        node = (node << 1) | bit;
+      }
+      encoder_.EncodeDirect(remaining_bits, i & ((1 << remaining_bits) - 1));
+    }
+    model_.Update(num_bits);
+  }
+
+  /* Gets the code that was written.  After calling this you must
+     not call Write(). */
+  std::vector<char> &Code() { return encoder_.Code(); }
+
+  /* Returns the number of bytes in the code; flushes, like Code(). */
+  size_t NumBytes() { return encoder_.NumBytes(); }
+
+  /* See BitStream::SwapCode(). */
+  void SwapCode(std::vector<char> *code) { encoder_.SwapCode(code); }
+
+ private:
+  BinaryRangeEncoder encoder_;
+  ArithIntModel model_;
+};
+
+
+/*
+  This class is for decoding data encoded by class ArithIntStream.
+  It has the same interface as class ReverseIntStream.
+ */
+class ReverseArithIntStream {
+ public:
+  ReverseArithIntStream(const char *code,
+                        const char *code_memory_end):
+      decoder_(code, code_memory_end) { }
+
+  /*
+    Read in an integer that was encoded by class ArithIntStream.
+    Returns true on success, false on failure (truncated or corrupted
+    input).
+  */
+  inline bool Read(int32_t *value) {
+    uint16_t *probs = model_.NumBitsProbs();
+    int node = 1;
+    for (int b = 0; b < 6; b++)
+      node = (node << 1) | decoder_.Decode(probs + node);
+    int num_bits = node - 64;
+    if (num_bits > 32)
+      return false;  /* corrupted code. */
+
+    uint32_t i;
+    if (num_bits <= 1) {
+      i = num_bits;
+    } else {
+      int remaining_bits = num_bits - 1,
+          num_high_bits = int_math::int_math_min(remaining_bits, kArithHighBits);
+      uint16_t *high_probs = model_.HighBitsProbs(num_bits);
+      node = 1;
+      for (int b = 0; b < num_high_bits; b++)
+        node = (node << 1) | decoder_.Decode(high_probs + node);
+      remaining_bits -= num_high_bits;
+      /* `node` now contains the top bit (which is 1) followed by the high
+         bits. */
+      i = ((uint32_t)node << remaining_bits) | decoder_.DecodeDirect(remaining_bits);
+    }
+    if (decoder_.Overflowed())
+      return false;
+    model_.Update(num_bits);
+    *value = (i % 2 == 0 ? (int32_t)(i/2) : -(int32_t)(i/2) - 1);
+    return true;
+  }
+
+  /* Returns a pointer to one past the end of the last byte read. */
+  const char *NextCode() const { return decoder_.NextCode(); }
+
+ private:
+  BinaryRangeDecoder decoder_;
+  ArithIntModel model_;
+};
+
+
+#endif /* __LILCOM__ARITH_INT_STREAM_H_ */
@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <math.h>
+#include <cassert>
+#include <iostream>
+#include "int_stream.h"
+#include "arith_int_stream.h"
+
+
+void arith_int_stream_test_edge() {
+  int32_t values[] = { 0, -1, 1, INT32_MIN, INT32_MAX, 12345, -99999, 0, 0, 0 };
+  int n = sizeof(values) / sizeof(int32_t);
+  ArithIntStream ais;
+  for (int i = 0; i < n; i++)
+    ais.Write(values[i]);
+  const char *code = &(ais.Code()[0]),
+      *code_end = code + ais.Code().size();
+  ReverseArithIntStream rais(code, code_end);
+  for (int i = 0; i < n; i++) {
+    int32_t r;
+    bool ans = rais.Read(&r);
+    assert(ans && r == values[i]);
+  }
+  /* The decoder should have consumed exactly the bytes written. */
+  assert(rais.NextCode() == code_end);
+
+  /* A truncated stream should fail to decode. */
+  ReverseArithIntStream rais2(code, code_end - 1);
+  bool ok = true;
+  for (int i = 0; i < n; i++) {
+    int32_t r;
+    ok = ok && rais2.Read(&r);
+  }
+  assert(!ok);
+}
+
+uint32_t rand_special() {
+  uint32_t num_to_shift = rand() % 32,
+      n = rand() % 5;
+  return n << num_to_shift;
+}
+
+void arith_int_stream_test_random() {
+  int32_t input[500];
+  for (int num_ints = 1; num_ints < 500; num_ints += 3) {
+    ArithIntStream ais;
+    for (int i = 0; i < num_ints; i++) {
+      input[i] = (int32_t)rand_special();
+      ais.Write(input[i]);
+    }
+    ReverseArithIntStream rais(&(ais.Code()[0]),
+                               &(ais.Code()[0]) + ais.Code().size());
+    for (int i = 0; i < num_ints; i++) {
+      int32_t r;
+      bool ans = rais.Read(&r);
+      assert(ans);
+      if (r != input[i]) {
+        std::cout << "Failure, " << r << " != " << input[i] << "\n";
+        exit(1);
+      }
+    }
+    assert(rais.NextCode() == &(ais.Code()[0]) + ais.Code().size());
+  }
+}
+
+
+inline double rand_uniform() {
+  return (1.0 + rand()) / (static_cast<double>(RAND_MAX) + 2);
+}
+
+void arith_int_stream_test_laplacian() {
+  int n = 10000;
+  for (int scale = 1; scale <= 10000; scale *= 10) {
+    IntStream is;
+    ArithIntStream ais;
+    std::vector<int32_t> buffer(n);
+    for (int i = 0; i < n; i++) {
+      double x = -log(rand_uniform()) * scale * (rand() % 2 ? 1 : -1);
+      buffer[i] = (int32_t)round(x);
+      is.Write(buffer[i]);
+      ais.Write(buffer[i]);
+    }
+    ReverseArithIntStream rais(&(ais.Code()[0]),
+                               &(ais.Code()[0]) + ais.Code().size());
+    for (int i = 0; i < n; i++) {
+      int32_t r;
+      bool ans = rais.Read(&r);
+      assert(ans && r == buffer[i]);
+    }
+    std::cout << "Laplacian with scale=" << scale << ": bits per sample with "
+              << "IntStream is " << (is.Code().size() * 8.0 / n)
+              << ", with ArithIntStream is " << (ais.Code().size() * 8.0 / n)
+              << "\n";
+    /* The arithmetic coder should be better. */
+    assert(ais.Code().size() < is.Code().size());
+  }
+}
+
+
+int main() {
+  arith_int_stream_test_edge();
+  arith_int_stream_test_random();
+  arith_int_stream_test_laplacian();
+  std::cout << "Done\n";
+}
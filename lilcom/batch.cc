@@ -0,0 +1,460 @@
+/*
+  Batches of small arrays; see batch.h.  This uses only the interface in
+  compression.h, so it is compiled once, not per instruction set.
+ */
+#include "batch.h"
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+
+/* The flags that CompressFloatBatch() accepts. */
+#define LILCOM_BATCH_FLAGS (LILCOM_FLAG_ARITHMETIC_CODING|LILCOM_FLAG_SPARSE|\
+                            LILCOM_FLAG_LOSSLESS|LILCOM_FLAG_ADAPTIVE)
+
+
+/* Returns the size of the batch header plus row_dims and the item table. */
+static int64_t BatchTablesOffset(int num_axes, int64_t num_items) {
+  return LILCOM_BATCH_HEADER_LEN + 8 * (num_axes - 1) +
+      8 * ((num_items + 1) / 2);
+}
+
+/*
+  Returns the product of the row_dims of a batch (see batch.h), or -1 if
+  one of them is negative or the product is more than 2^31 - 1.
+ */
+static int64_t RowSize(int num_axes, const int64_t *row_dims) {
+  int64_t row_size = 1;
+  for (int i = 0; i + 1 < num_axes; i++) {
+    int64_t dim = row_dims[i];
+    if (dim < 0 || dim > std::numeric_limits<int32_t>::max() ||
+        (row_size > 0 && dim > std::numeric_limits<int32_t>::max() / row_size))
+      return -1;
+    row_size *= dim;
+  }
+  return row_size;
+}
+
+/*
+  Sets `ans` to the header, row_dims and item table of a batch with these
+  args (see batch.h), followed by a table of `num_chunks` chunks that is
+  zero, for the caller to fill in before it appends the data of the
+  chunks.
+ */
+static void WriteBatchTables(int num_axes, const int64_t *row_dims,
+                             int64_t num_items, const int64_t *item_rows,
+                             int64_t num_chunks, std::vector<char> *ans) {
+  int64_t tables_offset = BatchTablesOffset(num_axes, num_items);
+  ans->assign(tables_offset + 16 * num_chunks, 0);
+  LilcomBatchHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = 'L';
+  header.batch_magic = 'B';
+  header.num_axes = num_axes;
+  header.num_items = num_items;
+  header.num_chunks = num_chunks;
+  memcpy(&((*ans)[0]), &header, sizeof(header));
+  if (num_axes > 1)
+    memcpy(&((*ans)[LILCOM_BATCH_HEADER_LEN]), row_dims,
+           8 * (num_axes - 1));
+  for (int64_t i = 0; i < num_items; i++) {
+    uint32_t rows = item_rows[i];
+    memcpy(&((*ans)[LILCOM_BATCH_HEADER_LEN + 8 * (num_axes - 1) + 4 * i]),
+           &rows, sizeof(rows));
+  }
+}
+
+/*
+  The parts of a batch, as located by ReadBatchLayout().
+ */
+struct BatchLayout {
+  int num_axes;
+  int64_t row_dims[16];
+  int64_t row_size;  /* The product of row_dims */
+  int64_t num_items;
+  int64_t num_chunks;
+  const char *item_rows;   /* uint32_t[num_items] */
+  const char *chunks;      /* uint64_t[num_chunks][2] */
+  const char *chunk_data;  /* The start of the data of the first chunk */
+  int64_t chunk_data_bytes;
+
+  int64_t ItemRows(int64_t i) const {
+    uint32_t rows;
+    memcpy(&rows, item_rows + 4 * i, sizeof(rows));
+    return rows;
+  }
+  int64_t ChunkFirstItem(int64_t c) const {
+    uint64_t first_item;
+    memcpy(&first_item, chunks + 16 * c, sizeof(first_item));
+    return first_item;
+  }
+  /* Returns the index of the item after the last one of chunk c. */
+  int64_t ChunkEndItem(int64_t c) const {
+    return (c + 1 < num_chunks ? ChunkFirstItem(c + 1) : num_items);
+  }
+  int64_t ChunkEnd(int64_t c) const {
+    uint64_t end;
+    memcpy(&end, chunks + 16 * c + 8, sizeof(end));
+    return end;
+  }
+  int64_t ChunkBegin(int64_t c) const {
+    return (c == 0 ? 0 : ChunkEnd(c - 1));
+  }
+};
+
+/*
+  Reads and checks the header and the tables of the batch at `src`.
+  Returns true on success, false if it is not a valid batch.
+ */
+static bool ReadBatchLayout(const char *src, int64_t num_bytes,
+                            BatchLayout *layout) {
+  LilcomBatchHeader header;
+  if (num_bytes < LILCOM_BATCH_HEADER_LEN)
+    return false;
+  memcpy(&header, src, sizeof(header));
+  if (header.magic != 'L' || header.batch_magic != 'B' ||
+      header.num_axes < 1 || header.num_axes > 16)
+    return false;
+  for (int i = 0; i < 5; i++)
+    if (header.reserved[i] != 0)
+      return false;
+  int num_axes = header.num_axes;
+  /* The limits on the counts are so that the offsets below can't
+     overflow. */
+  if (header.num_items > (uint64_t)num_bytes ||
+      header.num_chunks > header.num_items)
+    return false;
+  layout->num_axes = num_axes;
+  layout->num_items = header.num_items;
+  layout->num_chunks = header.num_chunks;
+  if ((layout->num_chunks == 0) != (layout->num_items == 0))
+    return false;
+  int64_t tables_offset = BatchTablesOffset(num_axes, layout->num_items),
+      data_offset = tables_offset + 16 * layout->num_chunks;
+  if (data_offset > num_bytes)
+    return false;
+
+  if (num_axes > 1)
+    memcpy(layout->row_dims, src + LILCOM_BATCH_HEADER_LEN,
+           8 * (num_axes - 1));
+  layout->row_size = RowSize(num_axes, layout->row_dims);
+  if (layout->row_size < 0)
+    return false;
+  layout->item_rows = src + LILCOM_BATCH_HEADER_LEN + 8 * (num_axes - 1);
+  layout->chunks = src + tables_offset;
+  layout->chunk_data = src + data_offset;
+  layout->chunk_data_bytes = num_bytes - data_offset;
+
+  int64_t prev_end = 0;
+  for (int64_t c = 0; c < layout->num_chunks; c++) {
+    int64_t first_item = layout->ChunkFirstItem(c),
+        end = layout->ChunkEnd(c);
+    if ((c == 0 ? first_item != 0 :
+         first_item <= layout->ChunkFirstItem(c - 1)) ||
+        first_item >= layout->num_items ||
+        end < prev_end || end > layout->chunk_data_bytes)
+      return false;
+    prev_end = end;
+  }
+  return (prev_end == layout->chunk_data_bytes);
+}
+
+
+std::vector<char> CompressFloatBatch(
+    int tick_power,
+    int64_t num_items,
+    const float *const *items,
+    const int64_t *item_rows,
+    int num_axes,
+    const int64_t *row_dims,
+    const int *regression_coeffs,
+    int flags,
+    int significant_bits,
+    int64_t chunk_elements) {
+  std::vector<char> ans;
+  if (num_items < 0 || num_axes < 1 || num_axes > 16 || chunk_elements < 1 ||
+      (flags & ~LILCOM_BATCH_FLAGS) != 0 ||
+      (num_items > 0 && (items == NULL || item_rows == NULL ||
+                         regression_coeffs == NULL)) ||
+      (num_axes > 1 && row_dims == NULL)) {
+    std::cerr << "lilcom: invalid args to CompressFloatBatch()\n";
+    return ans;
+  }
+  int64_t row_size = 1;
+  for (int i = 0; i + 1 < num_axes; i++) {
+    if (row_dims[i] < 0 || row_dims[i] > std::numeric_limits<int32_t>::max() ||
+        (row_size > 0 &&
+         row_dims[i] > std::numeric_limits<int32_t>::max() / row_size)) {
+      std::cerr << "lilcom: invalid dim in CompressFloatBatch(): "
+                << row_dims[i] << "\n";
+      return ans;
+    }
+    row_size *= row_dims[i];
+  }
+  for (int64_t i = 0; i < num_items; i++) {
+    if (item_rows[i] < 0 || item_rows[i] > std::numeric_limits<uint32_t>::max() ||
+        (items[i] == NULL && item_rows[i] * row_size != 0)) {
+      std::cerr << "lilcom: invalid item " << i
+                << " in CompressFloatBatch()\n";
+      return ans;
+    }
+  }
+
+  /* Divide the items into chunks: a chunk ends after the item that brings
+     it to chunk_elements elements. */
+  std::vector<int64_t> chunk_first_items;
+  int64_t elements_in_chunk = chunk_elements;
+  for (int64_t i = 0; i < num_items; i++) {
+    if (elements_in_chunk >= chunk_elements) {
+      chunk_first_items.push_back(i);
+      elements_in_chunk = 0;
+    }
+    elements_in_chunk += item_rows[i] * row_size;
+  }
+  int64_t num_chunks = chunk_first_items.size();
+
+  int64_t tables_offset = BatchTablesOffset(num_axes, num_items),
+      data_offset = tables_offset + 16 * num_chunks;
+  WriteBatchTables(num_axes, row_dims, num_items, item_rows, num_chunks,
+                   &ans);
+
+  int64_t dims[16], strides[16];
+  for (int i = 1; i < num_axes; i++)
+    dims[i] = row_dims[i - 1];
+  strides[num_axes - 1] = 1;
+  for (int i = num_axes - 2; i >= 0; i--)
+    strides[i] = strides[i + 1] * row_dims[i];
+
+  /* The memory for the chunks is reused from one chunk to the next. */
+  std::vector<float> chunk;
+  CompressionContext context;
+  for (int64_t c = 0; c < num_chunks; c++) {
+    int64_t first_item = chunk_first_items[c],
+        end_item = (c + 1 < num_chunks ? chunk_first_items[c + 1] : num_items),
+        rows = 0;
+    for (int64_t i = first_item; i < end_item; i++)
+      rows += item_rows[i];
+    if (rows * row_size != 0) {
+      /* Concatenate the items; this also gives CompressFloat() a copy to
+         change. */
+      chunk.resize(rows * row_size);
+      float *dest = &(chunk[0]);
+      for (int64_t i = first_item; i < end_item; i++) {
+        std::copy(items[i], items[i] + item_rows[i] * row_size, dest);
+        dest += item_rows[i] * row_size;
+      }
+      dims[0] = rows;
+      const std::vector<char> &code = CompressFloat(
+          &context, tick_power, &(chunk[0]), num_axes, dims, strides,
+          regression_coeffs, flags, significant_bits);
+      if (code.empty())
+        return code;  /* An error message will have been printed. */
+      ans.insert(ans.end(), code.begin(), code.end());
+    }
+    uint64_t entry[2] = { (uint64_t)first_item,
+                          (uint64_t)(ans.size() - data_offset) };
+    memcpy(&(ans[tables_offset + 16 * c]), entry, sizeof(entry));
+  }
+  return ans;
+}
+
+
+bool GetBatchShape(const char *src, int64_t num_bytes, int *num_axes,
+                   int64_t *row_dims, int64_t *num_items,
+                   std::vector<int64_t> *item_rows) {
+  BatchLayout layout;
+  if (!ReadBatchLayout(src, num_bytes, &layout))
+    return false;
+  *num_axes = layout.num_axes;
+  for (int i = 0; i + 1 < layout.num_axes; i++)
+    row_dims[i] = layout.row_dims[i];
+  *num_items = layout.num_items;
+  if (item_rows != NULL) {
+    item_rows->resize(layout.num_items);
+    for (int64_t i = 0; i < layout.num_items; i++)
+      (*item_rows)[i] = layout.ItemRows(i);
+  }
+  return true;
+}
+
+
+int64_t GetBatchItemRows(const char *src, int64_t num_bytes, int64_t index) {
+  BatchLayout layout;
+  if (!ReadBatchLayout(src, num_bytes, &layout) ||
+      index < 0 || index >= layout.num_items)
+    return -1;
+  return layout.ItemRows(index);
+}
+
+
+int DecompressBatchItems(const char *src, int64_t num_bytes,
+                         int64_t begin, int64_t end, float *data) {
+  BatchLayout layout;
+  if (!ReadBatchLayout(src, num_bytes, &layout) ||
+      begin < 0 || begin > end || end > layout.num_items)
+    return 13;
+  if (begin == end)
+    return 0;
+
+  int num_axes = layout.num_axes;
+  int64_t row_size = layout.row_size,
+      dims[16], strides[16];
+  for (int i = 1; i < num_axes; i++)
+    dims[i] = layout.row_dims[i - 1];
+  strides[num_axes - 1] = 1;
+  for (int i = num_axes - 2; i >= 0; i--)
+    strides[i] = strides[i + 1] * layout.row_dims[i];
+
+  /* Find the chunk that item `begin` is in: the last one whose first item
+     is <= begin. */
+  int64_t lo = 0, hi = layout.num_chunks;
+  while (hi - lo > 1) {
+    int64_t mid = (lo + hi) / 2;
+    if (layout.ChunkFirstItem(mid) <= begin)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  std::vector<float> temp;
+  DecompressionContext context;
+  for (int64_t c = lo; c < layout.num_chunks &&
+           layout.ChunkFirstItem(c) < end; c++) {
+    int64_t first_item = layout.ChunkFirstItem(c),
+        end_item = layout.ChunkEndItem(c),
+        rows = 0, skip_rows = 0, take_rows = 0;
+    for (int64_t i = first_item; i < end_item; i++) {
+      int64_t item_rows = layout.ItemRows(i);
+      rows += item_rows;
+      if (i < begin)
+        skip_rows += item_rows;
+      else if (i < end)
+        take_rows += item_rows;
+    }
+    const char *chunk_src = layout.chunk_data + layout.ChunkBegin(c);
+    int64_t chunk_bytes = layout.ChunkEnd(c) - layout.ChunkBegin(c);
+    if (rows == 0 || row_size == 0) {
+      if (chunk_bytes != 0)
+        return 13;
+      continue;
+    }
+    /* Check the shape before we allocate anything for it. */
+    int64_t chunk_shape[17];
+    if (!GetCompressedDataShape(chunk_src, chunk_bytes, chunk_shape) ||
+        chunk_shape[0] != num_axes || chunk_shape[1] != rows ||
+        rows > std::numeric_limits<int64_t>::max() / row_size)
+      return 13;
+    bool whole_chunk = (take_rows == rows);
+    float *dest = data;
+    if (!whole_chunk) {
+      temp.resize(rows * row_size);
+      dest = &(temp[0]);
+    }
+    dims[0] = rows;
+    int ret = DecompressFloat(&context, chunk_src, chunk_bytes, dest,
+                              num_axes, dims, strides);
+    if (ret != 0)
+      return ret;
+    if (!whole_chunk)
+      std::copy(temp.begin() + skip_rows * row_size,
+                temp.begin() + (skip_rows + take_rows) * row_size, data);
+    data += take_rows * row_size;
+  }
+  return 0;
+}
+
+
+std::vector<char> ConcatenateCompressed(int64_t num_inputs,
+                                        const char *const *srcs,
+                                        const int64_t *num_bytes) {
+  std::vector<char> ans;
+  if (num_inputs < 1 || srcs == NULL || num_bytes == NULL) {
+    std::cerr << "lilcom: invalid args to ConcatenateCompressed()\n";
+    return ans;
+  }
+  /* The item and chunk tables of the output, and the data of the chunks of
+     each input, which is copied unchanged. */
+  int num_axes = 0;
+  int64_t row_dims[16];
+  std::vector<int64_t> item_rows, chunk_first_items, chunk_ends;
+  std::vector<const char*> input_data(num_inputs);
+  std::vector<int64_t> input_data_bytes(num_inputs);
+  int64_t data_bytes = 0;
+  for (int64_t n = 0; n < num_inputs; n++) {
+    int input_num_axes;
+    int64_t input_row_dims[16];
+    BatchLayout layout;
+    if (ReadBatchLayout(srcs[n], num_bytes[n], &layout)) {
+      input_num_axes = layout.num_axes;
+      for (int i = 0; i + 1 < input_num_axes; i++)
+        input_row_dims[i] = layout.row_dims[i];
+      int64_t first_item = item_rows.size();
+      for (int64_t i = 0; i < layout.num_items; i++)
+        item_rows.push_back(layout.ItemRows(i));
+      for (int64_t c = 0; c < layout.num_chunks; c++) {
+        chunk_first_items.push_back(first_item + layout.ChunkFirstItem(c));
+        chunk_ends.push_back(data_bytes + layout.ChunkEnd(c));
+      }
+      input_data[n] = layout.chunk_data;
+      input_data_bytes[n] = layout.chunk_data_bytes;
+    } else {
+      /* The whole of an array compressed by CompressFloat() (or by
+         CompressFloatLayered(), if it is not cut short) becomes one chunk
+         with one item. */
+      int64_t shape[17];
+      int64_t layered_bytes = LayerPrefixBytes(srcs[n], num_bytes[n], -1);
+      if (!GetCompressedDataShape(srcs[n], num_bytes[n], shape) ||
+          GetCompressedDataType(srcs[n], num_bytes[n]) != LILCOM_TYPE_FLOAT32 ||
+          (layered_bytes >= 0 && layered_bytes != num_bytes[n]) ||
+          shape[1] > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "lilcom: input " << n << " to ConcatenateCompressed() "
+                  << "is neither a batch nor a compressed array of floats\n";
+        return ans;
+      }
+      input_num_axes = shape[0];
+      int64_t num_elements = shape[1];
+      for (int i = 0; i + 1 < input_num_axes; i++) {
+        input_row_dims[i] = shape[i + 2];
+        num_elements *= shape[i + 2];
+      }
+      chunk_first_items.push_back(item_rows.size());
+      item_rows.push_back(shape[1]);
+      input_data[n] = srcs[n];
+      /* A chunk with no elements has no data. */
+      input_data_bytes[n] = (num_elements == 0 ? 0 : num_bytes[n]);
+      chunk_ends.push_back(data_bytes + input_data_bytes[n]);
+    }
+
+    bool same_dims = (n == 0 || input_num_axes == num_axes);
+    for (int i = 0; n > 0 && same_dims && i + 1 < num_axes; i++)
+      same_dims = (input_row_dims[i] == row_dims[i]);
+    if (n == 0) {
+      num_axes = input_num_axes;
+      for (int i = 0; i + 1 < num_axes; i++)
+        row_dims[i] = input_row_dims[i];
+      same_dims = (RowSize(num_axes, row_dims) >= 0);
+    }
+    if (!same_dims) {
+      std::cerr << "lilcom: input " << n << " to ConcatenateCompressed() has "
+                << "different dims (except on axis 0) from the first one\n";
+      return ans;
+    }
+    data_bytes += input_data_bytes[n];
+  }
+
+  int64_t num_items = item_rows.size(),
+      num_chunks = chunk_first_items.size(),
+      tables_offset = BatchTablesOffset(num_axes, num_items);
+  WriteBatchTables(num_axes, row_dims, num_items,
+                   (num_items ? &(item_rows[0]) : NULL), num_chunks, &ans);
+  for (int64_t c = 0; c < num_chunks; c++) {
+    uint64_t entry[2] = { (uint64_t)chunk_first_items[c],
+                          (uint64_t)chunk_ends[c] };
+    memcpy(&(ans[tables_offset + 16 * c]), entry, sizeof(entry));
+  }
+  ans.reserve(ans.size() + data_bytes);
+  for (int64_t n = 0; n < num_inputs; n++)
+    ans.insert(ans.end(), input_data[n], input_data[n] + input_data_bytes[n]);
+  return ans;
+}
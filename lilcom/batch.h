@@ -0,0 +1,160 @@
+#ifndef __LILCOM__BATCH_H_
+#define __LILCOM__BATCH_H_ 1
+
+#include <stdint.h>
+#include <vector>
+#include "compression.h"
+
+
+/**
+   A batch stores many small arrays of floats (the items), e.g. per-token
+   embeddings or short segments of audio, in one piece of data, with less
+   overhead than compressing each of them with CompressFloat().  All the
+   items have the same number of axes and the same dims except on axis 0
+   (their "rows").  CompressFloatBatch() compresses them all with the same
+   tick_power, regression coefficients and flags, but each chunk has its
+   own header, so in a batch made by ConcatenateCompressed() they may
+   differ from chunk to chunk.
+
+   Consecutive items are concatenated along axis 0 into chunks of about
+   `chunk_elements` elements, and each chunk is compressed by
+   CompressFloat() as one array.  So the header and the start-up cost of
+   the stream of codes (e.g. the initial num_bits of class UintStream, and
+   the adaptive model with LILCOM_FLAG_ARITHMETIC_CODING) are paid once per
+   chunk rather than once per item, and the regression works across the
+   items of a chunk.  An item can be decompressed by its index, which
+   decompresses just the chunk it is in.
+
+   Batch data starts with 'L' then 'B' (where other lilcom data has its
+   format version, so DecompressFloat() etc. reject it), and is laid out
+   as follows; as in struct LilcomHeader, everything is little-endian and
+   at naturally aligned offsets:
+       struct LilcomBatchHeader
+       int64_t row_dims[num_axes - 1]   The dims of axes 1, 2, ... of the
+                                        items
+       uint32_t item_rows[num_items]    The dim of axis 0 of each item,
+                                        then zero padding up to a multiple
+                                        of 8 bytes
+       uint64_t chunks[num_chunks][2]   For each chunk, the index of its
+                                        first item and the offset of the end
+                                        of its data relative to the start
+                                        of the data of the first chunk
+   and then the chunks, each of which is data as returned by
+   CompressFloat() (or nothing if its items have no elements).
+ */
+
+struct LilcomBatchHeader {
+  char magic;               /* 'L' */
+  char batch_magic;         /* 'B' */
+  uint8_t num_axes;         /* Of each item, in the range [1, 16] */
+  uint8_t reserved[5];      /* 0 */
+  uint64_t num_items;
+  uint64_t num_chunks;
+};
+#define LILCOM_BATCH_HEADER_LEN 24  // sizeof(LilcomBatchHeader)
+
+/* The default number of elements per chunk: a compromise between the
+   overhead per chunk and the time to decompress one item. */
+#define LILCOM_BATCH_CHUNK_ELEMENTS 8192
+
+
+/*
+  Compresses a batch of arrays of floats.
+
+    @param [in] tick_power  As for CompressFloat()
+    @param [in] num_items  The number of items; must be >= 0.
+    @param [in] items  For each item, a pointer to its data, which must be
+                   contiguous (in C order).  It is not changed.  May be NULL
+                   for items with no rows.
+    @param [in] item_rows  The dim of axis 0 of each item, in [0, 2^32).
+    @param [in] num_axes  The number of axes of each item, in [1, 16]
+    @param [in] row_dims  The dims of axes 1, 2, ... num_axes - 1 of each
+                   item (may be NULL if num_axes == 1).
+    @param [in] regression_coeffs, flags, significant_bits  As for
+                   CompressFloat(); they are used for every chunk.  Only
+                   LILCOM_FLAG_ARITHMETIC_CODING, LILCOM_FLAG_SPARSE,
+                   LILCOM_FLAG_LOSSLESS and LILCOM_FLAG_ADAPTIVE are
+                   allowed.
+    @param [in] chunk_elements  The number of elements after which a chunk
+                   is ended; must be >= 1.  A chunk always contains at least
+                   one item, however large it is.
+    @return  Returns the compressed batch, or an empty vector if the args
+             were invalid.  Throws std::bad_alloc if allocation fails.
+ */
+std::vector<char> CompressFloatBatch(
+    int tick_power,
+    int64_t num_items,
+    const float *const *items,
+    const int64_t *item_rows,
+    int num_axes,
+    const int64_t *row_dims,
+    const int *regression_coeffs,
+    int flags,
+    int significant_bits = 0,
+    int64_t chunk_elements = LILCOM_BATCH_CHUNK_ELEMENTS);
+
+/*
+  Reads the shape of the items of a batch.
+     @param [in] src, num_bytes  The batch, as returned by
+                   CompressFloatBatch()
+     @param [out] num_axes  The number of axes of the items
+     @param [out] row_dims  Must have space for 15 elements; the first
+                   *num_axes - 1 will be set to the dims of axes 1, 2, ...
+     @param [out] num_items  The number of items
+     @param [out] item_rows  If not NULL, it will be set to the number of
+                   rows of each item.
+     @return  Returns true on success, false if `src` is not a valid batch
+              (the item table and the table of chunks are checked, but not
+              the data of the chunks).
+ */
+bool GetBatchShape(const char *src, int64_t num_bytes, int *num_axes,
+                   int64_t *row_dims, int64_t *num_items,
+                   std::vector<int64_t> *item_rows = NULL);
+
+/*
+  Returns the number of rows (the dim of axis 0) of item `index` of a
+  batch, or -1 if `src` is not a valid batch or index is out of range.
+ */
+int64_t GetBatchItemRows(const char *src, int64_t num_bytes, int64_t index);
+
+/*
+  Decompresses items [begin, end) of a batch, concatenated along axis 0,
+  into `data`.  Each chunk that they are in is decompressed once; chunks
+  that are entirely within the range are decompressed directly into
+  `data`.
+
+     @param [in] src, num_bytes  The batch
+     @param [in] begin, end  The range of items; 0 <= begin <= end <=
+                   num_items.
+     @param [out] data  Contiguous (C order) array with the sum of the
+                   rows of the items and the row_dims of the batch.
+     @return  Returns 0 on success, 13 if `src` is not a valid batch or the
+              range is invalid, or an error code returned by
+              DecompressFloat() for a chunk.
+ */
+int DecompressBatchItems(const char *src, int64_t num_bytes,
+                         int64_t begin, int64_t end, float *data);
+
+/*
+  Concatenates compressed arrays along axis 0 without decompressing them:
+  the data of each input is copied unchanged into a chunk of a batch, and
+  only the tables of the batch are written.  The result can be
+  decompressed as a whole (by DecompressBatchItems() with all the items),
+  or one input at a time.
+
+     @param [in] num_inputs  The number of inputs; must be >= 1.
+     @param [in] srcs, num_bytes  The inputs, each of which may be an
+                   array of floats compressed by CompressFloat() (with any
+                   tick_power, regression coefficients and flags), which
+                   becomes one item, or a batch, whose items and chunks
+                   are all kept.  They must have the same number of axes and
+                   the same dims except on axis 0.
+     @return  Returns the batch, or an empty vector if an input was not
+              valid or the dims did not match (an error message will have
+              been printed).  Throws std::bad_alloc if allocation fails.
+ */
+std::vector<char> ConcatenateCompressed(int64_t num_inputs,
+                                        const char *const *srcs,
+                                        const int64_t *num_bytes);
+
+#endif /* __LILCOM__BATCH_H_ */
@@ -0,0 +1,242 @@
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <vector>
+#include "batch.h"
+
+/*
+  Tests of the batches of small arrays in batch.h.
+ */
+
+#define ROW_DIM 8
+
+
+/* Makes `num_items` items of ROW_DIM columns and random numbers of rows
+   (some of them zero). */
+void make_items(int num_items, std::vector<std::vector<float> > *items,
+                std::vector<int64_t> *item_rows) {
+  items->resize(num_items);
+  item_rows->resize(num_items);
+  for (int i = 0; i < num_items; i++) {
+    int64_t rows = rand() % 6;
+    (*item_rows)[i] = rows;
+    (*items)[i].resize(rows * ROW_DIM);
+    for (int64_t j = 0; j < rows * ROW_DIM; j++)
+      (*items)[i][j] = sin(i * 0.3 + j * 0.1) + (rand() % 100) * 0.001;
+  }
+}
+
+void batch_test_round_trip(int flags, int64_t chunk_elements) {
+  std::vector<std::vector<float> > items;
+  std::vector<int64_t> item_rows;
+  int num_items = 300;
+  make_items(num_items, &items, &item_rows);
+  std::vector<const float*> item_ptrs(num_items);
+  for (int i = 0; i < num_items; i++)
+    item_ptrs[i] = (items[i].empty() ? NULL : &(items[i][0]));
+  int64_t row_dims[1] = { ROW_DIM };
+  int regression_coeffs[2] = { 0, 256 };
+  int tick_power = -8;
+  std::vector<char> batch = CompressFloatBatch(
+      tick_power, num_items, &(item_ptrs[0]), &(item_rows[0]), 2, row_dims,
+      regression_coeffs, flags, (flags & LILCOM_FLAG_ADAPTIVE ? 12 : 0),
+      chunk_elements);
+  assert(!batch.empty());
+
+  int num_axes;
+  int64_t dims[16], batch_num_items;
+  assert(GetBatchShape(&(batch[0]), batch.size(), &num_axes, dims,
+                       &batch_num_items));
+  assert(num_axes == 2 && dims[0] == ROW_DIM && batch_num_items == num_items);
+  std::vector<int64_t> batch_item_rows;
+  assert(GetBatchShape(&(batch[0]), batch.size(), &num_axes, dims,
+                       &batch_num_items, &batch_item_rows));
+  assert(batch_item_rows == item_rows);
+  float max_error = ((flags & LILCOM_FLAG_LOSSLESS) ? 0.0 :
+                     (flags & LILCOM_FLAG_ADAPTIVE) ? 0.01 :
+                     pow(2.0, tick_power - 1) + 1.0e-06);
+
+  /* Each item by itself. */
+  for (int i = 0; i < num_items; i++) {
+    assert(GetBatchItemRows(&(batch[0]), batch.size(), i) == item_rows[i]);
+    std::vector<float> item(item_rows[i] * ROW_DIM + 1);
+    assert(DecompressBatchItems(&(batch[0]), batch.size(), i, i + 1,
+                                &(item[0])) == 0);
+    for (size_t j = 0; j < items[i].size(); j++)
+      assert(fabs(item[j] - items[i][j]) <= max_error);
+  }
+  /* A range that spans several chunks, and all of them. */
+  int ranges[2][2] = { { 17, 211 }, { 0, num_items } };
+  for (int r = 0; r < 2; r++) {
+    int begin = ranges[r][0], end = ranges[r][1];
+    std::vector<float> all;
+    for (int i = begin; i < end; i++)
+      all.insert(all.end(), items[i].begin(), items[i].end());
+    std::vector<float> decompressed(all.size() + 1);
+    assert(DecompressBatchItems(&(batch[0]), batch.size(), begin, end,
+                                &(decompressed[0])) == 0);
+    for (size_t j = 0; j < all.size(); j++)
+      assert(fabs(decompressed[j] - all[j]) <= max_error);
+  }
+
+  /* Errors. */
+  assert(GetBatchItemRows(&(batch[0]), batch.size(), num_items) == -1);
+  assert(DecompressBatchItems(&(batch[0]), batch.size(), 5, 4, NULL) == 13);
+  assert(DecompressBatchItems(&(batch[0]), batch.size() - 1, 0, 1,
+                              NULL) == 13);
+  assert(!GetBatchShape(&(batch[0]), 10, &num_axes, dims, &batch_num_items));
+}
+
+/* A batch is much smaller than the items compressed separately. */
+void batch_test_size() {
+  std::vector<std::vector<float> > items;
+  std::vector<int64_t> item_rows;
+  int num_items = 1000;
+  make_items(num_items, &items, &item_rows);
+  std::vector<const float*> item_ptrs(num_items);
+  size_t separate_size = 0;
+  int64_t row_dims[1] = { ROW_DIM };
+  int regression_coeffs[2] = { 0, 0 };
+  for (int i = 0; i < num_items; i++) {
+    item_ptrs[i] = (items[i].empty() ? NULL : &(items[i][0]));
+    if (items[i].empty())
+      continue;
+    std::vector<float> copy(items[i]);
+    int64_t dims[2] = { item_rows[i], ROW_DIM }, strides[2] = { ROW_DIM, 1 };
+    separate_size += CompressFloat(-8, &(copy[0]), 2, dims, strides,
+                                   regression_coeffs, 0).size();
+  }
+  std::vector<char> batch = CompressFloatBatch(
+      -8, num_items, &(item_ptrs[0]), &(item_rows[0]), 2, row_dims,
+      regression_coeffs, 0);
+  std::cout << "Size of " << num_items << " items compressed separately is "
+            << separate_size << " bytes, as a batch " << batch.size()
+            << " bytes\n";
+  assert(batch.size() * 2 < separate_size);
+}
+
+void batch_test_empty() {
+  std::vector<char> batch = CompressFloatBatch(-8, 0, NULL, NULL, 1, NULL,
+                                               NULL, 0);
+  int num_axes;
+  int64_t dims[16], num_items;
+  assert(GetBatchShape(&(batch[0]), batch.size(), &num_axes, dims,
+                       &num_items));
+  assert(num_axes == 1 && num_items == 0);
+  assert(DecompressBatchItems(&(batch[0]), batch.size(), 0, 0, NULL) == 0);
+  /* Invalid flags. */
+  int64_t rows = 0;
+  const float *item = NULL;
+  assert(CompressFloatBatch(-8, 1, &item, &rows, 1, NULL, NULL,
+                            LILCOM_FLAG_INTEGER).empty());
+}
+
+/* Compresses `rows` rows of ROW_DIM columns with CompressFloat(), and sets
+   `decompressed` to what they decompress to. */
+std::vector<char> compress_rows(int64_t rows, int tick_power, int flags,
+                                std::vector<float> *decompressed) {
+  std::vector<float> data(rows * ROW_DIM + 1);
+  for (int64_t j = 0; j < rows * ROW_DIM; j++)
+    data[j] = cos(j * 0.05) + (rand() % 100) * 0.001;
+  int64_t dims[2] = { rows, ROW_DIM }, strides[2] = { ROW_DIM, 1 };
+  int regression_coeffs[2] = { 0, 200 };
+  std::vector<char> ans = CompressFloat(tick_power, &(data[0]), 2, dims,
+                                        strides, regression_coeffs, flags);
+  decompressed->resize(rows * ROW_DIM + 1);
+  assert(DecompressFloat(&(ans[0]), ans.size(), &((*decompressed)[0]), 2,
+                         dims, strides) == 0);
+  decompressed->resize(rows * ROW_DIM);
+  return ans;
+}
+
+/* Concatenating compressed arrays and batches gives a batch that
+   decompresses to exactly what they decompress to. */
+void batch_test_concatenate() {
+  std::vector<std::vector<char> > inputs;
+  std::vector<float> expected, decompressed;
+  inputs.push_back(compress_rows(10, -8, 0, &decompressed));
+  expected.insert(expected.end(), decompressed.begin(), decompressed.end());
+  inputs.push_back(compress_rows(0, -8, 0, &decompressed));
+  inputs.push_back(compress_rows(33, -4, LILCOM_FLAG_ARITHMETIC_CODING,
+                                 &decompressed));
+  expected.insert(expected.end(), decompressed.begin(), decompressed.end());
+
+  std::vector<std::vector<float> > items;
+  std::vector<int64_t> item_rows;
+  make_items(50, &items, &item_rows);
+  std::vector<const float*> item_ptrs(items.size());
+  for (size_t i = 0; i < items.size(); i++)
+    item_ptrs[i] = (items[i].empty() ? NULL : &(items[i][0]));
+  int64_t row_dims[1] = { ROW_DIM };
+  int regression_coeffs[2] = { 0, 0 };
+  inputs.push_back(CompressFloatBatch(-6, items.size(), &(item_ptrs[0]),
+                                      &(item_rows[0]), 2, row_dims,
+                                      regression_coeffs,
+                                      LILCOM_FLAG_LOSSLESS, 0, 40));
+  for (size_t i = 0; i < items.size(); i++)
+    expected.insert(expected.end(), items[i].begin(), items[i].end());
+  inputs.push_back(compress_rows(7, -10, LILCOM_FLAG_SPARSE, &decompressed));
+  expected.insert(expected.end(), decompressed.begin(), decompressed.end());
+
+  std::vector<const char*> srcs;
+  std::vector<int64_t> num_bytes;
+  for (size_t n = 0; n < inputs.size(); n++) {
+    srcs.push_back(&(inputs[n][0]));
+    num_bytes.push_back(inputs[n].size());
+  }
+  std::vector<char> batch = ConcatenateCompressed(srcs.size(), &(srcs[0]),
+                                                  &(num_bytes[0]));
+  int num_axes;
+  int64_t dims[16], num_items;
+  assert(GetBatchShape(&(batch[0]), batch.size(), &num_axes, dims,
+                       &num_items));
+  assert(num_axes == 2 && dims[0] == ROW_DIM && num_items == 54);
+  assert(GetBatchItemRows(&(batch[0]), batch.size(), 2) == 33);
+  std::vector<float> all(expected.size() + 1);
+  assert(DecompressBatchItems(&(batch[0]), batch.size(), 0, num_items,
+                              &(all[0])) == 0);
+  all.resize(expected.size());
+  assert(all == expected);
+
+  /* A concatenation can be concatenated again. */
+  const char *twice_srcs[2] = { &(batch[0]), srcs[0] };
+  int64_t twice_num_bytes[2] = { (int64_t)batch.size(), num_bytes[0] };
+  std::vector<char> twice = ConcatenateCompressed(2, twice_srcs,
+                                                  twice_num_bytes);
+  std::vector<float> last(10 * ROW_DIM);
+  assert(DecompressBatchItems(&(twice[0]), twice.size(), 54, 55,
+                              &(last[0])) == 0);
+  assert(std::equal(last.begin(), last.end(), expected.begin()));
+
+  /* Errors: different row dims, and integer data. */
+  std::vector<float> one_column(5, 1.0);
+  int64_t column_dims[1] = { 5 }, column_strides[1] = { 1 };
+  std::vector<char> other = CompressFloat(-8, &(one_column[0]), 1,
+                                          column_dims, column_strides,
+                                          regression_coeffs);
+  const char *bad_srcs[2] = { srcs[0], &(other[0]) };
+  int64_t bad_num_bytes[2] = { num_bytes[0], (int64_t)other.size() };
+  assert(ConcatenateCompressed(2, bad_srcs, bad_num_bytes).empty());
+  int16_t ints[5] = { 1, 2, 3, 4, 5 };
+  std::vector<char> int_data = CompressInt(ints, 1, column_dims,
+                                           column_strides, regression_coeffs);
+  bad_srcs[1] = &(int_data[0]);
+  bad_num_bytes[1] = int_data.size();
+  assert(ConcatenateCompressed(1, bad_srcs + 1, bad_num_bytes + 1).empty());
+}
+
+
+int main() {
+  batch_test_round_trip(0, LILCOM_BATCH_CHUNK_ELEMENTS);
+  batch_test_round_trip(0, 100);
+  batch_test_round_trip(LILCOM_FLAG_ARITHMETIC_CODING, 1);
+  batch_test_round_trip(LILCOM_FLAG_LOSSLESS, 500);
+  batch_test_round_trip(LILCOM_FLAG_ADAPTIVE, 1000);
+  batch_test_size();
+  batch_test_empty();
+  batch_test_concatenate();
+  std::cout << "Done\n";
+  return 0;
+}
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""
+Compression-ratio and throughput regression harness for lilcom.
+
+This compresses a fixed corpus (speech features, model weights, audio and
+sparse activations, generated with fixed random seeds, or loaded from .npy
+files in a directory), sweeping tick_power and regression on/off, and
+records the bytes per element, the maximum error, the encode and decode
+speed and the peak memory use.  The results can be written as JSON and
+compared against a stored baseline, e.g.:
+
+   lilcom-bench --output=baseline.json
+   ... make changes ...
+   lilcom-bench --baseline=baseline.json
+
+which exits with status 1 if anything got worse by more than the
+tolerances.  (`python3 -m lilcom.bench` does the same as `lilcom-bench`;
+see also `make bench-regression` in lilcom/Makefile.)
+"""
+
+import argparse
+import json
+import os
+import resource
+import sys
+import time
+
+import numpy as np
+
+import lilcom
+
+
+def generate_corpus(scale=1.0):
+  """
+  Returns a dict from name to a float32 array, for the default corpus.  The
+  arrays are the same every time for the same `scale`, which multiplies
+  the number of rows (or samples) of each.
+  """
+  def rows(n):
+    return max(2, int(n * scale))
+  rng = np.random.RandomState(0)
+  corpus = {}
+
+  # Log-mel-like speech features: smooth along both time and frequency.
+  t = rows(2000)
+  energy = np.cumsum(rng.randn(t, 1) * 0.3, axis=0)
+  spectrum = np.cumsum(rng.randn(t, 80) * 0.5, axis=1) * 0.2
+  corpus['speech_features'] = (energy + spectrum + rng.randn(t, 80) * 0.3)
+
+  # Weights of a neural net layer.
+  corpus['model_weights'] = rng.randn(rows(512), 512) * 0.02
+
+  # 16kHz audio: a few harmonics with a varying amplitude, plus noise.
+  n = rows(160000)
+  x = np.arange(n) / 16000.0
+  amplitude = 0.3 * (1.1 + np.sin(2 * np.pi * 0.7 * x))
+  corpus['audio'] = (amplitude * (np.sin(2 * np.pi * 200 * x) +
+                                  0.5 * np.sin(2 * np.pi * 600 * x)) +
+                     0.01 * rng.randn(n))
+
+  # ReLU activations, mostly zero.
+  corpus['sparse_activations'] = np.maximum(0.0, rng.randn(rows(256), 1024) - 0.6)
+
+  return dict((k, v.astype(np.float32)) for k, v in corpus.items())
+
+
+def load_corpus(dirname):
+  """
+  Returns a dict from name to array for the files *.npy in `dirname`.
+  """
+  corpus = {}
+  for f in sorted(os.listdir(dirname)):
+    if f.endswith('.npy'):
+      corpus[f[:-4]] = np.load(os.path.join(dirname, f))
+  if not corpus:
+    raise ValueError("No .npy files in {}".format(dirname))
+  return corpus
+
+
+def peak_rss_mb():
+  # ru_maxrss is in kilobytes on Linux, bytes on macOS.
+  maxrss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+  return maxrss / (1024.0 * 1024.0 if sys.platform == 'darwin' else 1024.0)
+
+
+def time_best(fn, reps):
+  """
+  Calls fn() `reps` times; returns (the smallest time taken in seconds,
+  the return value of the last call).
+  """
+  best = None
+  for _ in range(reps):
+    start = time.perf_counter()
+    ans = fn()
+    elapsed = time.perf_counter() - start
+    best = elapsed if best is None else min(best, elapsed)
+  return best, ans
+
+
+def run(corpus, tick_powers, reps):
+  """
+  Runs the sweep; returns a list of dicts, one per (corpus entry,
+  tick_power, regression).
+  """
+  results = []
+  for name in sorted(corpus.keys()):
+    a = corpus[name]
+    # Speeds are in MB/s of the input as float32, whatever its dtype.
+    megabytes = a.size * 4 / 1.0e6
+    for tick_power in tick_powers:
+      for regression in [ True, False ]:
+        encode_time, b = time_best(
+            lambda: lilcom.compress(a, tick_power=tick_power,
+                                    do_regression=regression), reps)
+        decode_time, a2 = time_best(lambda: lilcom.decompress(b), reps)
+        err = np.abs(a2.astype(np.float64) - a.astype(np.float64))
+        results.append({
+            'corpus': name,
+            'tick_power': tick_power,
+            'regression': regression,
+            'num_elements': int(a.size),
+            'bytes_per_element': len(b) / a.size,
+            'max_error': float(err.max()) if err.size else 0.0,
+            'encode_mb_per_sec': megabytes / max(encode_time, 1.0e-9),
+            'decode_mb_per_sec': megabytes / max(decode_time, 1.0e-9) })
+  return results
+
+
+def _key(result):
+  return (result['corpus'], result['tick_power'], result['regression'])
+
+
+def compare(results, baseline, size_tolerance=0.01, speed_tolerance=0.3,
+            memory_tolerance=0.25):
+  """
+  Compares results (as returned by main(), i.e. a dict with 'results' and
+  'peak_rss_mb') with a baseline in the same format.
+
+     @param [in] size_tolerance  The relative increase in bytes per element
+                   or maximum error that is allowed
+     @param [in] speed_tolerance  The relative decrease in encode or
+                   decode speed that is allowed
+     @param [in] memory_tolerance  The relative increase in peak memory
+                   use that is allowed
+
+  Returns a list of strings describing the regressions (empty if there
+  were none).  Entries that are in only one of the two are not regressions.
+  """
+  problems = []
+  baseline_results = dict((_key(r), r) for r in baseline['results'])
+  for r in results['results']:
+    b = baseline_results.get(_key(r))
+    if b is None:
+      continue
+    name = "{}, tick_power={}, regression={}".format(*_key(r))
+    for field, tolerance, larger_is_worse in [
+        ('bytes_per_element', size_tolerance, True),
+        ('max_error', size_tolerance, True),
+        ('encode_mb_per_sec', speed_tolerance, False),
+        ('decode_mb_per_sec', speed_tolerance, False) ]:
+      if larger_is_worse:
+        bad = r[field] > b[field] * (1 + tolerance) + 1.0e-12
+      else:
+        bad = r[field] < b[field] * (1 - tolerance)
+      if bad:
+        problems.append("{}: {} changed from {:.6g} to {:.6g}".format(
+            name, field, b[field], r[field]))
+  if results['peak_rss_mb'] > baseline['peak_rss_mb'] * (1 + memory_tolerance):
+    problems.append("peak_rss_mb changed from {:.1f} to {:.1f}".format(
+        baseline['peak_rss_mb'], results['peak_rss_mb']))
+  return problems
+
+
+def main(argv=None):
+  parser = argparse.ArgumentParser(
+      description="Measures lilcom's compression ratio and speed on a fixed "
+      "corpus, and optionally compares them with a baseline.")
+  parser.add_argument('--corpus-dir', help="Directory of .npy files to use "
+                      "instead of the generated corpus")
+  parser.add_argument('--scale', type=float, default=1.0,
+                      help="Scales the size of the generated corpus")
+  parser.add_argument('--tick-powers', default='-10,-8,-6',
+                      help="Comma-separated list of tick_powers to sweep")
+  parser.add_argument('--reps', type=int, default=5,
+                      help="Number of timing repetitions (the best is used)")
+  parser.add_argument('--output', help="File to write the results to, as JSON")
+  parser.add_argument('--baseline', help="JSON file written by --output "
+                      "to compare the results with")
+  parser.add_argument('--size-tolerance', type=float, default=0.01)
+  parser.add_argument('--speed-tolerance', type=float, default=0.3)
+  parser.add_argument('--memory-tolerance', type=float, default=0.25)
+  args = parser.parse_args(argv)
+
+  if args.corpus_dir is not None:
+    corpus = load_corpus(args.corpus_dir)
+  else:
+    corpus = generate_corpus(args.scale)
+  tick_powers = [ int(x) for x in args.tick_powers.split(',') ]
+  results = { 'results': run(corpus, tick_powers, max(1, args.reps)),
+              'peak_rss_mb': peak_rss_mb() }
+
+  print("{:<20} {:>5} {:>5} {:>10} {:>10} {:>10} {:>10}".format(
+      'corpus', 'tick', 'regr', 'bytes/el', 'max_err', 'enc_MB/s', 'dec_MB/s'))
+  for r in results['results']:
+    print("{:<20} {:>5} {:>5} {:>10.4f} {:>10.3g} {:>10.1f} {:>10.1f}".format(
+        r['corpus'], r['tick_power'], int(r['regression']),
+        r['bytes_per_element'], r['max_error'], r['encode_mb_per_sec'],
+        r['decode_mb_per_sec']))
+  print("peak_rss_mb: {:.1f}".format(results['peak_rss_mb']))
+
+  if args.output is not None:
+    with open(args.output, 'w') as f:
+      json.dump(results, f, indent=1)
+  if args.baseline is not None:
+    with open(args.baseline) as f:
+      baseline = json.load(f)
+    problems = compare(results, baseline, args.size_tolerance,
+                       args.speed_tolerance, args.memory_tolerance)
+    for p in problems:
+      print("REGRESSION: " + p)
+    if problems:
+      return 1
+    print("No regressions relative to " + args.baseline)
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -67,6 +67,22 @@ class BitStream {
     return code_;
   }
 
+  /* Returns the number of bytes in the code.  Like Code(), this flushes
+     the stream so you cannot call Write() after calling it. */
+  size_t NumBytes() {
+    if (!flushed_) Flush();
+    return code_.size();
+  }
+
+  /*
+    Exchanges the vector that the code is appended to with `*code`.  If
+    this is called before the first Write(), the code will be appended to
+    the contents of `*code` (e.g. a header), using the memory it already
+    has; after Code(), it takes the code out without copying it.  Note
+    that Code() and NumBytes() include whatever was in the vector before.
+   */
+  void SwapCode(std::vector<char> *code) { code_.swap(*code); }
+
  private:
   /**
      Flushes out the last partial byte.  This is called exactly once,
@@ -97,6 +113,33 @@ class BitStream {
 };
 
 
+/**
+   class BitCounter has the same writing interface as class BitStream, but
+   instead of packing the bits into bytes it only counts them.  It is used
+   to work out the size of the code that would be produced (e.g. for
+   choosing the compression accuracy to meet a size budget), at lower
+   cost than actually producing it.
+ */
+class BitCounter {
+ public:
+  BitCounter(): num_bits_(0) { }
+
+  /* Same interface as BitStream::Write(); only the number of bits
+     matters here. */
+  inline void Write(int num_bits_in, uint32_t bits_in) {
+    assert(static_cast<unsigned int>(num_bits_in) <= 32);
+    num_bits_ += num_bits_in;
+  }
+
+  /* Returns the number of bytes BitStream would have produced given
+     the same sequence of calls to Write(). */
+  size_t NumBytes() const { return (num_bits_ + 7) / 8; }
+
+ private:
+  uint64_t num_bits_;
+};
+
+
 class ReverseBitStream {
  public:
   /*
@@ -0,0 +1,426 @@
+/*
+  Microbenchmarks for the layers of lilcom: class BitStream, class
+  UintStream and the float codec (CompressFloat() and DecompressFloat()),
+  on synthetic data with various distributions.
+
+  Usage: codec_bench [options]
+     --size=N       Number of elements per benchmark (default: 1000000)
+     --reps=N       Number of timed repetitions (default: 10)
+     --warmup=N     Number of untimed repetitions first (default: 2)
+     --filter=STR   Only run benchmarks whose name contains STR
+     --json         Print the results as JSON rather than as a table
+
+  For each benchmark we print the minimum, median, 90th percentile and
+  maximum time over the repetitions, and the throughput at the median time
+  in elements/sec and bytes/sec.  The bytes are those of the uncompressed
+  values (4 per element), so the bytes/sec of different benchmarks are
+  comparable; the size of the code is printed separately.
+
+  This is built by `make codec_bench` (and run by `make bench`); it is not
+  part of `make test`.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "bit_stream.h"
+#include "int_stream.h"
+#include "int_math_utils.h"
+#include "compression.h"
+
+
+/* Accumulates a value from the output of each benchmark, so the compiler
+   cannot optimize the work away. */
+static volatile uint64_t bench_sink = 0;
+
+
+/*
+  Synthetic data.  All are deterministic given the seed, so that results of
+  different runs are comparable.
+     @param [in] distribution  One of "laplacian", "gaussian", "sparse"
+                   (90% zeros, the rest Gaussian), "constant", or "audio"
+                   (a mixture of sinusoids plus autocorrelated noise, with
+                   a slowly varying amplitude).
+     @param [in] n  The number of elements to generate
+     @param [out] data  The data will be written to here.
+     @return  Returns false if the distribution was not recognized.
+ */
+static bool GenerateData(const std::string &distribution, int64_t n,
+                         std::vector<float> *data) {
+  std::mt19937 rng(1234);
+  std::normal_distribution<float> gauss(0.0, 1.0);
+  std::uniform_real_distribution<float> uniform(0.0, 1.0);
+  data->resize(n);
+  float *d = data->data();
+  if (distribution == "laplacian") {
+    std::exponential_distribution<float> expo(1.0);
+    for (int64_t i = 0; i < n; i++)
+      d[i] = (uniform(rng) < 0.5 ? -1 : 1) * expo(rng);
+  } else if (distribution == "gaussian") {
+    for (int64_t i = 0; i < n; i++)
+      d[i] = gauss(rng);
+  } else if (distribution == "sparse") {
+    for (int64_t i = 0; i < n; i++)
+      d[i] = (uniform(rng) < 0.9 ? 0.0 : gauss(rng));
+  } else if (distribution == "constant") {
+    for (int64_t i = 0; i < n; i++)
+      d[i] = 0.25;
+  } else if (distribution == "audio") {
+    float noise = 0.0;
+    for (int64_t i = 0; i < n; i++) {
+      double t = i / 16000.0;
+      noise = 0.95 * noise + 0.05 * gauss(rng);
+      float amplitude = 0.5 * (1.1 + sin(2 * M_PI * 0.5 * t));
+      d[i] = amplitude * (0.3 * sin(2 * M_PI * 220 * t) +
+                          0.2 * sin(2 * M_PI * 331 * t) +
+                          0.1 * sin(2 * M_PI * 1250 * t)) + noise;
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/* Returns the regression coefficient on the previous element (times 256,
+   as used by CompressFloat()) that the Python code would choose for 1-d
+   data; see regress_array() in lilcom_interface.py. */
+static int RegressionCoeff(const std::vector<float> &data) {
+  double prod = 0.0, sumsq = 1.0e-20;
+  for (size_t i = 1; i < data.size(); i++) {
+    prod += data[i - 1] * (double)data[i];
+    sumsq += data[i - 1] * (double)data[i - 1];
+  }
+  double coeff = prod / sumsq;
+  if (fabs(coeff) < 0.02) coeff = 0.0;
+  coeff = std::max(-1.0, std::min(1.0, coeff));
+  return (int)round(coeff * 256);
+}
+
+
+/*
+  A benchmark.  Setup() is called before each repetition and is not
+  timed; Run() is timed.  Run() returns the size of the code produced or
+  consumed, in bytes.
+ */
+class Benchmark {
+ public:
+  Benchmark(const std::string &name, const std::vector<float> &data):
+      name_(name), data_(data) { }
+  virtual void Setup() { }
+  virtual size_t Run() = 0;
+  const std::string &Name() const { return name_; }
+  int64_t NumElements() const { return data_.size(); }
+  virtual ~Benchmark() { }
+ protected:
+  std::string name_;
+  const std::vector<float> &data_;
+};
+
+/* Converts the data to integers as CompressFloat() would with
+   tick_power = -8 and no regression, for the stream benchmarks. */
+static void QuantizeData(const std::vector<float> &data,
+                         std::vector<int32_t> *ints) {
+  ints->resize(data.size());
+  for (size_t i = 0; i < data.size(); i++)
+    (*ints)[i] = (int32_t)round(data[i] * 256.0f);
+}
+
+class BitStreamWriteBenchmark: public Benchmark {
+ public:
+  BitStreamWriteBenchmark(const std::string &name,
+                          const std::vector<float> &data):
+      Benchmark(name, data) {
+    QuantizeData(data, &ints_);
+  }
+  virtual size_t Run() {
+    BitStream bs;
+    for (size_t i = 0; i < ints_.size(); i++) {
+      uint32_t u = ints_[i] < 0 ? -(uint32_t)ints_[i] : ints_[i];
+      bs.Write(int_math::num_bits(u), u);
+    }
+    bench_sink += bs.Code().size();
+    return bs.Code().size();
+  }
+ private:
+  std::vector<int32_t> ints_;
+};
+
+class BitStreamReadBenchmark: public Benchmark {
+ public:
+  BitStreamReadBenchmark(const std::string &name,
+                         const std::vector<float> &data):
+      Benchmark(name, data) {
+    std::vector<int32_t> ints;
+    QuantizeData(data, &ints);
+    BitStream bs;
+    for (size_t i = 0; i < ints.size(); i++) {
+      uint32_t u = ints[i] < 0 ? -(uint32_t)ints[i] : ints[i];
+      num_bits_.push_back(int_math::num_bits(u));
+      bs.Write(num_bits_.back(), u);
+    }
+    code_ = bs.Code();
+  }
+  virtual size_t Run() {
+    const char *code = code_.data();
+    ReverseBitStream rbs(code, code + code_.size());
+    uint32_t sum = 0, bits;
+    for (size_t i = 0; i < num_bits_.size(); i++) {
+      if (!rbs.Read(num_bits_[i], &bits)) {
+        std::cerr << "codec_bench: failed to read bits\n";
+        exit(1);
+      }
+      sum += bits;
+    }
+    bench_sink += sum;
+    return code_.size();
+  }
+ private:
+  std::vector<int> num_bits_;
+  std::vector<char> code_;
+};
+
+class UintStreamWriteBenchmark: public Benchmark {
+ public:
+  UintStreamWriteBenchmark(const std::string &name,
+                           const std::vector<float> &data):
+      Benchmark(name, data) {
+    std::vector<int32_t> ints;
+    QuantizeData(data, &ints);
+    uints_.resize(ints.size());
+    for (size_t i = 0; i < ints.size(); i++)
+      uints_[i] = ints[i] < 0 ? -(uint32_t)ints[i] : ints[i];
+  }
+  virtual size_t Run() {
+    UintStream us;
+    for (size_t i = 0; i < uints_.size(); i++)
+      us.Write(uints_[i]);
+    bench_sink += us.Code().size();
+    return us.Code().size();
+  }
+ private:
+  std::vector<uint32_t> uints_;
+};
+
+class UintStreamReadBenchmark: public Benchmark {
+ public:
+  UintStreamReadBenchmark(const std::string &name,
+                          const std::vector<float> &data):
+      Benchmark(name, data) {
+    std::vector<int32_t> ints;
+    QuantizeData(data, &ints);
+    UintStream us;
+    for (size_t i = 0; i < ints.size(); i++)
+      us.Write(ints[i] < 0 ? -(uint32_t)ints[i] : ints[i]);
+    code_ = us.Code();
+  }
+  virtual size_t Run() {
+    const char *code = code_.data();
+    ReverseUintStream rus(code, code + code_.size());
+    uint32_t sum = 0, value;
+    for (int64_t i = 0; i < NumElements(); i++) {
+      if (!rus.Read(&value)) {
+        std::cerr << "codec_bench: failed to read from UintStream\n";
+        exit(1);
+      }
+      sum += value;
+    }
+    bench_sink += sum;
+    return code_.size();
+  }
+ private:
+  std::vector<char> code_;
+};
+
+/* CompressFloat() overwrites its input, so Setup() copies the data. */
+class CompressFloatBenchmark: public Benchmark {
+ public:
+  CompressFloatBenchmark(const std::string &name,
+                         const std::vector<float> &data, int flags):
+      Benchmark(name, data), flags_(flags),
+      regression_coeff_(RegressionCoeff(data)) { }
+  virtual void Setup() { copy_ = data_; }
+  virtual size_t Run() {
+    int64_t dim = copy_.size(), stride = 1;
+    std::vector<char> code = CompressFloat(-8, copy_.data(), 1, &dim, &stride,
+                                           &regression_coeff_, flags_);
+    if (code.empty()) {
+      std::cerr << "codec_bench: CompressFloat failed\n";
+      exit(1);
+    }
+    bench_sink += code.size();
+    return code.size();
+  }
+ private:
+  int flags_;
+  int regression_coeff_;
+  std::vector<float> copy_;
+};
+
+class DecompressFloatBenchmark: public Benchmark {
+ public:
+  DecompressFloatBenchmark(const std::string &name,
+                           const std::vector<float> &data, int flags):
+      Benchmark(name, data), output_(data.size()) {
+    std::vector<float> copy(data);
+    int64_t dim = copy.size(), stride = 1;
+    int regression_coeff = RegressionCoeff(data);
+    code_ = CompressFloat(-8, copy.data(), 1, &dim, &stride,
+                          &regression_coeff, flags);
+  }
+  virtual size_t Run() {
+    int64_t dim = output_.size(), stride = 1;
+    int ret = DecompressFloat(code_.data(), code_.size(), output_.data(), 1,
+                              &dim, &stride);
+    if (ret != 0) {
+      std::cerr << "codec_bench: DecompressFloat failed with code "
+                << ret << "\n";
+      exit(1);
+    }
+    bench_sink += (uint64_t)output_[output_.size() / 2];
+    return code_.size();
+  }
+ private:
+  std::vector<char> code_;
+  std::vector<float> output_;
+};
+
+
+struct BenchmarkResult {
+  std::string name;
+  int64_t num_elements;
+  size_t code_bytes;
+  /* The sorted times of the repetitions, in seconds. */
+  std::vector<double> times;
+
+  /* Returns the p'th percentile of the times, for p in [0,100]. */
+  double Percentile(double p) const {
+    int i = (int)ceil(p / 100.0 * times.size()) - 1;
+    return times[std::max(0, std::min<int>(i, times.size() - 1))];
+  }
+};
+
+static BenchmarkResult RunBenchmark(Benchmark *b, int warmup, int reps) {
+  BenchmarkResult ans;
+  ans.name = b->Name();
+  ans.num_elements = b->NumElements();
+  for (int r = 0; r < warmup + reps; r++) {
+    b->Setup();
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    ans.code_bytes = b->Run();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (r >= warmup)
+      ans.times.push_back(elapsed.count());
+  }
+  std::sort(ans.times.begin(), ans.times.end());
+  return ans;
+}
+
+static void PrintTable(const std::vector<BenchmarkResult> &results) {
+  printf("%-36s %10s %10s %10s %10s %12s %12s %10s\n", "benchmark",
+         "min_ms", "median_ms", "p90_ms", "max_ms", "Melem/s", "MB/s",
+         "code_B/el");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult &r = results[i];
+    double median = r.Percentile(50);
+    printf("%-36s %10.3f %10.3f %10.3f %10.3f %12.2f %12.2f %10.4f\n",
+           r.name.c_str(), 1000 * r.times.front(), 1000 * median,
+           1000 * r.Percentile(90), 1000 * r.times.back(),
+           r.num_elements / median / 1.0e6,
+           4.0 * r.num_elements / median / 1.0e6,
+           (double)r.code_bytes / r.num_elements);
+  }
+}
+
+static void PrintJson(const std::vector<BenchmarkResult> &results,
+                      int warmup, int reps) {
+  printf("{\"warmup\": %d, \"reps\": %d, \"benchmarks\": [\n", warmup, reps);
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult &r = results[i];
+    double median = r.Percentile(50);
+    printf("  {\"name\": \"%s\", \"num_elements\": %lld, "
+           "\"code_bytes\": %lld, \"min_s\": %.9g, \"median_s\": %.9g, "
+           "\"p90_s\": %.9g, \"max_s\": %.9g, \"elements_per_sec\": %.6g, "
+           "\"bytes_per_sec\": %.6g}%s\n",
+           r.name.c_str(), (long long)r.num_elements, (long long)r.code_bytes,
+           r.times.front(), median, r.Percentile(90), r.times.back(),
+           r.num_elements / median, 4.0 * r.num_elements / median,
+           (i + 1 < results.size() ? "," : ""));
+  }
+  printf("]}\n");
+}
+
+/* Parses an option of the form --name=value into *value; returns false if
+   `arg` is not that option. */
+static bool ParseOption(const char *arg, const char *name, std::string *value) {
+  size_t len = strlen(name);
+  if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+    return false;
+  *value = arg + len + 1;
+  return true;
+}
+
+
+int main(int argc, char **argv) {
+  int64_t size = 1000000;
+  int reps = 10, warmup = 2;
+  bool json = false;
+  std::string filter, value;
+  for (int i = 1; i < argc; i++) {
+    if (ParseOption(argv[i], "--size", &value)) size = atoll(value.c_str());
+    else if (ParseOption(argv[i], "--reps", &value)) reps = atoi(value.c_str());
+    else if (ParseOption(argv[i], "--warmup", &value)) warmup = atoi(value.c_str());
+    else if (ParseOption(argv[i], "--filter", &value)) filter = value;
+    else if (!strcmp(argv[i], "--json")) json = true;
+    else {
+      std::cerr << "Usage: codec_bench [--size=N] [--reps=N] [--warmup=N] "
+          "[--filter=STR] [--json]\n";
+      return 1;
+    }
+  }
+  if (size <= 0 || reps <= 0 || warmup < 0) {
+    std::cerr << "codec_bench: invalid options\n";
+    return 1;
+  }
+
+  const char *distributions[] = { "laplacian", "gaussian", "sparse",
+                                  "constant", "audio" };
+  const int num_distributions = sizeof(distributions) / sizeof(distributions[0]);
+  std::vector<std::vector<float> > data(num_distributions);
+  std::vector<Benchmark*> benchmarks;
+  for (int i = 0; i < num_distributions; i++) {
+    std::string d = distributions[i];
+    GenerateData(d, size, &data[i]);
+    benchmarks.push_back(new BitStreamWriteBenchmark("bit_stream_write/" + d, data[i]));
+    benchmarks.push_back(new BitStreamReadBenchmark("bit_stream_read/" + d, data[i]));
+    benchmarks.push_back(new UintStreamWriteBenchmark("uint_stream_write/" + d, data[i]));
+    benchmarks.push_back(new UintStreamReadBenchmark("uint_stream_read/" + d, data[i]));
+    benchmarks.push_back(new CompressFloatBenchmark("compress_float/" + d, data[i], 0));
+    benchmarks.push_back(new DecompressFloatBenchmark("decompress_float/" + d, data[i], 0));
+    benchmarks.push_back(new CompressFloatBenchmark(
+        "compress_float_arith/" + d, data[i], LILCOM_FLAG_ARITHMETIC_CODING));
+    benchmarks.push_back(new DecompressFloatBenchmark(
+        "decompress_float_arith/" + d, data[i], LILCOM_FLAG_ARITHMETIC_CODING));
+  }
+
+  std::vector<BenchmarkResult> results;
+  for (size_t i = 0; i < benchmarks.size(); i++) {
+    if (benchmarks[i]->Name().find(filter) != std::string::npos)
+      results.push_back(RunBenchmark(benchmarks[i], warmup, reps));
+    delete benchmarks[i];
+  }
+  if (json)
+    PrintJson(results, warmup, reps);
+  else
+    PrintTable(results);
+  return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef __LILCOM__CODEC_CONTEXT_H_
+#define __LILCOM__CODEC_CONTEXT_H_ 1
+
+#include <stdint.h>
+#include <vector>
+
+
+/**
+   The memory that CompressFloat() and DecompressFloat() need, for callers
+   that compress or decompress many arrays and want to avoid the cost of
+   allocating it each time: pass the same context to each call (see the
+   versions of those functions that take one, in compression.h) and the
+   memory is kept and reused, so that once it is large enough for the
+   arrays being processed the calls do almost no heap allocation.
+
+   A context may be used by only one call at a time, so a program that
+   compresses in several threads needs one per thread (e.g. a thread_local
+   one, as the Python extension has).  Apart from `output`, the contents of
+   the vectors are of no meaning between calls.
+ */
+struct CompressionContext {
+  /* After a call of CompressFloat() with this context, the compressed
+     data; it stays valid until the next call. */
+  std::vector<char> output;
+
+  /* The runs of nonzero values in sparse mode (see class
+     SparseIntStream). */
+  std::vector<int32_t> nonzeros;
+
+  /* The table of constant blocks (see struct ConstantBlocks in
+     compression.cc). */
+  std::vector<int64_t> block_starts;
+  std::vector<int32_t> block_lengths;
+  std::vector<int32_t> block_codes;
+
+  /* A copy of the input, for estimating the size of the output when
+     choosing whether to use sparse mode. */
+  std::vector<float> copy;
+};
+
+struct DecompressionContext {
+  /* The table of constant blocks, as in struct CompressionContext.  (The
+     codes are decoded straight into the output array, so this is all the
+     memory that decompression needs.) */
+  std::vector<int64_t> block_starts;
+  std::vector<int32_t> block_lengths;
+  std::vector<int32_t> block_codes;
+};
+
+
+#endif /* __LILCOM__CODEC_CONTEXT_H_ */
@@ -0,0 +1,81 @@
+#ifndef __LILCOM__CODEC_STATS_H_
+#define __LILCOM__CODEC_STATS_H_ 1
+
+#include <stdint.h>
+#include <string.h>
+
+
+/*
+  LILCOM_STATS_ONLY(x) expands to x if LILCOM_STATS is defined, else to
+  nothing.  It is for the code that collects the statistics below.
+ */
+#ifdef LILCOM_STATS
+#define LILCOM_STATS_ONLY(...) __VA_ARGS__
+#else
+#define LILCOM_STATS_ONLY(...)
+#endif
+
+
+/**
+   Statistics about a single call to CompressFloat() or DecompressFloat(),
+   for working out why compressed data is the size it is.  They are only
+   collected if the code was compiled with LILCOM_STATS defined; otherwise
+   all the code that collects them compiles to nothing and a CodecStats
+   object passed in is left unchanged.
+
+   The statistics about the codes (num_bits_histogram down to
+   top_bit_savings) are collected by class UintStream, so they are only
+   collected when compressing, and not with LILCOM_FLAG_ARITHMETIC_CODING.
+ */
+struct CodecStats {
+  CodecStats() { Clear(); }
+
+  void Clear() { memset(this, 0, sizeof(*this)); }
+
+  /* num_bits_histogram[n] is the number of codes written with num_bits n
+     (see ComputeNumBits() in int_stream.h), for 0 <= n <= 32. */
+  int64_t num_bits_histogram[33];
+
+  /* The number of codes after which num_bits went up by one, down by one,
+     or stayed the same (these are not counted for codes with num_bits 0,
+     which are coded as runs of zeros). */
+  int64_t num_bits_up;
+  int64_t num_bits_down;
+  int64_t num_bits_same;
+
+  /* The number of runs of codes with num_bits 0, and the total number of
+     codes in them.  zero_run_histogram[k] is the number of runs whose
+     length is in [2^k, 2^(k+1)). */
+  int64_t num_zero_runs;
+  int64_t num_zeros_in_runs;
+  int64_t zero_run_histogram[64];
+
+  /* The number of bits saved because the top bit of a code was known from
+     the num_bits before and after it (one per such code). */
+  int64_t top_bit_savings;
+
+  /* The number of values that were out of the range of int32_t after
+     dividing by the tick, and so were clipped to the edge of the range. */
+  int64_t num_clipped;
+
+  /* The sizes of the parts of the compressed data: the header, the
+     meta-information after it (if any; see LILCOM_FLAG_CONSTANT_BLOCKS and
+     LILCOM_FLAG_ADAPTIVE in compression.h), and the codes.  The payload is
+     the meta-information plus the codes. */
+  int64_t header_bytes;
+  int64_t meta_bytes;
+  int64_t code_bytes;
+
+  /* Times in seconds.  analysis_seconds is the time spent deciding how to
+     code the array when compressing (sparse mode and constant blocks);
+     encode_seconds and decode_seconds are the time spent writing or
+     reading the meta-information and codes, and total_seconds is the time
+     for the whole call. */
+  double analysis_seconds;
+  double encode_seconds;
+  double decode_seconds;
+  double total_seconds;
+};
+
+
+#endif /* __LILCOM__CODEC_STATS_H_ */
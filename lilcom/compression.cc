@@ -1,10 +1,338 @@
 #include "compression.h"
+#include "arith_int_stream.h"
+#include "sparse_int_stream.h"
 #include <iostream>
 #include <cassert>
 #include <cmath> 
 #include <limits> 
+#include <algorithm>
+#include <cstring>
+#ifdef LILCOM_STATS
+#include <chrono>
+#endif
 
 
+#ifdef LILCOM_STATS
+/*
+  The statistics of the call to CompressFloat() or DecompressFloat() that
+  is in progress in this thread, or NULL if it was not asked for any; see
+  class StatsScope.
+ */
+static thread_local CodecStats *current_stats = NULL;
+
+static inline double StatsSeconds() {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+  Makes `stats` (which may be NULL) the current_stats, after clearing it,
+  for the lifetime of this object, and sets its total_seconds at the end.
+ */
+class StatsScope {
+ public:
+  explicit StatsScope(CodecStats *stats): prev_stats_(current_stats),
+                                          start_(StatsSeconds()) {
+    if (stats != NULL)
+      stats->Clear();
+    current_stats = stats;
+  }
+  ~StatsScope() {
+    if (current_stats != NULL)
+      current_stats->total_seconds = StatsSeconds() - start_;
+    current_stats = prev_stats_;
+  }
+ private:
+  CodecStats *prev_stats_;
+  double start_;
+};
+
+/*
+  Adds the time from construction until Stop() (or destruction) to the
+  field `field` of current_stats, if it is non-NULL.
+ */
+class StatsTimer {
+ public:
+  explicit StatsTimer(double CodecStats::*field): field_(field),
+                                                  start_(StatsSeconds()) { }
+  void Stop() {
+    if (current_stats != NULL && field_ != NULL)
+      current_stats->*field_ += StatsSeconds() - start_;
+    field_ = NULL;
+  }
+  ~StatsTimer() { Stop(); }
+ private:
+  double CodecStats::*field_;
+  double start_;
+};
+#endif
+
+
+/*
+  Returns the integer code for `offset`, i.e. `offset` divided by `tick` and
+  rounded to the nearest integer, with values outside the range of int32_t
+  pinned to the edges of the range.
+ */
+static inline int32_t Quantize(float offset, float tick, float inv_tick) {
+  int32_t code = round(offset * inv_tick);
+
+  if (std::abs(offset - (code * tick)) > tick) {
+    // Handle out-of-range data that cannot be represented; pin to
+    // edges of range.  NOTE: this could be removed for speed,
+    // at the expense of handling these kinds of situations less well.
+    if (offset * inv_tick < std::numeric_limits<int32_t>::min()) {
+      code = std::numeric_limits<int32_t>::min();
+      LILCOM_STATS_ONLY(if (current_stats) current_stats->num_clipped++;)
+    } else if (offset * inv_tick > std::numeric_limits<int32_t>::max()) {
+      code = std::numeric_limits<int32_t>::max();
+      LILCOM_STATS_ONLY(if (current_stats) current_stats->num_clipped++;)
+    }
+    // else do nothing; the difference could just be roundoff
+    // error, which we can ignore.
+  }
+  return code;
+}
+
+
+/*
+  The constant blocks of an array (see LILCOM_FLAG_CONSTANT_BLOCKS in
+  compression.h), and how far we have got through them while compressing
+  or decompressing the array.
+ */
+struct ConstantBlocks {
+  /* The constant blocks are stored as runs of consecutive blocks with the
+     same code.  starts[i] is the index of the first block of the i'th run
+     (these are in increasing order), lengths[i] is its number of blocks,
+     and every element of its blocks is codes[i] * tick. */
+  std::vector<int64_t> starts;
+  std::vector<int32_t> lengths;
+  std::vector<int32_t> codes;
+  /* The run containing the next constant block we will reach, and the
+     number of blocks of that run that we have already passed. */
+  size_t next;
+  int32_t next_offset;
+  /* The index of the first block of the row we are processing. */
+  int64_t row_block;
+
+  ConstantBlocks(): next(0), next_offset(0), row_block(0) { }
+
+  /*
+    Gets the next range of constant blocks in the current row, which has
+    `dim` elements and starts at block `row_block`; this is for
+    CompressFloatInternal() and DecompressFloatInternal().  If there is
+    one, sets `start` and `end` to the element indexes within the row of
+    its start and one past its end, and `code` to its code, and returns
+    true; otherwise moves on to the next row and returns false.
+   */
+  inline bool NextRange(int64_t dim, int64_t *start, int64_t *end,
+                        int32_t *code) {
+    int64_t row_end_block = row_block +
+        (dim + LILCOM_CONSTANT_BLOCK_SIZE - 1) / LILCOM_CONSTANT_BLOCK_SIZE;
+    if (next == starts.size() || starts[next] + next_offset >= row_end_block) {
+      row_block = row_end_block;
+      return false;
+    }
+    int64_t first = starts[next] + next_offset,
+        last = std::min(starts[next] + lengths[next], row_end_block);
+    *start = (first - row_block) * LILCOM_CONSTANT_BLOCK_SIZE;
+    *end = std::min<int64_t>((last - row_block) * LILCOM_CONSTANT_BLOCK_SIZE,
+                             dim);
+    *code = codes[next];
+    next_offset += last - first;
+    if (next_offset == lengths[next]) {
+      next++;
+      next_offset = 0;
+    }
+    return true;
+  }
+};
+
+
+/*
+  Lends the memory of the table of constant blocks in `context` (a
+  CompressionContext or DecompressionContext; see codec_context.h) to `cb`,
+  which must be empty, for the lifetime of this object, so that it is
+  reused from one call to the next.  Does nothing if `context` is NULL.
+ */
+template <class Context>
+class ConstantBlocksMemory {
+ public:
+  ConstantBlocksMemory(Context *context, ConstantBlocks *cb):
+      context_(context), cb_(cb) { Swap(); }
+  ~ConstantBlocksMemory() { Swap(); }
+ private:
+  void Swap() {
+    if (context_ == NULL)
+      return;
+    context_->block_starts.clear();
+    context_->block_lengths.clear();
+    context_->block_codes.clear();
+    cb_->starts.swap(context_->block_starts);
+    cb_->lengths.swap(context_->block_lengths);
+    cb_->codes.swap(context_->block_codes);
+  }
+  Context *context_;
+  ConstantBlocks *cb_;
+};
+
+
+/*
+  Returns the configuration of class Truncation that we use in adaptive
+  mode (LILCOM_FLAG_ADAPTIVE) with this number of significant bits.
+  alpha = 64 means that the number of significant bits does not grow with
+  the magnitude of the residuals, so the error is roughly proportional to
+  it.
+ */
+static TruncationConfig AdaptiveConfig(int significant_bits) {
+  return TruncationConfig(significant_bits, 64, 32, 0);
+}
+
+
+/*
+  AdaptiveIntStream is a wrapper for IntStream (or any class with the same
+  interface, e.g. ArithIntStream) that drops some of the least significant
+  bits of each code, as TruncatedIntStream does; class Truncation decides
+  how many from the magnitude of the recent codes.  This is for adaptive
+  mode (LILCOM_FLAG_ADAPTIVE).  Write() returns the code that the decoder
+  will see, which the prediction has to use.
+ */
+template <class IntStreamType>
+class AdaptiveIntStream: private Truncation {
+ public:
+  /* `is` is the stream to write to; it is not owned here. */
+  AdaptiveIntStream(const TruncationConfig &config, IntStreamType *is):
+      Truncation(config), is_(is) { }
+
+  inline int32_t Write(int32_t code) {
+    int num_truncated_bits = NumBits();
+    int32_t truncated_code = Truncate(code, num_truncated_bits);
+    is_->Write(truncated_code);
+    Step(truncated_code);
+    return Restore(truncated_code, num_truncated_bits);
+  }
+
+  /* The number of bits to truncate, limited so that the shifts are
+     defined. */
+  inline int NumBits() const { return std::min(NumTruncatedBits(), 30); }
+
+  /* Like Truncation::Restore() but pins the result to the range of
+     int32_t. */
+  inline static int32_t Restore(int32_t truncated_code,
+                                int num_truncated_bits) {
+    int64_t ans = (int64_t)truncated_code * ((int64_t)1 << num_truncated_bits) +
+        (num_truncated_bits > 1 ? ((int64_t)1 << (num_truncated_bits - 1)) : 0);
+    return (int32_t)std::min<int64_t>(ans, std::numeric_limits<int32_t>::max());
+  }
+
+ private:
+  IntStreamType *is_;
+};
+
+/*
+  This class is for decoding data encoded by class AdaptiveIntStream.
+  ReverseIntStreamType would be ReverseIntStream or ReverseArithIntStream.
+ */
+template <class ReverseIntStreamType>
+class ReverseAdaptiveIntStream: private Truncation {
+ public:
+  /* `ris` is the stream to read from; it is not owned here. */
+  ReverseAdaptiveIntStream(const TruncationConfig &config,
+                           ReverseIntStreamType *ris):
+      Truncation(config), ris_(ris) { }
+
+  inline bool Read(int32_t *code) {
+    int32_t truncated_code;
+    if (!ris_->Read(&truncated_code))
+      return false;
+    int num_truncated_bits = std::min(NumTruncatedBits(), 30);
+    Step(truncated_code);
+    *code = AdaptiveIntStream<IntStream>::Restore(truncated_code,
+                                                  num_truncated_bits);
+    return true;
+  }
+
+  const char *NextCode() const { return ris_->NextCode(); }
+
+ private:
+  ReverseIntStreamType *ris_;
+};
+
+
+/*
+  Writes `code` to the stream `is` and returns the code that the decoder
+  will read, which is different only for AdaptiveIntStream.
+ */
+template <class IntStreamType>
+static inline int32_t WriteCode(IntStreamType *is, int32_t code) {
+  is->Write(code);
+  return code;
+}
+template <class IntStreamType>
+static inline int32_t WriteCode(AdaptiveIntStream<IntStreamType> *is,
+                                int32_t code) {
+  return is->Write(code);
+}
+
+
+/*
+  Returns the number of axes of an array that has these dims once trailing
+  axes of dimension 1 are removed; this does not change the codes, and the
+  constant blocks are defined in terms of the remaining last axis.
+ */
+static inline int NumEffectiveAxes(int num_axes, const int64_t *dims) {
+  while (num_axes > 1 && dims[num_axes - 1] == 1)
+    num_axes--;
+  return num_axes;
+}
+
+
+/* Sets the `n` elements of `data` with stride `stride` to `value`. */
+template <class T>
+static inline void FillElements(T *data, int64_t n, int64_t stride,
+                                T value) {
+  if (stride == 1) {
+    std::fill(data, data + n, value);
+  } else {
+    for (int64_t i = 0; i < n; i++)
+      data[i * stride] = value;
+  }
+}
+
+
+/*
+  Compresses `n` elements of one row of an array, starting at `cur_data`;
+  this is a helper for CompressFloatInternal(), which documents most of the
+  args.  `prev_prediction` is the prediction from the previous element of
+  the row.  Returns the prediction from the last element compressed.
+ */
+template <class IntStreamType>
+static inline float CompressElements(float tick,
+                                     float inv_tick,
+                                     float *cur_data,
+                                     int64_t n,
+                                     int64_t stride,
+                                     float coeff,
+                                     int local_prev_axes,
+                                     const int64_t *local_strides,
+                                     const float *local_coeffs,
+                                     float prev_prediction,
+                                     IntStreamType *is) {
+  float *end = cur_data + (n * stride);
+  for (; cur_data < end; cur_data += stride) {
+    float predicted = prev_prediction; /* will be prev element times coeff */
+    for (int i = 0; i < local_prev_axes; i++) {
+      /* add prediction from lower-numbered axes to this prediction. */
+      predicted += cur_data[-(local_strides[i])] * local_coeffs[i];
+    }
+    float offset = *cur_data - predicted;
+    int32_t code = WriteCode(is, Quantize(offset, tick, inv_tick));
+    float compressed_data = predicted + (code * tick);
+    *cur_data = compressed_data;
+    prev_prediction = compressed_data * coeff;
+  }
+  return prev_prediction;
+}
+
 
 /*
   Internal recursively called function that writes codes to `is` to compress
@@ -20,7 +348,12 @@
                         one per axis.  See docs in compression.h for how this works
       @param [in,out] is   The codes will be written to this stream, one per data
                            element.  Meta-info is expected to have already been
-                           written to here.
+                           written to here.  Will be of type IntStream, or
+                           IntStreamSizeEstimator if we only need the size.
+      @param [in,out] cb  The constant blocks of the array, which are not
+                        written to `is`, or NULL if there are none.
+                        num_axes must not include trailing axes of
+                        dimension 1 if this is non-NULL.
       @param [in] axis  The axis to iterate on; top-level call is with 0,
                         this will have values 0 <= axis < num_axes.
       @param [in] indexes  Array of indexes we're processing on axes *prior* to the
@@ -28,22 +361,24 @@
                         have space equal to at least num_axes-1.
                         Will be set in the recursion.
  */
+template <class IntStreamType>
 void CompressFloatInternal(float tick,
                            float inv_tick,
                            float *data, 
                            int num_axes,
-                           const int *dims, 
-                           const int *strides,
+                           const int64_t *dims, 
+                           const int64_t *strides,
                            const float *regression_coeffs,
-                           IntStream *is,
+                           IntStreamType *is,
+                           ConstantBlocks *cb,
                            int axis,
-                           int *indexes) {
+                           int64_t *indexes) {
   if (axis + 1 < num_axes) {
-    for (int i = 0; i < dims[axis]; i++) {
+    for (int64_t i = 0; i < dims[axis]; i++) {
       indexes[axis] = i;
       // Recurse
       CompressFloatInternal(tick, inv_tick, data, num_axes, dims, strides,
-			    regression_coeffs, is, axis + 1, indexes);
+			    regression_coeffs, is, cb, axis + 1, indexes);
     }
     return;
   }
@@ -54,7 +389,7 @@ void CompressFloatInternal(float tick,
      whose corresponding indexes are not zero and whose regression
      coefficients are not 1. */
 
-  int local_strides[16];
+  int64_t local_strides[16];
   float local_coeffs[16];
   int local_prev_axes = 0;
   float *cur_data = data;
@@ -70,247 +405,3114 @@ void CompressFloatInternal(float tick,
 
   /* The base-case, where there is 1 dimension, is a bit more optimized. */
   
-  int dim = dims[axis],
+  int64_t dim = dims[axis],
     stride = strides[axis];
   float coeff = regression_coeffs[axis];
 
   float prev_prediction = 0.0;
-  float *end = cur_data + (dim * stride);
-  for (; cur_data < end; cur_data += stride) {
-    float predicted = prev_prediction; /* will be prev element times coeff */
-    for (int i = 0; i < local_prev_axes; i++) {
-      /* add prediction from lower-numbered axes to this prediction. */
-      predicted += cur_data[-(local_strides[i])] * local_coeffs[i];
-    }
-    float offset = *cur_data - predicted;
-    int32_t code = round(offset * inv_tick);
-
-    if (std::abs(offset - (code * tick)) > tick) {
-      // Handle out-of-range data that cannot be represented; pin to
-      // edges of range.  NOTE: this could be removed for speed,
-      // at the expense of handling these kinds of situations less well.
-      if (offset * inv_tick < std::numeric_limits<int32_t>::min()) {
-        code = std::numeric_limits<int32_t>::min();
-      } else if (offset * inv_tick > std::numeric_limits<int32_t>::max()) {
-        code = std::numeric_limits<int32_t>::max();
-      }
-      // else do nothing; the difference could just be roundoff
-      // error, which we can ignore.
-    }
-    is->Write(code);
-    float compressed_data = predicted + (code * tick);
-    *cur_data = compressed_data;
-    prev_prediction = compressed_data * coeff;
+  int64_t pos = 0;  /* The number of elements of this row done so far. */
+  int64_t start, end;
+  int32_t code;
+  while (cb != NULL && cb->NextRange(dim, &start, &end, &code)) {
+    CompressElements(tick, inv_tick, cur_data + pos * stride, start - pos,
+                     stride, coeff, local_prev_axes, local_strides,
+                     local_coeffs, prev_prediction, is);
+    float value = code * tick;
+    FillElements(cur_data + start * stride, end - start, stride, value);
+    prev_prediction = value * coeff;
+    pos = end;
   }
+  CompressElements(tick, inv_tick, cur_data + pos * stride, dim - pos,
+                   stride, coeff, local_prev_axes, local_strides,
+                   local_coeffs, prev_prediction, is);
 }
 
 
-std::vector<char> CompressFloat(int tick_power,  /* e.g. -8 meaning tick=1.0/256.0 */
-                                float *data, 
-                                int num_axes, 
-                                const int *dims, 
-                                const int *strides,
-                                const int *regression_coeffs) {
-  IntStream is;
-  float regression_coeffs_float[16];
-  int indexes[16];
+/*
+  Returns the number of elements of this array that would be compressed to
+  exactly zero if there were no regression (i.e. that have absolute value
+  less than half of `tick`).
+ */
+static int64_t CountZeroCodes(float inv_tick,
+                              const float *data,
+                              int num_axes,
+                              const int64_t *dims,
+                              const int64_t *strides) {
+  int64_t dim = dims[0], stride = strides[0];
+  int64_t ans = 0;
+  if (num_axes > 1) {
+    for (int64_t i = 0; i < dim; i++)
+      ans += CountZeroCodes(inv_tick, data + i * stride, num_axes - 1,
+                            dims + 1, strides + 1);
+  } else {
+    for (int64_t i = 0; i < dim; i++)
+      ans += (std::abs(data[i * stride] * inv_tick) < 0.5f);
+  }
+  return ans;
+}
 
-  if (num_axes <= 0 || num_axes > 16) {
-    std::cerr << "lilcom: compression error: num-axes out of range "
-	      << num_axes << std::endl;
-    // Something is wrong here.  This is for memory safety.
-    return std::vector<char>();
+/*
+  Sets num_zero_codes[t + 20], for each tick_power t in [-20, 20], to what
+  CountZeroCodes() would return for that tick_power, in a single pass over
+  the contiguous array `data` with `num_elements` elements.  An element x
+  with |x| = m * 2^e, 0.5 <= m < 1, is less than half the tick 2^t exactly
+  when t > e (multiplying by a power of two is exact), and zero always is.
+ */
+static void CountZeroCodesAllTicks(const float *data,
+                                   int64_t num_elements,
+                                   int64_t *num_zero_codes) {
+  for (int t = 0; t <= 40; t++)
+    num_zero_codes[t] = 0;
+  for (int64_t i = 0; i < num_elements; i++) {
+    float value = std::abs(data[i]);
+    if (value == 0.0f) {
+      num_zero_codes[0]++;
+    } else if (value <= std::numeric_limits<float>::max()) {  /* not inf/NaN */
+      int e;
+      frexp(value, &e);
+      if (e < 20)
+        num_zero_codes[std::max(e + 1, -20) + 20]++;
+    }
   }
-  if (strides[num_axes - 1] != 1) {
-    std::cerr << "lilcom: compression error: last stride should be 1, got "
-	      << strides[num_axes - 1] << std::endl;
-    return std::vector<char>();
+  /* So far num_zero_codes[t + 20] counts the elements for which t is the
+     smallest tick_power at which they are zero. */
+  for (int t = 1; t <= 40; t++)
+    num_zero_codes[t] += num_zero_codes[t - 1];
+}
+
+/*
+  Internal recursively called function that writes codes to `sis` to compress
+  this array in sparse mode (LILCOM_FLAG_SPARSE), in which there is no
+  regression.  `data` is replaced with its compressed version.  The
+  top-level call is with the dims and strides of the whole array, and
+  recursive calls are with those of sub-arrays.
+ */
+template <class IntStreamType>
+static void CompressSparseInternal(float tick,
+                                   float inv_tick,
+                                   float *data,
+                                   int num_axes,
+                                   const int64_t *dims,
+                                   const int64_t *strides,
+                                   SparseIntStream<IntStreamType> *sis) {
+  int64_t dim = dims[0], stride = strides[0];
+  if (num_axes > 1) {
+    for (int64_t i = 0; i < dim; i++)
+      CompressSparseInternal(tick, inv_tick, data + i * stride, num_axes - 1,
+                             dims + 1, strides + 1, sis);
+    return;
   }
-  if (tick_power < -20 || tick_power > 20) {
-    std::cerr << "lilcom: tick_power out of range: " << tick_power
-	      << std::endl;
-    return std::vector<char>();
+  for (int64_t i = 0; i < dim; i++) {
+    float *cur_data = data + i * stride;
+    int32_t code = Quantize(*cur_data, tick, inv_tick);
+    sis->Write(code);
+    *cur_data = code * tick;
   }
-  is.Write(num_axes);
-  is.Write(tick_power);
-  for (int i = 0; i < num_axes; i++) {
-    regression_coeffs_float[i] = regression_coeffs[i] * (1.0 / 256.0);
-    is.Write(dims[i]);
-    is.Write(regression_coeffs[i]);
+}
+
+
+/*
+  The smallest constant block that is worth starting a run of constant
+  blocks with; shorter blocks (which occur at the ends of rows, and if rows
+  are short) are coded in the normal way unless they extend a run.
+ */
+static const int kMinConstantBlockLen = 16;
+
+/*
+  Internal recursively called function that finds the constant blocks of
+  this array (see LILCOM_FLAG_CONSTANT_BLOCKS in compression.h) and appends
+  them to `cb`.  `num_axes` must not include trailing axes of dimension 1.
+  `*block_index` is the index of the first block of `data`, and is
+  advanced past the blocks of `data`.  This is fast for non-constant
+  blocks because we stop looking at a block as soon as it differs.
+ */
+static void FindConstantBlocks(float tick,
+                               float inv_tick,
+                               const float *data,
+                               int num_axes,
+                               const int64_t *dims,
+                               const int64_t *strides,
+                               int64_t *block_index,
+                               ConstantBlocks *cb) {
+  int64_t dim = dims[0], stride = strides[0];
+  if (num_axes > 1) {
+    for (int64_t i = 0; i < dim; i++)
+      FindConstantBlocks(tick, inv_tick, data + i * stride, num_axes - 1,
+                         dims + 1, strides + 1, block_index, cb);
+    return;
+  }
+  for (int64_t start = 0; start < dim; start += LILCOM_CONSTANT_BLOCK_SIZE,
+           (*block_index)++) {
+    int64_t end = std::min<int64_t>(start + LILCOM_CONSTANT_BLOCK_SIZE, dim);
+    float first = data[start * stride];
+    int32_t code = Quantize(first, tick, inv_tick);
+    int64_t i = start + 1;
+    for (; i < end; i++) {
+      float f = data[i * stride];
+      if (f != first && Quantize(f, tick, inv_tick) != code)
+        break;
+    }
+    if (i < end)
+      continue;
+    if (!cb->starts.empty() && cb->codes.back() == code &&
+        cb->starts.back() + cb->lengths.back() == *block_index &&
+        cb->lengths.back() < std::numeric_limits<int32_t>::max()) {
+      cb->lengths.back()++;
+    } else if (end - start >= kMinConstantBlockLen) {
+      cb->starts.push_back(*block_index);
+      cb->lengths.push_back(1);
+      cb->codes.push_back(code);
+    }
   }
-  float tick = pow(2.0, tick_power), 
-    inv_tick = pow(2.0, -tick_power);
-  while (num_axes > 1 && dims[num_axes - 1] == 1)
-    num_axes--;  /* will increase speed without affecting the output, in the
-		    case where the last axis is useless. */
-  CompressFloatInternal(tick, inv_tick, data, num_axes, dims, strides,
-                        regression_coeffs_float, &is, 0, indexes);
-  return is.Code();
 }
 
 
+/*
+  Writes the table of constant blocks in `cb` to the stream `is`; see
+  LILCOM_FLAG_CONSTANT_BLOCKS in compression.h for the format.
+ */
+template <class IntStreamType>
+static void WriteConstantBlocks(const ConstantBlocks &cb,
+                                IntStreamType *is) {
+  is->Write((int32_t)cb.starts.size());
+  int64_t prev_end = 0;
+  int32_t prev_code = 0;
+  for (size_t i = 0; i < cb.starts.size(); i++) {
+    is->Write((int32_t)(cb.starts[i] - prev_end));
+    is->Write(cb.lengths[i] - 1);
+    is->Write(cb.codes[i] - prev_code);
+    prev_end = cb.starts[i] + cb.lengths[i];
+    prev_code = cb.codes[i];
+  }
+}
+
 
+/*
+  LosslessType<T> says how elements of type T are converted to and from the
+  integers (of type IntType, which is int32_t or int64_t) that we predict
+  and code in lossless mode; the conversion must be one-to-one.  kType is
+  the LILCOM_TYPE_ value for T.
+ */
+template <class T> struct LosslessType;
 
-bool GetCompressedDataShape(const char *data,
-                            int num_bytes,
-                            int *meta) {
-  ReverseIntStream ris(data, data + num_bytes);
-  int32_t num_axes = -100, tick_power = -100;
-  if (!ris.Read(&num_axes) ||
-      num_axes < 1 || num_axes > 16) {
-    std::cerr << "lilcom: num_axes=" << num_axes
-              << " is out of range or could not be read" << std::endl;
-    return false;
+template <> struct LosslessType<float> {
+  typedef int32_t IntType;
+  static const int kType = LILCOM_TYPE_FLOAT32;
+  /* Maps the bit pattern of `f` to an int32_t such that the order of the
+     integers is the same as the order of the floats (ignoring NaNs), so
+     that nearby floats map to nearby integers. */
+  static inline IntType ToInt(float f) {
+    int32_t i;
+    memcpy(&i, &f, sizeof(i));
+    return (i >= 0 ? i : i ^ 0x7fffffff);
   }
-  if (!ris.Read(&tick_power) ||
-      tick_power < -20 || tick_power > 20) {
-    std::cerr << "lilcom: tick_power=" << tick_power
-              << " is out of range or could not be read" << std::endl;
-    return false;
+  static inline float FromInt(IntType i) {
+    if (i < 0)
+      i ^= 0x7fffffff;
+    float f;
+    memcpy(&f, &i, sizeof(f));
+    return f;
   }
+};
 
-  meta[0] = num_axes;
-  for (int i = 0; i < num_axes; i++) {
-    int32_t dim = -100, _coeff;
-    if (!ris.Read(&dim) || !ris.Read(&_coeff) || dim < 1) {
-      std::cerr << "lilcom: dim=" << dim << " for axis="
-                << i << " could not be read or is out of range.";
+
+template <class T, class I, int type> struct LosslessIntType {
+  typedef I IntType;
+  static const int kType = type;
+  static inline IntType ToInt(T t) { return (IntType)t; }
+  static inline T FromInt(IntType i) { return (T)i; }
+};
+template <> struct LosslessType<int8_t>:
+      public LosslessIntType<int8_t, int32_t, LILCOM_TYPE_INT8> { };
+template <> struct LosslessType<uint8_t>:
+      public LosslessIntType<uint8_t, int32_t, LILCOM_TYPE_UINT8> { };
+template <> struct LosslessType<int16_t>:
+      public LosslessIntType<int16_t, int32_t, LILCOM_TYPE_INT16> { };
+template <> struct LosslessType<uint16_t>:
+      public LosslessIntType<uint16_t, int32_t, LILCOM_TYPE_UINT16> { };
+template <> struct LosslessType<int32_t>:
+      public LosslessIntType<int32_t, int32_t, LILCOM_TYPE_INT32> { };
+template <> struct LosslessType<uint32_t>:
+      public LosslessIntType<uint32_t, int32_t, LILCOM_TYPE_UINT32> { };
+template <> struct LosslessType<int64_t>:
+      public LosslessIntType<int64_t, int64_t, LILCOM_TYPE_INT64> { };
+template <> struct LosslessType<uint64_t>:
+      public LosslessIntType<uint64_t, int64_t, LILCOM_TYPE_UINT64> { };
+
+
+/*
+  SplitIntStream writes int64_t's to two streams of type IntStreamType
+  (e.g. IntStream): the low 32 bits of each value, as a signed integer, go
+  to `low`, and the high part, which is zero unless the value is outside the
+  range of int32_t, goes to `high`.  This is how we code the residuals for
+  64-bit types in lossless mode.
+ */
+template <class IntStreamType>
+struct SplitIntStream {
+  IntStreamType low;
+  IntStreamType high;
+
+  inline void Write(int64_t value) {
+    int32_t low_part = (int32_t)(uint32_t)value;
+    low.Write(low_part);
+    high.Write((int32_t)(uint32_t)(((uint64_t)value -
+                                     (uint64_t)(int64_t)low_part) >> 32));
+  }
+};
+
+/*
+  This is for reading data written by class SplitIntStream.
+ */
+template <class ReverseIntStreamType>
+struct ReverseSplitIntStream {
+  /* The low stream is from `begin` to `middle` and the high stream from
+     `middle` to `end`. */
+  ReverseSplitIntStream(const char *begin, const char *middle,
+                        const char *end):
+      low(begin, middle), high(middle, end), middle_(middle) { }
+
+  inline bool Read(int64_t *value) {
+    int32_t low_part, high_part;
+    if (!low.Read(&low_part) || !high.Read(&high_part))
       return false;
-    }
-    meta[i + 1] = dim;
+    *value = (int64_t)((uint64_t)(int64_t)low_part +
+                       ((uint64_t)(uint32_t)high_part << 32));
+    return true;
+  }
+
+  /* Returns one past the last byte read from the high stream, or NULL if
+     we did not read exactly the whole of the low stream. */
+  const char *NextCode() const {
+    return (low.NextCode() == middle_ ? high.NextCode() : NULL);
   }
+
+  ReverseIntStreamType low;
+  ReverseIntStreamType high;
+ private:
+  const char *middle_;
+};
+
+
+/*
+  Writes an int64_t to `is` as two int32_t's, the low 32 bits and then the
+  high 32 bits; this is for meta-information that may not fit in an
+  int32_t.
+ */
+static void WriteInt64(int64_t value, IntStream *is) {
+  is->Write((int32_t)(uint32_t)value);
+  is->Write((int32_t)(uint32_t)((uint64_t)value >> 32));
+}
+
+/*
+  Reads an int64_t written by WriteInt64(); returns false on failure.
+ */
+static bool ReadInt64(ReverseIntStream *ris, int64_t *value) {
+  int32_t low, high;
+  if (!ris->Read(&low) || !ris->Read(&high))
+    return false;
+  *value = (int64_t)(((uint64_t)(uint32_t)high << 32) | (uint32_t)low);
   return true;
 }
 
 
+/*
+  Returns floor(value * coeff / 256) without overflow, where coeff is an
+  integerized regression coefficient in [-256, 256].  Lossless mode does
+  its prediction with this, so that it is exactly reproducible.
+ */
+static inline int64_t ScaleByCoeff(int64_t value, int coeff) {
+  return coeff * (value >> 8) + ((coeff * (value & 255)) >> 8);
+}
 
 
 /*
-  Internal recursively called function that reads codes from `ris` to 
-  decompress this array.
-      @param [in] ris   The codes will be read from this stream, one per data
-                        element.  The meta-info will already have been
-                        read from here.
-      @param [in] tick  Distance between compressed values, e.g. 2^-8
-      @param [in] data  Array to write data to
-      @param [in] num_axes  Number of axes in `data`.  Must be in the range [1..16]
-      @param [in] dims  Dimensions of `data`, indexed by axis
-      @param [in] strides   Strides of elements of `data`, in float elements
-                       (not bytes), indexed by axis.
-      @param [in] regression_coeffs  Regression coefficients, one per axis, 
-                        the same as used for compression (these will have been
-                        read from the header).  See docs in compression.h for how 
-			this works
-      @param [in] axis  The axis to iterate on; top-level call is with 0,
-                        this will have values 0 <= axis < num_axes.
-      @param [in] indexes  Array of indexes we're processing on axes *prior* to the
-                        current axis, i.e. for axes i with 0 <= i < axis.  Must
-                        have space equal to at least num_axes-1.
-                        Will be set in the recursion.
-      @return  Returns true on success, false if we reached the end of the stream
-                        before decompression was finished.
+  Internal recursively called function that writes codes to `is` to
+  compress this array losslessly (LILCOM_FLAG_LOSSLESS).  The elements are
+  converted to integers by LosslessType<T>, and we code the difference
+  between each integer and its prediction, which is computed as for
+  CompressFloatInternal() but with integer arithmetic; the arithmetic wraps
+  around, so the differences are in the range of the integer type.  The
+  args are as for CompressFloatInternal(), except that `data` is not
+  modified and the regression coefficients are the integerized ones.  `is`
+  must be able to write values of type LosslessType<T>::IntType.
  */
-bool DecompressFloatInternal(ReverseIntStream *ris,
-			     float tick,
-			     float *data, 
-			     int num_axes,
-			     const int *dims, 
-			     const int *strides,
-			     const float *regression_coeffs,
-			     int axis,
-			     int *indexes) {
+template <class T, class IntStreamType>
+static void CompressLosslessInternal(const T *data,
+                                     int num_axes,
+                                     const int64_t *dims,
+                                     const int64_t *strides,
+                                     const int *regression_coeffs,
+                                     IntStreamType *is,
+                                     int axis,
+                                     int64_t *indexes) {
   if (axis + 1 < num_axes) {
-    for (int i = 0; i < dims[axis]; i++) {
+    for (int64_t i = 0; i < dims[axis]; i++) {
       indexes[axis] = i;
-      // Recurse
-      if (!DecompressFloatInternal(ris, tick, data, num_axes, dims, strides, 
-				   regression_coeffs, axis + 1, indexes))
-        return false;
+      CompressLosslessInternal(data, num_axes, dims, strides,
+                               regression_coeffs, is, axis + 1, indexes);
     }
-    return true;
+    return;
   }
-  assert(axis == num_axes - 1);
-
-  /* local_strides and local_coeffs will be the strides and
-     corresponding regression coefficients for axes prior to `axis`
-     whose corresponding indexes are not zero and whose regression
-     coefficients are not 1. */
+  typedef typename LosslessType<T>::IntType IntType;
 
-  int local_strides[16];
-  float local_coeffs[16];
+  int64_t local_strides[16];
+  int local_coeffs[16];
   int local_prev_axes = 0;
-  float *cur_data = data;
+  const T *cur_data = data;
   for (int i = 0; i < axis; i++) {
-    /* make `local_data` point to the start of what we're processing here. */
     cur_data += indexes[i] * strides[i];
-    if (regression_coeffs[i] != 0.0 && indexes[i] != 0) {
+    if (regression_coeffs[i] != 0 && indexes[i] != 0) {
       local_strides[local_prev_axes] = strides[i];
       local_coeffs[local_prev_axes] = regression_coeffs[i];
       local_prev_axes++;
     }
   }
 
-  int dim = dims[axis],
+  int64_t dim = dims[axis],
     stride = strides[axis];
-  float coeff = regression_coeffs[axis];
+  int coeff = regression_coeffs[axis];
 
-  /* The base-case, where there is 1 dimension, is a bit more optimized. */
-  float prev_prediction = 0.0;
-  float *end = cur_data + (dim * stride);
+  /* We use unsigned arithmetic for the predictions so that overflow is
+     well defined. */
+  uint64_t prev_prediction = 0;
+  const T *end = cur_data + (dim * stride);
   for (; cur_data < end; cur_data += stride) {
-    float predicted = prev_prediction; /* will be prev element times coeff */
-    int32_t code;
-    if (!ris->Read(&code))
-      return false;
-    for (int i = 0; i < local_prev_axes; i++) {
-      /* add prediction from lower-numbered axes to this prediction. */
-      predicted += cur_data[-(local_strides[i])] * local_coeffs[i];
-    }
-    float value = predicted + code * tick;
-    *cur_data = value;
-    prev_prediction = value * coeff;
+    uint64_t predicted = prev_prediction;
+    for (int i = 0; i < local_prev_axes; i++)
+      predicted += ScaleByCoeff(
+          LosslessType<T>::ToInt(cur_data[-(local_strides[i])]),
+          local_coeffs[i]);
+    IntType value = LosslessType<T>::ToInt(*cur_data);
+    is->Write((IntType)((uint64_t)value - predicted));
+    prev_prediction = ScaleByCoeff(value, coeff);
   }
-  return true;
 }
 
 
-int DecompressFloat(const char *src,
-		    int num_bytes,
-		    float *array, 
-		    int num_axes, 
-		    const int *dims, 
-		    const int *strides) {
-  if (num_axes < 1 || num_axes > 16)
-    return 1;
-  ReverseIntStream ris(src, src + num_bytes);
-  float regression_coeffs[16];
-  int indexes[16];
-  int _num_axes, tick_power;
-  if (!ris.Read(&_num_axes) || _num_axes != num_axes)
-    return 2;
-  if (!ris.Read(&tick_power) || tick_power < -20 || 
-      tick_power > 20)
-    return 3;
-
-  for (int i = 0; i < num_axes; i++) {
-    int32_t dim, coeff;
-    if (!ris.Read(&dim) || !ris.Read(&coeff) || dim != dims[i] || dim < 1)
-      return 4;
-    if (coeff < -256 || coeff > 256)
-      return 5;
-    regression_coeffs[i] = coeff * (1.0 / 256.0);
+/*
+  Checks the args to CompressFloat(); returns true if they are OK, else prints
+  a message and returns false.
+ */
+static bool CheckCompressionArgs(int tick_power,
+                                 int num_axes,
+                                 const int64_t *dims,
+                                 const int64_t *strides,
+                                 const int *regression_coeffs,
+                                 int flags,
+                                 int significant_bits) {
+  if (num_axes <= 0 || num_axes > 16) {
+    std::cerr << "lilcom: compression error: num-axes out of range "
+	      << num_axes << std::endl;
+    // Something is wrong here.  This is for memory safety.
+    return false;
   }
-
-  if (!DecompressFloatInternal(&ris, pow(2.0, tick_power), array,
-			       num_axes, dims, strides, regression_coeffs,
-			       0, indexes)) {
-    return 6;
+  /* The last stride does not matter if there is at most one element per
+     row (NumPy gives empty arrays stride 0). */
+  if (strides[num_axes - 1] != 1 && dims[num_axes - 1] > 1) {
+    std::cerr << "lilcom: compression error: last stride should be 1, got "
+	      << strides[num_axes - 1] << std::endl;
+    return false;
+  }
+  if (tick_power < -20 || tick_power > 20) {
+    std::cerr << "lilcom: tick_power out of range: " << tick_power
+	      << std::endl;
+    return false;
+  }
+  for (int i = 0; i < num_axes; i++) {
+    if (regression_coeffs[i] < -256 || regression_coeffs[i] > 256) {
+      std::cerr << "lilcom: regression coefficient out of range: "
+                << regression_coeffs[i] << std::endl;
+      return false;
+    }
+  }
+  if ((flags & ~LILCOM_VALID_FLAGS) != 0 ||
+      (flags & (LILCOM_FLAG_LAYERED|LILCOM_FLAG_CHANNELS)) ||
+      ((flags & LILCOM_FLAG_ADAPTIVE) && (flags & LILCOM_FLAG_LOSSLESS))) {
+    std::cerr << "lilcom: invalid flags: " << flags << std::endl;
+    return false;
+  }
+  if ((flags & LILCOM_FLAG_ADAPTIVE) &&
+      (significant_bits < 3 || significant_bits > 31)) {
+    std::cerr << "lilcom: significant_bits out of range: "
+              << significant_bits << std::endl;
+    return false;
+  }
+  return true;
+}
+
+
+/*
+  Appends the format-version-2 header (struct LilcomHeader, then the dims
+  and regression coefficients; see compression.h) to `*ans`, which must be
+  empty.  `payload_bytes` is set to zero; call SetPayloadBytes() once it is
+  known.
+ */
+static void WriteFixedHeader(int type,
+                             int tick_power,
+                             int flags,
+                             int num_axes,
+                             const int64_t *dims,
+                             const int *regression_coeffs,
+                             std::vector<char> *ans) {
+  assert(ans->empty());
+  ans->resize(LilcomHeaderLen(num_axes), 0);
+  LilcomHeader header;
+  header.magic = 'L';
+  header.format_version = 2;
+  header.type = type;
+  header.num_axes = num_axes;
+  header.tick_power = tick_power;
+  header.num_layers = 0;
+  header.flags = flags;
+  header.payload_bytes = 0;
+  memcpy(&((*ans)[0]), &header, sizeof(header));
+  for (int i = 0; i < num_axes; i++) {
+    int64_t dim = dims[i];
+    int16_t coeff = regression_coeffs[i];
+    memcpy(&((*ans)[LILCOM_FIXED_HEADER_LEN + 8 * i]), &dim, sizeof(dim));
+    memcpy(&((*ans)[LILCOM_FIXED_HEADER_LEN + 8 * num_axes + 2 * i]),
+           &coeff, sizeof(coeff));
+  }
+}
+
+/*
+  Sets the payload_bytes field of the header written by WriteFixedHeader()
+  to the number of bytes in `*ans` after the header.
+ */
+static void SetPayloadBytes(std::vector<char> *ans) {
+  LilcomHeader header;
+  memcpy(&header, &((*ans)[0]), sizeof(header));
+  header.payload_bytes = ans->size() - LilcomHeaderLen(header.num_axes);
+  memcpy(&((*ans)[0]), &header, sizeof(header));
+}
+
+
+/*
+  Writes the codes for the elements of this array to the stream `is` (which
+  may be of any type with the same Write() interface as IntStream).  See
+  CompressFloat() for the meanings of the args; `cb` is the constant blocks
+  of the array (if flags contains LILCOM_FLAG_CONSTANT_BLOCKS), else NULL.
+ */
+template <class IntStreamType>
+static void WriteCodes(int tick_power,
+                       float *data,
+                       int num_axes,
+                       const int64_t *dims,
+                       const int64_t *strides,
+                       const int *regression_coeffs,
+                       int flags,
+                       ConstantBlocks *cb,
+                       const TruncationConfig *adaptive_config,
+                       CompressionContext *context,
+                       IntStreamType *is) {
+  float regression_coeffs_float[16];
+  int64_t indexes[16];
+  for (int i = 0; i < num_axes; i++)
+    regression_coeffs_float[i] = regression_coeffs[i] * (1.0 / 256.0);
+  float tick = pow(2.0, tick_power), 
+    inv_tick = pow(2.0, -tick_power);
+  if (flags & LILCOM_FLAG_LOSSLESS) {
+    CompressLosslessInternal(data, NumEffectiveAxes(num_axes, dims), dims,
+                             strides, regression_coeffs, is, 0, indexes);
+    return;
+  }
+  if (flags & LILCOM_FLAG_SPARSE) {
+    SparseIntStream<IntStreamType> sis(is);
+    context->nonzeros.clear();
+    sis.SwapNonzeros(&(context->nonzeros));
+    CompressSparseInternal(tick, inv_tick, data, num_axes, dims, strides,
+                           &sis);
+    sis.Finish();
+    sis.SwapNonzeros(&(context->nonzeros));
+    return;
+  }
+  /* Removing trailing axes of dimension 1 will increase speed without
+     affecting the output, in the case where the last axis is useless. */
+  num_axes = NumEffectiveAxes(num_axes, dims);
+  if (flags & LILCOM_FLAG_ADAPTIVE) {
+    AdaptiveIntStream<IntStreamType> ais(*adaptive_config, is);
+    CompressFloatInternal(tick, inv_tick, data, num_axes, dims, strides,
+                          regression_coeffs_float, &ais, cb, 0, indexes);
+  } else {
+    CompressFloatInternal(tick, inv_tick, data, num_axes, dims, strides,
+                          regression_coeffs_float, is, cb, 0, indexes);
+  }
+}
+
+
+/*
+  The following functions append the code in stream `s` to `*ans` (if `ans` is
+  non-NULL) and return its size in bytes.
+ */
+static size_t AppendCode(IntStream *s, std::vector<char> *ans) {
+  std::vector<char> &code = s->Code();
+  ans->insert(ans->end(), code.begin(), code.end());
+  return code.size();
+}
+static size_t AppendCode(ArithIntStream *s, std::vector<char> *ans) {
+  if (ans == NULL)
+    return s->NumBytes();
+  std::vector<char> &code = s->Code();
+  ans->insert(ans->end(), code.begin(), code.end());
+  return code.size();
+}
+
+/*
+  The following functions are an alternative to AppendCode() that avoids
+  copying the code: StartCode() makes the stream `s` append its code
+  directly to `*ans` (if `ans` is non-NULL), and must be called before
+  anything is written to it; FinishCode() gives `*ans` back, with the
+  code, and returns the size of the code in bytes.
+ */
+static void StartCode(IntStream *s, std::vector<char> *ans) {
+  s->SwapCode(ans);
+}
+static void StartCode(IntStreamSizeEstimator *s, std::vector<char> *ans) {
+  assert(ans == NULL);
+}
+static void StartCode(ArithIntStream *s, std::vector<char> *ans) {
+  if (ans != NULL)
+    s->SwapCode(ans);
+}
+static size_t FinishCode(IntStream *s, size_t start, std::vector<char> *ans) {
+  s->Code();
+  s->SwapCode(ans);
+  return ans->size() - start;
+}
+static size_t FinishCode(IntStreamSizeEstimator *s, size_t start,
+                         std::vector<char> *ans) {
+  return s->NumBytes();
+}
+static size_t FinishCode(ArithIntStream *s, size_t start,
+                         std::vector<char> *ans) {
+  if (ans == NULL)
+    return s->NumBytes();
+  s->Code();
+  s->SwapCode(ans);
+  return ans->size() - start;
+}
+
+
+static int64_t NumElements(int num_axes, const int64_t *dims) {
+  int64_t ans = 1;
+  for (int i = 0; i < num_axes; i++)
+    ans *= dims[i];
+  return ans;
+}
+
+
+/*
+  Returns the number of blocks (see LILCOM_FLAG_CONSTANT_BLOCKS in
+  compression.h) in an array with these dims.
+ */
+static int64_t NumBlocks(int num_axes, const int64_t *dims) {
+  num_axes = NumEffectiveAxes(num_axes, dims);
+  int64_t last_dim = dims[num_axes - 1];
+  return NumElements(num_axes - 1, dims) *
+      ((last_dim + LILCOM_CONSTANT_BLOCK_SIZE - 1) / LILCOM_CONSTANT_BLOCK_SIZE);
+}
+
+/*
+  Returns the number of elements of an array with these dims that will have
+  codes in the stream of codes, i.e. that are not in constant blocks.  `cb`
+  is the constant blocks, or NULL if there are none.
+ */
+static int64_t NumCodedElements(int num_axes, const int64_t *dims,
+                                const ConstantBlocks *cb) {
+  int64_t ans = NumElements(num_axes, dims);
+  if (cb == NULL)
+    return ans;
+  int64_t last_dim = dims[NumEffectiveAxes(num_axes, dims) - 1],
+      blocks_per_row = (last_dim + LILCOM_CONSTANT_BLOCK_SIZE - 1) /
+      LILCOM_CONSTANT_BLOCK_SIZE,
+      last_block_size = last_dim -
+      (blocks_per_row - 1) * LILCOM_CONSTANT_BLOCK_SIZE;
+  for (size_t i = 0; i < cb->starts.size(); i++) {
+    int64_t start = cb->starts[i], end = start + cb->lengths[i],
+        num_last_blocks = end / blocks_per_row - start / blocks_per_row;
+    /* num_last_blocks is the number of blocks in the run that are the last
+       block of their row. */
+    ans -= cb->lengths[i] * (int64_t)LILCOM_CONSTANT_BLOCK_SIZE -
+        num_last_blocks * (LILCOM_CONSTANT_BLOCK_SIZE - last_block_size);
+  }
+  return ans;
+}
+
+
+/*
+  If at least this proportion of the elements of an array would be
+  compressed to zero, we consider using sparse mode (LILCOM_FLAG_SPARSE)
+  automatically; see ChooseSparse().
+ */
+static const double kSparseProportion = 0.6;
+
+
+/*
+  This contains the implementation of CompressFloat() and
+  EstimateCompressedSize().  The args are as for CompressFloat(), except:
+      @param [in] context  Memory to use for the table of constant blocks
+                  and in sparse mode; see codec_context.h.
+      @param [out] ans  If IntStreamType is IntStream, the compressed data
+                  will be written to here (it must be empty); if it is
+                  IntStreamSizeEstimator, this must be NULL.
+      @return  Returns the size of the compressed data in bytes.
+  The args are assumed to have already been checked.
+ */
+template <class IntStreamType>
+static size_t CompressFloatImpl(int tick_power,
+                                float *data,
+                                int num_axes,
+                                const int64_t *dims,
+                                const int64_t *strides,
+                                const int *regression_coeffs,
+                                int flags,
+                                int significant_bits,
+                                CompressionContext *context,
+                                std::vector<char> *ans) {
+  LILCOM_STATS_ONLY(
+      StatsTimer analysis_timer(&CodecStats::analysis_seconds);
+      int64_t num_clipped = (current_stats ? current_stats->num_clipped : 0);)
+  /* Sparse mode and constant blocks are based on the quantized values, so
+     they do not apply in lossless mode; and sparse mode has no regression,
+     so it does not apply in adaptive mode, whose truncation is of the
+     residuals. */
+  if (flags & (LILCOM_FLAG_LOSSLESS|LILCOM_FLAG_ADAPTIVE))
+    flags &= ~LILCOM_FLAG_SPARSE;
+
+  /* LILCOM_FLAG_CONSTANT_BLOCKS is never taken from the user; it is set
+     if there are constant blocks. */
+  flags &= ~LILCOM_FLAG_CONSTANT_BLOCKS;
+  ConstantBlocks cb;
+  ConstantBlocksMemory<CompressionContext> cb_memory(context, &cb);
+  if (!(flags & (LILCOM_FLAG_SPARSE|LILCOM_FLAG_LOSSLESS)) &&
+      NumElements(num_axes, dims) > 0 &&
+      NumBlocks(num_axes, dims) <= std::numeric_limits<int32_t>::max()) {
+    int64_t num_blocks = 0;
+    FindConstantBlocks(pow(2.0, tick_power), pow(2.0, -tick_power), data,
+                       NumEffectiveAxes(num_axes, dims), dims, strides,
+                       &num_blocks, &cb);
+    if (!cb.starts.empty())
+      flags |= LILCOM_FLAG_CONSTANT_BLOCKS;
+  }
+  ConstantBlocks *cb_ptr =
+      (flags & LILCOM_FLAG_CONSTANT_BLOCKS ? &cb : NULL);
+  /* FindConstantBlocks() quantizes the elements too; we don't count
+     clipping there. */
+  LILCOM_STATS_ONLY(
+      analysis_timer.Stop();
+      if (current_stats) current_stats->num_clipped = num_clipped;
+      StatsTimer encode_timer(&CodecStats::encode_seconds);)
+
+  TruncationConfig adaptive_config = AdaptiveConfig(significant_bits);
+  const TruncationConfig *adaptive_config_ptr =
+      (flags & LILCOM_FLAG_ADAPTIVE ? &adaptive_config : NULL);
+
+  /* The header; then any configuration for adaptive mode and table of
+     constant blocks, in their own stream; then the codes, in a stream whose
+     type depends on the flags.  If there are no elements to code there are
+     no codes. */
+  if (ans)
+    WriteFixedHeader(LILCOM_TYPE_FLOAT32, tick_power, flags, num_axes, dims,
+                     regression_coeffs, ans);
+  size_t num_bytes = LilcomHeaderLen(num_axes);
+  if (adaptive_config_ptr != NULL || cb_ptr != NULL) {
+    IntStreamType meta;
+    StartCode(&meta, ans);
+    if (adaptive_config_ptr != NULL)
+      adaptive_config.Write(&meta);
+    if (cb_ptr != NULL)
+      WriteConstantBlocks(cb, &meta);
+    num_bytes += FinishCode(&meta, num_bytes, ans);
+  }
+  LILCOM_STATS_ONLY(
+      if (current_stats) {
+        current_stats->header_bytes = LilcomHeaderLen(num_axes);
+        current_stats->meta_bytes = num_bytes - LilcomHeaderLen(num_axes);
+      })
+  if (NumCodedElements(num_axes, dims, cb_ptr) > 0) {
+    if (flags & LILCOM_FLAG_ARITHMETIC_CODING) {
+      ArithIntStream as;
+      StartCode(&as, ans);
+      WriteCodes(tick_power, data, num_axes, dims, strides,
+                 regression_coeffs, flags, cb_ptr, adaptive_config_ptr,
+                 context, &as);
+      num_bytes += FinishCode(&as, num_bytes, ans);
+    } else {
+      IntStreamType is;
+      LILCOM_STATS_ONLY(is.SetStats(current_stats);)
+      StartCode(&is, ans);
+      WriteCodes(tick_power, data, num_axes, dims, strides,
+                 regression_coeffs, flags, cb_ptr, adaptive_config_ptr,
+                 context, &is);
+      num_bytes += FinishCode(&is, num_bytes, ans);
+    }
+  }
+  LILCOM_STATS_ONLY(
+      if (current_stats)
+        current_stats->code_bytes = num_bytes - LilcomHeaderLen(num_axes) -
+            current_stats->meta_bytes;)
+  if (ans)
+    SetPayloadBytes(ans);
+  return num_bytes;
+}
+
+
+/*
+  Copies the array `src` with dimensions `dims` and strides `src_strides`
+  to the contiguous array `dest` (which must have space for the
+  product of `dims`).  Returns a pointer to one past the last element written.
+ */
+static float *CopyToContiguous(const float *src,
+                               int num_axes,
+                               const int64_t *dims,
+                               const int64_t *src_strides,
+                               float *dest) {
+  int64_t dim = dims[0], stride = src_strides[0];
+  if (num_axes == 1) {
+    for (int64_t i = 0; i < dim; i++)
+      *(dest++) = src[i * stride];
+  } else {
+    for (int64_t i = 0; i < dim; i++)
+      dest = CopyToContiguous(src + i * stride, num_axes - 1,
+                              dims + 1, src_strides + 1, dest);
+  }
+  return dest;
+}
+
+
+/*
+  Returns `flags` with LILCOM_FLAG_SPARSE added if sparse mode should be
+  used automatically, i.e. if at least kSparseProportion of the elements
+  would be compressed to zero and the output would be no larger than
+  without it.  (Sparse mode has no regression, so e.g. a smooth signal
+  padded with zeros can be much larger in it.)  The args are as for
+  CompressFloatImpl(); `data` is not changed.
+ */
+static int ChooseSparse(int tick_power,
+                        const float *data,
+                        int num_axes,
+                        const int64_t *dims,
+                        const int64_t *strides,
+                        const int *regression_coeffs,
+                        int flags,
+                        int significant_bits,
+                        CompressionContext *context) {
+  int64_t num_elements = NumElements(num_axes, dims);
+  if ((flags & (LILCOM_FLAG_SPARSE|LILCOM_FLAG_LOSSLESS|
+                LILCOM_FLAG_ADAPTIVE)) || num_elements == 0 ||
+      CountZeroCodes(pow(2.0, -tick_power), data, num_axes, dims, strides) <
+      kSparseProportion * num_elements)
+    return flags;
+  /* The estimates are not part of the statistics of this call, except for
+     their time. */
+  LILCOM_STATS_ONLY(
+      StatsTimer analysis_timer(&CodecStats::analysis_seconds);
+      StatsScope no_stats(NULL);)
+  /* Compression overwrites its input, so each estimate needs a copy. */
+  int64_t contiguous_strides[16];
+  contiguous_strides[num_axes - 1] = 1;
+  for (int i = num_axes - 1; i > 0; i--)
+    contiguous_strides[i - 1] = contiguous_strides[i] * dims[i];
+  std::vector<float> &copy = context->copy;
+  copy.resize(num_elements);
+  CopyToContiguous(data, num_axes, dims, strides, &(copy[0]));
+  size_t sparse_bytes = CompressFloatImpl<IntStreamSizeEstimator>(
+      tick_power, &(copy[0]), num_axes, dims, contiguous_strides,
+      regression_coeffs, flags | LILCOM_FLAG_SPARSE, significant_bits,
+      context, NULL);
+  CopyToContiguous(data, num_axes, dims, strides, &(copy[0]));
+  size_t dense_bytes = CompressFloatImpl<IntStreamSizeEstimator>(
+      tick_power, &(copy[0]), num_axes, dims, contiguous_strides,
+      regression_coeffs, flags, significant_bits, context, NULL);
+  return (sparse_bytes <= dense_bytes ? flags | LILCOM_FLAG_SPARSE : flags);
+}
+
+
+std::vector<char> CompressFloat(int tick_power,  /* e.g. -8 meaning tick=1.0/256.0 */
+                                float *data, 
+                                int num_axes, 
+                                const int64_t *dims, 
+                                const int64_t *strides,
+                                const int *regression_coeffs,
+                                int flags,
+                                int significant_bits,
+                                CodecStats *stats) {
+  CompressionContext context;
+  CompressFloat(&context, tick_power, data, num_axes, dims, strides,
+                regression_coeffs, flags, significant_bits, stats);
+  std::vector<char> ans;
+  ans.swap(context.output);
+  return ans;
+}
+
+
+const std::vector<char> &CompressFloat(CompressionContext *context,
+                                       int tick_power,
+                                       float *data,
+                                       int num_axes,
+                                       const int64_t *dims,
+                                       const int64_t *strides,
+                                       const int *regression_coeffs,
+                                       int flags,
+                                       int significant_bits,
+                                       CodecStats *stats) {
+  LILCOM_STATS_ONLY(StatsScope stats_scope(stats);)
+  context->output.clear();
+  if (CheckCompressionArgs(tick_power, num_axes, dims, strides,
+                           regression_coeffs, flags, significant_bits)) {
+    flags = ChooseSparse(tick_power, data, num_axes, dims, strides,
+                         regression_coeffs, flags, significant_bits, context);
+    CompressFloatImpl<IntStream>(tick_power, data, num_axes, dims, strides,
+                                 regression_coeffs, flags, significant_bits,
+                                 context, &(context->output));
+  }
+  return context->output;
+}
+
+
+/*
+  Returns the size of the output of CompressFloat() with these args, like
+  EstimateCompressedSize(), except that `data` must be contiguous (with
+  `strides` as its strides) and `num_zero_codes` must be the number of its
+  elements that are zero with this tick_power (see CountZeroCodes()).  It
+  is used when searching over tick_power, which can work out the copy and
+  those counts once for all tick_powers.  `data` is not changed; the copy
+  that is compressed is kept in context->copy.
+ */
+static int64_t EstimateContiguous(int tick_power,
+                                  const float *data,
+                                  int num_axes,
+                                  const int64_t *dims,
+                                  const int64_t *strides,
+                                  const int *regression_coeffs,
+                                  int flags,
+                                  int significant_bits,
+                                  int64_t num_zero_codes,
+                                  CompressionContext *context) {
+  int64_t num_elements = NumElements(num_axes, dims);
+  /* Compression overwrites its input, so each estimate needs a copy. */
+  std::vector<float> &copy = context->copy;
+  copy.assign(data, data + num_elements);
+  int64_t dense_bytes = CompressFloatImpl<IntStreamSizeEstimator>(
+      tick_power, (num_elements > 0 ? &(copy[0]) : NULL), num_axes, dims,
+      strides, regression_coeffs, flags, significant_bits, context, NULL);
+  /* As in ChooseSparse(), sparse mode would be chosen if it is no larger. */
+  if ((flags & (LILCOM_FLAG_SPARSE|LILCOM_FLAG_LOSSLESS|
+                LILCOM_FLAG_ADAPTIVE)) || num_elements == 0 ||
+      num_zero_codes < kSparseProportion * num_elements)
+    return dense_bytes;
+  copy.assign(data, data + num_elements);
+  int64_t sparse_bytes = CompressFloatImpl<IntStreamSizeEstimator>(
+      tick_power, &(copy[0]), num_axes, dims, strides, regression_coeffs,
+      flags | LILCOM_FLAG_SPARSE, significant_bits, context, NULL);
+  return std::min(sparse_bytes, dense_bytes);
+}
+
+
+int64_t EstimateCompressedSize(int tick_power,
+                               const float *data,
+                               int num_axes,
+                               const int64_t *dims,
+                               const int64_t *strides,
+                               const int *regression_coeffs,
+                               int flags,
+                               int significant_bits) {
+  if (num_axes <= 0 || num_axes > 16)
+    return -1;
+  int64_t contiguous_strides[16];
+  int64_t num_elements = 1;
+  for (int i = num_axes - 1; i >= 0; i--) {
+    contiguous_strides[i] = num_elements;
+    num_elements *= dims[i];
+  }
+  if (!CheckCompressionArgs(tick_power, num_axes, dims, contiguous_strides,
+                            regression_coeffs, flags, significant_bits))
+    return -1;
+  std::vector<float> contiguous(num_elements);
+  int64_t num_zero_codes = 0;
+  if (num_elements > 0) {
+    CopyToContiguous(data, num_axes, dims, strides, &(contiguous[0]));
+    num_zero_codes = CountZeroCodes(pow(2.0, -tick_power), &(contiguous[0]),
+                                    num_axes, dims, contiguous_strides);
+  }
+  CompressionContext context;
+  return EstimateContiguous(tick_power,
+                            (num_elements > 0 ? &(contiguous[0]) : NULL),
+                            num_axes, dims, contiguous_strides,
+                            regression_coeffs, flags, significant_bits,
+                            num_zero_codes, &context);
+}
+
+
+/*
+  Returns a guess at the tick_power with which the codes of the contiguous
+  array `data` (with strides `strides`) would take `bits_per_element` bits
+  each, to start the search in ChooseTickPower().  It assumes that the
+  residuals of the prediction have a Laplacian distribution whose mean
+  absolute value m is that of the residuals of the prediction from the
+  original (not the compressed) data; then they take about
+  log2(2e * m / tick) bits each, when that is more than a bit or two.
+ */
+static int GuessTickPower(const float *data,
+                          int num_axes,
+                          const int64_t *dims,
+                          const int64_t *strides,
+                          const int *regression_coeffs,
+                          double bits_per_element) {
+  int64_t num_elements = NumElements(num_axes, dims), indexes[16];
+  for (int a = 0; a < num_axes; a++)
+    indexes[a] = 0;
+  double sum = 0.0;
+  for (int64_t i = 0; i < num_elements; i++) {
+    double predicted = 0.0;
+    for (int a = 0; a < num_axes; a++)
+      if (indexes[a] > 0)
+        predicted += data[i - strides[a]] * (regression_coeffs[a] / 256.0);
+    double residual = std::abs(data[i] - predicted);
+    if (residual <= std::numeric_limits<float>::max())  /* not inf/NaN */
+      sum += residual;
+    for (int a = num_axes - 1; a >= 0 && ++indexes[a] == dims[a]; a--)
+      indexes[a] = 0;
+  }
+  if (!(sum > 0.0))
+    return 0;
+  double guess = log2(sum / num_elements) + log2(2.0 * exp(1.0)) -
+      bits_per_element;
+  return (int)round(std::max(-20.0, std::min(guess, 20.0)));
+}
+
+
+/*
+  Returns EstimateContiguous() for this tick_power, using and updating the
+  cache `sizes`, of size 41 and indexed by tick_power + 20, in which -1
+  means not yet estimated.  `num_zero_codes` is as set by
+  CountZeroCodesAllTicks(), and the other args are as for
+  EstimateContiguous().  This is a helper for ChooseTickPower().
+ */
+static int64_t EstimateForTickPower(int tick_power,
+                                    const float *data,
+                                    int num_axes,
+                                    const int64_t *dims,
+                                    const int64_t *strides,
+                                    const int *regression_coeffs,
+                                    int flags,
+                                    int significant_bits,
+                                    const int64_t *num_zero_codes,
+                                    CompressionContext *context,
+                                    int64_t *sizes) {
+  int64_t *size = sizes + tick_power + 20;
+  if (*size < 0)
+    *size = EstimateContiguous(tick_power, data, num_axes, dims, strides,
+                               regression_coeffs, flags, significant_bits,
+                               num_zero_codes[tick_power + 20], context);
+  return *size;
+}
+
+
+bool ChooseTickPower(int64_t max_bytes,
+                     const float *data,
+                     int num_axes,
+                     const int64_t *dims,
+                     const int64_t *strides,
+                     const int *regression_coeffs,
+                     int flags,
+                     int *tick_power,
+                     int significant_bits) {
+  if (num_axes <= 0 || num_axes > 16)
+    return false;
+  int64_t contiguous_strides[16];
+  int64_t num_elements = 1;
+  for (int i = num_axes - 1; i >= 0; i--) {
+    contiguous_strides[i] = num_elements;
+    num_elements *= dims[i];
+  }
+  if (!CheckCompressionArgs(0, num_axes, dims, contiguous_strides,
+                            regression_coeffs, flags, significant_bits))
+    return false;
+  /* All the estimates compress copies of one contiguous copy of the input,
+     and the numbers of zero codes, which decide whether sparse mode is
+     tried, are counted for all tick_powers at once. */
+  std::vector<float> contiguous(num_elements);
+  int64_t num_zero_codes[41], sizes[41];
+  for (int t = 0; t <= 40; t++)
+    sizes[t] = -1;
+  const float *contiguous_data = NULL;
+  if (num_elements > 0) {
+    CopyToContiguous(data, num_axes, dims, strides, &(contiguous[0]));
+    contiguous_data = &(contiguous[0]);
+  }
+  CountZeroCodesAllTicks(contiguous_data, num_elements, num_zero_codes);
+  CompressionContext context;
+
+  /* The compressed size mostly decreases as tick_power increases, so we
+     search for the smallest tick_power that meets the budget, assuming
+     that it does.  Invariant: if it does, the answer is in [lower, upper].
+     Rather than bisecting, we start from GuessTickPower(), and each
+     further probe is where the size would meet the budget if it changed by
+     one bit per element per step of tick_power, which is about right
+     unless most of the codes are zero (then it changes less, and we take
+     more, smaller steps); it is kept within [lower, upper - 1] so that the
+     search always ends. */
+  double bytes_per_step = std::max(num_elements / 8.0, 1.0);
+  int lower = -20, upper = 20,
+      probe = (num_elements > 0 ?
+               GuessTickPower(contiguous_data, num_axes, dims,
+                              contiguous_strides, regression_coeffs,
+                              max_bytes / bytes_per_step) : 0);
+  while (lower < upper) {
+    probe = std::max(lower, std::min(probe, upper - 1));
+    int64_t size = EstimateForTickPower(probe, contiguous_data, num_axes, dims,
+                                        contiguous_strides, regression_coeffs,
+                                        flags, significant_bits,
+                                        num_zero_codes, &context, sizes);
+    if (size < 0)
+      return false;
+    if (size <= max_bytes)
+      upper = probe;
+    else
+      lower = probe + 1;
+    double steps = (size - max_bytes) / bytes_per_step;
+    if (size > max_bytes)
+      probe += (int)std::max(1.0, std::min(ceil(steps), 40.0));
+    else
+      probe -= (int)std::max(1.0, std::min(floor(-steps), 40.0));
+  }
+  /* But the size is not always monotonic (e.g. constant blocks and sparse
+     mode are chosen per tick_power), so the search may have been misled by
+     a size that was locally too large.  We guess that such a bump is at
+     most two tick_powers wide, so we try smaller tick_powers until two in a
+     row are over the budget.  This is a heuristic: it is not proven that
+     the size cannot come back under the budget further down. */
+  for (int t = lower - 1, num_over = 0; t >= -20 && num_over < 2; t--) {
+    int64_t size = EstimateForTickPower(t, contiguous_data, num_axes, dims,
+                                        contiguous_strides, regression_coeffs,
+                                        flags, significant_bits,
+                                        num_zero_codes, &context, sizes);
+    if (size <= max_bytes) {
+      lower = t;
+      num_over = 0;
+    } else {
+      num_over++;
+    }
+  }
+  *tick_power = lower;
+  return true;
+}
+
+
+/*
+  Compresses the array losslessly and appends the payload (any further
+  meta-information, then the codes) to `ans`; this is a helper for
+  CompressInt().  The last arg is only used to select the version for
+  32-bit IntType (this one) or 64-bit IntType.
+ */
+template <class T, class IntStreamType>
+static void AppendIntCodes(const T *data,
+                           int num_axes,
+                           const int64_t *dims,
+                           const int64_t *strides,
+                           const int *regression_coeffs,
+                           std::vector<char> *ans,
+                           int32_t) {
+  IntStreamType is;
+  int64_t indexes[16];
+  CompressLosslessInternal(data, num_axes, dims, strides, regression_coeffs,
+                           &is, 0, indexes);
+  AppendCode(&is, ans);
+}
+
+template <class T, class IntStreamType>
+static void AppendIntCodes(const T *data,
+                           int num_axes,
+                           const int64_t *dims,
+                           const int64_t *strides,
+                           const int *regression_coeffs,
+                           std::vector<char> *ans,
+                           int64_t) {
+  SplitIntStream<IntStreamType> sis;
+  int64_t indexes[16];
+  CompressLosslessInternal(data, num_axes, dims, strides, regression_coeffs,
+                           &sis, 0, indexes);
+  IntStream meta;
+  WriteInt64(sis.low.Code().size(), &meta);
+  AppendCode(&meta, ans);
+  AppendCode(&sis.low, ans);
+  AppendCode(&sis.high, ans);
+}
+
+
+template <class T>
+std::vector<char> CompressInt(const T *data,
+                              int num_axes,
+                              const int64_t *dims,
+                              const int64_t *strides,
+                              const int *regression_coeffs,
+                              int flags) {
+  std::vector<char> ans;
+  if (num_axes <= 0 || num_axes > 16) {
+    std::cerr << "lilcom: compression error: num-axes out of range "
+	      << num_axes << std::endl;
+    return ans;
+  }
+  if ((flags & ~LILCOM_FLAG_ARITHMETIC_CODING) != 0) {
+    std::cerr << "lilcom: invalid flags for integer data: " << flags
+              << std::endl;
+    return ans;
+  }
+  for (int i = 0; i < num_axes; i++) {
+    if (regression_coeffs[i] < -256 || regression_coeffs[i] > 256) {
+      std::cerr << "lilcom: regression coefficient out of range: "
+                << regression_coeffs[i] << std::endl;
+      return ans;
+    }
+  }
+  flags |= LILCOM_FLAG_LOSSLESS | LILCOM_FLAG_INTEGER;
+
+  WriteFixedHeader(LosslessType<T>::kType, 0, flags, num_axes, dims,
+                   regression_coeffs, &ans);
+  if (NumElements(num_axes, dims) == 0)
+    return ans;
+  num_axes = NumEffectiveAxes(num_axes, dims);
+  typename LosslessType<T>::IntType int_type = 0;
+  if (flags & LILCOM_FLAG_ARITHMETIC_CODING)
+    AppendIntCodes<T, ArithIntStream>(data, num_axes, dims, strides,
+                                      regression_coeffs, &ans, int_type);
+  else
+    AppendIntCodes<T, IntStream>(data, num_axes, dims, strides,
+                                 regression_coeffs, &ans, int_type);
+  SetPayloadBytes(&ans);
+  return ans;
+}
+
+
+/*
+  Returns true if `sample_bits` is a valid number of bits per sample for
+  audio samples of type T with CompressIntAdaptive().
+ */
+template <class T>
+static bool ValidSampleBits(int sample_bits) {
+  int type = LosslessType<T>::kType;
+  return (type == LILCOM_TYPE_INT16 && sample_bits == 16) ||
+      (type == LILCOM_TYPE_INT32 && (sample_bits == 24 || sample_bits == 32));
+}
+
+/* Returns `value` clipped to the range of a kSampleBits-bit integer. */
+template <int kSampleBits>
+static inline int32_t ClipSample(int64_t value) {
+  const int64_t max_value = ((int64_t)1 << (kSampleBits - 1)) - 1;
+  return (int32_t)std::max<int64_t>(-max_value - 1,
+                                    std::min<int64_t>(value, max_value));
+}
+
+/*
+  Internal recursively called function that writes the codes of audio
+  samples of kSampleBits bits to `tis`, for CompressIntAdaptive().  It is
+  like CompressLosslessInternal(), except that the predictions are
+  computed from the decompressed samples (which may differ from the
+  samples, because `tis` truncates the residuals), and clipped to the range
+  of kSampleBits bits, as the samples are.  The decompressed samples are
+  written to `decompressed`, which has the same dims as `data` and strides
+  `decompressed_strides`.
+ */
+template <int kSampleBits, class T>
+static void CompressIntAdaptiveInternal(const T *data,
+                                        int num_axes,
+                                        const int64_t *dims,
+                                        const int64_t *strides,
+                                        const int *regression_coeffs,
+                                        const int64_t *decompressed_strides,
+                                        int32_t *decompressed,
+                                        TruncatedIntStream *tis,
+                                        int axis,
+                                        int64_t *indexes) {
+  if (axis + 1 < num_axes) {
+    for (int64_t i = 0; i < dims[axis]; i++) {
+      indexes[axis] = i;
+      CompressIntAdaptiveInternal<kSampleBits>(
+          data, num_axes, dims, strides, regression_coeffs,
+          decompressed_strides, decompressed, tis, axis + 1, indexes);
+    }
+    return;
+  }
+  int64_t local_strides[16];
+  int local_coeffs[16];
+  int local_prev_axes = 0;
+  const T *cur_data = data;
+  int32_t *cur_decompressed = decompressed;
+  for (int i = 0; i < axis; i++) {
+    cur_data += indexes[i] * strides[i];
+    cur_decompressed += indexes[i] * decompressed_strides[i];
+    if (regression_coeffs[i] != 0 && indexes[i] != 0) {
+      local_strides[local_prev_axes] = decompressed_strides[i];
+      local_coeffs[local_prev_axes] = regression_coeffs[i];
+      local_prev_axes++;
+    }
+  }
+
+  int64_t dim = dims[axis],
+      stride = strides[axis],
+      decompressed_stride = decompressed_strides[axis];
+  int coeff = regression_coeffs[axis];
+
+  int64_t prev_prediction = 0;
+  for (int64_t i = 0; i < dim; i++) {
+    int64_t predicted = prev_prediction;
+    for (int j = 0; j < local_prev_axes; j++)
+      predicted += ScaleByCoeff(cur_decompressed[-(local_strides[j])],
+                                local_coeffs[j]);
+    int32_t prediction = ClipSample<kSampleBits>(predicted),
+        value = ClipSample<kSampleBits>(cur_data[i * stride]),
+        decompressed_value, decompressed_residual;
+    tis->WriteLimited<kSampleBits>((int64_t)value - prediction, prediction,
+                                   &decompressed_value,
+                                   &decompressed_residual);
+    *cur_decompressed = decompressed_value;
+    cur_decompressed += decompressed_stride;
+    prev_prediction = ScaleByCoeff(decompressed_value, coeff);
+  }
+}
+
+
+template <class T>
+std::vector<char> CompressIntAdaptive(const T *data,
+                                      int num_axes,
+                                      const int64_t *dims,
+                                      const int64_t *strides,
+                                      const int *regression_coeffs,
+                                      int sample_bits,
+                                      int significant_bits) {
+  std::vector<char> ans;
+  if (num_axes <= 0 || num_axes > 16) {
+    std::cerr << "lilcom: compression error: num-axes out of range "
+	      << num_axes << std::endl;
+    return ans;
+  }
+  if (!ValidSampleBits<T>(sample_bits)) {
+    std::cerr << "lilcom: invalid sample_bits for this type: "
+              << sample_bits << std::endl;
+    return ans;
+  }
+  if (significant_bits < 3 || significant_bits > 31) {
+    std::cerr << "lilcom: significant_bits out of range: "
+              << significant_bits << std::endl;
+    return ans;
+  }
+  for (int i = 0; i < num_axes; i++) {
+    if (regression_coeffs[i] < -256 || regression_coeffs[i] > 256) {
+      std::cerr << "lilcom: regression coefficient out of range: "
+                << regression_coeffs[i] << std::endl;
+      return ans;
+    }
+  }
+  WriteFixedHeader(LosslessType<T>::kType, 0,
+                   LILCOM_FLAG_INTEGER | LILCOM_FLAG_ADAPTIVE, num_axes, dims,
+                   regression_coeffs, &ans);
+  int64_t num_elements = NumElements(num_axes, dims);
+  if (num_elements == 0)
+    return ans;
+  num_axes = NumEffectiveAxes(num_axes, dims);
+
+  IntStream meta;
+  TruncationConfig config = AdaptiveConfig(significant_bits);
+  config.Write(&meta);
+  meta.Write(sample_bits);
+  AppendCode(&meta, &ans);
+
+  /* The decompressed samples, in C order, from which we predict. */
+  std::vector<int32_t> decompressed(num_elements);
+  int64_t decompressed_strides[16], indexes[16];
+  decompressed_strides[num_axes - 1] = 1;
+  for (int i = num_axes - 1; i > 0; i--)
+    decompressed_strides[i - 1] = decompressed_strides[i] * dims[i];
+  TruncatedIntStream tis(config);
+  switch (sample_bits) {
+    case 16:
+      CompressIntAdaptiveInternal<16>(data, num_axes, dims, strides,
+                                      regression_coeffs, decompressed_strides,
+                                      &(decompressed[0]), &tis, 0, indexes);
+      break;
+    case 24:
+      CompressIntAdaptiveInternal<24>(data, num_axes, dims, strides,
+                                      regression_coeffs, decompressed_strides,
+                                      &(decompressed[0]), &tis, 0, indexes);
+      break;
+    default:
+      CompressIntAdaptiveInternal<32>(data, num_axes, dims, strides,
+                                      regression_coeffs, decompressed_strides,
+                                      &(decompressed[0]), &tis, 0, indexes);
+  }
+  AppendCode(&tis, &ans);
+  SetPayloadBytes(&ans);
+  return ans;
+}
+
+
+/*
+  Writes the codes q = round(x / tick) of the elements x of the array `src`
+  with dimensions `dims` and strides `src_strides` to the contiguous array
+  `dest` (which must have space for the product of `dims`), as
+  CopyToContiguous() does for the elements themselves.  Returns a pointer
+  to one past the last code written.
+ */
+static int32_t *QuantizeToContiguous(const float *src,
+                                     int num_axes,
+                                     const int64_t *dims,
+                                     const int64_t *src_strides,
+                                     float tick,
+                                     int32_t *dest) {
+  int64_t dim = dims[0], stride = src_strides[0];
+  if (num_axes == 1) {
+    float inv_tick = 1.0 / tick;
+    for (int64_t i = 0; i < dim; i++)
+      *(dest++) = Quantize(src[i * stride], tick, inv_tick);
+  } else {
+    for (int64_t i = 0; i < dim; i++)
+      dest = QuantizeToContiguous(src + i * stride, num_axes - 1, dims + 1,
+                                  src_strides + 1, tick, dest);
+  }
+  return dest;
+}
+
+
+/*
+  Appends the contiguous array of codes `codes` with dimensions `dims`,
+  coded as by CompressInt(), to `*ans`.  This is for the base layer of data
+  compressed in layers (see LILCOM_FLAG_LAYERED in compression.h), and for
+  each channel with LILCOM_FLAG_CHANNELS.
+ */
+template <class IntStreamType>
+static void AppendContiguousCodes(const int32_t *codes,
+                                  int num_axes,
+                                  const int64_t *dims,
+                                  const int *regression_coeffs,
+                                  std::vector<char> *ans) {
+  int64_t strides[16], indexes[16];
+  strides[num_axes - 1] = 1;
+  for (int i = num_axes - 1; i > 0; i--)
+    strides[i - 1] = strides[i] * dims[i];
+  IntStreamType is;
+  size_t start = ans->size();
+  StartCode(&is, ans);
+  CompressLosslessInternal(codes, NumEffectiveAxes(num_axes, dims), dims,
+                           strides, regression_coeffs, &is, 0, indexes);
+  FinishCode(&is, start, ans);
+}
+
+
+std::vector<char> CompressFloatLayered(int tick_power,
+                                       const float *data,
+                                       int num_axes,
+                                       const int64_t *dims,
+                                       const int64_t *strides,
+                                       const int *regression_coeffs,
+                                       int num_layers,
+                                       int flags) {
+  std::vector<char> ans;
+  if (!CheckCompressionArgs(tick_power, num_axes, dims, strides,
+                            regression_coeffs, flags, 0))
+    return ans;
+  if ((flags & ~LILCOM_FLAG_ARITHMETIC_CODING) != 0) {
+    std::cerr << "lilcom: invalid flags for compression in layers: "
+              << flags << std::endl;
+    return ans;
+  }
+  if (num_layers < 1 || num_layers > LILCOM_MAX_LAYERS) {
+    std::cerr << "lilcom: number of layers out of range: " << num_layers
+              << std::endl;
+    return ans;
+  }
+  flags |= LILCOM_FLAG_LAYERED;
+  WriteFixedHeader(LILCOM_TYPE_FLOAT32, tick_power, flags, num_axes, dims,
+                   regression_coeffs, &ans);
+  LilcomHeader header;
+  memcpy(&header, &(ans[0]), sizeof(header));
+  header.num_layers = num_layers;
+  memcpy(&(ans[0]), &header, sizeof(header));
+
+  int64_t n = NumElements(num_axes, dims);
+  uint64_t base_bytes = 0;
+  size_t base_bytes_pos = ans.size();
+  ans.resize(base_bytes_pos + sizeof(base_bytes));
+  if (n != 0) {
+    /* Split each code q into the code of the base layer, q >> num_layers,
+       and the bits of the refinement layers, which we keep in `low`. */
+    std::vector<int32_t> codes(n);
+    QuantizeToContiguous(data, num_axes, dims, strides,
+                         pow(2.0, tick_power), &(codes[0]));
+    std::vector<uint16_t> low(n);
+    int32_t mask = (1 << num_layers) - 1;
+    for (int64_t i = 0; i < n; i++) {
+      low[i] = codes[i] & mask;
+      codes[i] >>= num_layers;
+    }
+    if (flags & LILCOM_FLAG_ARITHMETIC_CODING)
+      AppendContiguousCodes<ArithIntStream>(&(codes[0]), num_axes, dims,
+                                            regression_coeffs, &ans);
+    else
+      AppendContiguousCodes<IntStream>(&(codes[0]), num_axes, dims,
+                                       regression_coeffs, &ans);
+    base_bytes = ans.size() - base_bytes_pos - sizeof(base_bytes);
+
+    for (int layer = 1; layer <= num_layers; layer++) {
+      int bit = num_layers - layer;
+      BitStream bs;
+      bs.SwapCode(&ans);
+      for (int64_t i = 0; i < n; i++)
+        bs.Write(1, (low[i] >> bit) & 1);
+      bs.Code();
+      bs.SwapCode(&ans);
+    }
+  }
+  memcpy(&(ans[base_bytes_pos]), &base_bytes, sizeof(base_bytes));
+  SetPayloadBytes(&ans);
+  return ans;
+}
+
+
+/*
+  Returns the number of bytes of the table at the start of the payload of
+  data with LILCOM_FLAG_CHANNELS (see compression.h) with this number of
+  channels.
+ */
+static int64_t ChannelTableBytes(int64_t num_channels) {
+  return (num_channels * 4 + 7) / 8 * 8 + num_channels * 8;
+}
+
+/*
+  Returns the integerized coefficient in [-256, 256] for predicting
+  y[i] from x[i] by least squares, for 0 <= i < n, or 0 if it would be
+  small.  This is for LILCOM_FLAG_CHANNELS.
+ */
+static int ChannelCoeff(const int32_t *x, const int32_t *y, int64_t n) {
+  double xx = 0.0, xy = 0.0;
+  for (int64_t i = 0; i < n; i++) {
+    xx += x[i] * (double)x[i];
+    xy += x[i] * (double)y[i];
+  }
+  if (xx == 0.0)
+    return 0;
+  double coeff = xy / xx;
+  if (fabs(coeff) < 0.02)
+    return 0;
+  return (int)round(256.0 * std::max(-1.0, std::min(coeff, 1.0)));
+}
+
+
+std::vector<char> CompressFloatChannels(int tick_power,
+                                        const float *data,
+                                        int num_axes,
+                                        const int64_t *dims,
+                                        const int64_t *strides,
+                                        int flags) {
+  std::vector<char> ans;
+  /* Unlike CompressFloat(), we allow any strides, e.g. for audio with the
+     channels interleaved. */
+  if (num_axes != 2 || (flags & ~LILCOM_FLAG_ARITHMETIC_CODING) != 0) {
+    std::cerr << "lilcom: compression by channels needs 2 axes, and only "
+              << "allows arithmetic coding; got num-axes=" << num_axes
+              << ", flags=" << flags << std::endl;
+    return ans;
+  }
+  if (tick_power < -20 || tick_power > 20) {
+    std::cerr << "lilcom: tick_power out of range: " << tick_power
+	      << std::endl;
+    return ans;
+  }
+  flags |= LILCOM_FLAG_CHANNELS;
+  int zero_coeffs[2] = { 0, 0 };
+  WriteFixedHeader(LILCOM_TYPE_FLOAT32, tick_power, flags, num_axes, dims,
+                   zero_coeffs, &ans);
+  int64_t num_channels = dims[0], n = dims[1];
+  if (num_channels * n == 0) {
+    SetPayloadBytes(&ans);
+    return ans;
+  }
+  std::vector<int32_t> codes(num_channels * n), residuals(n);
+  QuantizeToContiguous(data, num_axes, dims, strides, pow(2.0, tick_power),
+                       &(codes[0]));
+  size_t table_pos = ans.size(),
+      ends_pos = table_pos + (num_channels * 4 + 7) / 8 * 8;
+  ans.resize(table_pos + ChannelTableBytes(num_channels), 0);
+  size_t streams_pos = ans.size();
+  for (int64_t c = 0; c < num_channels; c++) {
+    const int32_t *channel_codes = &(codes[c * n]);
+    int inter_coeff = (c == 0 ? 0 :
+                       ChannelCoeff(&(codes[0]), channel_codes, n));
+    if (inter_coeff != 0) {
+      /* We use unsigned arithmetic so that overflow is well defined; the
+         decoder wraps around in the same way. */
+      for (int64_t i = 0; i < n; i++)
+        residuals[i] = (int32_t)((uint32_t)channel_codes[i] -
+                                 (uint32_t)ScaleByCoeff(codes[i],
+                                                        inter_coeff));
+      channel_codes = &(residuals[0]);
+    }
+    int coeff = ChannelCoeff(channel_codes, channel_codes + 1, n - 1);
+    int16_t channel_coeffs[2] = { (int16_t)inter_coeff, (int16_t)coeff };
+    memcpy(&(ans[table_pos + c * 4]), channel_coeffs, 4);
+    if (flags & LILCOM_FLAG_ARITHMETIC_CODING)
+      AppendContiguousCodes<ArithIntStream>(channel_codes, 1, dims + 1,
+                                            &coeff, &ans);
+    else
+      AppendContiguousCodes<IntStream>(channel_codes, 1, dims + 1, &coeff,
+                                       &ans);
+    uint64_t end = ans.size() - streams_pos;
+    memcpy(&(ans[ends_pos + c * 8]), &end, 8);
+  }
+  SetPayloadBytes(&ans);
+  return ans;
+}
+
+
+/*
+  Returns true if `flags` is a valid combination of flags for compressed
+  data (some flags exclude others; see compression.h).
+ */
+static bool ValidFlags(int flags) {
+  return (flags & ~LILCOM_VALID_FLAGS) == 0 &&
+      !((flags & LILCOM_FLAG_SPARSE) &&
+        (flags & LILCOM_FLAG_CONSTANT_BLOCKS)) &&
+      !((flags & LILCOM_FLAG_LOSSLESS) &&
+        (flags & (LILCOM_FLAG_SPARSE|LILCOM_FLAG_CONSTANT_BLOCKS))) &&
+      !((flags & LILCOM_FLAG_INTEGER) &&
+        !(flags & (LILCOM_FLAG_LOSSLESS|LILCOM_FLAG_ADAPTIVE))) &&
+      !((flags & LILCOM_FLAG_ADAPTIVE) &&
+        (flags & (LILCOM_FLAG_SPARSE|LILCOM_FLAG_LOSSLESS))) &&
+      !((flags & LILCOM_FLAG_INTEGER) && (flags & LILCOM_FLAG_ADAPTIVE) &&
+        (flags & (LILCOM_FLAG_ARITHMETIC_CODING|
+                  LILCOM_FLAG_CONSTANT_BLOCKS))) &&
+      !((flags & LILCOM_FLAG_LAYERED) &&
+        (flags & ~(LILCOM_FLAG_LAYERED|LILCOM_FLAG_ARITHMETIC_CODING))) &&
+      !((flags & LILCOM_FLAG_CHANNELS) &&
+        (flags & ~(LILCOM_FLAG_CHANNELS|LILCOM_FLAG_ARITHMETIC_CODING)));
+}
+
+
+/*
+  Reads the format-version-2 header from the start of the compressed data
+  `src`, and checks it.  The args are as for ReadHeader() (but there is no
+  stream to read from; the payload starts at src + LilcomHeaderLen(*num_axes)).
+  Returns 0 on success, or one of the nonzero error codes documented for
+  DecompressFloat().
+ */
+static int ReadFixedHeader(const char *src,
+                           int64_t num_bytes,
+                           int *num_axes,
+                           int *tick_power,
+                           int *flags,
+                           int *type,
+                           int64_t *dims,
+                           int *regression_coeffs) {
+  LilcomHeader header;
+  if (num_bytes < LILCOM_FIXED_HEADER_LEN)
+    return 8;
+  memcpy(&header, src, sizeof(header));
+  if (header.magic != 'L' || header.format_version != 2)
+    return 8;
+  if (header.num_axes < 1 || header.num_axes > 16)
+    return 2;
+  *num_axes = header.num_axes;
+  int64_t header_len = LilcomHeaderLen(*num_axes);
+  /* Data compressed in layers may be cut short; see LayerPrefixBytes(). */
+  if (num_bytes < header_len ||
+      (header.payload_bytes > (uint64_t)(num_bytes - header_len) &&
+       !(header.flags & LILCOM_FLAG_LAYERED)))
+    return 6;
+  if (header.payload_bytes < (uint64_t)(num_bytes - header_len))
+    return 7;
+  if (header.tick_power < -20 || header.tick_power > 20)
+    return 3;
+  *tick_power = header.tick_power;
+  *flags = header.flags;
+  *type = header.type;
+  if (!ValidFlags(*flags) ||
+      ((*flags & LILCOM_FLAG_INTEGER) ?
+       (*type < LILCOM_TYPE_INT8 || *type > LILCOM_TYPE_UINT64) :
+       *type != LILCOM_TYPE_FLOAT32) ||
+      ((*flags & LILCOM_FLAG_LAYERED) ?
+       (header.num_layers < 1 || header.num_layers > LILCOM_MAX_LAYERS) :
+       header.num_layers != 0) ||
+      ((*flags & LILCOM_FLAG_CHANNELS) && *num_axes != 2))
+    return 8;
+  for (int i = 0; i < *num_axes; i++) {
+    int64_t dim = LilcomHeaderDim(src, i);
+    if (dim < 0)
+      return 4;
+    dims[i] = dim;
+    regression_coeffs[i] = LilcomHeaderCoeff(src, *num_axes, i);
+    if (regression_coeffs[i] < -256 || regression_coeffs[i] > 256)
+      return 5;
+  }
+  return 0;
+}
+
+
+/*
+  Reads the 'L', the format version, and the meta-information from the
+  start of compressed data `src` in format version 0 or 1.
+     @param [in] src   Start of the compressed data
+     @param [in] src_end  One past the end of the compressed data
+     @param [out] format_version   The format version (0 or 1)
+     @param [out] ris   Must be a stream constructed to read from
+                     src + LILCOM_HEADER_LEN; on success we will have read
+                     the meta-information from it.
+     @param [out] num_axes, tick_power, flags  The corresponding
+                     values from the header (flags will be 0 for format
+                     version 0)
+     @param [out] type  The element type, one of the LILCOM_TYPE_ values
+     @param [out] dims, regression_coeffs  Arrays of size 16 where
+                     the dimensions and regression coefficients of each axis
+                     will be written.
+     @return  Returns 0 on success, or one of the nonzero error codes
+              documented for DecompressFloat().
+ */
+static int ReadHeader(const char *src,
+                      const char *src_end,
+                      int *format_version,
+                      ReverseIntStream *ris,
+                      int *num_axes,
+                      int *tick_power,
+                      int *flags,
+                      int *type,
+                      int64_t *dims,
+                      int *regression_coeffs) {
+  if (src_end - src <= LILCOM_HEADER_LEN || src[0] != 'L' ||
+      src[1] < 0 || src[1] > 1)
+    return 8;
+  *format_version = src[1];
+  if (!ris->Read(num_axes) || *num_axes < 1 || *num_axes > 16)
+    return 2;
+  if (!ris->Read(tick_power) || *tick_power < -20 || *tick_power > 20)
+    return 3;
+  *flags = 0;
+  if (*format_version >= 1 &&
+      (!ris->Read(flags) || !ValidFlags(*flags) ||
+       (*flags & (LILCOM_FLAG_LAYERED|LILCOM_FLAG_CHANNELS)) ||
+       ((*flags & LILCOM_FLAG_INTEGER) && !(*flags & LILCOM_FLAG_LOSSLESS))))
+    return 8;
+  *type = LILCOM_TYPE_FLOAT32;
+  if ((*flags & LILCOM_FLAG_INTEGER) &&
+      (!ris->Read(type) || *type < LILCOM_TYPE_INT8 ||
+       *type > LILCOM_TYPE_UINT64))
+    return 8;
+  for (int i = 0; i < *num_axes; i++) {
+    int32_t dim;
+    if (!ris->Read(&dim) || !ris->Read(regression_coeffs + i) || dim < 0)
+      return 4;
+    dims[i] = dim;
+    if (regression_coeffs[i] < -256 || regression_coeffs[i] > 256)
+      return 5;
+  }
+  return 0;
+}
+
+
+/*
+  Reads the header of compressed data in any format version; this is
+  ReadFixedHeader() for format version 2 and ReadHeader() otherwise.  The
+  args are as for ReadHeader(), except that there is no `ris`.
+ */
+static int ReadAnyHeader(const char *src,
+                         int64_t num_bytes,
+                         int *format_version,
+                         int *num_axes,
+                         int *tick_power,
+                         int *flags,
+                         int *type,
+                         int64_t *dims,
+                         int *regression_coeffs) {
+  if (num_bytes > 1 && src[1] == 2) {
+    *format_version = 2;
+    return ReadFixedHeader(src, num_bytes, num_axes, tick_power, flags,
+                           type, dims, regression_coeffs);
+  }
+  if (num_bytes <= LILCOM_HEADER_LEN)
+    return 8;
+  ReverseIntStream ris(src + LILCOM_HEADER_LEN, src + num_bytes);
+  return ReadHeader(src, src + num_bytes, format_version, &ris, num_axes,
+                    tick_power, flags, type, dims, regression_coeffs);
+}
+
+
+bool GetCompressedDataShape(const char *data,
+                            int64_t num_bytes,
+                            int64_t *meta) {
+  int format_version, num_axes, tick_power, flags, type,
+      regression_coeffs[16];
+  int64_t dims[16];
+  int ret = ReadAnyHeader(data, num_bytes, &format_version, &num_axes,
+                          &tick_power, &flags, &type, dims,
+                          regression_coeffs);
+  if (ret != 0) {
+    std::cerr << "lilcom: could not read the header of the compressed "
+              << "data, error code " << ret << std::endl;
+    return false;
+  }
+  meta[0] = num_axes;
+  for (int i = 0; i < num_axes; i++)
+    meta[i + 1] = dims[i];
+  return true;
+}
+
+
+int GetCompressedDataType(const char *data,
+                          int64_t num_bytes) {
+  int format_version, num_axes, tick_power, flags, type,
+      regression_coeffs[16];
+  int64_t dims[16];
+  if (ReadAnyHeader(data, num_bytes, &format_version, &num_axes,
+                    &tick_power, &flags, &type, dims,
+                    regression_coeffs) != 0)
+    return -1;
+  return type;
+}
+
+
+/*
+  Reads the meta-information of the compressed data `src` as ReadHeader()
+  does (or as ReadFixedHeader() does, if `ris` is NULL), and checks that it
+  matches the num_axes and dims of the array we are decompressing to.  The
+  caller must already have checked num_axes, and that
+  num_bytes > LILCOM_HEADER_LEN.  Returns 0 on success, or one of the
+  nonzero error codes documented for DecompressFloat().
+ */
+static int ReadAndCheckHeader(const char *src,
+                              int64_t num_bytes,
+                              int num_axes,
+                              const int64_t *dims,
+                              int *format_version,
+                              ReverseIntStream *ris,
+                              int *tick_power,
+                              int *flags,
+                              int *type,
+                              int *regression_coeffs) {
+  int _num_axes, ret;
+  int64_t _dims[16];
+  if (ris == NULL) {
+    *format_version = 2;
+    ret = ReadFixedHeader(src, num_bytes, &_num_axes, tick_power, flags,
+                          type, _dims, regression_coeffs);
+  } else {
+    ret = ReadHeader(src, src + num_bytes, format_version, ris,
+                     &_num_axes, tick_power, flags, type, _dims,
+                     regression_coeffs);
+  }
+  if (ret != 0)
+    return ret;
+  if (_num_axes != num_axes)
+    return 2;
+  for (int i = 0; i < num_axes; i++)
+    if (_dims[i] != dims[i])
+      return 4;
+  return 0;
+}
+
+
+
+
+/*
+  ElementDecoder<T> says how the elements of a compressed float array are
+  reconstructed from their codes when they are decompressed to type T.
+  For T = float (DecompressFloat()) the value is prediction + code * tick.
+  For the integer types (DecompressQuantized()) the values are in units of
+  the tick, so the value is prediction + code; this requires the
+  regression coefficients to be 0 or +-1, so that the predictions are
+  integers too (see CanDecodeAs()).  Values that are out of the range of T
+  are an error, which sets out_of_range.
+ */
+template <class T>
+struct ElementDecoder {
+  typedef int64_t Value;  /* The type of the values and predictions. */
+
+  explicit ElementDecoder(float tick): out_of_range(false) { }
+
+  static Value Coeff(int regression_coeff) { return regression_coeff / 256; }
+
+  inline Value Decode(Value predicted, int32_t code) const {
+    return predicted + code;
+  }
+  inline Value FromCode(int32_t code) const { return code; }
+
+  /* Sets *dest to value; returns false if it is out of range. */
+  inline bool Store(Value value, T *dest) {
+    if (value < std::numeric_limits<T>::min() ||
+        value > std::numeric_limits<T>::max()) {
+      out_of_range = true;
+      return false;
+    }
+    *dest = static_cast<T>(value);
+    return true;
+  }
+
+  bool out_of_range;
+};
+
+template <>
+struct ElementDecoder<float> {
+  typedef float Value;
+
+  explicit ElementDecoder(float tick): tick(tick), out_of_range(false) { }
+
+  static Value Coeff(int regression_coeff) {
+    return regression_coeff * (1.0 / 256.0);
+  }
+
+  inline Value Decode(Value predicted, int32_t code) const {
+    return predicted + code * tick;
+  }
+  inline Value FromCode(int32_t code) const { return code * tick; }
+
+  inline bool Store(Value value, float *dest) {
+    *dest = value;
+    return true;
+  }
+
+  float tick;
+  bool out_of_range;  /* Always false. */
+};
+
+
+/*
+  Decompresses `n` elements of one row of an array, starting at `cur_data`;
+  this is a helper for DecompressFloatInternal(), which documents most of
+  the args.  `*prev_prediction` is the prediction from the previous element
+  of the row, and is updated.  Returns false if the stream ended early or
+  a value was out of range.
+ */
+template <class T, class ReverseIntStreamType>
+static inline bool DecompressElements(
+    ReverseIntStreamType *ris,
+    ElementDecoder<T> *decoder,
+    T *cur_data,
+    int64_t n,
+    int64_t stride,
+    typename ElementDecoder<T>::Value coeff,
+    int local_prev_axes,
+    const int64_t *local_strides,
+    const typename ElementDecoder<T>::Value *local_coeffs,
+    typename ElementDecoder<T>::Value *prev_prediction) {
+  typedef typename ElementDecoder<T>::Value Value;
+  /* A local copy, so the compiler knows that writing the elements does not
+     change it (for floats it would otherwise reload the tick each time). */
+  ElementDecoder<T> local_decoder(*decoder);
+  T *end = cur_data + (n * stride);
+  for (; cur_data < end; cur_data += stride) {
+    Value predicted = *prev_prediction; /* will be prev element times coeff */
+    int32_t code;
+    if (!ris->Read(&code))
+      return false;
+    for (int i = 0; i < local_prev_axes; i++) {
+      /* add prediction from lower-numbered axes to this prediction. */
+      predicted += cur_data[-(local_strides[i])] * local_coeffs[i];
+    }
+    Value value = local_decoder.Decode(predicted, code);
+    if (!local_decoder.Store(value, cur_data)) {
+      *decoder = local_decoder;
+      return false;
+    }
+    *prev_prediction = value * coeff;
+  }
+  return true;
+}
+
+
+/*
+  Internal recursively called function that reads codes from `ris` to 
+  decompress this array.
+      @param [in] ris   The codes will be read from this stream, one per data
+                        element.  Will be of type ReverseIntStream or
+                        ReverseArithIntStream.  If the meta-info was in the
+                        same stream, it will already have been read.
+      @param [in,out] decoder  Reconstructs the values from the codes; it
+                        knows the tick (the distance between compressed
+                        values, e.g. 2^-8).
+      @param [in] data  Array to write data to
+      @param [in] num_axes  Number of axes in `data`.  Must be in the range [1..16]
+      @param [in] dims  Dimensions of `data`, indexed by axis
+      @param [in] strides   Strides of elements of `data`, in float elements
+                       (not bytes), indexed by axis.
+      @param [in] regression_coeffs  Regression coefficients, one per axis, 
+                        the same as used for compression (these will have been
+                        read from the header), as converted by
+                        ElementDecoder<T>::Coeff().  See docs in compression.h
+                        for how this works
+      @param [in,out] cb  The constant blocks of the array, which are not
+                        in `ris`, or NULL if there are none.  num_axes must
+                        not include trailing axes of dimension 1 if this is
+                        non-NULL.
+      @param [in] axis  The axis to iterate on; top-level call is with 0,
+                        this will have values 0 <= axis < num_axes.
+      @param [in] indexes  Array of indexes we're processing on axes *prior* to the
+                        current axis, i.e. for axes i with 0 <= i < axis.  Must
+                        have space equal to at least num_axes-1.
+                        Will be set in the recursion.
+      @return  Returns true on success, false if we reached the end of the stream
+                        before decompression was finished (or a value was
+                        out of range, which sets decoder->out_of_range).
+ */
+template <class T, class ReverseIntStreamType>
+bool DecompressFloatInternal(ReverseIntStreamType *ris,
+			     ElementDecoder<T> *decoder,
+			     T *data,
+			     int num_axes,
+			     const int64_t *dims, 
+			     const int64_t *strides,
+			     const typename ElementDecoder<T>::Value *regression_coeffs,
+			     ConstantBlocks *cb,
+			     int axis,
+			     int64_t *indexes) {
+  typedef typename ElementDecoder<T>::Value Value;
+  if (axis + 1 < num_axes) {
+    for (int64_t i = 0; i < dims[axis]; i++) {
+      indexes[axis] = i;
+      // Recurse
+      if (!DecompressFloatInternal(ris, decoder, data, num_axes, dims, strides,
+				   regression_coeffs, cb, axis + 1, indexes))
+        return false;
+    }
+    return true;
+  }
+  assert(axis == num_axes - 1);
+
+  /* local_strides and local_coeffs will be the strides and
+     corresponding regression coefficients for axes prior to `axis`
+     whose corresponding indexes are not zero and whose regression
+     coefficients are not 1. */
+
+  /* (They are initialized only so that the compiler does not warn that
+     they may be used uninitialized; only the first local_prev_axes are
+     used.) */
+  int64_t local_strides[16] = { 0 };
+  Value local_coeffs[16] = { 0 };
+  int local_prev_axes = 0;
+  T *cur_data = data;
+  for (int i = 0; i < axis; i++) {
+    /* make `local_data` point to the start of what we're processing here. */
+    cur_data += indexes[i] * strides[i];
+    if (regression_coeffs[i] != 0 && indexes[i] != 0) {
+      local_strides[local_prev_axes] = strides[i];
+      local_coeffs[local_prev_axes] = regression_coeffs[i];
+      local_prev_axes++;
+    }
+  }
+
+  int64_t dim = dims[axis],
+    stride = strides[axis];
+  Value coeff = regression_coeffs[axis];
+
+  /* The base-case, where there is 1 dimension, is a bit more optimized. */
+  Value prev_prediction = 0;
+  int64_t pos = 0;  /* The number of elements of this row done so far. */
+  int64_t start, end;
+  int32_t code;
+  while (cb != NULL && cb->NextRange(dim, &start, &end, &code)) {
+    if (!DecompressElements(ris, decoder, cur_data + pos * stride,
+                            start - pos, stride, coeff, local_prev_axes,
+                            local_strides, local_coeffs, &prev_prediction))
+      return false;
+    Value value = decoder->FromCode(code);
+    T fill_value;
+    if (!decoder->Store(value, &fill_value))
+      return false;
+    FillElements(cur_data + start * stride, end - start, stride, fill_value);
+    prev_prediction = value * coeff;
+    pos = end;
+  }
+  return DecompressElements(ris, decoder, cur_data + pos * stride, dim - pos,
+                            stride, coeff, local_prev_axes, local_strides,
+                            local_coeffs, &prev_prediction);
+}
+
+
+/*
+  Internal recursively called function that reads codes from `ris` to
+  decompress an array that was compressed losslessly (see
+  CompressLosslessInternal()).  Returns true on success, false if the
+  stream ended early.
+ */
+template <class T, class ReverseIntStreamType>
+static bool DecompressLosslessInternal(ReverseIntStreamType *ris,
+                                       T *data,
+                                       int num_axes,
+                                       const int64_t *dims,
+                                       const int64_t *strides,
+                                       const int *regression_coeffs,
+                                       int axis,
+                                       int64_t *indexes) {
+  if (axis + 1 < num_axes) {
+    for (int64_t i = 0; i < dims[axis]; i++) {
+      indexes[axis] = i;
+      if (!DecompressLosslessInternal(ris, data, num_axes, dims, strides,
+                                      regression_coeffs, axis + 1, indexes))
+        return false;
+    }
+    return true;
+  }
+  typedef typename LosslessType<T>::IntType IntType;
+
+  int64_t local_strides[16];
+  int local_coeffs[16];
+  int local_prev_axes = 0;
+  T *cur_data = data;
+  for (int i = 0; i < axis; i++) {
+    cur_data += indexes[i] * strides[i];
+    if (regression_coeffs[i] != 0 && indexes[i] != 0) {
+      local_strides[local_prev_axes] = strides[i];
+      local_coeffs[local_prev_axes] = regression_coeffs[i];
+      local_prev_axes++;
+    }
+  }
+
+  int64_t dim = dims[axis],
+    stride = strides[axis];
+  int coeff = regression_coeffs[axis];
+
+  uint64_t prev_prediction = 0;
+  T *end = cur_data + (dim * stride);
+  for (; cur_data < end; cur_data += stride) {
+    uint64_t predicted = prev_prediction;
+    IntType residual;
+    if (!ris->Read(&residual))
+      return false;
+    for (int i = 0; i < local_prev_axes; i++)
+      predicted += ScaleByCoeff(
+          LosslessType<T>::ToInt(cur_data[-(local_strides[i])]),
+          local_coeffs[i]);
+    IntType value = (IntType)(predicted + (uint64_t)residual);
+    *cur_data = LosslessType<T>::FromInt(value);
+    prev_prediction = ScaleByCoeff(value, coeff);
+  }
+  return true;
+}
+
+
+/*
+  Reads the table of constant blocks written by WriteConstantBlocks() from
+  `ris` into `cb`.  `num_blocks` is the number of blocks in the array.
+  Returns true on success, false if the table could not be read or was
+  invalid.
+ */
+static bool ReadConstantBlocks(ReverseIntStream *ris,
+                               int64_t num_blocks,
+                               ConstantBlocks *cb) {
+  int32_t num_runs;
+  if (!ris->Read(&num_runs) || num_runs <= 0 || num_runs > num_blocks)
+    return false;
+  cb->starts.resize(num_runs);
+  cb->lengths.resize(num_runs);
+  cb->codes.resize(num_runs);
+  int64_t prev_end = 0;
+  int32_t prev_code = 0;
+  for (int32_t i = 0; i < num_runs; i++) {
+    int32_t gap, length_minus_one, code_diff;
+    if (!ris->Read(&gap) || !ris->Read(&length_minus_one) ||
+        !ris->Read(&code_diff) || gap < 0 || length_minus_one < 0 ||
+        prev_end + gap + length_minus_one + 1 > num_blocks)
+      return false;
+    cb->starts[i] = prev_end + gap;
+    cb->lengths[i] = length_minus_one + 1;
+    cb->codes[i] = (int32_t)((uint32_t)prev_code + (uint32_t)code_diff);
+    prev_end = cb->starts[i] + cb->lengths[i];
+    prev_code = cb->codes[i];
+  }
+  return true;
+}
+
+
+
+
+/*
+  Internal recursively called function that reads codes from `rsis` to
+  decompress an array that was compressed in sparse mode (see
+  CompressSparseInternal()).  Runs of zeros are written without reading
+  them one by one.  Returns true on success, false if the stream ended
+  early or was corrupted (or a value was out of range; see
+  DecompressFloatInternal()).
+ */
+template <class T, class ReverseIntStreamType>
+static bool DecompressSparseInternal(
+    ElementDecoder<T> *decoder,
+    T *data,
+    int num_axes,
+    const int64_t *dims,
+    const int64_t *strides,
+    ReverseSparseIntStream<ReverseIntStreamType> *rsis) {
+  int64_t dim = dims[0], stride = strides[0];
+  if (num_axes > 1) {
+    for (int64_t i = 0; i < dim; i++)
+      if (!DecompressSparseInternal(decoder, data + i * stride, num_axes - 1,
+                                    dims + 1, strides + 1, rsis))
+        return false;
+    return true;
+  }
+  int64_t i = 0;
+  while (i < dim) {
+    int64_t num_zeros = rsis->NumZeros();
+    if (num_zeros < 0)
+      return false;
+    if (num_zeros > 0) {
+      int64_t n = (num_zeros < dim - i ? num_zeros : dim - i);
+      if (stride == 1) {
+        std::fill(data + i, data + i + n, T(0));
+      } else {
+        for (int64_t j = i; j < i + n; j++)
+          data[j * stride] = 0;
+      }
+      rsis->SkipZeros(n);
+      i += n;
+    } else {
+      int32_t code;
+      if (!rsis->Read(&code) ||
+          !decoder->Store(decoder->FromCode(code), data + i * stride))
+        return false;
+      i++;
+    }
+  }
+  return true;
+}
+
+
+/*
+  Decompresses the codes for the elements of the array from the stream `rs`,
+  which may be any type with the same Read() interface as ReverseIntStream.
+  `cb` is the constant blocks of the array, or NULL if there are none.
+  The elements are of type T, as for DecompressFloatAs().  Returns 0 on
+  success or an error code as documented for DecompressFloat() and
+  DecompressQuantized().
+ */
+template <class T, class ReverseIntStreamType>
+static int ReadCodes(ReverseIntStreamType *rs,
+                     const char *src_end,
+                     int tick_power,
+                     T *array,
+                     int num_axes,
+                     const int64_t *dims,
+                     const int64_t *strides,
+                     const int *regression_coeffs,
+                     int flags,
+                     ConstantBlocks *cb) {
+  ElementDecoder<T> decoder(pow(2.0, tick_power));
+  typename ElementDecoder<T>::Value decoder_coeffs[16];
+  int64_t indexes[16];
+  for (int i = 0; i < num_axes; i++)
+    decoder_coeffs[i] = ElementDecoder<T>::Coeff(regression_coeffs[i]);
+  if (flags & LILCOM_FLAG_LOSSLESS) {
+    if (!DecompressLosslessInternal(rs, array,
+                                    NumEffectiveAxes(num_axes, dims), dims,
+                                    strides, regression_coeffs, 0, indexes))
+      return 6;
+  } else if (flags & LILCOM_FLAG_SPARSE) {
+    ReverseSparseIntStream<ReverseIntStreamType> rsis(rs);
+    if (!DecompressSparseInternal(&decoder, array, num_axes,
+                                  dims, strides, &rsis))
+      return (decoder.out_of_range ? 12 : 6);
+  } else if (!DecompressFloatInternal(rs, &decoder, array,
+                                      NumEffectiveAxes(num_axes, dims),
+                                      dims, strides, decoder_coeffs,
+                                      cb, 0, indexes)) {
+    return (decoder.out_of_range ? 12 : 6);
+  }
+  if (rs->NextCode() != src_end)
+    return 7;
+  return 0;
+}
+
+
+/*
+  Calls ReadCodes() with the stream `rs`, or, if `adaptive_config` is
+  non-NULL (i.e. in adaptive mode), with a ReverseAdaptiveIntStream reading
+  from it.
+ */
+template <class T, class ReverseIntStreamType>
+static int ReadCodesAdaptive(ReverseIntStreamType *rs,
+                             const TruncationConfig *adaptive_config,
+                             const char *src_end,
+                             int tick_power,
+                             T *array,
+                             int num_axes,
+                             const int64_t *dims,
+                             const int64_t *strides,
+                             const int *regression_coeffs,
+                             int flags,
+                             ConstantBlocks *cb) {
+  if (adaptive_config == NULL)
+    return ReadCodes(rs, src_end, tick_power, array, num_axes, dims,
+                     strides, regression_coeffs, flags, cb);
+  ReverseAdaptiveIntStream<ReverseIntStreamType> rais(*adaptive_config, rs);
+  return ReadCodes(&rais, src_end, tick_power, array, num_axes, dims,
+                   strides, regression_coeffs, flags, cb);
+}
+
+
+/*
+  Decompresses what follows the header: any configuration for adaptive mode
+  and table of constant blocks, then the codes.  This is a helper for
+  DecompressFloat(), which documents most of the args.
+     @param [in] meta  The stream from which to read the configuration and
+                  table of constant blocks if the flags say there are any;
+                  the codes follow it.  May be NULL if there are none, in
+                  which case the codes start at `codes`.
+     @param [in] codes  Where the codes start if `meta` is NULL.
+     @param [in] context  Memory to use for the table of constant blocks,
+                  or NULL; see codec_context.h.
+  The elements are of type T, as for DecompressFloatAs().
+ */
+template <class T>
+static int DecompressFloatPayload(ReverseIntStream *meta,
+                                  const char *codes,
+                                  const char *src_end,
+                                  DecompressionContext *context,
+                                  int tick_power,
+                                  int flags,
+                                  const int *regression_coeffs,
+                                  T *array,
+                                  int num_axes,
+                                  const int64_t *dims,
+                                  const int64_t *strides) {
+  LILCOM_STATS_ONLY(StatsTimer decode_timer(&CodecStats::decode_seconds);)
+  TruncationConfig adaptive_config;
+  TruncationConfig *adaptive_config_ptr = NULL;
+  if (flags & LILCOM_FLAG_ADAPTIVE) {
+    if (meta == NULL || !adaptive_config.Read(1, meta))
+      return 9;
+    adaptive_config_ptr = &adaptive_config;
+  }
+  ConstantBlocks cb;
+  ConstantBlocksMemory<DecompressionContext> cb_memory(context, &cb);
+  ConstantBlocks *cb_ptr = NULL;
+  if (flags & LILCOM_FLAG_CONSTANT_BLOCKS) {
+    if (meta == NULL ||
+        !ReadConstantBlocks(meta, NumBlocks(num_axes, dims), &cb))
+      return 9;
+    cb_ptr = &cb;
+  }
+  if (meta != NULL)
+    codes = meta->NextCode();
+  LILCOM_STATS_ONLY(
+      if (current_stats) current_stats->code_bytes = src_end - codes;)
+  if (NumCodedElements(num_axes, dims, cb_ptr) == 0) {
+    if (codes != src_end)
+      return 7;
+    if (cb_ptr == NULL)
+      return 0;  /* There are no elements. */
+    /* The elements are all in constant blocks. */
+    return ReadCodes(meta, src_end, tick_power, array, num_axes, dims,
+                     strides, regression_coeffs, flags, cb_ptr);
+  }
+  if (codes >= src_end)
+    return 6;
+  if (flags & LILCOM_FLAG_ARITHMETIC_CODING) {
+    ReverseArithIntStream ras(codes, src_end);
+    return ReadCodesAdaptive(&ras, adaptive_config_ptr, src_end, tick_power,
+                             array, num_axes, dims, strides,
+                             regression_coeffs, flags, cb_ptr);
+  } else {
+    ReverseIntStream codes_ris(codes, src_end);
+    return ReadCodesAdaptive(&codes_ris, adaptive_config_ptr, src_end,
+                             tick_power, array, num_axes, dims, strides,
+                             regression_coeffs, flags, cb_ptr);
+  }
+}
+
+
+/*
+  Returns true if data with these flags and regression coefficients can be
+  decompressed to elements of type T (see DecompressFloatAs()).  Floats
+  always can; integers (in units of the tick) only if all the values are
+  integer multiples of the tick, which is so if the regression coefficients
+  are all 0 or +-1 (so the predictions are too) and it is not lossless, or
+  if it was compressed in layers or by channels.
+ */
+static bool CanDecodeAs(const float*, int, int, const int*) {
+  return true;
+}
+
+template <class T>
+static bool CanDecodeAs(const T*, int flags, int num_axes,
+                        const int *regression_coeffs) {
+  if (flags & (LILCOM_FLAG_LAYERED|LILCOM_FLAG_CHANNELS))
+    return true;
+  if (flags & LILCOM_FLAG_LOSSLESS)
+    return false;
+  for (int i = 0; i < num_axes; i++)
+    if (regression_coeffs[i] != 0 && regression_coeffs[i] != 256 &&
+        regression_coeffs[i] != -256)
+      return false;
+  return true;
+}
+
+
+/*
+  Reads the sizes of the layers of data compressed in layers (see
+  LILCOM_FLAG_LAYERED in compression.h), whose header has been read and
+  checked by ReadFixedHeader(), from `src`, which may be cut short after
+  the size of the base layer.  Sets `*num_layers` to the number of
+  refinement layers, `*base_bytes` to the size of the base layer, and
+  `*plane_bytes` to the size of each refinement layer.  Returns 0 on
+  success, 6 if `src` is too short, or 8 if the sizes do not add up to the
+  size of the payload.
+ */
+static int ReadLayerSizes(const char *src,
+                          int64_t num_bytes,
+                          int num_axes,
+                          const int64_t *dims,
+                          int *num_layers,
+                          int64_t *base_bytes,
+                          int64_t *plane_bytes) {
+  LilcomHeader header;
+  memcpy(&header, src, sizeof(header));
+  int64_t header_len = LilcomHeaderLen(num_axes);
+  uint64_t base;
+  if (num_bytes < header_len + (int64_t)sizeof(base))
+    return 6;
+  memcpy(&base, src + header_len, sizeof(base));
+  *num_layers = header.num_layers;
+  *plane_bytes = (NumElements(num_axes, dims) + 7) / 8;
+  if (header.payload_bytes < sizeof(base) ||
+      base > header.payload_bytes - sizeof(base) ||
+      header.payload_bytes - sizeof(base) - base !=
+      (uint64_t)(*num_layers * *plane_bytes))
+    return 8;
+  *base_bytes = base;
+  return 0;
+}
+
+/*
+  Decodes codes written by AppendContiguousCodes(), which are from `begin`
+  to `end`, to the contiguous array `codes`.  Returns 0 on success, 6 if
+  the stream ended early or 7 if it did not end at `end`.
+ */
+template <class ReverseIntStreamType>
+static int ReadContiguousCodes(const char *begin,
+                               const char *end,
+                               int num_axes,
+                               const int64_t *dims,
+                               const int *regression_coeffs,
+                               int32_t *codes) {
+  int64_t strides[16], indexes[16];
+  strides[num_axes - 1] = 1;
+  for (int i = num_axes - 1; i > 0; i--)
+    strides[i - 1] = strides[i] * dims[i];
+  ReverseIntStreamType rs(begin, end);
+  if (!DecompressLosslessInternal(&rs, codes,
+                                  NumEffectiveAxes(num_axes, dims), dims,
+                                  strides, regression_coeffs, 0, indexes))
+    return 6;
+  return (rs.NextCode() == end ? 0 : 7);
+}
+
+/*
+  Stores the values of the contiguous array of codes `codes` to the array
+  `dest` with dimensions `dims` and strides `strides`, using `decoder`.
+  Returns a pointer to one past the last code used, or NULL if a value was
+  out of range.
+ */
+template <class T>
+static const int32_t *StoreCodes(const int32_t *codes,
+                                 ElementDecoder<T> *decoder,
+                                 int num_axes,
+                                 const int64_t *dims,
+                                 const int64_t *strides,
+                                 T *dest) {
+  int64_t dim = dims[0], stride = strides[0];
+  if (num_axes == 1) {
+    for (int64_t i = 0; i < dim; i++)
+      if (!decoder->Store(decoder->FromCode(*(codes++)), dest + i * stride))
+        return NULL;
+  } else {
+    for (int64_t i = 0; i < dim; i++) {
+      codes = StoreCodes(codes, decoder, num_axes - 1, dims + 1,
+                         strides + 1, dest + i * stride);
+      if (codes == NULL)
+        return NULL;
+    }
+  }
+  return codes;
+}
+
+/*
+  Decompresses data compressed in layers (see LILCOM_FLAG_LAYERED in
+  compression.h), up to layer `max_layer`, to the array `array` of type T;
+  this is a helper for DecompressFloatAs(), which has read and checked the
+  header, and documents the other args.  If not all the refinement layers
+  are decoded, each code is put in the middle of the range of codes that
+  the ones decoded allow.  Returns 0 on success or an error code as
+  documented for DecompressFloat() and DecompressQuantized().
+ */
+template <class T>
+static int DecompressLayered(const char *src,
+                             int64_t num_bytes,
+                             int max_layer,
+                             int tick_power,
+                             int flags,
+                             const int *regression_coeffs,
+                             T *array,
+                             int num_axes,
+                             const int64_t *dims,
+                             const int64_t *strides) {
+  int num_layers;
+  int64_t base_bytes, plane_bytes;
+  int ret = ReadLayerSizes(src, num_bytes, num_axes, dims, &num_layers,
+                           &base_bytes, &plane_bytes);
+  if (ret != 0)
+    return ret;
+  if (max_layer < 0 || max_layer > num_layers)
+    max_layer = num_layers;
+  const char *base = src + LilcomHeaderLen(num_axes) + sizeof(uint64_t),
+      *planes = base + base_bytes;
+  if (num_bytes - (planes - src) < max_layer * plane_bytes)
+    return 6;
+  int64_t n = NumElements(num_axes, dims);
+  if (n == 0)
+    return 0;
+
+  std::vector<int32_t> codes(n);
+  if (flags & LILCOM_FLAG_ARITHMETIC_CODING)
+    ret = ReadContiguousCodes<ReverseArithIntStream>(
+        base, planes, num_axes, dims, regression_coeffs, &(codes[0]));
+  else
+    ret = ReadContiguousCodes<ReverseIntStream>(
+        base, planes, num_axes, dims, regression_coeffs, &(codes[0]));
+  if (ret != 0)
+    return ret;
+  LILCOM_STATS_ONLY(
+      if (current_stats)
+        current_stats->code_bytes = base_bytes + max_layer * plane_bytes;)
+
+  /* We use unsigned arithmetic so that the shifts are well defined for
+     negative codes. */
+  for (int layer = 0; layer < max_layer; layer++) {
+    const char *plane = planes + layer * plane_bytes;
+    ReverseBitStream rbs(plane, plane + plane_bytes);
+    for (int64_t i = 0; i < n; i++) {
+      uint32_t bit = 0;
+      rbs.Read(1, &bit);
+      codes[i] = (int32_t)(((uint32_t)codes[i] << 1) | bit);
+    }
+  }
+  if (max_layer < num_layers) {
+    int shift = num_layers - max_layer;
+    uint32_t middle = (uint32_t)1 << (shift - 1);
+    for (int64_t i = 0; i < n; i++)
+      codes[i] = (int32_t)(((uint32_t)codes[i] << shift) + middle);
+  }
+
+  ElementDecoder<T> decoder(pow(2.0, tick_power));
+  if (StoreCodes(&(codes[0]), &decoder, num_axes, dims, strides,
+                 array) == NULL)
+    return 12;
+  return 0;
+}
+
+
+/*
+  Decodes the codes of channel `c` of data with LILCOM_FLAG_CHANNELS to
+  `codes`, which has space for the dims[1] samples; this is a helper for
+  DecompressChannels(), which has read the table of channels to
+  `stream_ends`, `inter_coeffs` and `coeffs`.  `reference_codes` must be
+  the codes of channel 0 if the channel is predicted from it.  Returns 0
+  on success or an error code as for ReadContiguousCodes().
+ */
+static int ReadChannel(const char *streams,
+                       const uint64_t *stream_ends,
+                       const int *inter_coeffs,
+                       const int *coeffs,
+                       int64_t c,
+                       int flags,
+                       const int64_t *dims,
+                       const int32_t *reference_codes,
+                       int32_t *codes) {
+  const char *stream = streams + (c == 0 ? 0 : stream_ends[c - 1]),
+      *stream_end = streams + stream_ends[c];
+  int ret;
+  if (flags & LILCOM_FLAG_ARITHMETIC_CODING)
+    ret = ReadContiguousCodes<ReverseArithIntStream>(
+        stream, stream_end, 1, dims + 1, coeffs + c, codes);
+  else
+    ret = ReadContiguousCodes<ReverseIntStream>(
+        stream, stream_end, 1, dims + 1, coeffs + c, codes);
+  if (ret != 0 || inter_coeffs[c] == 0)
+    return ret;
+  for (int64_t i = 0; i < dims[1]; i++)
+    codes[i] = (int32_t)((uint32_t)codes[i] +
+                         (uint32_t)ScaleByCoeff(reference_codes[i],
+                                                inter_coeffs[c]));
+  return 0;
+}
+
+
+/*
+  Decompresses channels [begin, end) of data with LILCOM_FLAG_CHANNELS
+  (see compression.h), whose header has been read and checked by
+  ReadFixedHeader() and says it has `dims` (the number of channels and of
+  samples), to the array `array` of type T, where channel c goes to
+  array + (c - begin) * strides[0].  Only the streams of those channels
+  are decoded, and that of channel 0 if one of them is predicted from it.
+  Returns 0 on success or an error code as documented for
+  DecompressFloat().
+ */
+template <class T>
+static int DecompressChannels(const char *src,
+                              int64_t num_bytes,
+                              int tick_power,
+                              int flags,
+                              const int64_t *dims,
+                              int64_t begin,
+                              int64_t end,
+                              T *array,
+                              const int64_t *strides) {
+  int64_t num_channels = dims[0], n = dims[1];
+  const char *payload = src + LilcomHeaderLen(2),
+      *src_end = src + num_bytes;
+  if (num_channels == 0 || n == 0)
+    return (payload == src_end ? 0 : 7);
+  /* Each channel takes 12 bytes of the table, so this rejects dims that are
+     too large before the arithmetic below can overflow. */
+  if (num_channels > (src_end - payload) / 12 ||
+      n > std::numeric_limits<int64_t>::max() / num_channels)
+    return 6;
+  int64_t table_bytes = ChannelTableBytes(num_channels);
+  if (src_end - payload < table_bytes)
+    return 6;
+  const char *ends = payload + (num_channels * 4 + 7) / 8 * 8,
+      *streams = payload + table_bytes;
+  /* Checks the table, and reads the coefficients. */
+  std::vector<int> inter_coeffs(num_channels), coeffs(num_channels);
+  std::vector<uint64_t> stream_ends(num_channels);
+  uint64_t prev_end = 0;
+  for (int64_t c = 0; c < num_channels; c++) {
+    int16_t channel_coeffs[2];
+    memcpy(channel_coeffs, payload + c * 4, 4);
+    memcpy(&(stream_ends[c]), ends + c * 8, 8);
+    inter_coeffs[c] = channel_coeffs[0];
+    coeffs[c] = channel_coeffs[1];
+    if (inter_coeffs[c] < -256 || inter_coeffs[c] > 256 ||
+        (c == 0 && inter_coeffs[c] != 0) ||
+        coeffs[c] < -256 || coeffs[c] > 256 ||
+        stream_ends[c] <= prev_end)
+      return 9;
+    prev_end = stream_ends[c];
+  }
+  if (prev_end != (uint64_t)(src_end - streams))
+    return 9;
+  LILCOM_STATS_ONLY(
+      if (current_stats)
+        current_stats->code_bytes = src_end - streams;)
+
+  /* reference_codes are the codes of channel 0, if we need them. */
+  std::vector<int32_t> channel_codes(n), reference_codes;
+  bool need_reference = false;
+  for (int64_t c = std::max<int64_t>(begin, 1); c < end; c++)
+    if (inter_coeffs[c] != 0)
+      need_reference = true;
+  int ret;
+  if (need_reference && begin > 0) {
+    reference_codes.resize(n);
+    ret = ReadChannel(streams, &(stream_ends[0]), &(inter_coeffs[0]),
+                      &(coeffs[0]), 0, flags, dims, NULL,
+                      &(reference_codes[0]));
+    if (ret != 0)
+      return ret;
+  }
+  ElementDecoder<T> decoder(pow(2.0, tick_power));
+  for (int64_t c = begin; c < end; c++) {
+    ret = ReadChannel(streams, &(stream_ends[0]), &(inter_coeffs[0]),
+                      &(coeffs[0]), c, flags, dims,
+                      (reference_codes.empty() ? NULL :
+                       &(reference_codes[0])),
+                      &(channel_codes[0]));
+    if (ret != 0)
+      return ret;
+    if (c == 0 && need_reference)
+      reference_codes = channel_codes;
+    if (StoreCodes(&(channel_codes[0]), &decoder, 1, dims + 1, strides + 1,
+                   array + (c - begin) * strides[0]) == NULL)
+      return 12;
+  }
+  return 0;
+}
+
+
+/*
+  Implementation of DecompressFloat() (for T = float) and
+  DecompressQuantized() (for integer T), which document the args.  If
+  `tick_power_out` is non-NULL it is set to the tick_power once the header
+  has been read.  `context` is as for DecompressFloatPayload().  For data
+  compressed in layers, `max_layer` is as for DecompressFloatLayers().
+ */
+template <class T>
+static int DecompressFloatAs(const char *src,
+                             int64_t num_bytes,
+                             T *array,
+                             int num_axes,
+                             const int64_t *dims,
+                             const int64_t *strides,
+                             int *tick_power_out,
+                             DecompressionContext *context,
+                             int max_layer) {
+  if (num_axes < 1 || num_axes > 16)
+    return 1;
+  if (num_bytes <= LILCOM_HEADER_LEN)
+    return 8;
+  const char *src_end = src + num_bytes;
+  int format_version, tick_power, flags, type, regression_coeffs[16];
+
+  if (src[1] == 2) {
+    int ret = ReadAndCheckHeader(src, num_bytes, num_axes, dims,
+                                 &format_version, NULL, &tick_power, &flags,
+                                 &type, regression_coeffs);
+    if (ret != 0)
+      return ret;
+    if (type != LILCOM_TYPE_FLOAT32)
+      return 10;
+    if (tick_power_out != NULL)
+      *tick_power_out = tick_power;
+    if (!CanDecodeAs(array, flags, num_axes, regression_coeffs))
+      return 11;
+    const char *payload = src + LilcomHeaderLen(num_axes);
+    if (flags & LILCOM_FLAG_LAYERED) {
+      ret = DecompressLayered(src, num_bytes, max_layer, tick_power, flags,
+                              regression_coeffs, array, num_axes, dims,
+                              strides);
+    } else if (flags & LILCOM_FLAG_CHANNELS) {
+      ret = DecompressChannels(src, num_bytes, tick_power, flags, dims, 0,
+                               dims[0], array, strides);
+    } else if (!(flags & (LILCOM_FLAG_CONSTANT_BLOCKS|LILCOM_FLAG_ADAPTIVE))) {
+      ret = DecompressFloatPayload(NULL, payload, src_end, context,
+                                   tick_power, flags, regression_coeffs,
+                                   array, num_axes, dims, strides);
+    } else {
+      if (payload >= src_end)
+        return 9;
+      ReverseIntStream meta(payload, src_end);
+      ret = DecompressFloatPayload(&meta, NULL, src_end, context,
+                                   tick_power, flags, regression_coeffs,
+                                   array, num_axes, dims, strides);
+    }
+    LILCOM_STATS_ONLY(
+        if (current_stats) {
+          current_stats->header_bytes = payload - src;
+          current_stats->meta_bytes = (src_end - payload) -
+              current_stats->code_bytes;
+        })
+    return ret;
+  }
+
+  /* Format versions 0 and 1, which we no longer write. */
+  ReverseIntStream ris(src + LILCOM_HEADER_LEN, src_end);
+  int ret = ReadAndCheckHeader(src, num_bytes, num_axes, dims,
+                               &format_version, &ris, &tick_power, &flags,
+                               &type, regression_coeffs);
+  if (ret != 0)
+    return ret;
+  if (type != LILCOM_TYPE_FLOAT32)
+    return 10;
+  if (tick_power_out != NULL)
+    *tick_power_out = tick_power;
+  if (!CanDecodeAs(array, flags, num_axes, regression_coeffs))
+    return 11;
+  if (format_version == 0)
+    return ReadCodes(&ris, src_end, tick_power, array, num_axes, dims,
+                     strides, regression_coeffs, flags, NULL);
+  return DecompressFloatPayload(&ris, NULL, src_end, context, tick_power,
+                                flags, regression_coeffs, array, num_axes,
+                                dims, strides);
+}
+
+
+int DecompressFloat(const char *src,
+		    int64_t num_bytes,
+		    float *array, 
+		    int num_axes, 
+		    const int64_t *dims, 
+		    const int64_t *strides,
+		    CodecStats *stats) {
+  LILCOM_STATS_ONLY(StatsScope stats_scope(stats);)
+  return DecompressFloatAs(src, num_bytes, array, num_axes, dims, strides,
+                           (int*)NULL, (DecompressionContext*)NULL, -1);
+}
+
+
+int DecompressFloat(DecompressionContext *context,
+                    const char *src,
+                    int64_t num_bytes,
+                    float *array,
+                    int num_axes,
+                    const int64_t *dims,
+                    const int64_t *strides,
+                    CodecStats *stats) {
+  LILCOM_STATS_ONLY(StatsScope stats_scope(stats);)
+  return DecompressFloatAs(src, num_bytes, array, num_axes, dims, strides,
+                           (int*)NULL, context, -1);
+}
+
+
+template <class T>
+int DecompressQuantized(const char *src,
+                        int64_t num_bytes,
+                        T *array,
+                        int num_axes,
+                        const int64_t *dims,
+                        const int64_t *strides,
+                        int *tick_power) {
+  return DecompressFloatAs(src, num_bytes, array, num_axes, dims, strides,
+                           tick_power, (DecompressionContext*)NULL, -1);
+}
+
+
+int DecompressFloatLayers(const char *src,
+                          int64_t num_bytes,
+                          int max_layer,
+                          float *data,
+                          int num_axes,
+                          const int64_t *dims,
+                          const int64_t *strides) {
+  return DecompressFloatAs(src, num_bytes, data, num_axes, dims, strides,
+                           (int*)NULL, (DecompressionContext*)NULL,
+                           max_layer);
+}
+
+
+int DecompressFloatChannel(const char *src,
+                           int64_t num_bytes,
+                           int64_t channel,
+                           float *data,
+                           int64_t stride) {
+  int num_axes, tick_power, flags, type, regression_coeffs[16];
+  int64_t dims[16];
+  if (num_bytes <= LILCOM_HEADER_LEN || src[1] != 2)
+    return 8;
+  int ret = ReadFixedHeader(src, num_bytes, &num_axes, &tick_power, &flags,
+                            &type, dims, regression_coeffs);
+  if (ret != 0)
+    return ret;
+  if (!(flags & LILCOM_FLAG_CHANNELS))
+    return 8;
+  if (channel < 0 || channel >= dims[0])
+    return 4;
+  int64_t strides[2] = { 0, stride };
+  return DecompressChannels(src, num_bytes, tick_power, flags, dims,
+                            channel, channel + 1, data, strides);
+}
+
+int64_t LayerPrefixBytes(const char *src,
+                         int64_t num_bytes,
+                         int max_layer) {
+  int num_axes, tick_power, flags, type, regression_coeffs[16], num_layers;
+  int64_t dims[16], base_bytes, plane_bytes;
+  if (ReadFixedHeader(src, num_bytes, &num_axes, &tick_power, &flags, &type,
+                      dims, regression_coeffs) != 0 ||
+      !(flags & LILCOM_FLAG_LAYERED) ||
+      ReadLayerSizes(src, num_bytes, num_axes, dims, &num_layers,
+                     &base_bytes, &plane_bytes) != 0)
+    return -1;
+  if (max_layer < 0 || max_layer > num_layers)
+    max_layer = num_layers;
+  return LilcomHeaderLen(num_axes) + sizeof(uint64_t) + base_bytes +
+      max_layer * plane_bytes;
+}
+
+
+/*
+  Decompresses the codes of a lossless integer array from the stream `rs`;
+  this is a helper for DecompressInt().  Returns 0 on success or an error
+  code as documented for DecompressFloat().
+ */
+template <class T, class ReverseIntStreamType>
+static int ReadIntCodes(ReverseIntStreamType *rs,
+                        const char *src_end,
+                        T *array,
+                        int num_axes,
+                        const int64_t *dims,
+                        const int64_t *strides,
+                        const int *regression_coeffs) {
+  int64_t indexes[16];
+  if (!DecompressLosslessInternal(rs, array, NumEffectiveAxes(num_axes, dims),
+                                  dims, strides, regression_coeffs, 0,
+                                  indexes))
+    return 6;
+  if (rs->NextCode() != src_end)
+    return 7;
+  return 0;
+}
+
+/*
+  Decompresses the codes of a lossless integer array.  `meta` is the
+  stream of meta-information that precedes the codes, from which we may
+  read more, or NULL if there is none, in which case the codes start at
+  `codes`.  `format_version` is the format version of the data.  The last
+  arg is only used to select the version for 32-bit IntType (this one) or
+  64-bit IntType; see AppendIntCodes().
+ */
+template <class T>
+static int DecompressIntCodes(ReverseIntStream *meta,
+                              int format_version,
+                              const char *codes,
+                              const char *src_end,
+                              int flags,
+                              T *array,
+                              int num_axes,
+                              const int64_t *dims,
+                              const int64_t *strides,
+                              const int *regression_coeffs,
+                              int32_t) {
+  if (meta != NULL)
+    codes = meta->NextCode();
+  if (codes >= src_end)
+    return 6;
+  if (flags & LILCOM_FLAG_ARITHMETIC_CODING) {
+    ReverseArithIntStream ras(codes, src_end);
+    return ReadIntCodes(&ras, src_end, array, num_axes, dims, strides,
+                        regression_coeffs);
+  } else {
+    ReverseIntStream codes_ris(codes, src_end);
+    return ReadIntCodes(&codes_ris, src_end, array, num_axes, dims, strides,
+                        regression_coeffs);
+  }
+}
+
+template <class T>
+static int DecompressIntCodes(ReverseIntStream *meta,
+                              int format_version,
+                              const char *codes,
+                              const char *src_end,
+                              int flags,
+                              T *array,
+                              int num_axes,
+                              const int64_t *dims,
+                              const int64_t *strides,
+                              const int *regression_coeffs,
+                              int64_t) {
+  /* Format version 1 wrote the size of the low stream as an int32_t. */
+  int64_t low_bytes;
+  int32_t low_bytes_32;
+  if (meta == NULL)
+    return 6;
+  if (format_version == 1) {
+    if (!meta->Read(&low_bytes_32))
+      return 6;
+    low_bytes = low_bytes_32;
+  } else if (!ReadInt64(meta, &low_bytes)) {
+    return 6;
+  }
+  if (low_bytes <= 0)
+    return 6;
+  codes = meta->NextCode();
+  if (codes >= src_end || low_bytes >= src_end - codes)
+    return 6;
+  if (flags & LILCOM_FLAG_ARITHMETIC_CODING) {
+    ReverseSplitIntStream<ReverseArithIntStream> rsis(
+        codes, codes + low_bytes, src_end);
+    return ReadIntCodes(&rsis, src_end, array, num_axes, dims, strides,
+                        regression_coeffs);
+  } else {
+    ReverseSplitIntStream<ReverseIntStream> rsis(
+        codes, codes + low_bytes, src_end);
+    return ReadIntCodes(&rsis, src_end, array, num_axes, dims, strides,
+                        regression_coeffs);
+  }
+}
+
+
+/*
+  Internal recursively called function that decompresses audio samples of
+  kSampleBits bits compressed by CompressIntAdaptive(), the inverse of
+  CompressIntAdaptiveInternal(); as the decompressed samples are exact in
+  type T, we predict from `data` itself.  Returns false if the data ended
+  early or a sample was out of range.
+ */
+template <int kSampleBits, class T>
+static bool DecompressIntAdaptiveInternal(ReverseTruncatedIntStream *rtis,
+                                          T *data,
+                                          int num_axes,
+                                          const int64_t *dims,
+                                          const int64_t *strides,
+                                          const int *regression_coeffs,
+                                          int axis,
+                                          int64_t *indexes) {
+  if (axis + 1 < num_axes) {
+    for (int64_t i = 0; i < dims[axis]; i++) {
+      indexes[axis] = i;
+      if (!DecompressIntAdaptiveInternal<kSampleBits>(
+              rtis, data, num_axes, dims, strides, regression_coeffs,
+              axis + 1, indexes))
+        return false;
+    }
+    return true;
+  }
+  int64_t local_strides[16];
+  int local_coeffs[16];
+  int local_prev_axes = 0;
+  T *cur_data = data;
+  for (int i = 0; i < axis; i++) {
+    cur_data += indexes[i] * strides[i];
+    if (regression_coeffs[i] != 0 && indexes[i] != 0) {
+      local_strides[local_prev_axes] = strides[i];
+      local_coeffs[local_prev_axes] = regression_coeffs[i];
+      local_prev_axes++;
+    }
+  }
+
+  int64_t dim = dims[axis],
+      stride = strides[axis];
+  int coeff = regression_coeffs[axis];
+
+  int64_t prev_prediction = 0;
+  T *end = cur_data + (dim * stride);
+  for (; cur_data != end; cur_data += stride) {
+    int64_t predicted = prev_prediction;
+    for (int i = 0; i < local_prev_axes; i++)
+      predicted += ScaleByCoeff(cur_data[-(local_strides[i])],
+                                local_coeffs[i]);
+    int32_t value;
+    if (!rtis->Read<kSampleBits>(ClipSample<kSampleBits>(predicted), &value))
+      return false;
+    *cur_data = (T)value;
+    prev_prediction = ScaleByCoeff(value, coeff);
+  }
+  return true;
+}
+
+/*
+  Decompresses the payload `payload` of audio samples compressed by
+  CompressIntAdaptive(); the other args are as for ReadIntCodes().
+ */
+template <class T>
+static int DecompressIntAdaptive(const char *payload,
+                                 const char *src_end,
+                                 T *array,
+                                 int num_axes,
+                                 const int64_t *dims,
+                                 const int64_t *strides,
+                                 const int *regression_coeffs) {
+  if (payload >= src_end)
+    return 6;
+  ReverseIntStream meta(payload, src_end);
+  TruncationConfig config;
+  int32_t sample_bits;
+  if (!config.Read(1, &meta) || !meta.Read(&sample_bits) ||
+      !ValidSampleBits<T>(sample_bits))
+    return 9;
+  const char *codes = meta.NextCode();
+  if (codes >= src_end)
+    return 6;
+  ReverseTruncatedIntStream rtis(config, codes, src_end);
+  int64_t indexes[16];
+  num_axes = NumEffectiveAxes(num_axes, dims);
+  bool ok;
+  switch (sample_bits) {
+    case 16:
+      ok = DecompressIntAdaptiveInternal<16>(&rtis, array, num_axes, dims,
+                                             strides, regression_coeffs, 0,
+                                             indexes);
+      break;
+    case 24:
+      ok = DecompressIntAdaptiveInternal<24>(&rtis, array, num_axes, dims,
+                                             strides, regression_coeffs, 0,
+                                             indexes);
+      break;
+    default:
+      ok = DecompressIntAdaptiveInternal<32>(&rtis, array, num_axes, dims,
+                                             strides, regression_coeffs, 0,
+                                             indexes);
   }
-  if (ris.NextCode() != src + num_bytes )
+  if (!ok)
+    return 6;
+  if (rtis.NextCode() != src_end)
     return 7;
-  return 0;  // Success
+  return 0;
+}
+
+
+template <class T>
+int DecompressInt(const char *src,
+                  int64_t num_bytes,
+                  T *array,
+                  int num_axes,
+                  const int64_t *dims,
+                  const int64_t *strides) {
+  if (num_axes < 1 || num_axes > 16)
+    return 1;
+  if (num_bytes <= LILCOM_HEADER_LEN)
+    return 8;
+  const char *src_end = src + num_bytes;
+  int format_version, tick_power, flags, type, regression_coeffs[16];
+  typename LosslessType<T>::IntType int_type = 0;
+
+  if (src[1] == 2) {
+    int ret = ReadAndCheckHeader(src, num_bytes, num_axes, dims,
+                                 &format_version, NULL, &tick_power, &flags,
+                                 &type, regression_coeffs);
+    if (ret != 0)
+      return ret;
+    if (type != LosslessType<T>::kType)
+      return 10;
+    const char *payload = src + LilcomHeaderLen(num_axes);
+    if (NumElements(num_axes, dims) == 0)
+      return (payload == src_end ? 0 : 7);
+    if (flags & LILCOM_FLAG_ADAPTIVE)
+      return DecompressIntAdaptive(payload, src_end, array, num_axes, dims,
+                                   strides, regression_coeffs);
+    if (sizeof(int_type) == 4)
+      return DecompressIntCodes(NULL, 2, payload, src_end, flags, array,
+                                num_axes, dims, strides, regression_coeffs,
+                                int_type);
+    if (payload >= src_end)
+      return 6;
+    ReverseIntStream meta(payload, src_end);
+    return DecompressIntCodes(&meta, 2, NULL, src_end, flags, array,
+                              num_axes, dims, strides, regression_coeffs,
+                              int_type);
+  }
+
+  /* Format version 1, which we no longer write. */
+  ReverseIntStream ris(src + LILCOM_HEADER_LEN, src_end);
+  int ret = ReadAndCheckHeader(src, num_bytes, num_axes, dims,
+                               &format_version, &ris, &tick_power, &flags,
+                               &type, regression_coeffs);
+  if (ret != 0)
+    return ret;
+  if (type != LosslessType<T>::kType)
+    return 10;
+  if (NumElements(num_axes, dims) == 0)
+    return (ris.NextCode() == src_end ? 0 : 7);
+  return DecompressIntCodes(&ris, 1, NULL, src_end, flags, array,
+                            num_axes, dims, strides, regression_coeffs,
+                            int_type);
 }
 
 
+/* Instantiate CompressInt() and DecompressInt() for the supported types. */
+#define LILCOM_INSTANTIATE_INT(T)                                         \
+  template std::vector<char> CompressInt<T>(const T*, int, const int64_t*,\
+                                            const int64_t*, const int*,   \
+                                            int);                         \
+  template int DecompressInt<T>(const char*, int64_t, T*, int,            \
+                                const int64_t*, const int64_t*);
+LILCOM_INSTANTIATE_INT(int8_t)
+LILCOM_INSTANTIATE_INT(uint8_t)
+LILCOM_INSTANTIATE_INT(int16_t)
+LILCOM_INSTANTIATE_INT(uint16_t)
+LILCOM_INSTANTIATE_INT(int32_t)
+LILCOM_INSTANTIATE_INT(uint32_t)
+LILCOM_INSTANTIATE_INT(int64_t)
+LILCOM_INSTANTIATE_INT(uint64_t)
+#undef LILCOM_INSTANTIATE_INT
 
+#define LILCOM_INSTANTIATE_INT_ADAPTIVE(T)                                \
+  template std::vector<char> CompressIntAdaptive<T>(const T*, int,        \
+                                                    const int64_t*,       \
+                                                    const int64_t*,       \
+                                                    const int*, int, int);
+LILCOM_INSTANTIATE_INT_ADAPTIVE(int16_t)
+LILCOM_INSTANTIATE_INT_ADAPTIVE(int32_t)
+#undef LILCOM_INSTANTIATE_INT_ADAPTIVE
 
+#define LILCOM_INSTANTIATE_QUANTIZED(T)                                   \
+  template int DecompressQuantized<T>(const char*, int64_t, T*, int,      \
+                                      const int64_t*, const int64_t*,     \
+                                      int*);
+LILCOM_INSTANTIATE_QUANTIZED(int8_t)
+LILCOM_INSTANTIATE_QUANTIZED(int16_t)
+LILCOM_INSTANTIATE_QUANTIZED(int32_t)
+#undef LILCOM_INSTANTIATE_QUANTIZED
@@ -3,15 +3,225 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <string.h>
 #include "int_stream.h"
+#include "codec_context.h"
 
 
 /**
    This header provides a C++ interface to lilom's audio-compression algorithm.
-   We'll further wrap this in plain "C" for ease of Python-wrapping.
+   lilcom_c.h wraps it in plain "C", for use from other languages.
 */
 
 
+/*
+  The compressed data begins with LILCOM_HEADER_LEN bytes: 'L', then the
+  format version.
+    Format version 0 (no longer written) has the meta-information (num_axes,
+       tick_power, and the dim and regression coefficient of each axis)
+       written to an IntStream, followed by the codes of the elements in the
+       same stream.
+    Format version 1 (no longer written) has the flags (see below) after
+       tick_power in the meta-information, and the meta-information stream is
+       flushed; the codes of the elements follow in a separate stream, whose
+       type is determined by the flags.
+    Format version 2 begins with a fixed-layout header, struct LilcomHeader
+       below, so that the shape can be found without decoding anything.  If
+       the flags require more meta-information (see LILCOM_FLAG_CONSTANT_BLOCKS,
+       LILCOM_FLAG_INTEGER and LILCOM_FLAG_ADAPTIVE) it is written to an IntStream that starts
+       the payload, as in format version 1; then come the codes.  (Data
+       with LILCOM_FLAG_LAYERED has a different payload; see there.)
+  LILCOM_FORMAT_VERSION is the latest format version, i.e. the latest we can
+  read, and the one we write.
+ */
+#define LILCOM_HEADER_LEN 2  // Must not be changed.
+#define LILCOM_FORMAT_VERSION 2
+
+/*
+  The start of data in format version 2.  All fields are little-endian (we
+  assume the machine is little-endian) and are at naturally aligned offsets.
+  It is followed by `num_axes` int64_t's containing the dims, then
+  `num_axes` int16_t's containing the regression coefficients, then zero
+  padding up to a multiple of 8 bytes; LilcomHeaderLen() gives the total
+  size.  Then come `payload_bytes` bytes of payload, which end the data
+  (but data with LILCOM_FLAG_LAYERED may be cut short; see there).
+ */
+struct LilcomHeader {
+  char magic;               /* 'L' */
+  int8_t format_version;    /* 2 */
+  uint8_t type;             /* One of the LILCOM_TYPE_ values below */
+  uint8_t num_axes;         /* In the range [1, 16] */
+  int8_t tick_power;        /* In the range [-20, 20]; 0 for integer data */
+  uint8_t num_layers;       /* With LILCOM_FLAG_LAYERED, the number of
+                               refinement layers, in [1, LILCOM_MAX_LAYERS];
+                               else 0 */
+  uint16_t flags;           /* The LILCOM_FLAG_ values below */
+  uint64_t payload_bytes;   /* The number of bytes after the header */
+};
+#define LILCOM_FIXED_HEADER_LEN 16  // sizeof(LilcomHeader)
+
+/* Returns the total size of the format-version-2 header, including the
+   dims, regression coefficients and padding. */
+inline int64_t LilcomHeaderLen(int num_axes) {
+  return LILCOM_FIXED_HEADER_LEN + 8 * num_axes + 8 * ((num_axes + 3) / 4);
+}
+
+/* Returns the dim of axis `axis` from the format-version-2 header at
+   `data`; requires the header to be valid. */
+inline int64_t LilcomHeaderDim(const char *data, int axis) {
+  int64_t dim;
+  memcpy(&dim, data + LILCOM_FIXED_HEADER_LEN + 8 * axis, sizeof(dim));
+  return dim;
+}
+
+/* Returns the regression coefficient of axis `axis` from the
+   format-version-2 header at `data`; requires the header to be valid. */
+inline int LilcomHeaderCoeff(const char *data, int num_axes, int axis) {
+  int16_t coeff;
+  memcpy(&coeff, data + LILCOM_FIXED_HEADER_LEN + 8 * num_axes + 2 * axis,
+         sizeof(coeff));
+  return coeff;
+}
+
+/*
+  Flags that can be passed to CompressFloat() (combined with bitwise or).
+     LILCOM_FLAG_ARITHMETIC_CODING   Code the elements with adaptive arithmetic
+                  coding (see arith_int_stream.h) instead of with IntStream.
+                  This is slower but gives smaller output.
+     LILCOM_FLAG_SPARSE   Use sparse mode, which is efficient for arrays that
+                  are mostly zero: no regression is done, and runs of zeros
+                  are coded by their lengths (see sparse_int_stream.h).
+                  CompressFloat() sets this automatically if at least 60% of
+                  the elements would be compressed to zero and the output
+                  would be no larger than without it.
+     LILCOM_FLAG_CONSTANT_BLOCKS   Set automatically by CompressFloat() (if
+                  LILCOM_FLAG_SPARSE is not set) when some blocks of the
+                  array are constant.  The last axis (ignoring trailing axes
+                  of dimension 1) is divided into blocks of
+                  LILCOM_CONSTANT_BLOCK_SIZE elements, numbered in order;
+                  a block is constant if all of its elements have the same
+                  code without regression.  The meta-information then ends
+                  with a table of the runs of consecutive constant blocks
+                  with the same code (the number of runs, then for each run
+                  the number of blocks since the previous run, the number
+                  of blocks minus one, and the difference between its code
+                  and that of the previous run), and those blocks are not
+                  coded in the stream of codes.  Arrays with 2^31 or more
+                  blocks do not use this.
+     LILCOM_FLAG_LOSSLESS   Compress losslessly, so that decompression gives
+                  exactly the same bits as the input (including NaNs, infinities
+                  and negative zero).  tick_power is ignored (but must be in
+                  range), and LILCOM_FLAG_SPARSE is ignored.  The floats are
+                  mapped to int32_t's with the same order, and we code the
+                  difference between each one and its prediction from the
+                  regression coefficients, computed with integer arithmetic.
+     LILCOM_FLAG_INTEGER   Set by CompressInt(), together with
+                  LILCOM_FLAG_LOSSLESS: the array is of integers, of the
+                  element type (one of the LILCOM_TYPE_ values below) in
+                  the header (in format version 1, it is written after the
+                  flags).  For 64-bit types each residual is split into its
+                  low 32 bits (as a signed integer) and the remaining,
+                  usually zero, high part; these are coded in two streams,
+                  the first of whose length in bytes is at the end of the
+                  meta-information (as two int32_t's, the low and high 32
+                  bits; in format version 1, as one int32_t).  Set
+                  instead together with LILCOM_FLAG_ADAPTIVE by
+                  CompressIntAdaptive(), for audio samples: see there.
+     LILCOM_FLAG_ADAPTIVE   Adaptive precision: some of the least significant
+                  bits of each code are dropped, so that about
+                  `significant_bits` significant bits are kept relative to
+                  the magnitude of the recent codes (see class Truncation in
+                  int_stream.h, which decides how many; it is updated every
+                  32 codes).  So quiet regions keep the accuracy given by
+                  tick_power, and the error in loud regions is roughly
+                  proportional to the magnitude of their residuals.  The
+                  configuration of class Truncation starts the
+                  meta-information (see TruncationConfig::Write()).  Not
+                  compatible with LILCOM_FLAG_LOSSLESS; LILCOM_FLAG_SPARSE
+                  is ignored.  With LILCOM_FLAG_INTEGER, it is not
+                  compatible with LILCOM_FLAG_ARITHMETIC_CODING either.
+     LILCOM_FLAG_LAYERED   Set by CompressFloatLayered(), and only
+                  compatible with LILCOM_FLAG_ARITHMETIC_CODING: the data
+                  can be decompressed progressively, at lower accuracy from
+                  a prefix of it.  Each element is quantized to q =
+                  round(x / tick) directly, without regression, and with
+                  L = num_layers (from the header), the payload is:
+                    uint64_t base_bytes    The size of the base layer
+                    The base layer         The coarse codes q >> L (i.e.
+                                           the quantization at tick * 2^L),
+                                           coded as by CompressInt() for
+                                           int32_t, with the regression
+                                           coefficients from the header
+                    L refinement layers    Each is a bit-plane of
+                                           ceil(n / 8) bytes (n = the number
+                                           of elements), with one bit per
+                                           element, in C order, packed as by
+                                           class BitStream.  Refinement
+                                           layer k (from 1) has bit L - k of
+                                           each q.
+                  Decoding up to refinement layer k (the base layer is layer
+                  0) needs only the data up to the end of that layer, and
+                  the error is at most tick * (2^(L - k - 1) + 1/2) (for
+                  k = L, tick / 2).
+     LILCOM_FLAG_CHANNELS   Set by CompressFloatChannels(), and only
+                  compatible with LILCOM_FLAG_ARITHMETIC_CODING: the array
+                  has 2 axes, (channels, samples), e.g. of multichannel
+                  audio, and each channel is coded in its own stream, so
+                  that one channel can be decompressed without the others
+                  (see DecompressFloatChannel()).  Each element is
+                  quantized to q = round(x / tick) directly, without
+                  regression.  Channel 0 is coded on its own; from each
+                  other channel c we subtract the prediction from channel 0
+                  at the same sample, ScaleByCoeff(q[0][t], k[c]) (see
+                  compression.cc; k[c] = 256 gives the side signal of
+                  mid/side stereo), and the result is coded as by
+                  CompressInt() for a 1-d array of int32_t with the
+                  regression coefficient a[c].  The regression coefficients
+                  in the header are 0, and the payload, if there are any
+                  elements, is:
+                    int16_t coeffs[C][2]   k[c] and a[c] for each channel c,
+                                           each in [-256, 256] (k[0] = 0),
+                                           then zero padding up to a
+                                           multiple of 8 bytes
+                    uint64_t ends[C]       The offset of the end of the
+                                           stream of each channel relative
+                                           to the start of that of channel 0
+                    The streams of the channels.
+ */
+#define LILCOM_FLAG_ARITHMETIC_CODING 1
+#define LILCOM_FLAG_SPARSE 2
+#define LILCOM_FLAG_CONSTANT_BLOCKS 4
+#define LILCOM_FLAG_LOSSLESS 8
+#define LILCOM_FLAG_INTEGER 16
+#define LILCOM_FLAG_ADAPTIVE 32
+#define LILCOM_FLAG_LAYERED 64
+#define LILCOM_FLAG_CHANNELS 128
+#define LILCOM_VALID_FLAGS (LILCOM_FLAG_ARITHMETIC_CODING|LILCOM_FLAG_SPARSE|\
+                            LILCOM_FLAG_CONSTANT_BLOCKS|LILCOM_FLAG_LOSSLESS|\
+                            LILCOM_FLAG_INTEGER|LILCOM_FLAG_ADAPTIVE|\
+                            LILCOM_FLAG_LAYERED|LILCOM_FLAG_CHANNELS)
+
+/* The maximum number of refinement layers with LILCOM_FLAG_LAYERED. */
+#define LILCOM_MAX_LAYERS 16
+
+/*
+  The element types of compressed arrays, as returned by
+  GetCompressedDataType().  LILCOM_TYPE_FLOAT32 is for data compressed by
+  CompressFloat(); the others are for data compressed by CompressInt().
+ */
+#define LILCOM_TYPE_FLOAT32 0
+#define LILCOM_TYPE_INT8 1
+#define LILCOM_TYPE_UINT8 2
+#define LILCOM_TYPE_INT16 3
+#define LILCOM_TYPE_UINT16 4
+#define LILCOM_TYPE_INT32 5
+#define LILCOM_TYPE_UINT32 6
+#define LILCOM_TYPE_INT64 7
+#define LILCOM_TYPE_UINT64 8
+
+#define LILCOM_CONSTANT_BLOCK_SIZE 64  // Part of the format; do not change.
+
+
 /*
   Implementation of lossy compression of a possibly multi-dimensional
   array of floats.
@@ -25,7 +235,7 @@
                    data is changed by being replaced by the compressed version;
 		   view it as being destructively consumed.  (This is necessary
 		   because of how the regression works; we regress on the
-    		   compressed versions).
+    		   compressed versions).  In lossless mode it is not changed.
     @param [in] num_axes  The number of axes in `data`; must be >0.
     @param [in] dims   The dimension of each axis i is given by dim[i].
     @param [in] strides  The stride on each axis i is given by strides[i];
@@ -47,22 +257,242 @@
                    regressed on the previously compressed version of the data.
 		   Out of range values (for i, j or k == 0) are treated
 		   as zero.
+    @param [in] flags  Flags that affect how the data is compressed, e.g.
+                   LILCOM_FLAG_ARITHMETIC_CODING; see their documentation
+                   above.  (LILCOM_FLAG_LAYERED and LILCOM_FLAG_CHANNELS
+                   are not allowed; use CompressFloatLayered() or
+                   CompressFloatChannels().)
+    @param [in] significant_bits  Only used if flags contains
+                   LILCOM_FLAG_ADAPTIVE, in which case it must be in the
+                   range [3, 31]: the approximate number of significant bits
+                   kept in each code, relative to the magnitude of the
+                   recent codes.
+    @param [out] stats  If non-NULL, it will be cleared and set to
+                   statistics about this call (only if compiled with
+                   LILCOM_STATS defined; see struct CodecStats).
 
-    @return  Returns a vector of bytes representing the compressed data.  Certain
+    @return  Returns a vector of bytes representing the compressed data,
+            starting with the 'L' and the format version.  Certain
             error conditions (generally: code errors in calling code)
             will cause it to return an empty vector.
  */
 std::vector<char> CompressFloat(int tick_power,
                                 float *data, 
                                 int num_axes, 
-                                const int *dims, 
-                                const int *strides,
-                                const int *regression_coeffs);
-			  
+                                const int64_t *dims, 
+                                const int64_t *strides,
+                                const int *regression_coeffs,
+                                int flags = 0,
+                                int significant_bits = 0,
+                                CodecStats *stats = NULL);
+
+/*
+  The same as CompressFloat() above, except that it uses the memory in
+  `context` (see codec_context.h), which is kept for the next call, so that
+  compressing many arrays does not keep allocating and freeing it.  The
+  compressed data is put in context->output, and a reference to it is
+  returned; it is empty on error.
+ */
+const std::vector<char> &CompressFloat(CompressionContext *context,
+                                       int tick_power,
+                                       float *data,
+                                       int num_axes,
+                                       const int64_t *dims,
+                                       const int64_t *strides,
+                                       const int *regression_coeffs,
+                                       int flags = 0,
+                                       int significant_bits = 0,
+                                       CodecStats *stats = NULL);
+
+
+/*
+  Compresses an array of floats in layers (see LILCOM_FLAG_LAYERED), so
+  that it can be decompressed at a coarser accuracy from a prefix of the
+  data (see LayerPrefixBytes() and DecompressFloatLayers()), e.g. for
+  previews.  Decompressed in full it has the same accuracy as
+  CompressFloat() gives.
+
+    @param [in] tick_power, num_axes, dims, strides  As for CompressFloat()
+    @param [in] data  The input data; it is not changed.
+    @param [in] regression_coeffs  As for CompressFloat() (they must be in
+                   [-256, 256]), but they are used to predict the codes of
+                   the base layer, with integer arithmetic.
+    @param [in] num_layers  The number of refinement layers, in
+                   [1, LILCOM_MAX_LAYERS]; the base layer has a tick of
+                   2^(tick_power + num_layers).
+    @param [in] flags  Only LILCOM_FLAG_ARITHMETIC_CODING (for the base
+                   layer) is allowed.
+    @return  Returns the compressed data, or an empty vector if the args
+            were invalid.
+ */
+std::vector<char> CompressFloatLayered(int tick_power,
+                                       const float *data,
+                                       int num_axes,
+                                       const int64_t *dims,
+                                       const int64_t *strides,
+                                       const int *regression_coeffs,
+                                       int num_layers,
+                                       int flags = 0);
+
+/*
+  Returns the number of bytes at the start of data compressed by
+  CompressFloatLayered() that DecompressFloatLayers() needs in order to
+  decompress it up to layer `max_layer` (0 for the base layer, or
+  negative for all the layers).  Only the header and the size of the base
+  layer are read, so `src` may be just the first LilcomHeaderLen(num_axes)
+  + 8 bytes of the data.  Returns -1 if those could not be read or the
+  data was not compressed in layers.
+ */
+int64_t LayerPrefixBytes(const char *src,
+                         int64_t num_bytes,
+                         int max_layer);
+
+/*
+  Compresses an array of floats of shape (channels, samples), e.g.
+  multichannel audio, with each channel in its own stream (see
+  LILCOM_FLAG_CHANNELS).  Instead of one regression coefficient per axis,
+  each channel gets its own coefficients: for predicting it from channel 0
+  (so correlated channels, e.g. the two of stereo audio, are coded as
+  something like mid/side), and from its previous sample; they are
+  estimated by least squares.  The accuracy is the same as CompressFloat()
+  gives.
+
+    @param [in] tick_power  As for CompressFloat()
+    @param [in] data  The input data; it is not changed.
+    @param [in] num_axes  Must be 2.
+    @param [in] strides  The strides of the axes, in floats; unlike for
+                   CompressFloat(), the last one need not be 1, so e.g.
+                   interleaved audio can be compressed where it is.
+    @param [in] dims  The number of channels and the number of samples.
+    @param [in] flags  Only LILCOM_FLAG_ARITHMETIC_CODING is allowed.
+    @return  Returns the compressed data, or an empty vector if the args
+            were invalid.  It can be decompressed by DecompressFloat() as a
+            whole, or one channel at a time by DecompressFloatChannel().
+ */
+std::vector<char> CompressFloatChannels(int tick_power,
+                                        const float *data,
+                                        int num_axes,
+                                        const int64_t *dims,
+                                        const int64_t *strides,
+                                        int flags = 0);
+
+/*
+  Returns the number of bytes that CompressFloat() would return if called
+  with these args, without actually packing any bits (and without modifying
+  `data`; the work is done on a copy).  The result is exact, not an
+  approximation.  Returns -1 if the args were invalid.
+ */
+int64_t EstimateCompressedSize(int tick_power,
+                               const float *data,
+                               int num_axes,
+                               const int64_t *dims,
+                               const int64_t *strides,
+                               const int *regression_coeffs,
+                               int flags = 0,
+                               int significant_bits = 0);
+
+/*
+  Chooses the tick_power to use so that the output of CompressFloat() will
+  fit within a size budget; this is done by searching over tick_power
+  with estimates of the size as from EstimateCompressedSize(), starting
+  from a guess based on the data, so that usually only a few are needed.
+  The size does not always decrease monotonically with tick_power, so the
+  two tick_powers below the one found are tried too; but this is a
+  heuristic, and a smaller tick_power that fits might be missed.
+
+     @param [in] max_bytes   The maximum number of bytes we want
+                   CompressFloat() to return
+     @param [in] data, num_axes, dims, strides, regression_coeffs, flags
+                   The same as the args to CompressFloat() (but `data` is
+                   not modified).
+     @param [in] significant_bits  The same as for CompressFloat().
+     @param [out] tick_power  On success, will be set to the smallest
+                   tick_power in [-20, 20] (i.e. the highest accuracy) that
+                   was found for which the compressed size is no greater
+                   than `max_bytes`; or 20 if none was found.
+     @return  Returns true on success, false if the args were invalid.
+ */
+bool ChooseTickPower(int64_t max_bytes,
+                     const float *data,
+                     int num_axes,
+                     const int64_t *dims,
+                     const int64_t *strides,
+                     const int *regression_coeffs,
+                     int flags,
+                     int *tick_power,
+                     int significant_bits = 0);
+
+
+/*
+  Lossless compression of a possibly multi-dimensional array of integers.
+  T may be int8_t, uint8_t, int16_t, uint16_t, int32_t, uint32_t, int64_t
+  or uint64_t.  The prediction is as for CompressFloat() with
+  LILCOM_FLAG_LOSSLESS (exact integer arithmetic, wrapping around on
+  overflow).
+
+    @param [in] data   Pointer to start of the input data; it is not changed.
+    @param [in] num_axes, dims, regression_coeffs  As for CompressFloat().
+    @param [in] strides  The stride on each axis i is given by strides[i];
+                   these are strides in elements, not bytes.
+    @param [in] flags  Flags that affect how the data is compressed; only
+                   LILCOM_FLAG_ARITHMETIC_CODING is allowed.
+
+    @return  Returns a vector of bytes representing the compressed data,
+            starting with the 'L' and the format version, or an empty
+            vector if the args were invalid.  Decompress it with
+            DecompressInt<T>() for the same T.
+ */
+template <class T>
+std::vector<char> CompressInt(const T *data,
+                              int num_axes,
+                              const int64_t *dims,
+                              const int64_t *strides,
+                              const int *regression_coeffs,
+                              int flags = 0);
+
+
+/*
+  Compresses audio samples of 16, 24 or 32 bits lossily, with adaptive
+  precision as with LILCOM_FLAG_ADAPTIVE: quiet regions are coded exactly,
+  and in loud ones about `significant_bits` bits are kept relative to the
+  magnitude of the residuals.  Each sample is predicted from the
+  decompressed previous ones as in CompressInt(), and the residuals are
+  coded by class TruncatedIntStream (see its WriteLimited()), which keeps
+  the decompressed samples within the range of `sample_bits` bits.
+
+  The header has LILCOM_FLAG_INTEGER|LILCOM_FLAG_ADAPTIVE and the type of T,
+  and the payload is an IntStream containing the configuration of class
+  Truncation (see TruncationConfig::Write()) and sample_bits, then the
+  codes.
+
+    @param [in] data  The samples; those out of the range of `sample_bits`
+                   bits are clipped to it.  It is not changed.
+    @param [in] num_axes, dims, strides, regression_coeffs  As for
+                   CompressInt(); e.g. for audio with channels on the
+                   last axis, regression_coeffs might be { 256, 0 }.
+    @param [in] sample_bits  The number of bits per sample: 16 for
+                   T = int16_t, or 24 or 32 for T = int32_t (24-bit
+                   samples are stored sign-extended in int32_t).
+    @param [in] significant_bits  As for CompressFloat() with
+                   LILCOM_FLAG_ADAPTIVE; must be in [3, 31].
+
+    @return  Returns the compressed data, or an empty vector if the args
+             were invalid.  Decompress it with DecompressInt<T>() for the
+             same T.
+ */
+template <class T>
+std::vector<char> CompressIntAdaptive(const T *data,
+                                      int num_axes,
+                                      const int64_t *dims,
+                                      const int64_t *strides,
+                                      const int *regression_coeffs,
+                                      int sample_bits,
+                                      int significant_bits);
+
 
 /*
   This function gets the shape of an array that has been compressed by
-  CompressFloat().
+  CompressFloat() or CompressInt().
      @param [in] data   Start of the compressed data
      @param [in] num_bytes  The number of bytes in the array `data`
      @param [out] meta   Pointer to an array where some meta-information
@@ -73,8 +503,16 @@ std::vector<char> CompressFloat(int tick_power,
                to be valid).
  */
 bool GetCompressedDataShape(const char *data,
-                            int num_bytes,
-                            int *meta);
+                            int64_t num_bytes,
+                            int64_t *meta);
+
+/*
+  Returns the element type of an array that has been compressed by
+  CompressFloat() or CompressInt(): one of the LILCOM_TYPE_ values, or -1
+  on error (e.g. data did not seem to be valid).
+ */
+int GetCompressedDataType(const char *data,
+                          int64_t num_bytes);
 
 /*
   Decompresses data that was compressed by CompressFloat().
@@ -90,16 +528,152 @@ bool GetCompressedDataShape(const char *data,
                           GetCompressedDataSize() on `src`.
       @param [in] strides Strides of each axis of `array`, in
                           floats (not bytes).
+      @param [out] stats  If non-NULL, it will be cleared and set to
+                          statistics about this call, as for
+                          CompressFloat().
       @return       Returns zero on success, otherwise various
-                    nonzero error codes (see code for meanings)
+                    nonzero error codes:
+                      1  num_axes out of range
+                      2  num_axes did not match the data
+                      3  tick_power could not be read or out of range
+                      4  dims could not be read or did not match the data
+                      5  regression coefficient out of range
+                      6  the data ended before decompression was finished
+                      7  there was data left over after decompression
+                      8  not lilcom data, or unknown format version or flags
+                      9  the meta-information after the header (e.g. the
+                         table of constant blocks) was invalid
+                      10 the data was not of the expected element type
  */
 int DecompressFloat(const char *src,
-		    int num_bytes,
+		    int64_t num_bytes,
 		    float *data, 
 		    int num_axes, 
-		    const int *dims, 
-		    const int *strides);
+		    const int64_t *dims, 
+		    const int64_t *strides,
+		    CodecStats *stats = NULL);
+
+/*
+  The same as DecompressFloat() above, except that it uses the memory in
+  `context` (see codec_context.h), which is kept for the next call.
+ */
+int DecompressFloat(DecompressionContext *context,
+                    const char *src,
+                    int64_t num_bytes,
+                    float *data,
+                    int num_axes,
+                    const int64_t *dims,
+                    const int64_t *strides,
+                    CodecStats *stats = NULL);
+
+/*
+  The same as DecompressFloat() above, except that if the data was
+  compressed by CompressFloatLayered() it is decompressed only up to layer
+  `max_layer` (0 for the base layer; all the layers if it is negative or
+  more than there are), and `num_bytes` may be less than the size of the
+  data, as long as it is at least LayerPrefixBytes(src, num_bytes,
+  max_layer).  Other data is decompressed in full.
+ */
+int DecompressFloatLayers(const char *src,
+                          int64_t num_bytes,
+                          int max_layer,
+                          float *data,
+                          int num_axes,
+                          const int64_t *dims,
+                          const int64_t *strides);
+
+/*
+  Decompresses one channel of data that was compressed by
+  CompressFloatChannels().  Only the stream of that channel is decoded,
+  and that of channel 0 if the channel is predicted from it, so the
+  channels can be decompressed concurrently by separate calls.
+      @param [in] src, num_bytes  The compressed data
+      @param [in] channel  The channel, in [0, dims[0])
+      @param [out] data  Start of the array of dims[1] samples to which we
+                         are writing
+      @param [in] stride  The stride of `data`, in floats
+      @return  Returns zero on success, otherwise an error code as for
+               DecompressFloat() (with 8 if the data was not compressed by
+               CompressFloatChannels(), and 4 if `channel` was out of
+               range).
+ */
+int DecompressFloatChannel(const char *src,
+                           int64_t num_bytes,
+                           int64_t channel,
+                           float *data,
+                           int64_t stride);
+
+/*
+  Decompresses data that was compressed by CompressInt<T>() or
+  CompressIntAdaptive<T>() for the same T.
+  The args and return value are as for DecompressFloat(), except that
+  `strides` are in elements of type T.
+ */
+template <class T>
+int DecompressInt(const char *src,
+                  int64_t num_bytes,
+                  T *data,
+                  int num_axes,
+                  const int64_t *dims,
+                  const int64_t *strides);
 
+/*
+  Decompresses data that was compressed by CompressFloat() directly to
+  integers: the quantized values in units of the tick (2^tick_power), i.e.
+  the values DecompressFloat() would give divided by the tick, but without
+  the multiplication by the tick and the rounding of float arithmetic.
+  This is useful when the values are going to be processed as integers
+  anyway, e.g. 16-bit audio.  T may be int8_t, int16_t or int32_t.
+
+  This is only possible if all the values are integer multiples of the
+  tick, which is so if the regression coefficients are all 0 or 256 (or
+  -256), since then so are the predictions, and LILCOM_FLAG_LOSSLESS was
+  not used; or if the data was compressed by CompressFloatLayered() or
+  CompressFloatChannels().  (DecompressFloat() gives the same values,
+  times the tick, as long as they are less than 2^24 in magnitude.)
+
+     @param [in] src, num_bytes, num_axes, dims  As for DecompressFloat()
+     @param [out] data  Start of the array to which we are writing
+     @param [in] strides  Strides of each axis of `data`, in elements
+     @param [out] tick_power  If non-NULL, will be set to the tick_power of
+                   the data once its header has been read (in particular
+                   if the return value is 0 or 11), so the caller can
+                   convert the values: value = data[i] * 2^tick_power.
+     @return  Returns zero on success, otherwise an error code as
+              documented for DecompressFloat(), or:
+                11  the values are not all integer multiples of the tick,
+                    because of the regression coefficients or
+                    LILCOM_FLAG_LOSSLESS; use DecompressFloat() instead.
+                12  a value was out of the range of T; the contents of
+                    `data` are undefined.
+ */
+template <class T>
+int DecompressQuantized(const char *src,
+                        int64_t num_bytes,
+                        T *data,
+                        int num_axes,
+                        const int64_t *dims,
+                        const int64_t *strides,
+                        int *tick_power);
+
+/*
+  Returns the name of the instruction set whose variant of this library is
+  being used: "default", "avx2" or "avx512" (see compression_variant.h).
+  By default the best one that the CPU supports is used; this can be
+  overridden by setting the environment variable LILCOM_ISA to one of those
+  names, or by calling LilcomSetIsa().
+ */
+const char *LilcomIsa();
+
+/*
+  Selects the variant of this library to use, by the name of its
+  instruction set as returned by LilcomIsa().  Returns true on success,
+  false if the name was not recognized or the CPU (or this build) does not
+  support that instruction set.  This is mainly for testing and
+  benchmarking; it must not be called while another thread is compressing
+  or decompressing.  All the variants give exactly the same results.
+ */
+bool LilcomSetIsa(const char *name);
 
 
 
@@ -0,0 +1,21 @@
+/*
+  compression.cc compiled for x86-64 CPUs with AVX2, BMI2 and LZCNT
+  (e.g. Intel Haswell or AMD Zen and later); see compression_variant.h.
+ */
+#include "compression_variant.h"
+
+#ifdef LILCOM_X86_VARIANTS
+#ifdef __clang__
+#pragma clang attribute push (__attribute__((target("avx2,bmi,bmi2,lzcnt,popcnt"))), apply_to = function)
+#else
+#pragma GCC target("avx2,bmi,bmi2,lzcnt,popcnt")
+#endif
+
+namespace lilcom_avx2 {
+#include "compression.cc"
+}
+
+#ifdef __clang__
+#pragma clang attribute pop
+#endif
+#endif
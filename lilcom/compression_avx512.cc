@@ -0,0 +1,22 @@
+/*
+  compression.cc compiled for x86-64 CPUs with AVX-512 (F, BW, DQ and VL)
+  as well as the extensions used by compression_avx2.cc (e.g. Intel
+  Skylake-X or AMD Zen 4 and later); see compression_variant.h.
+ */
+#include "compression_variant.h"
+
+#ifdef LILCOM_X86_VARIANTS
+#ifdef __clang__
+#pragma clang attribute push (__attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,bmi,bmi2,lzcnt,popcnt"))), apply_to = function)
+#else
+#pragma GCC target("avx512f,avx512bw,avx512dq,avx512vl,avx2,bmi,bmi2,lzcnt,popcnt")
+#endif
+
+namespace lilcom_avx512 {
+#include "compression.cc"
+}
+
+#ifdef __clang__
+#pragma clang attribute pop
+#endif
+#endif
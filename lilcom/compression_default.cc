@@ -0,0 +1,9 @@
+/*
+  compression.cc compiled for the baseline instruction set of the target
+  architecture; see compression_variant.h.
+ */
+#include "compression_variant.h"
+
+namespace lilcom_default {
+#include "compression.cc"
+}
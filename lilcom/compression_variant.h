@@ -0,0 +1,58 @@
+#ifndef __LILCOM__COMPRESSION_VARIANT_H_
+#define __LILCOM__COMPRESSION_VARIANT_H_ 1
+
+/**
+   The library is built from several variants of compression.cc, each
+   compiled for a different instruction set and in its own namespace:
+      compression_default.cc   namespace lilcom_default: the baseline of
+                               the target architecture (e.g. x86-64 or
+                               aarch64, which always has NEON)
+      compression_avx2.cc      namespace lilcom_avx2: x86-64 with AVX2,
+                               BMI2 and LZCNT
+      compression_avx512.cc    namespace lilcom_avx512: x86-64 with
+                               AVX-512 (F, BW, DQ, VL) as well
+   cpu_dispatch.cc defines the functions declared in compression.h; each
+   calls the variant for the best instruction set that the CPU supports,
+   which is chosen the first time any of them is called (see
+   LilcomSetIsa() in compression.h).
+
+   This header is included by each variant before it opens its namespace.
+   It includes all the system headers that compression.cc and the headers
+   it uses need, so that they are not included inside the namespace, and
+   so that the templates in them are compiled for the baseline (their
+   instances are shared between the variants).  It includes codec_stats.h
+   and codec_context.h for the same reason, so that all the variants use the
+   same struct CodecStats, CompressionContext and DecompressionContext.
+
+   The variants must produce exactly the same output, so the library must be
+   compiled with -ffp-contract=off: otherwise the compiler may use fused
+   multiply-adds in the variants that have them, which would change the
+   rounding of the predictions.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <vector>
+#include "codec_stats.h"
+#include "codec_context.h"
+
+/* LILCOM_X86_VARIANTS is defined if we build the AVX2 and AVX-512
+   variants. */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define LILCOM_X86_VARIANTS 1
+#endif
+
+#endif /* __LILCOM__COMPRESSION_VARIANT_H_ */
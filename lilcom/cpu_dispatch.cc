@@ -0,0 +1,402 @@
+/*
+  Defines the functions declared in compression.h, each of which calls the
+  variant of it (see compression_variant.h) for the instruction set
+  selected by CurrentIsa().
+ */
+#include "compression_variant.h"
+#include "compression.h"
+#include <stdlib.h>
+#include <atomic>
+
+
+/*
+  Declares the functions of compression.h that are defined in the variant
+  in namespace `ns`.  (We can't include compression.h inside the namespace
+  as the variants do, because it has already been included above.)
+ */
+#define LILCOM_DECLARE_VARIANT(ns)                                      \
+  namespace ns {                                                        \
+  std::vector<char> CompressFloat(int, float*, int, const int64_t*,     \
+                                  const int64_t*, const int*, int, int, \
+                                  CodecStats*);                         \
+  const std::vector<char> &CompressFloat(CompressionContext*, int,      \
+                                         float*, int, const int64_t*,   \
+                                         const int64_t*, const int*,    \
+                                         int, int, CodecStats*);        \
+  int64_t EstimateCompressedSize(int, const float*, int, const int64_t*,\
+                                 const int64_t*, const int*, int, int); \
+  bool ChooseTickPower(int64_t, const float*, int, const int64_t*,      \
+                       const int64_t*, const int*, int, int*, int);     \
+  template <class T>                                                    \
+  std::vector<char> CompressInt(const T*, int, const int64_t*,          \
+                                const int64_t*, const int*, int);       \
+  template <class T>                                                    \
+  std::vector<char> CompressIntAdaptive(const T*, int, const int64_t*,  \
+                                        const int64_t*, const int*, int,\
+                                        int);                           \
+  std::vector<char> CompressFloatLayered(int, const float*, int,        \
+                                         const int64_t*, const int64_t*,\
+                                         const int*, int, int);         \
+  int64_t LayerPrefixBytes(const char*, int64_t, int);                  \
+  std::vector<char> CompressFloatChannels(int, const float*, int,       \
+                                          const int64_t*,               \
+                                          const int64_t*, int);         \
+  int DecompressFloatChannel(const char*, int64_t, int64_t, float*,     \
+                             int64_t);                                  \
+  bool GetCompressedDataShape(const char*, int64_t, int64_t*);          \
+  int GetCompressedDataType(const char*, int64_t);                      \
+  int DecompressFloat(const char*, int64_t, float*, int, const int64_t*,\
+                      const int64_t*, CodecStats*);                     \
+  int DecompressFloat(DecompressionContext*, const char*, int64_t,      \
+                      float*, int, const int64_t*, const int64_t*,      \
+                      CodecStats*);                                     \
+  int DecompressFloatLayers(const char*, int64_t, int, float*, int,     \
+                            const int64_t*, const int64_t*);            \
+  template <class T>                                                    \
+  int DecompressInt(const char*, int64_t, T*, int, const int64_t*,      \
+                    const int64_t*);                                    \
+  template <class T>                                                    \
+  int DecompressQuantized(const char*, int64_t, T*, int, const int64_t*,\
+                          const int64_t*, int*);                        \
+  }
+
+LILCOM_DECLARE_VARIANT(lilcom_default)
+#ifdef LILCOM_X86_VARIANTS
+LILCOM_DECLARE_VARIANT(lilcom_avx2)
+LILCOM_DECLARE_VARIANT(lilcom_avx512)
+#endif
+#undef LILCOM_DECLARE_VARIANT
+
+
+/* The instruction sets, in increasing order of preference; they index
+   isa_names. */
+#define LILCOM_ISA_DEFAULT 0
+#define LILCOM_ISA_AVX2 1
+#define LILCOM_ISA_AVX512 2
+#define LILCOM_NUM_ISAS 3
+
+static const char *isa_names[LILCOM_NUM_ISAS] = { "default", "avx2", "avx512" };
+
+
+/* Returns true if this build and the CPU support instruction set `isa`. */
+static bool IsaSupported(int isa) {
+  switch (isa) {
+    case LILCOM_ISA_DEFAULT:
+      return true;
+#ifdef LILCOM_X86_VARIANTS
+    case LILCOM_ISA_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") &&
+          __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("lzcnt") &&
+          __builtin_cpu_supports("popcnt");
+    case LILCOM_ISA_AVX512:
+      return IsaSupported(LILCOM_ISA_AVX2) &&
+          __builtin_cpu_supports("avx512f") &&
+          __builtin_cpu_supports("avx512bw") &&
+          __builtin_cpu_supports("avx512dq") &&
+          __builtin_cpu_supports("avx512vl");
+#endif
+    default:
+      return false;
+  }
+}
+
+/* Returns the index into isa_names of `name`, or -1 if there is none. */
+static int IsaIndex(const char *name) {
+  for (int isa = 0; isa < LILCOM_NUM_ISAS; isa++)
+    if (strcmp(name, isa_names[isa]) == 0)
+      return isa;
+  return -1;
+}
+
+/*
+  Returns the instruction set to use at first: the one named by the
+  environment variable LILCOM_ISA if it is set (with a warning if it can't
+  be used), else the best one supported.
+ */
+static int InitialIsa() {
+  const char *name = getenv("LILCOM_ISA");
+  if (name != NULL && *name != '\0') {
+    int isa = IsaIndex(name);
+    if (isa >= 0 && IsaSupported(isa))
+      return isa;
+    std::cerr << "lilcom: warning: ignoring LILCOM_ISA=" << name
+              << " (not a supported instruction set)\n";
+  }
+  int isa = LILCOM_NUM_ISAS - 1;
+  while (!IsaSupported(isa))
+    isa--;
+  return isa;
+}
+
+/*
+  The selected instruction set; it is chosen the first time it is needed.
+  It is atomic because LilcomSetIsa() may change it while other threads
+  (e.g. Python threads that have released the GIL) are dispatching; relaxed
+  ordering is enough, as each call only needs to see some valid value.
+ */
+static std::atomic<int> &SelectedIsa() {
+  static std::atomic<int> isa(InitialIsa());
+  return isa;
+}
+
+/* Returns the selected instruction set. */
+static inline int CurrentIsa() {
+  return SelectedIsa().load(std::memory_order_relaxed);
+}
+
+
+const char *LilcomIsa() {
+  return isa_names[CurrentIsa()];
+}
+
+bool LilcomSetIsa(const char *name) {
+  int isa = IsaIndex(name);
+  if (isa < 0 || !IsaSupported(isa))
+    return false;
+  SelectedIsa().store(isa, std::memory_order_relaxed);
+  return true;
+}
+
+
+/*
+  LILCOM_DISPATCH(f(args)) returns the value of f(args) for the variant of
+  f in the namespace of the selected instruction set.
+ */
+#ifdef LILCOM_X86_VARIANTS
+#define LILCOM_DISPATCH(...)                                    \
+  switch (CurrentIsa()) {                                       \
+    case LILCOM_ISA_AVX512: return lilcom_avx512::__VA_ARGS__;  \
+    case LILCOM_ISA_AVX2: return lilcom_avx2::__VA_ARGS__;      \
+    default: return lilcom_default::__VA_ARGS__;                \
+  }
+#else
+#define LILCOM_DISPATCH(...) return lilcom_default::__VA_ARGS__;
+#endif
+
+
+std::vector<char> CompressFloat(int tick_power,
+                                float *data,
+                                int num_axes,
+                                const int64_t *dims,
+                                const int64_t *strides,
+                                const int *regression_coeffs,
+                                int flags,
+                                int significant_bits,
+                                CodecStats *stats) {
+  LILCOM_DISPATCH(CompressFloat(tick_power, data, num_axes, dims, strides,
+                                regression_coeffs, flags, significant_bits,
+                                stats));
+}
+
+const std::vector<char> &CompressFloat(CompressionContext *context,
+                                       int tick_power,
+                                       float *data,
+                                       int num_axes,
+                                       const int64_t *dims,
+                                       const int64_t *strides,
+                                       const int *regression_coeffs,
+                                       int flags,
+                                       int significant_bits,
+                                       CodecStats *stats) {
+  LILCOM_DISPATCH(CompressFloat(context, tick_power, data, num_axes, dims,
+                                strides, regression_coeffs, flags,
+                                significant_bits, stats));
+}
+
+int64_t EstimateCompressedSize(int tick_power,
+                               const float *data,
+                               int num_axes,
+                               const int64_t *dims,
+                               const int64_t *strides,
+                               const int *regression_coeffs,
+                               int flags,
+                               int significant_bits) {
+  LILCOM_DISPATCH(EstimateCompressedSize(tick_power, data, num_axes, dims,
+                                         strides, regression_coeffs, flags,
+                                         significant_bits));
+}
+
+bool ChooseTickPower(int64_t max_bytes,
+                     const float *data,
+                     int num_axes,
+                     const int64_t *dims,
+                     const int64_t *strides,
+                     const int *regression_coeffs,
+                     int flags,
+                     int *tick_power,
+                     int significant_bits) {
+  LILCOM_DISPATCH(ChooseTickPower(max_bytes, data, num_axes, dims, strides,
+                                  regression_coeffs, flags, tick_power,
+                                  significant_bits));
+}
+
+template <class T>
+std::vector<char> CompressInt(const T *data,
+                              int num_axes,
+                              const int64_t *dims,
+                              const int64_t *strides,
+                              const int *regression_coeffs,
+                              int flags) {
+  LILCOM_DISPATCH(CompressInt<T>(data, num_axes, dims, strides,
+                                 regression_coeffs, flags));
+}
+
+template <class T>
+std::vector<char> CompressIntAdaptive(const T *data,
+                                      int num_axes,
+                                      const int64_t *dims,
+                                      const int64_t *strides,
+                                      const int *regression_coeffs,
+                                      int sample_bits,
+                                      int significant_bits) {
+  LILCOM_DISPATCH(CompressIntAdaptive<T>(data, num_axes, dims, strides,
+                                         regression_coeffs, sample_bits,
+                                         significant_bits));
+}
+
+std::vector<char> CompressFloatLayered(int tick_power,
+                                       const float *data,
+                                       int num_axes,
+                                       const int64_t *dims,
+                                       const int64_t *strides,
+                                       const int *regression_coeffs,
+                                       int num_layers,
+                                       int flags) {
+  LILCOM_DISPATCH(CompressFloatLayered(tick_power, data, num_axes, dims,
+                                       strides, regression_coeffs,
+                                       num_layers, flags));
+}
+
+std::vector<char> CompressFloatChannels(int tick_power,
+                                        const float *data,
+                                        int num_axes,
+                                        const int64_t *dims,
+                                        const int64_t *strides,
+                                        int flags) {
+  LILCOM_DISPATCH(CompressFloatChannels(tick_power, data, num_axes, dims,
+                                        strides, flags));
+}
+
+/* These only read the header, so there is nothing to gain from the other
+   variants. */
+int64_t LayerPrefixBytes(const char *src,
+                         int64_t num_bytes,
+                         int max_layer) {
+  return lilcom_default::LayerPrefixBytes(src, num_bytes, max_layer);
+}
+
+bool GetCompressedDataShape(const char *data,
+                            int64_t num_bytes,
+                            int64_t *meta) {
+  return lilcom_default::GetCompressedDataShape(data, num_bytes, meta);
+}
+
+int GetCompressedDataType(const char *data,
+                          int64_t num_bytes) {
+  return lilcom_default::GetCompressedDataType(data, num_bytes);
+}
+
+int DecompressFloat(const char *src,
+                    int64_t num_bytes,
+                    float *data,
+                    int num_axes,
+                    const int64_t *dims,
+                    const int64_t *strides,
+                    CodecStats *stats) {
+  LILCOM_DISPATCH(DecompressFloat(src, num_bytes, data, num_axes, dims,
+                                  strides, stats));
+}
+
+int DecompressFloat(DecompressionContext *context,
+                    const char *src,
+                    int64_t num_bytes,
+                    float *data,
+                    int num_axes,
+                    const int64_t *dims,
+                    const int64_t *strides,
+                    CodecStats *stats) {
+  LILCOM_DISPATCH(DecompressFloat(context, src, num_bytes, data, num_axes,
+                                  dims, strides, stats));
+}
+
+int DecompressFloatLayers(const char *src,
+                          int64_t num_bytes,
+                          int max_layer,
+                          float *data,
+                          int num_axes,
+                          const int64_t *dims,
+                          const int64_t *strides) {
+  LILCOM_DISPATCH(DecompressFloatLayers(src, num_bytes, max_layer, data,
+                                        num_axes, dims, strides));
+}
+
+int DecompressFloatChannel(const char *src,
+                           int64_t num_bytes,
+                           int64_t channel,
+                           float *data,
+                           int64_t stride) {
+  LILCOM_DISPATCH(DecompressFloatChannel(src, num_bytes, channel, data,
+                                         stride));
+}
+
+template <class T>
+int DecompressInt(const char *src,
+                  int64_t num_bytes,
+                  T *data,
+                  int num_axes,
+                  const int64_t *dims,
+                  const int64_t *strides) {
+  LILCOM_DISPATCH(DecompressInt<T>(src, num_bytes, data, num_axes, dims,
+                                   strides));
+}
+
+template <class T>
+int DecompressQuantized(const char *src,
+                        int64_t num_bytes,
+                        T *data,
+                        int num_axes,
+                        const int64_t *dims,
+                        const int64_t *strides,
+                        int *tick_power) {
+  LILCOM_DISPATCH(DecompressQuantized<T>(src, num_bytes, data, num_axes,
+                                         dims, strides, tick_power));
+}
+
+#undef LILCOM_DISPATCH
+
+
+/* Instantiate CompressInt() and DecompressInt() for the supported types. */
+#define LILCOM_INSTANTIATE_INT(T)                                         \
+  template std::vector<char> CompressInt<T>(const T*, int, const int64_t*,\
+                                            const int64_t*, const int*,   \
+                                            int);                         \
+  template int DecompressInt<T>(const char*, int64_t, T*, int,            \
+                                const int64_t*, const int64_t*);
+LILCOM_INSTANTIATE_INT(int8_t)
+LILCOM_INSTANTIATE_INT(uint8_t)
+LILCOM_INSTANTIATE_INT(int16_t)
+LILCOM_INSTANTIATE_INT(uint16_t)
+LILCOM_INSTANTIATE_INT(int32_t)
+LILCOM_INSTANTIATE_INT(uint32_t)
+LILCOM_INSTANTIATE_INT(int64_t)
+LILCOM_INSTANTIATE_INT(uint64_t)
+#undef LILCOM_INSTANTIATE_INT
+
+#define LILCOM_INSTANTIATE_INT_ADAPTIVE(T)                                \
+  template std::vector<char> CompressIntAdaptive<T>(const T*, int,        \
+                                                    const int64_t*,       \
+                                                    const int64_t*,       \
+                                                    const int*, int, int);
+LILCOM_INSTANTIATE_INT_ADAPTIVE(int16_t)
+LILCOM_INSTANTIATE_INT_ADAPTIVE(int32_t)
+#undef LILCOM_INSTANTIATE_INT_ADAPTIVE
+
+#define LILCOM_INSTANTIATE_QUANTIZED(T)                                   \
+  template int DecompressQuantized<T>(const char*, int64_t, T*, int,      \
+                                      const int64_t*, const int64_t*,     \
+                                      int*);
+LILCOM_INSTANTIATE_QUANTIZED(int8_t)
+LILCOM_INSTANTIATE_QUANTIZED(int16_t)
+LILCOM_INSTANTIATE_QUANTIZED(int32_t)
+#undef LILCOM_INSTANTIATE_QUANTIZED
@@ -0,0 +1,370 @@
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <vector>
+#include "compression.h"
+
+/*
+  Checks that all the variants of the library that this CPU supports (see
+  compression_variant.h) give exactly the same compressed data, and decode
+  each other's output to the same values.
+ */
+
+static const char *all_isas[] = { "default", "avx2", "avx512" };
+
+
+/* Returns a smooth signal plus noise, with some runs of zeros. */
+std::vector<float> test_signal(int64_t n) {
+  std::vector<float> ans(n);
+  for (int64_t i = 0; i < n; i++) {
+    float noise = (rand() % 2001 - 1000) * 1.0e-4;
+    ans[i] = ((i / 700) % 5 == 3 ? 0.0 :
+              sin(i * 0.01) * (1.0 + 0.5 * sin(i * 0.0003)) + noise);
+  }
+  return ans;
+}
+
+/* Compresses `signal` as a 2-d array with the selected variant. */
+std::vector<char> compress_with(const std::vector<float> &signal,
+                                int flags, int significant_bits) {
+  std::vector<float> copy(signal);  // CompressFloat() changes its input.
+  int64_t dims[2] = { (int64_t)signal.size() / 40, 40 },
+      strides[2] = { 40, 1 };
+  int regression_coeffs[2] = { 0, 0 };
+  return CompressFloat(-8, &copy[0], 2, dims, strides, regression_coeffs,
+                       flags, significant_bits);
+}
+
+void cpu_dispatch_test_float() {
+  std::vector<float> signal = test_signal(40 * 1000);
+  int64_t dims[2] = { 1000, 40 }, strides[2] = { 40, 1 };
+  int all_flags[] = { 0, LILCOM_FLAG_ARITHMETIC_CODING,
+                      LILCOM_FLAG_SPARSE | LILCOM_FLAG_CONSTANT_BLOCKS,
+                      LILCOM_FLAG_LOSSLESS, LILCOM_FLAG_ADAPTIVE };
+  for (size_t f = 0; f < sizeof(all_flags) / sizeof(int); f++) {
+    int flags = all_flags[f],
+        significant_bits = (flags & LILCOM_FLAG_ADAPTIVE ? 8 : 0);
+    bool ans = LilcomSetIsa("default");
+    assert(ans);
+    std::vector<char> ref = compress_with(signal, flags, significant_bits);
+    assert(!ref.empty());
+    std::vector<float> ref_decoded(signal.size());
+    ans = (DecompressFloat(&ref[0], ref.size(), &ref_decoded[0], 2,
+                           dims, strides) == 0);
+    assert(ans);
+
+    for (int i = 1; i < 3; i++) {
+      if (!LilcomSetIsa(all_isas[i])) {
+        std::cout << "Skipping " << all_isas[i]
+                  << ", which this CPU does not support\n";
+        continue;
+      }
+      std::vector<char> code = compress_with(signal, flags, significant_bits);
+      if (code != ref) {
+        std::cout << "Failure, output of " << all_isas[i] << " differs from "
+                  << "default for flags = " << flags << "\n";
+        exit(1);
+      }
+      std::vector<float> decoded(signal.size());
+      ans = (DecompressFloat(&ref[0], ref.size(), &decoded[0], 2,
+                             dims, strides) == 0);
+      assert(ans);
+      if (decoded != ref_decoded) {
+        std::cout << "Failure, " << all_isas[i] << " decodes differently "
+                  << "from default for flags = " << flags << "\n";
+        exit(1);
+      }
+    }
+  }
+}
+
+void cpu_dispatch_test_int() {
+  std::vector<int16_t> signal(5000);
+  for (size_t i = 0; i < signal.size(); i++)
+    signal[i] = (int16_t)(10000 * sin(i * 0.02)) + rand() % 30;
+  int64_t dims[1] = { (int64_t)signal.size() }, strides[1] = { 1 };
+  int regression_coeffs[1] = { 0 };
+  bool ans = LilcomSetIsa("default");
+  assert(ans);
+  std::vector<char> ref = CompressInt(&signal[0], 1, dims, strides,
+                                      regression_coeffs);
+  for (int i = 1; i < 3; i++) {
+    if (!LilcomSetIsa(all_isas[i]))
+      continue;
+    std::vector<char> code = CompressInt(&signal[0], 1, dims, strides,
+                                         regression_coeffs);
+    std::vector<int16_t> decoded(signal.size());
+    ans = (DecompressInt(&ref[0], ref.size(), &decoded[0], 1,
+                         dims, strides) == 0);
+    assert(ans);
+    if (code != ref || decoded != signal) {
+      std::cout << "Failure, integer compression with " << all_isas[i]
+                << " differs from default\n";
+      exit(1);
+    }
+  }
+}
+
+/* Compresses stereo audio of `sample_bits` bits with CompressIntAdaptive():
+   a quiet part, which must be decoded exactly, and a loud part with
+   samples at the extremes of the range.  The variants must agree. */
+void cpu_dispatch_test_int_adaptive(int sample_bits) {
+  const int64_t max_value = ((int64_t)1 << (sample_bits - 1)) - 1;
+  int64_t num_frames = 4000;
+  std::vector<int32_t> signal(num_frames * 2);
+  for (int64_t i = 0; i < num_frames; i++) {
+    for (int c = 0; c < 2; c++) {
+      int64_t value = (i < 1000 ? (int64_t)(100 * sin(i * 0.05 + c)) :
+                       (int64_t)(1.1 * max_value * sin(i * 0.01 + c)) +
+                       (rand() % 1001 - 500) * (max_value >> 12));
+      signal[i * 2 + c] = (int32_t)std::max(-max_value - 1,
+                                            std::min(value, max_value));
+    }
+  }
+  int64_t dims[2] = { num_frames, 2 }, strides[2] = { 2, 1 };
+  int regression_coeffs[2] = { 256, 0 };
+  bool ans = LilcomSetIsa("default");
+  assert(ans);
+  std::vector<char> ref = CompressIntAdaptive(&signal[0], 2, dims, strides,
+                                              regression_coeffs, sample_bits,
+                                              8);
+  assert(!ref.empty() && GetCompressedDataType(&ref[0], ref.size()) ==
+         LILCOM_TYPE_INT32);
+  std::cout << "Size of " << num_frames << " frames of " << sample_bits
+            << "-bit stereo audio is " << ref.size() << " bytes\n";
+  for (int i = 0; i < 3; i++) {
+    if (!LilcomSetIsa(all_isas[i]))
+      continue;
+    std::vector<char> code = CompressIntAdaptive(&signal[0], 2, dims, strides,
+                                                 regression_coeffs,
+                                                 sample_bits, 8);
+    std::vector<int32_t> decoded(signal.size());
+    ans = (DecompressInt(&ref[0], ref.size(), &decoded[0], 2,
+                         dims, strides) == 0);
+    assert(ans && code == ref);
+    for (size_t j = 0; j < signal.size(); j++) {
+      assert(decoded[j] >= -max_value - 1 && decoded[j] <= max_value);
+      assert(j >= 2000 ? fabs((double)decoded[j] - signal[j]) <
+             max_value / 16.0 : decoded[j] == signal[j]);
+    }
+  }
+  /* Invalid sample_bits for the type. */
+  assert(CompressIntAdaptive(&signal[0], 2, dims, strides, regression_coeffs,
+                             16, 8).empty());
+  LilcomSetIsa("default");
+}
+
+/* Reusing one context for all the calls, with every variant, gives the same
+   output as CompressFloat() and DecompressFloat() without one. */
+void cpu_dispatch_test_context() {
+  std::vector<float> signal = test_signal(40 * 500);
+  int64_t dims[2] = { 500, 40 }, strides[2] = { 40, 1 };
+  int regression_coeffs[2] = { 0, 0 };
+  int all_flags[] = { LILCOM_FLAG_SPARSE | LILCOM_FLAG_CONSTANT_BLOCKS, 0,
+                      LILCOM_FLAG_ARITHMETIC_CODING |
+                      LILCOM_FLAG_CONSTANT_BLOCKS,
+                      LILCOM_FLAG_LOSSLESS, LILCOM_FLAG_ADAPTIVE };
+  CompressionContext compression_context;
+  DecompressionContext decompression_context;
+  for (int i = 0; i < 3; i++) {
+    if (!LilcomSetIsa(all_isas[i]))
+      continue;
+    for (size_t f = 0; f < sizeof(all_flags) / sizeof(int); f++) {
+      int flags = all_flags[f],
+          significant_bits = (flags & LILCOM_FLAG_ADAPTIVE ? 8 : 0);
+      std::vector<char> ref = compress_with(signal, flags, significant_bits);
+      std::vector<float> copy(signal);
+      const std::vector<char> &code = CompressFloat(
+          &compression_context, -8, &copy[0], 2, dims, strides,
+          regression_coeffs, flags, significant_bits);
+      assert(&code == &compression_context.output);
+      if (code != ref) {
+        std::cout << "Failure, output with a context differs for "
+                  << all_isas[i] << ", flags = " << flags << "\n";
+        exit(1);
+      }
+      std::vector<float> ref_decoded(signal.size()), decoded(signal.size());
+      bool ans = (DecompressFloat(&ref[0], ref.size(), &ref_decoded[0], 2,
+                                  dims, strides) == 0 &&
+                  DecompressFloat(&decompression_context, &code[0],
+                                  code.size(), &decoded[0], 2, dims,
+                                  strides) == 0);
+      assert(ans && decoded == ref_decoded);
+    }
+  }
+}
+
+/* Data compressed in layers is the same with every variant, and each
+   prefix of it that LayerPrefixBytes() gives decompresses to within the
+   documented error. */
+void cpu_dispatch_test_layered() {
+  std::vector<float> signal = test_signal(40 * 300);
+  int64_t dims[2] = { 300, 40 }, strides[2] = { 40, 1 };
+  int regression_coeffs[2] = { 0, 256 };
+  int num_layers = 5, tick_power = -8;
+  for (int flags = 0; flags <= LILCOM_FLAG_ARITHMETIC_CODING;
+       flags += LILCOM_FLAG_ARITHMETIC_CODING) {
+    bool ans = LilcomSetIsa("default");
+    assert(ans);
+    std::vector<char> ref = CompressFloatLayered(
+        tick_power, &signal[0], 2, dims, strides, regression_coeffs,
+        num_layers, flags);
+    assert(!ref.empty() &&
+           LayerPrefixBytes(&ref[0], ref.size(), -1) == (int64_t)ref.size());
+    for (int i = 0; i < 3; i++) {
+      if (!LilcomSetIsa(all_isas[i]))
+        continue;
+      std::vector<char> code = CompressFloatLayered(
+          tick_power, &signal[0], 2, dims, strides, regression_coeffs,
+          num_layers, flags);
+      if (code != ref) {
+        std::cout << "Failure, layered output of " << all_isas[i]
+                  << " differs from default\n";
+        exit(1);
+      }
+      for (int layer = 0; layer <= num_layers; layer++) {
+        /* Only the header and the size of the base layer are needed to
+           find the size of a prefix. */
+        int64_t prefix_bytes = LayerPrefixBytes(&code[0],
+                                                LilcomHeaderLen(2) + 8,
+                                                layer);
+        assert(prefix_bytes > 0 && prefix_bytes <= (int64_t)code.size());
+        std::vector<float> decoded(signal.size());
+        ans = (DecompressFloatLayers(&code[0], prefix_bytes, layer,
+                                     &decoded[0], 2, dims, strides) == 0);
+        assert(ans);
+        double max_error = pow(2.0, tick_power) *
+            (layer == num_layers ? 0.5 :
+             pow(2.0, num_layers - layer - 1) + 0.5) + 1.0e-06;
+        for (size_t j = 0; j < signal.size(); j++)
+          assert(fabs(decoded[j] - signal[j]) <= max_error);
+        if (layer < num_layers) {
+          /* Too short for all the layers, or this one. */
+          assert(DecompressFloat(&code[0], prefix_bytes, &decoded[0], 2,
+                                 dims, strides) == 6);
+          assert(DecompressFloatLayers(&code[0], prefix_bytes - 1, layer,
+                                       &decoded[0], 2, dims, strides) == 6);
+        }
+      }
+      /* In full, it decodes to the nearest tick, so as integers too. */
+      std::vector<float> decoded(signal.size());
+      std::vector<int32_t> quantized(signal.size());
+      int quantized_tick_power;
+      ans = (DecompressFloat(&code[0], code.size(), &decoded[0], 2, dims,
+                             strides) == 0 &&
+             DecompressQuantized(&code[0], code.size(), &quantized[0], 2,
+                                 dims, strides, &quantized_tick_power) == 0);
+      assert(ans && quantized_tick_power == tick_power);
+      for (size_t j = 0; j < signal.size(); j++)
+        assert(decoded[j] == quantized[j] * pow(2.0, tick_power) &&
+               fabs(decoded[j] - signal[j]) <= pow(2.0, tick_power - 1) +
+               1.0e-06);
+    }
+  }
+  /* CompressFloat() does not accept the flag. */
+  std::vector<float> copy(signal);
+  assert(CompressFloat(tick_power, &copy[0], 2, dims, strides,
+                       regression_coeffs, LILCOM_FLAG_LAYERED).empty());
+  assert(CompressFloatLayered(tick_power, &signal[0], 2, dims, strides,
+                              regression_coeffs, LILCOM_MAX_LAYERS + 1,
+                              0).empty());
+}
+
+/* Three channels, interleaved in memory: two correlated ones like stereo
+   audio, and one that is not.  Each channel decodes on its own to the same
+   as in the whole array, which is within half a tick of the input. */
+void cpu_dispatch_test_channels() {
+  int64_t num_samples = 5000, num_channels = 3;
+  std::vector<float> left = test_signal(num_samples),
+      interleaved(num_samples * num_channels);
+  for (int64_t i = 0; i < num_samples; i++) {
+    interleaved[i * 3] = left[i];
+    interleaved[i * 3 + 1] = 0.8 * left[i] + (rand() % 101 - 50) * 1.0e-5;
+    interleaved[i * 3 + 2] = cos(i * 0.003);
+  }
+  int64_t dims[2] = { num_channels, num_samples },
+      strides[2] = { 1, num_channels };
+  int tick_power = -10;
+  for (int flags = 0; flags <= LILCOM_FLAG_ARITHMETIC_CODING;
+       flags += LILCOM_FLAG_ARITHMETIC_CODING) {
+    bool ans = LilcomSetIsa("default");
+    assert(ans);
+    std::vector<char> ref = CompressFloatChannels(tick_power, &interleaved[0],
+                                                  2, dims, strides, flags);
+    assert(!ref.empty());
+    std::vector<float> copy(interleaved.size());  // in C order
+    for (int64_t j = 0; j < num_samples * num_channels; j++)
+      copy[j] = interleaved[(j % num_samples) * num_channels +
+                            j / num_samples];
+    int64_t c_strides[2] = { num_samples, 1 };
+    int regression_coeffs[2] = { 0, 256 };
+    size_t plain_size = CompressFloat(tick_power, &copy[0], 2, dims,
+                                      c_strides, regression_coeffs,
+                                      flags).size();
+    std::cout << "Size of " << num_channels << " channels compressed by "
+              << "channel is " << ref.size() << " bytes, as one array "
+              << plain_size << " bytes\n";
+    assert(ref.size() < plain_size);
+    for (int i = 0; i < 3; i++) {
+      if (!LilcomSetIsa(all_isas[i]))
+        continue;
+      std::vector<char> code = CompressFloatChannels(
+          tick_power, &interleaved[0], 2, dims, strides, flags);
+      assert(code == ref);
+      std::vector<float> decoded(interleaved.size());
+      ans = (DecompressFloat(&code[0], code.size(), &decoded[0], 2, dims,
+                             strides) == 0);
+      assert(ans);
+      for (size_t j = 0; j < interleaved.size(); j++)
+        assert(fabs(decoded[j] - interleaved[j]) <=
+               pow(2.0, tick_power - 1) + 1.0e-06);
+      for (int64_t c = 0; c < num_channels; c++) {
+        std::vector<float> channel(num_samples * 2);
+        ans = (DecompressFloatChannel(&code[0], code.size(), c, &channel[0],
+                                      2) == 0);
+        assert(ans);
+        for (int64_t j = 0; j < num_samples; j++)
+          assert(channel[j * 2] == decoded[j * num_channels + c]);
+      }
+    }
+  }
+  /* Errors: not 2 axes, the flag in CompressFloat(), a channel out of
+     range, and data not compressed by channel. */
+  std::vector<float> copy(interleaved);
+  int regression_coeffs[2] = { 0, 0 };
+  int64_t one_stride[1] = { 1 };
+  assert(CompressFloatChannels(tick_power, &interleaved[0], 1, dims + 1,
+                               strides + 1, 0).empty());
+  assert(CompressFloat(tick_power, &copy[0], 1, dims + 1, one_stride,
+                       regression_coeffs, LILCOM_FLAG_CHANNELS).empty());
+  std::vector<char> code = CompressFloatChannels(tick_power, &interleaved[0],
+                                                 2, dims, strides, 0);
+  std::vector<float> channel(num_samples);
+  assert(DecompressFloatChannel(&code[0], code.size(), num_channels,
+                                &channel[0], 1) == 4);
+  std::vector<char> plain = CompressFloat(tick_power, &copy[0], 1, dims + 1,
+                                          one_stride, regression_coeffs, 0);
+  assert(DecompressFloatChannel(&plain[0], plain.size(), 0, &channel[0],
+                                1) == 8);
+}
+
+void cpu_dispatch_test_set_isa() {
+  assert(!LilcomSetIsa("no-such-isa"));
+  assert(LilcomSetIsa("default"));
+  assert(strcmp(LilcomIsa(), "default") == 0);
+}
+
+int main() {
+  std::cout << "Selected instruction set: " << LilcomIsa() << "\n";
+  cpu_dispatch_test_set_isa();
+  cpu_dispatch_test_float();
+  cpu_dispatch_test_int();
+  cpu_dispatch_test_int_adaptive(24);
+  cpu_dispatch_test_int_adaptive(32);
+  cpu_dispatch_test_context();
+  cpu_dispatch_test_layered();
+  cpu_dispatch_test_channels();
+  std::cout << "Done\n";
+}
@@ -2,10 +2,13 @@
 #define __LILCOM__INT_STREAM_H_ 1
 
 #include <stdint.h>
+#include <string.h>  /* for memmove() */
 #include <sys/types.h>
 #include <vector>
+#include <algorithm>
 #include "int_math_utils.h"  /* for num_bits() */
 #include "bit_stream.h"
+#include "codec_stats.h"
 #include <iostream>
 #include <sstream>
 
@@ -28,19 +31,41 @@
 
 
 /**
-   class UintStream (with the help of class BitStream) is responsible for coding
-   32-bit integers into a sequence of bytes.
+   class UintStreamBase (with the help of class BitStream) is responsible for
+   coding 32-bit integers into a sequence of bytes.  The template argument
+   `BitWriter` would normally be BitStream (see the typedef UintStream
+   below); it may also be BitCounter, if we only need to know the size
+   of the code.
 
    See also class ReverseUintStream and class IntStream.
  */
-class UintStream {
+template <class BitWriter>
+class UintStreamBase {
  public:
 
   /*  Constructor */
-  UintStream(): most_recent_num_bits_(0),
-                started_(false),
-                flushed_(false),
-                num_pending_zeros_(0) { }
+  UintStreamBase(): buffer_size_(0),
+                    most_recent_num_bits_(0),
+                    started_(false),
+                    flushed_(false),
+                    num_pending_zeros_(0) {
+#ifdef LILCOM_STATS
+    stats_ = NULL;
+#endif
+  }
+
+  /*
+    Makes this stream add statistics about the codes it writes to `*stats`
+    (see struct CodecStats for which).  Does nothing unless compiled with
+    LILCOM_STATS defined.  Must be called before Write().
+   */
+  void SetStats(CodecStats *stats) {
+#ifdef LILCOM_STATS
+    stats_ = stats;
+#else
+    (void)stats;
+#endif
+  }
 
   /*
     Write the bits.  The lower-order `num_bits_in` of `bits_in` will
@@ -53,20 +78,31 @@ class UintStream {
    */
   inline void Write(uint32_t value) {
     assert(!flushed_);
-    buffer_.push_back(value);
-    if (buffer_.size() >= 64) {
-      FlushSome(32);
+    buffer_[buffer_size_++] = value;
+    if (buffer_size_ >= kBufferSize) {
+      FlushSome(kBufferSize / 2);
     }
   }
 
 
   /* Gets the code that was written.  After calling this you must
-     not call Write(), since this function flushes the stream. */
+     not call Write(), since this function flushes the stream.
+     (Only usable if BitWriter is BitStream.) */
   std::vector<char> &Code() {
     if (!flushed_) Flush();
     return bit_stream_.Code();
   }
 
+  /* Returns the number of bytes in the code that was written.  This
+     flushes the stream, like Code(). */
+  size_t NumBytes() {
+    if (!flushed_) Flush();
+    return bit_stream_.NumBytes();
+  }
+
+  /* See BitStream::SwapCode().  (Only usable if BitWriter is BitStream.) */
+  void SwapCode(std::vector<char> *code) { bit_stream_.SwapCode(code); }
+
  private:
 
   /*
@@ -75,9 +111,9 @@ class UintStream {
    */
   void Flush() {
     assert(!flushed_);
-    assert(!buffer_.empty());  /* check that data has been written. */
+    assert(buffer_size_ != 0);  /* check that data has been written. */
     flushed_ = true;
-    FlushSome(buffer_.size());
+    FlushSome(buffer_size_);
     if (num_pending_zeros_)
       FlushPendingZeros();
   }
@@ -104,21 +140,47 @@ class UintStream {
 
     /* think of the following as writing `num_bits_written` zeros, then
        a 1. */
-    bit_stream_.Write(num_bits_written + 1, 1 << num_bits_written);
+    WriteBits(num_bits_written + 1, (uint64_t)1 << num_bits_written);
 
     /* Write `num_pending_zeros_`, except for the top bit.  We couldn't just
        write num_bits_written zeros, then num_pending_zeros_ in
        num_bits_written+1 bits, because they'd be in the wrong order; we need
        the `1` to be first so we can identify where the zeros end.
      */
-    bit_stream_.Write(num_bits_written,
-                      num_pending_zeros_ & ((1 << num_bits_written) - 1));
+    WriteBits(num_bits_written,
+              num_pending_zeros_ & (((uint64_t)1 << num_bits_written) - 1));
+#ifdef LILCOM_STATS
+    if (stats_ != NULL) {
+      stats_->num_zero_runs++;
+      stats_->num_zeros_in_runs += num_pending_zeros_;
+      stats_->zero_run_histogram[num_bits_written]++;
+    }
+#endif
     num_pending_zeros_ = 0;
   }
 
+  /* Writes the lower-order `num_bits` of `bits` (num_bits <= 64); this is
+     the same as one call to bit_stream_.Write() if num_bits <= 32.  This is
+     only needed for runs of more than 2^32 - 1 zeros. */
+  inline void WriteBits(int num_bits, uint64_t bits) {
+    if (num_bits > 32) {
+      bit_stream_.Write(32, (uint32_t)bits);
+      bit_stream_.Write(num_bits - 32, (uint32_t)(bits >> 32));
+    } else {
+      bit_stream_.Write(num_bits, (uint32_t)bits);
+    }
+  }
+
+
+  /* The size of buffer_.  When it is full we encode the first half of it;
+     we need to see the values after them to choose their num_bits. */
+  static const int kBufferSize = 64;
 
-  /* buffer_ contains pending values that we have not yet encoded. */
-  std::vector<uint32_t> buffer_;
+  /* buffer_[0 .. buffer_size_ - 1] are pending values that we have not yet
+     encoded.  (This is a plain array so that writing does no heap
+     allocation.) */
+  uint32_t buffer_[kBufferSize];
+  int buffer_size_;
 
   /* most_recent_num_bits_ is 0 if we have not yet called FlushSome();
      otherwise is is the num-bits of the most recent int that was
@@ -127,7 +189,7 @@ class UintStream {
   */
   int most_recent_num_bits_;
 
-  BitStream bit_stream_;
+  BitWriter bit_stream_;
 
   /**
      This function outputs to the `num-bits` array the number of bits
@@ -135,14 +197,14 @@ class UintStream {
      to ensure that successive elements differ by no more than 1
      (and the zeroth element is no less than most_recent_num_bits_ - 1).
 
-       `num_bits_out` must have size equal to buffer_.size().
+       `num_bits_out` must have space for buffer_size_ elements.
   */
-  inline void ComputeNumBits(std::vector<int> *num_bits_out) const {
+  inline void ComputeNumBits(int *num_bits_out) const {
     int prev_num_bits = most_recent_num_bits_;
 
-    std::vector<uint32_t>::const_iterator buffer_iter = buffer_.begin(),
-        buffer_end = buffer_.end();
-    std::vector<int>::iterator num_bits_iter = num_bits_out->begin();
+    const uint32_t *buffer_iter = buffer_,
+        *buffer_end = buffer_ + buffer_size_;
+    int *num_bits_iter = num_bits_out;
     /* Simplified version of the code below without end effects treated
        right is:
        for (i = 0 ... size-1):
@@ -154,24 +216,21 @@ class UintStream {
           prev_num_bits - 1));
     }
 
-    std::vector<int>::reverse_iterator num_bits_riter = num_bits_out->rbegin(),
-        num_bits_rend = num_bits_out->rend();
     int next_num_bits = 0;
     /* Simplified version of the code below without end effects being
        treated correctly is:
        for (i = size-1, size-2, ... 0):
          num_bits[i] = max(num_bits[i+1] - 1, num_bits[i]);
     */
-    for (; num_bits_riter != num_bits_rend; ++num_bits_riter) {
-      int this_num_bits = *num_bits_riter;
-      next_num_bits = *num_bits_riter = int_math::int_math_max(this_num_bits,
+    for (int i = buffer_size_ - 1; i >= 0; i--) {
+      int this_num_bits = num_bits_out[i];
+      next_num_bits = num_bits_out[i] = int_math::int_math_max(this_num_bits,
                                                                next_num_bits - 1);
     }
     /*
-    size_t size = buffer_.size();
-    std::cout << "size = " << size;
-    for (int i = 0; i < size; i++) {
-      std::cout << "  n=" << buffer_[i] << ", nbits=" << (*num_bits_out)[i];
+    std::cout << "size = " << buffer_size_;
+    for (int i = 0; i < buffer_size_; i++) {
+      std::cout << "  n=" << buffer_[i] << ", nbits=" << num_bits_out[i];
     }
     std::cout << std::endl;
     */
@@ -263,11 +322,11 @@ class UintStream {
 
   /**
      Flushes out up to `num_to_flush` ints from `buffer_` (or exactly
-     `num_to_flush` ints if it equals buffer_.size().  This is called
+     `num_to_flush` ints if it equals buffer_size_).  This is called
      by Write(), and also by Flush().
   */
-  inline void FlushSome(uint32_t num_to_flush) {
-    size_t size = buffer_.size();
+  inline void FlushSome(int num_to_flush) {
+    int size = buffer_size_;
     assert(num_to_flush <= size);
     if (size == 0)
       return;  /* ? */
@@ -281,11 +340,11 @@ class UintStream {
        then increase the values as necessary to ensure that the
        absolute difference between successive values is no greater than 1.
      */
-    std::vector<int> num_bits(size);
-    ComputeNumBits(&num_bits);
+    int num_bits[kBufferSize + 1];
+    ComputeNumBits(num_bits);
     if (num_to_flush == size) {
       /* end of stream.  we need to modify for end effects... */
-      num_bits.push_back(num_bits.back());
+      num_bits[size] = num_bits[size - 1];
     }
 
     if (!started_) {
@@ -303,11 +362,15 @@ class UintStream {
          condition. */
       most_recent_num_bits_ = first_num_bits;
     }
+#ifdef LILCOM_STATS
+    if (stats_ != NULL)
+      AccumulateStats(num_bits, num_to_flush);
+#endif
     int prev_num_bits = most_recent_num_bits_,
         cur_num_bits = num_bits[0];
 
-    std::vector<uint32_t>::const_iterator iter = buffer_.begin();
-    for (size_t i = 0; i < num_to_flush; i++,++iter) {
+    const uint32_t *iter = buffer_;
+    for (int i = 0; i < num_to_flush; i++,++iter) {
       int next_num_bits = num_bits[i+1];
       /* we're writing the element at buffer_[i] to the bit stream, and
          also encoding the exponent of the element following it. */
@@ -319,8 +382,37 @@ class UintStream {
       cur_num_bits = next_num_bits;
     }
     most_recent_num_bits_ = num_bits[num_to_flush - 1];
-    buffer_.erase(buffer_.begin(), buffer_.begin() + num_to_flush);
+    buffer_size_ = size - num_to_flush;
+    memmove(buffer_, buffer_ + num_to_flush, buffer_size_ * sizeof(uint32_t));
   }
+
+#ifdef LILCOM_STATS
+  /*
+    Adds to *stats_ the statistics about the codes of the first
+    `num_to_flush` elements of buffer_, whose num_bits are in `num_bits`
+    (which has one more element, the num_bits of the element after them).
+    This is called from FlushSome() and mirrors what WriteCode() does.
+   */
+  void AccumulateStats(const int *num_bits, int num_to_flush) {
+    int prev_num_bits = most_recent_num_bits_;
+    for (int i = 0; i < num_to_flush; i++) {
+      int cur_num_bits = num_bits[i], next_num_bits = num_bits[i + 1];
+      stats_->num_bits_histogram[cur_num_bits]++;
+      if (cur_num_bits > 0) {
+        if (next_num_bits > cur_num_bits) stats_->num_bits_up++;
+        else if (next_num_bits < cur_num_bits) stats_->num_bits_down++;
+        else stats_->num_bits_same++;
+        if (prev_num_bits <= cur_num_bits && next_num_bits <= cur_num_bits)
+          stats_->top_bit_savings++;
+      }
+      prev_num_bits = cur_num_bits;
+    }
+  }
+
+  /* The statistics object set by SetStats(), or NULL. */
+  CodecStats *stats_;
+#endif
+
   /* started_ is true if we have called FlushSome() at least once. */
   bool started_;
 
@@ -330,10 +422,12 @@ class UintStream {
   /* num_pending_zeros_ has to do with run-length encoding of sequences
      of 0's. It's the number of zeros in the sequence that we
      need to write. */
-  uint32_t num_pending_zeros_;
+  uint64_t num_pending_zeros_;
 
 };
 
+typedef UintStreamBase<BitStream> UintStream;
+
 
 class ReverseUintStream {
  public:
@@ -354,15 +448,15 @@ class ReverseUintStream {
       bit_reader_(code, code_memory_end),
       zero_runlength_(-1) {
     assert(code_memory_end > code);
-    uint32_t num_bits;
-    bool ans = bit_reader_.Read(5, &num_bits);
-    assert(ans);
-    if (num_bits >= 31) {
+    /* If the stream is too short to read these bits (i.e. it is invalid),
+       we leave num_bits at 0; the first call to Read() will then fail,
+       since bit_reader_ has reached the end of the memory. */
+    uint32_t num_bits = 0;
+    if (bit_reader_.Read(5, &num_bits) && num_bits >= 31) {
       /* we need an extra bit to distinguish between 31 and 32 (the
          initial num_bits can be anywhere from 0 to 32). */
-      uint32_t extra_bit;
-      ans = bit_reader_.Read(1, &extra_bit);
-      assert(ans);
+      uint32_t extra_bit = 0;
+      bit_reader_.Read(1, &extra_bit);
       num_bits += extra_bit;
     }
     prev_num_bits_ = num_bits;
@@ -439,18 +533,22 @@ class ReverseUintStream {
         int num_zeros_read = 0;
         uint32_t bit;
         while (1) {
-          if (!bit_reader_.Read(1, &bit) || num_zeros_read > 31)
+          if (!bit_reader_.Read(1, &bit) || num_zeros_read > 62)
             return false;  /* truncated or corrupted code? */
           if (bit == 0)
             num_zeros_read++;
           else  /* the bit was 1. */
             break;
         }
-        uint32_t x;
-        if (!bit_reader_.Read(num_zeros_read, &x))
+        /* Runs of more than 2^32 - 1 zeros need more than 32 bits here. */
+        uint32_t x, x_high = 0;
+        if (!bit_reader_.Read(std::min(num_zeros_read, 32), &x) ||
+            (num_zeros_read > 32 &&
+             !bit_reader_.Read(num_zeros_read - 32, &x_high)))
           return false;
 
-        int num_zeros_in_run = (1 << num_zeros_read) + x;
+        int64_t num_zeros_in_run = ((uint64_t)1 << num_zeros_read) +
+            (((uint64_t)x_high << 32) | x);
         /* minus 2 because we already have cur_num_bits == 0,
            so that's the first zero; then we are about to set
            next_num_bits, so that's potentially the second zero.
@@ -509,25 +607,33 @@ class ReverseUintStream {
      where the num-bits first became zero (however, this gets reset
      if we have just encoded a run of zeros
   */
-  int zero_runlength_;
+  int64_t zero_runlength_;
 };
 
 /*
   This encodes signed integers (will be effective when the
   values are close to zero).
  */
-class IntStream: public UintStream {
+template <class BitWriter>
+class IntStreamBase: public UintStreamBase<BitWriter> {
  public:
-  IntStream() { }
+  IntStreamBase() { }
 
   inline void Write(int32_t value) {
-    UintStream::Write(value >= 0 ? 2 * value : -(2 * value) - 1);
+    UintStreamBase<BitWriter>::Write(value >= 0 ? 2 * value : -(2 * value) - 1);
   }
 
-  /* Flush() and Code() are inherited from class UintStream. */
+  /* Flush(), Code() and NumBytes() are inherited from class UintStreamBase. */
 
 };
 
+typedef IntStreamBase<BitStream> IntStream;
+
+/* IntStreamSizeEstimator accepts the same sequence of Write() calls as
+   IntStream, but only keeps track of how many bytes the code would take
+   (see its NumBytes() function); no bits are actually packed. */
+typedef IntStreamBase<BitCounter> IntStreamSizeEstimator;
+
 /*
   This class is for decoding data encoded by class IntStream.
  */
@@ -628,12 +734,14 @@ struct TruncationConfig {
       first_block_correction(other.first_block_correction) { }
 
   /*
-     Writes configuration variables to an IntStream.
+     Writes configuration variables to an IntStream (or any class with the
+     same Write() interface, e.g. IntStreamSizeEstimator).
         @param [in,out] s  The stream to write the configuration variables to
         @param [in] format_version   Version of the format to use;
                        defaults to the current format version (currently 1).
    */
-  void Write(IntStream *s, int format_version=1) const {
+  template <class IntStreamType>
+  void Write(IntStreamType *s, int format_version=1) const {
     assert(format_version == 1);  /* currently only one version supported. */
     s->Write(num_significant_bits);
     s->Write(alpha);
@@ -739,15 +847,16 @@ class Truncation {
                     the value that would be written to the stream.
                     It would have to be shifted left by num_truncated_bits_
                     to get the actual signal value.
-                    CAUTION: although i_truncated is of type int32_t you
-                    are not allowed to use the full range of int32_t:
-                    specifically, i_truncated * block_size_ must still
-                    be representable as int32_t.  (This is no problem
-                    for our applications, as block_size will be small,
-                    e.g. 32 bits, and the elements of the stream will
-                    have either max 17 bits (for residuals of a 16-bit
-                    stream) or 25 bits (for residuals of a 24-bit
-                    stream, which is not implemented yet).
+                    CAUTION: the stats are accumulated in 64 bits, so
+                    i_truncated^2 * block_size must be representable as
+                    uint64_t for the number of bits to be exactly right.
+                    This is no problem for our applications, as
+                    block_size will be small, e.g. 32, and the elements of
+                    the stream will have max 17 bits (for residuals of a
+                    16-bit stream) or 25 bits (24-bit stream); it can only
+                    be exceeded in the first block of a 32-bit stream of
+                    near full-scale noise, which makes the truncation less
+                    efficient but is still decoded correctly.
    */
   void Step(int32_t i_truncated) {
     count_++;
@@ -777,6 +886,13 @@ class Truncation {
 
     return ans;
   }
+  /* As Restore(), but without overflow for num_truncated_bits up to 30 (as
+     used for the residuals of 32-bit samples). */
+  inline static int64_t RestoreWide(int32_t truncated_value,
+                                    int num_truncated_bits) {
+    return truncated_value * ((int64_t)1 << num_truncated_bits) +
+        (num_truncated_bits - 1 > 0 ? (1 << (num_truncated_bits - 1)) : 0);
+  }
 
  private:
   /*
@@ -894,39 +1010,58 @@ class TruncatedIntStream: public IntStream, private Truncation {
   }
 
   /*
-    WriteLimited() provides a slightly more complicated interface than Write().
-    It's like Write() but it guarantees that predicted + decompressed_residual
-    still fits into int16_t.  This makes decompression simpler, as we
-    can avoid range checks (or turn them into assertions).
-
-    Note: `decompressed_value_out` is not an approximation to `residual`, it is
-    an approximation to `predicted + residual`.
+    WriteLimited() provides a slightly more complicated interface than Write(),
+    for the residuals of audio samples of kSampleBits bits (16, 24 or 32; the
+    samples are stored in int32_t).  It's like Write() but it guarantees that
+    the decompressed value, predicted + decompressed_residual, is within the
+    range of a signed kSampleBits-bit integer.  This makes decompression
+    simpler, as we can avoid range checks.
+
+    The residual of a 32-bit sample may not fit into int32_t, so the residual
+    that is coded is `residual` modulo 2^32 (as a signed integer), and
+    ReverseTruncatedIntStream::Read<kSampleBits>() adds it to the prediction
+    modulo 2^32 too; for 16 and 24 bits this makes no difference.  At most
+    kSampleBits - 2 bits are truncated, so that a residual that is moved by
+    one step to keep the value in range cannot go out of the other side.
+
+       @param [in] residual  The sample minus `predicted`
+       @param [in] predicted  The prediction of the sample, which must be in
+                      the range of kSampleBits bits.
+       @param [out] decompressed_value_out  The sample as it will be
+                      decompressed (not an approximation to `residual`, but
+                      to `predicted + residual`).
+       @param [out] decompressed_residual_out  The residual as it will be
+                      decompressed, modulo 2^32 as above.
   */
-  inline void WriteLimited(int32_t residual, int16_t predicted,
-                           int16_t *decompressed_value_out,
+  template <int kSampleBits>
+  inline void WriteLimited(int64_t residual, int32_t predicted,
+                           int32_t *decompressed_value_out,
                            int32_t *decompressed_residual_out) {
-    int num_truncated_bits = NumTruncatedBits();
-    int32_t truncated_residual = Truncate(residual, num_truncated_bits),
-        decompressed_residual = Restore(truncated_residual, num_truncated_bits),
-        decompressed_value = predicted + decompressed_residual;
-    if (decompressed_value != static_cast<int16_t>(decompressed_value)) {
-      /* The prediction+residual exceeded the range of int16_t.  This should
-         be rare. */
-      if (truncated_residual >= 0)
-        truncated_residual--;  /* Note: if truncated_residual == 0, decompressed_residual
-                                  would in general be positive, due to the 2nd term
-                                  in the expression in Restore(). */
+    const int64_t max_value = ((int64_t)1 << (kSampleBits - 1)) - 1,
+        min_value = -max_value - 1;
+    int num_truncated_bits = std::min<int>(NumTruncatedBits(),
+                                           kSampleBits - 2);
+    int32_t wrapped_residual = (int32_t)(uint32_t)residual,
+        truncated_residual = Truncate(wrapped_residual, num_truncated_bits);
+    /* decompressed_value is the sample plus the (small) error of
+       truncation. */
+    int64_t value = predicted + residual,
+        decompressed_value = value - wrapped_residual +
+        RestoreWide(truncated_residual, num_truncated_bits);
+    if (decompressed_value > max_value || decompressed_value < min_value) {
+      /* The error took the value out of range.  This should be rare. */
+      if (decompressed_value > max_value)
+        truncated_residual--;
       else
         truncated_residual++;
-      decompressed_residual = Restore(truncated_residual, num_truncated_bits);
-      decompressed_value = predicted + decompressed_residual;
-      assert(decompressed_value == static_cast<int16_t>(decompressed_value));
+      decompressed_value = value - wrapped_residual +
+          RestoreWide(truncated_residual, num_truncated_bits);
+      assert(decompressed_value >= min_value &&
+             decompressed_value <= max_value);
     }
-    *decompressed_value_out = static_cast<int16_t>(decompressed_value);
-    *decompressed_residual_out = decompressed_residual;
-
-    //std::cout << "[T: writing " << residual << "(value=" << (predicted+residual)
-    // << ") truncated to " << truncated_residual << "]";
+    *decompressed_value_out = (int32_t)decompressed_value;
+    *decompressed_residual_out = (int32_t)(uint32_t)
+        RestoreWide(truncated_residual, num_truncated_bits);
 
     IntStream::Write(truncated_residual);
     /* Update the truncation base-class, which keeps NumTruncatedBits() up to
@@ -957,6 +1092,27 @@ class ReverseTruncatedIntStream: public ReverseIntStream, private Truncation {
     *value = Restore(truncated_value, num_truncated_bits);
     return true;
   }
+
+  /*
+    Reads a sample written by TruncatedIntStream::WriteLimited<kSampleBits>()
+    with the same prediction `predicted`.  Returns false if the stream ended,
+    or (only for corrupted data) the sample was out of the range of
+    kSampleBits bits.
+   */
+  template <int kSampleBits>
+  inline bool Read(int32_t predicted, int32_t *value) {
+    const int64_t max_value = ((int64_t)1 << (kSampleBits - 1)) - 1;
+    int32_t truncated_residual;
+    if (! ReverseIntStream::Read(&truncated_residual))
+      return false;
+    int num_truncated_bits = std::min<int>(NumTruncatedBits(),
+                                           kSampleBits - 2);
+    Step(truncated_residual);
+    uint32_t residual = (uint32_t)RestoreWide(truncated_residual,
+                                              num_truncated_bits);
+    *value = (int32_t)((uint32_t)predicted + residual);
+    return *value <= max_value && *value >= -max_value - 1;
+  }
   /* Inherits NextCode() from ReverseIntStream. */
 
 };
@@ -221,6 +221,52 @@ void truncated_int_stream_test() {
   }
 }
 
+/*
+  Tests WriteLimited<kSampleBits>() and Read<kSampleBits>() on loud samples
+  that are often at the extremes of the range, predicting each sample from
+  the previous decompressed one.
+ */
+template <int kSampleBits>
+void truncated_int_stream_test_limited() {
+  const int64_t max_value = ((int64_t)1 << (kSampleBits - 1)) - 1,
+      min_value = -max_value - 1;
+  const int num_samples = 2000;
+  std::vector<int32_t> samples(num_samples), decompressed(num_samples);
+  TruncationConfig config(8, 64, 32);
+  TruncatedIntStream tis(config);
+  int32_t predicted = 0;
+  for (int i = 0; i < num_samples; i++) {
+    int64_t value = (int64_t)(max_value * 1.2 * sin(i * 0.3) +
+                              rand_gauss() * (max_value / 8));
+    if (i % 7 == 0)
+      value = (i % 2 == 0 ? max_value : min_value);
+    value = std::max(min_value, std::min(value, max_value));
+    samples[i] = (int32_t)value;
+    int32_t decompressed_residual;
+    tis.WriteLimited<kSampleBits>(value - predicted, predicted,
+                                  &(decompressed[i]), &decompressed_residual);
+    assert(decompressed[i] >= min_value && decompressed[i] <= max_value);
+    assert(decompressed[i] ==
+           (int32_t)((uint32_t)predicted + (uint32_t)decompressed_residual));
+    /* With 8 significant bits the error is small relative to the full
+       scale. */
+    assert(fabs((double)decompressed[i] - samples[i]) < max_value / 16.0);
+    predicted = decompressed[i];
+  }
+  ReverseTruncatedIntStream rtis(config, &(tis.Code()[0]),
+                                 &(tis.Code()[0]) + tis.Code().size());
+  predicted = 0;
+  for (int i = 0; i < num_samples; i++) {
+    int32_t value;
+    bool ans = rtis.Read<kSampleBits>(predicted, &value);
+    assert(ans && value == decompressed[i]);
+    predicted = value;
+  }
+  std::cout << "Coded " << num_samples << " loud " << kSampleBits
+            << "-bit samples in " << tis.Code().size() << " bytes\n";
+}
+
+
 
 void int_stream_test_gauss() {
   int32_t buffer[10000];
@@ -265,12 +311,35 @@ void int_stream_test_gauss() {
   }
 }
 
+void int_stream_size_estimator_test() {
+  for (int num_ints = 1; num_ints < 500; num_ints += 7) {
+    IntStream is;
+    IntStreamSizeEstimator ise;
+    for (int i = 0; i < num_ints; i++) {
+      /* Mix runs of zeros with values of varying magnitude, so that all
+         the code paths of UintStreamBase are exercised. */
+      int32_t r = (rand() % 3 == 0 ? 0 : (int32_t)rand_special());
+      is.Write(r);
+      ise.Write(r);
+    }
+    if (ise.NumBytes() != is.Code().size()) {
+      std::cout << "Failure, estimated size " << ise.NumBytes()
+                << " != " << is.Code().size() << "\n";
+      exit(1);
+    }
+  }
+}
+
 
 int main() {
   uint_stream_test_one();
   int_stream_test_two();
   int_stream_test_gauss();
+  int_stream_size_estimator_test();
   truncated_int_stream_test();
+  truncated_int_stream_test_limited<16>();
+  truncated_int_stream_test_limited<24>();
+  truncated_int_stream_test_limited<32>();
   test_truncation_config_io();
   std::cout << "Done\n";
 }
@@ -0,0 +1,495 @@
+/*
+  The plain-C interface; see lilcom_c.h.
+ */
+#include "lilcom_c.h"
+#include "compression.h"
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <new>
+#include <vector>
+
+
+/* The flags that the caller may pass when compressing floats. */
+#define LILCOM_C_FLOAT_FLAGS (LILCOM_FLAG_ARITHMETIC_CODING|LILCOM_FLAG_SPARSE|\
+                              LILCOM_FLAG_LOSSLESS|LILCOM_FLAG_ADAPTIVE)
+
+/* Sets `strides` to the strides of a contiguous array of shape `dims`. */
+static void ContiguousStrides(int num_axes, const int64_t *dims,
+                              int64_t *strides) {
+  int64_t stride = 1;
+  for (int i = num_axes - 1; i >= 0; i--) {
+    strides[i] = stride;
+    stride *= dims[i];
+  }
+}
+
+/* Returns true if num_axes and dims describe a valid shape. */
+static bool ValidShape(int num_axes, const int64_t *dims) {
+  if (num_axes < 1 || num_axes > LILCOM_MAX_AXES || dims == NULL)
+    return false;
+  for (int i = 0; i < num_axes; i++)
+    if (dims[i] < 0)
+      return false;
+  return true;
+}
+
+/* Returns the number of elements of an array of a valid shape. */
+static int64_t NumElements(int num_axes, const int64_t *dims) {
+  int64_t ans = 1;
+  for (int i = 0; i < num_axes; i++)
+    ans *= dims[i];
+  return ans;
+}
+
+/*
+  The most bits that one integer can take up in the compressed data, for
+  the use of lilcom_compress_bound().  For IntStream this is 2 bits for the
+  change in num_bits plus 32 bits of value (a run of zeros takes less than
+  2 bits per zero).  For ArithIntStream it is 8 adaptively coded bits (the
+  num_bits and the 2 bits below the top one), each taking less than
+  log2(2048 / 31) < 6.05 bits because no probability gets below 31/2048,
+  plus up to 30 directly coded bits.
+ */
+static const int64_t kMaxBitsPerInt = 34, kMaxBitsPerArithInt = 80;
+
+/*
+  An allowance, for lilcom_compress_bound(), for everything in the
+  compressed data whose size does not grow with the number of elements:
+  the start and end of each stream, the configuration for adaptive mode and
+  the counts at the ends of a sparse stream.
+ */
+static const int64_t kMaxFixedBytes = 256;
+
+/* Copies the compressed data `code` to the caller's buffer, as described
+   in lilcom_c.h. */
+static int CopyOutput(const std::vector<char> &code, void *out,
+                      size_t out_capacity, size_t *out_size) {
+  if (out_size == NULL)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  *out_size = code.size();
+  if (code.size() > out_capacity || out == NULL)
+    return LILCOM_STATUS_BUFFER_TOO_SMALL;
+  memcpy(out, &(code[0]), code.size());
+  return LILCOM_STATUS_OK;
+}
+
+/*
+  Checks that `data` is valid lilcom data of element type `type` and shape
+  (num_axes, dims), as required before decompressing it.
+ */
+static int CheckData(const void *data, size_t num_bytes, int type,
+                     int num_axes, const int64_t *dims) {
+  if (data == NULL || !ValidShape(num_axes, dims))
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  int64_t meta[LILCOM_MAX_AXES + 1];
+  if (!GetCompressedDataShape(static_cast<const char*>(data), num_bytes, meta))
+    return LILCOM_STATUS_INVALID_DATA;
+  int data_type = GetCompressedDataType(static_cast<const char*>(data),
+                                        num_bytes);
+  if (data_type < 0)
+    return LILCOM_STATUS_INVALID_DATA;
+  if (data_type != type)
+    return LILCOM_STATUS_WRONG_TYPE;
+  if (meta[0] != num_axes)
+    return LILCOM_STATUS_SHAPE_MISMATCH;
+  for (int i = 0; i < num_axes; i++)
+    if (meta[i + 1] != dims[i])
+      return LILCOM_STATUS_SHAPE_MISMATCH;
+  return LILCOM_STATUS_OK;
+}
+
+
+extern "C" {
+
+int lilcom_api_version(void) {
+  return LILCOM_C_API_VERSION;
+}
+
+const char *lilcom_strerror(int status) {
+  switch (status) {
+    case LILCOM_STATUS_OK: return "success";
+    case LILCOM_STATUS_INVALID_ARGUMENT: return "invalid argument";
+    case LILCOM_STATUS_BUFFER_TOO_SMALL: return "output buffer too small";
+    case LILCOM_STATUS_INVALID_DATA: return "invalid compressed data";
+    case LILCOM_STATUS_WRONG_TYPE: return "wrong element type for data";
+    case LILCOM_STATUS_SHAPE_MISMATCH: return "shape does not match data";
+    case LILCOM_STATUS_OUT_OF_MEMORY: return "out of memory";
+    case LILCOM_STATUS_NOT_EXACT:
+      return "values are not exact multiples of the tick";
+    case LILCOM_STATUS_OUT_OF_RANGE: return "value out of range of type";
+    default: return "unknown status";
+  }
+}
+
+int lilcom_get_shape(const void *data, size_t num_bytes,
+                     int *num_axes, int64_t *dims) {
+  if (data == NULL || num_axes == NULL || dims == NULL)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  int64_t meta[LILCOM_MAX_AXES + 1];
+  if (!GetCompressedDataShape(static_cast<const char*>(data), num_bytes, meta))
+    return LILCOM_STATUS_INVALID_DATA;
+  *num_axes = static_cast<int>(meta[0]);
+  for (int i = 0; i < *num_axes; i++)
+    dims[i] = meta[i + 1];
+  return LILCOM_STATUS_OK;
+}
+
+int lilcom_get_type(const void *data, size_t num_bytes, int *type) {
+  if (data == NULL || type == NULL)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  int ans = GetCompressedDataType(static_cast<const char*>(data), num_bytes);
+  if (ans < 0)
+    return LILCOM_STATUS_INVALID_DATA;
+  *type = ans;
+  return LILCOM_STATUS_OK;
+}
+
+int lilcom_compress_float(const float *data, int num_axes,
+                          const int64_t *dims, const int64_t *strides,
+                          const int *regression_coeffs, int tick_power,
+                          int flags, int significant_bits,
+                          void *out, size_t out_capacity, size_t *out_size) {
+  if (!ValidShape(num_axes, dims) || (flags & ~LILCOM_C_FLOAT_FLAGS) != 0)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  /* CompressFloat() changes its input, so we compress a contiguous copy. */
+  int64_t copy_strides[LILCOM_MAX_AXES];
+  ContiguousStrides(num_axes, dims, copy_strides);
+  int64_t num_elements = copy_strides[0] * dims[0];
+  if (data == NULL && num_elements > 0)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  try {
+    std::vector<float> copy(num_elements);
+    if (strides == NULL) {
+      if (num_elements > 0)
+        memcpy(&(copy[0]), data, num_elements * sizeof(float));
+    } else {
+      for (int64_t i = 0; i < num_elements; i++) {
+        int64_t offset = 0;
+        for (int axis = 0; axis < num_axes; axis++)
+          offset += ((i / copy_strides[axis]) % dims[axis]) * strides[axis];
+        copy[i] = data[offset];
+      }
+    }
+    int zero_coeffs[LILCOM_MAX_AXES] = { 0 };
+    std::vector<char> code = CompressFloat(
+        tick_power, (num_elements > 0 ? &(copy[0]) : NULL), num_axes, dims,
+        copy_strides,
+        (regression_coeffs != NULL ? regression_coeffs : zero_coeffs),
+        flags, significant_bits);
+    if (code.empty())
+      return LILCOM_STATUS_INVALID_ARGUMENT;
+    return CopyOutput(code, out, out_capacity, out_size);
+  } catch (const std::exception &) {
+    return LILCOM_STATUS_OUT_OF_MEMORY;
+  }
+}
+
+}  // extern "C"
+
+
+template <class T>
+static int CompressIntTyped(const void *data, int num_axes,
+                            const int64_t *dims, const int64_t *strides,
+                            const int *regression_coeffs, int flags,
+                            void *out, size_t out_capacity, size_t *out_size) {
+  int64_t contiguous_strides[LILCOM_MAX_AXES];
+  if (strides == NULL) {
+    ContiguousStrides(num_axes, dims, contiguous_strides);
+    strides = contiguous_strides;
+  }
+  int zero_coeffs[LILCOM_MAX_AXES] = { 0 };
+  std::vector<char> code = CompressInt(
+      static_cast<const T*>(data), num_axes, dims, strides,
+      (regression_coeffs != NULL ? regression_coeffs : zero_coeffs), flags);
+  if (code.empty())
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  return CopyOutput(code, out, out_capacity, out_size);
+}
+
+template <class T>
+static int DecompressIntTyped(const void *data, size_t num_bytes, void *out,
+                              int num_axes, const int64_t *dims,
+                              const int64_t *strides) {
+  int64_t contiguous_strides[LILCOM_MAX_AXES];
+  if (strides == NULL) {
+    ContiguousStrides(num_axes, dims, contiguous_strides);
+    strides = contiguous_strides;
+  }
+  int ret = DecompressInt(static_cast<const char*>(data), num_bytes,
+                          static_cast<T*>(out), num_axes, dims, strides);
+  return (ret == 0 ? LILCOM_STATUS_OK : LILCOM_STATUS_INVALID_DATA);
+}
+
+template <class T>
+static int DecompressQuantizedTyped(const void *data, size_t num_bytes,
+                                    void *out, int num_axes,
+                                    const int64_t *dims,
+                                    const int64_t *strides,
+                                    int *tick_power) {
+  int64_t contiguous_strides[LILCOM_MAX_AXES];
+  if (strides == NULL) {
+    ContiguousStrides(num_axes, dims, contiguous_strides);
+    strides = contiguous_strides;
+  }
+  int ret = DecompressQuantized(static_cast<const char*>(data), num_bytes,
+                                static_cast<T*>(out), num_axes, dims,
+                                strides, tick_power);
+  switch (ret) {
+    case 0: return LILCOM_STATUS_OK;
+    case 11: return LILCOM_STATUS_NOT_EXACT;
+    case 12: return LILCOM_STATUS_OUT_OF_RANGE;
+    default: return LILCOM_STATUS_INVALID_DATA;
+  }
+}
+
+/* Expands to a switch statement that returns FN<T>(args) for the integer
+   type T that `type` refers to, or LILCOM_STATUS_INVALID_ARGUMENT. */
+#define LILCOM_SWITCH_INT_TYPE(type, FN, ...)                            \
+  switch (type) {                                                       \
+    case LILCOM_TYPE_INT8: return FN<int8_t>(__VA_ARGS__);              \
+    case LILCOM_TYPE_UINT8: return FN<uint8_t>(__VA_ARGS__);            \
+    case LILCOM_TYPE_INT16: return FN<int16_t>(__VA_ARGS__);            \
+    case LILCOM_TYPE_UINT16: return FN<uint16_t>(__VA_ARGS__);          \
+    case LILCOM_TYPE_INT32: return FN<int32_t>(__VA_ARGS__);            \
+    case LILCOM_TYPE_UINT32: return FN<uint32_t>(__VA_ARGS__);          \
+    case LILCOM_TYPE_INT64: return FN<int64_t>(__VA_ARGS__);            \
+    case LILCOM_TYPE_UINT64: return FN<uint64_t>(__VA_ARGS__);          \
+    default: return LILCOM_STATUS_INVALID_ARGUMENT;                     \
+  }
+
+
+extern "C" {
+
+int lilcom_compress_int(int type, const void *data, int num_axes,
+                        const int64_t *dims, const int64_t *strides,
+                        const int *regression_coeffs, int flags,
+                        void *out, size_t out_capacity, size_t *out_size) {
+  if (!ValidShape(num_axes, dims) ||
+      (flags & ~LILCOM_FLAG_ARITHMETIC_CODING) != 0)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  if (data == NULL && NumElements(num_axes, dims) > 0)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  try {
+    LILCOM_SWITCH_INT_TYPE(type, CompressIntTyped, data, num_axes, dims,
+                           strides, regression_coeffs, flags, out,
+                           out_capacity, out_size);
+  } catch (const std::exception &) {
+    return LILCOM_STATUS_OUT_OF_MEMORY;
+  }
+}
+
+size_t lilcom_compress_bound(int type, int num_axes, const int64_t *dims,
+                             int flags) {
+  if (!ValidShape(num_axes, dims))
+    return 0;
+  /* The most integers coded per element: the codes of 64-bit types are
+     split into two streams; in sparse mode (which may also be chosen
+     automatically) there are the lengths of the runs as well as the
+     values; and otherwise there may be a table of constant blocks as well
+     as the codes.  Lossless floats and other integers take one each. */
+  int64_t ints_per_element;
+  if (type == LILCOM_TYPE_FLOAT32) {
+    if ((flags & ~LILCOM_C_FLOAT_FLAGS) != 0)
+      return 0;
+    ints_per_element = (flags & LILCOM_FLAG_LOSSLESS ? 1 : 2);
+  } else if (type >= LILCOM_TYPE_INT8 && type <= LILCOM_TYPE_UINT64) {
+    if ((flags & ~LILCOM_FLAG_ARITHMETIC_CODING) != 0)
+      return 0;
+    ints_per_element = (type >= LILCOM_TYPE_INT64 ? 2 : 1);
+  } else {
+    return 0;
+  }
+  int64_t bits_per_element = ints_per_element *
+      (flags & LILCOM_FLAG_ARITHMETIC_CODING ? kMaxBitsPerArithInt :
+       kMaxBitsPerInt);
+  int64_t max_value = std::numeric_limits<int64_t>::max() / 2,
+      num_elements = 1;
+  for (int i = 0; i < num_axes; i++) {
+    if (dims[i] != 0 && num_elements > max_value / dims[i])
+      return 0;
+    num_elements *= dims[i];
+  }
+  if (num_elements > max_value / bits_per_element)
+    return 0;
+  uint64_t ans = LilcomHeaderLen(num_axes) + kMaxFixedBytes +
+      (num_elements * bits_per_element + 7) / 8;
+  if (ans > std::numeric_limits<size_t>::max())
+    return 0;
+  return static_cast<size_t>(ans);
+}
+
+int lilcom_decompress_float(const void *data, size_t num_bytes, float *out,
+                            int num_axes, const int64_t *dims,
+                            const int64_t *strides) {
+  int status = CheckData(data, num_bytes, LILCOM_TYPE_FLOAT32, num_axes, dims);
+  if (status != LILCOM_STATUS_OK)
+    return status;
+  if (out == NULL)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  int64_t contiguous_strides[LILCOM_MAX_AXES];
+  if (strides == NULL) {
+    ContiguousStrides(num_axes, dims, contiguous_strides);
+    strides = contiguous_strides;
+  }
+  try {
+    int ret = DecompressFloat(static_cast<const char*>(data), num_bytes, out,
+                              num_axes, dims, strides);
+    return (ret == 0 ? LILCOM_STATUS_OK : LILCOM_STATUS_INVALID_DATA);
+  } catch (const std::exception &) {
+    return LILCOM_STATUS_OUT_OF_MEMORY;
+  }
+}
+
+int lilcom_decompress_int(const void *data, size_t num_bytes, int type,
+                          void *out, int num_axes, const int64_t *dims,
+                          const int64_t *strides) {
+  if (type == LILCOM_TYPE_FLOAT32)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  int status = CheckData(data, num_bytes, type, num_axes, dims);
+  if (status != LILCOM_STATUS_OK)
+    return status;
+  if (out == NULL)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  try {
+    LILCOM_SWITCH_INT_TYPE(type, DecompressIntTyped, data, num_bytes, out,
+                           num_axes, dims, strides);
+  } catch (const std::exception &) {
+    return LILCOM_STATUS_OUT_OF_MEMORY;
+  }
+}
+
+int lilcom_decompress_quantized(const void *data, size_t num_bytes, int type,
+                                void *out, int num_axes, const int64_t *dims,
+                                const int64_t *strides, int *tick_power) {
+  int status = CheckData(data, num_bytes, LILCOM_TYPE_FLOAT32, num_axes, dims);
+  if (status != LILCOM_STATUS_OK)
+    return status;
+  if (out == NULL)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  try {
+    switch (type) {
+      case LILCOM_TYPE_INT8:
+        return DecompressQuantizedTyped<int8_t>(data, num_bytes, out,
+                                                num_axes, dims, strides,
+                                                tick_power);
+      case LILCOM_TYPE_INT16:
+        return DecompressQuantizedTyped<int16_t>(data, num_bytes, out,
+                                                 num_axes, dims, strides,
+                                                 tick_power);
+      case LILCOM_TYPE_INT32:
+        return DecompressQuantizedTyped<int32_t>(data, num_bytes, out,
+                                                 num_axes, dims, strides,
+                                                 tick_power);
+      default:
+        return LILCOM_STATUS_INVALID_ARGUMENT;
+    }
+  } catch (const std::exception &) {
+    return LILCOM_STATUS_OUT_OF_MEMORY;
+  }
+}
+
+}  // extern "C"
+
+#undef LILCOM_SWITCH_INT_TYPE
+
+
+struct lilcom_encoder {
+  int num_axes;
+  int64_t row_dims[LILCOM_MAX_AXES];  /* row_dims[0] is unused */
+  int regression_coeffs[LILCOM_MAX_AXES];
+  int tick_power;
+  int flags;
+  int significant_bits;
+  int64_t row_size;  /* The number of elements in each row */
+  std::vector<float> rows;
+  /* The output, once lilcom_encoder_finish() has compressed the rows. */
+  std::vector<char> code;
+};
+
+
+extern "C" {
+
+lilcom_encoder *lilcom_encoder_create(int num_axes, const int64_t *row_dims,
+                                      const int *regression_coeffs,
+                                      int tick_power, int flags,
+                                      int significant_bits) {
+  if (num_axes < 1 || num_axes > LILCOM_MAX_AXES ||
+      (num_axes > 1 && row_dims == NULL) ||
+      tick_power < -20 || tick_power > 20 ||
+      (flags & ~LILCOM_C_FLOAT_FLAGS) != 0)
+    return NULL;
+  lilcom_encoder *encoder = new (std::nothrow) lilcom_encoder;
+  if (encoder == NULL)
+    return NULL;
+  encoder->num_axes = num_axes;
+  encoder->row_dims[0] = 0;
+  encoder->row_size = 1;
+  for (int i = 1; i < num_axes; i++) {
+    if (row_dims[i - 1] < 1) {
+      delete encoder;
+      return NULL;
+    }
+    encoder->row_dims[i] = row_dims[i - 1];
+    encoder->row_size *= row_dims[i - 1];
+  }
+  for (int i = 0; i < num_axes; i++) {
+    int coeff = (regression_coeffs != NULL ? regression_coeffs[i] : 0);
+    if (coeff < -256 || coeff > 256) {
+      delete encoder;
+      return NULL;
+    }
+    encoder->regression_coeffs[i] = coeff;
+  }
+  encoder->tick_power = tick_power;
+  encoder->flags = flags;
+  encoder->significant_bits = significant_bits;
+  return encoder;
+}
+
+int lilcom_encoder_write(lilcom_encoder *encoder, const float *rows,
+                         int64_t num_rows) {
+  if (encoder == NULL || num_rows < 0 || (rows == NULL && num_rows > 0) ||
+      !encoder->code.empty())
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  try {
+    encoder->rows.insert(encoder->rows.end(), rows,
+                         rows + num_rows * encoder->row_size);
+  } catch (const std::exception &) {
+    return LILCOM_STATUS_OUT_OF_MEMORY;
+  }
+  return LILCOM_STATUS_OK;
+}
+
+int lilcom_encoder_finish(lilcom_encoder *encoder, void *out,
+                          size_t out_capacity, size_t *out_size) {
+  if (encoder == NULL)
+    return LILCOM_STATUS_INVALID_ARGUMENT;
+  if (encoder->code.empty()) {
+    int64_t dims[LILCOM_MAX_AXES], strides[LILCOM_MAX_AXES];
+    memcpy(dims, encoder->row_dims, sizeof(dims));
+    dims[0] = encoder->rows.size() / encoder->row_size;
+    ContiguousStrides(encoder->num_axes, dims, strides);
+    try {
+      /* CompressFloat() changes `rows`, which is no longer needed. */
+      encoder->code = CompressFloat(
+          encoder->tick_power,
+          (encoder->rows.empty() ? NULL : &(encoder->rows[0])),
+          encoder->num_axes, dims,
+          strides, encoder->regression_coeffs, encoder->flags,
+          encoder->significant_bits);
+    } catch (const std::exception &) {
+      return LILCOM_STATUS_OUT_OF_MEMORY;
+    }
+    if (encoder->code.empty())
+      return LILCOM_STATUS_INVALID_ARGUMENT;
+    std::vector<float>().swap(encoder->rows);
+  }
+  return CopyOutput(encoder->code, out, out_capacity, out_size);
+}
+
+void lilcom_encoder_destroy(lilcom_encoder *encoder) {
+  delete encoder;
+}
+
+}  // extern "C"
@@ -0,0 +1,233 @@
+#ifndef __LILCOM__LILCOM_C_H_
+#define __LILCOM__LILCOM_C_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+   The plain-C interface to lilcom, for programs that are not in Python
+   (it is part of liblilcom; see CMakeLists.txt).  It wraps the C++
+   interface in compression.h, and produces and reads the same data as the
+   Python module.
+
+   All the functions return one of the LILCOM_STATUS_ values below (0 on
+   success), except where stated otherwise; they never throw exceptions
+   (though, like the rest of the library, they may print a message to
+   stderr for invalid data).  Output goes into buffers provided by the
+   caller.  When compressing, the size of the output is not known in
+   advance: if the buffer is too small the functions return
+   LILCOM_STATUS_BUFFER_TOO_SMALL and set *out_size to the size needed, so
+   the caller can try again with a larger buffer.  Alternatively, a buffer
+   of size lilcom_compress_bound() is always large enough.
+
+   The interface is versioned: LILCOM_C_API_VERSION is increased whenever
+   it changes incompatibly (which is also when the SOVERSION of liblilcom
+   changes), and lilcom_api_version() returns the version the library was
+   built with.
+ */
+
+#define LILCOM_C_API_VERSION 1
+
+/* The status codes returned by the functions below. */
+#define LILCOM_STATUS_OK 0
+#define LILCOM_STATUS_INVALID_ARGUMENT 1  /* e.g. num_axes out of range */
+#define LILCOM_STATUS_BUFFER_TOO_SMALL 2  /* *out_size is the size needed */
+#define LILCOM_STATUS_INVALID_DATA 3      /* not valid lilcom data */
+#define LILCOM_STATUS_WRONG_TYPE 4        /* the data is of another type */
+#define LILCOM_STATUS_SHAPE_MISMATCH 5    /* dims don't match the data */
+#define LILCOM_STATUS_OUT_OF_MEMORY 6
+#define LILCOM_STATUS_NOT_EXACT 7         /* see lilcom_decompress_quantized() */
+#define LILCOM_STATUS_OUT_OF_RANGE 8      /* see lilcom_decompress_quantized() */
+
+/* The maximum number of axes of an array. */
+#define LILCOM_MAX_AXES 16
+
+/* The flags and element types; these are the same as in compression.h,
+   which documents them. */
+#define LILCOM_FLAG_ARITHMETIC_CODING 1
+#define LILCOM_FLAG_SPARSE 2
+#define LILCOM_FLAG_LOSSLESS 8
+#define LILCOM_FLAG_ADAPTIVE 32
+
+#define LILCOM_TYPE_FLOAT32 0
+#define LILCOM_TYPE_INT8 1
+#define LILCOM_TYPE_UINT8 2
+#define LILCOM_TYPE_INT16 3
+#define LILCOM_TYPE_UINT16 4
+#define LILCOM_TYPE_INT32 5
+#define LILCOM_TYPE_UINT32 6
+#define LILCOM_TYPE_INT64 7
+#define LILCOM_TYPE_UINT64 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns LILCOM_C_API_VERSION as it was when the library was built. */
+int lilcom_api_version(void);
+
+/* Returns a description of a LILCOM_STATUS_ value, e.g. for error
+   messages; never returns NULL. */
+const char *lilcom_strerror(int status);
+
+
+/*
+  Gets the shape of the array that was compressed, by reading the header.
+     @param [in] data  The compressed data
+     @param [in] num_bytes  The size of the compressed data
+     @param [out] num_axes  Will be set to the number of axes of the array
+     @param [out] dims  An array of size at least LILCOM_MAX_AXES; the
+                   first *num_axes elements will be set to the dims of the
+                   array.
+ */
+int lilcom_get_shape(const void *data, size_t num_bytes,
+                     int *num_axes, int64_t *dims);
+
+/* Sets *type to the element type of the array that was compressed (one of
+   the LILCOM_TYPE_ values). */
+int lilcom_get_type(const void *data, size_t num_bytes, int *type);
+
+
+/*
+  Compresses an array of floats (see CompressFloat() in compression.h).
+     @param [in] data  The array to compress; it is not changed.
+     @param [in] num_axes  The number of axes, in [1, LILCOM_MAX_AXES]
+     @param [in] dims  The dim of each axis
+     @param [in] strides  The stride of each axis, in elements; may be NULL
+                   if the array is contiguous (in C order).
+     @param [in] regression_coeffs  The regression coefficient of each
+                   axis, in [-256, 256] (256 means 1.0); may be NULL for no
+                   regression.
+     @param [in] tick_power  Determines the accuracy: the values are
+                   compressed to multiples of 2^tick_power; in [-20, 20].
+     @param [in] flags  Some of LILCOM_FLAG_ARITHMETIC_CODING,
+                   LILCOM_FLAG_SPARSE, LILCOM_FLAG_LOSSLESS and
+                   LILCOM_FLAG_ADAPTIVE, or 0.
+     @param [in] significant_bits  Only used with LILCOM_FLAG_ADAPTIVE, in
+                   which case it must be in [3, 31].
+     @param [out] out  The buffer to write the compressed data to
+     @param [in] out_capacity  The size of `out` in bytes
+     @param [out] out_size  Will be set to the size of the compressed data
+                   (if the return value is LILCOM_STATUS_OK or
+                   LILCOM_STATUS_BUFFER_TOO_SMALL).
+ */
+int lilcom_compress_float(const float *data, int num_axes,
+                          const int64_t *dims, const int64_t *strides,
+                          const int *regression_coeffs, int tick_power,
+                          int flags, int significant_bits,
+                          void *out, size_t out_capacity, size_t *out_size);
+
+/*
+  Compresses an array of integers losslessly (see CompressInt() in
+  compression.h).  `type` is one of the LILCOM_TYPE_ values other than
+  LILCOM_TYPE_FLOAT32, and gives the element type of `data`; `flags` may
+  be LILCOM_FLAG_ARITHMETIC_CODING or 0.  The other args are as for
+  lilcom_compress_float().
+ */
+int lilcom_compress_int(int type, const void *data, int num_axes,
+                        const int64_t *dims, const int64_t *strides,
+                        const int *regression_coeffs, int flags,
+                        void *out, size_t out_capacity, size_t *out_size);
+
+/*
+  Returns an upper bound on the size of the compressed data that
+  lilcom_compress_float() (if `type` is LILCOM_TYPE_FLOAT32) or
+  lilcom_compress_int() can produce for an array of element type `type`
+  and shape (num_axes, dims) with flags `flags`, whatever the values of the
+  elements; the same bound holds for lilcom_encoder_finish().  It is not a
+  tight bound, as it allows for the worst case of each way of coding.
+  Returns 0 if the args are invalid or the bound does not fit in a size_t.
+ */
+size_t lilcom_compress_bound(int type, int num_axes, const int64_t *dims,
+                             int flags);
+
+/*
+  Decompresses data that was compressed from an array of floats.
+     @param [in] data  The compressed data
+     @param [in] num_bytes  The size of the compressed data
+     @param [out] out  The array to write to
+     @param [in] num_axes, dims  The shape of `out`, which must match that
+                   of the data (see lilcom_get_shape()).
+     @param [in] strides  The stride of each axis of `out`, in elements;
+                   may be NULL if it is contiguous.
+ */
+int lilcom_decompress_float(const void *data, size_t num_bytes, float *out,
+                            int num_axes, const int64_t *dims,
+                            const int64_t *strides);
+
+/*
+  Decompresses data that was compressed from an array of integers.  `type`
+  is the element type of `out`, which must be the type of the data (see
+  lilcom_get_type()); the other args are as for lilcom_decompress_float().
+ */
+int lilcom_decompress_int(const void *data, size_t num_bytes, int type,
+                          void *out, int num_axes, const int64_t *dims,
+                          const int64_t *strides);
+
+/*
+  Decompresses data that was compressed from an array of floats to
+  integers in units of the tick, i.e. to the values that
+  lilcom_decompress_float() would give divided by 2^tick_power (see
+  DecompressQuantized() in compression.h).  `type` is the element type of
+  `out`: LILCOM_TYPE_INT8, LILCOM_TYPE_INT16 or LILCOM_TYPE_INT32.
+  *tick_power is set to the tick_power of the data (it may be NULL).  The
+  other args are as for lilcom_decompress_float().
+
+  This is only possible if the data was compressed with regression
+  coefficients of 0 or 256 (or -256) and without LILCOM_FLAG_LOSSLESS;
+  otherwise it returns LILCOM_STATUS_NOT_EXACT (having set *tick_power).
+  If a value does not fit in `type` it returns LILCOM_STATUS_OUT_OF_RANGE.
+ */
+int lilcom_decompress_quantized(const void *data, size_t num_bytes, int type,
+                                void *out, int num_axes, const int64_t *dims,
+                                const int64_t *strides, int *tick_power);
+
+
+/*
+  An encoder compresses an array of floats that is given to it a few rows
+  (i.e. indexes on axis 0) at a time, for when the number of rows is not
+  known in advance.
+
+  Note: this does not compress incrementally.  The rows are kept in memory
+  (as floats) until lilcom_encoder_finish() compresses them all at once,
+  because nothing can be written before all the rows are known: the header
+  contains the dims, and the table of constant blocks and the choice of
+  sparse mode come before the codes and depend on all of them.  For the
+  same reason there is no incremental decoder; use lilcom_get_shape() and
+  lilcom_decompress_float() on the whole of the data.
+ */
+typedef struct lilcom_encoder lilcom_encoder;
+
+/*
+  Creates an encoder.  `row_dims` are the dims of axes 1 ... num_axes - 1,
+  i.e. of each row (it may be NULL if num_axes is 1); `regression_coeffs`
+  (of size num_axes) and the other args are as for lilcom_compress_float().
+  Returns NULL if the args were invalid or there was not enough memory.
+ */
+lilcom_encoder *lilcom_encoder_create(int num_axes, const int64_t *row_dims,
+                                      const int *regression_coeffs,
+                                      int tick_power, int flags,
+                                      int significant_bits);
+
+/* Appends `num_rows` rows, stored contiguously at `rows`. */
+int lilcom_encoder_write(lilcom_encoder *encoder, const float *rows,
+                         int64_t num_rows);
+
+/*
+  Compresses the rows written so far (which may be none), as one array,
+  into `out`; the args are as for lilcom_compress_float().  If it returns
+  LILCOM_STATUS_BUFFER_TOO_SMALL it may be called again (without
+  compressing the data again); after it has returned LILCOM_STATUS_OK the
+  encoder may only be destroyed.
+ */
+int lilcom_encoder_finish(lilcom_encoder *encoder, void *out,
+                          size_t out_capacity, size_t *out_size);
+
+/* Frees the encoder; does nothing if it is NULL. */
+void lilcom_encoder_destroy(lilcom_encoder *encoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LILCOM__LILCOM_C_H_ */
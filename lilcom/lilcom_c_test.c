@@ -0,0 +1,273 @@
+/* Test of the plain-C interface in lilcom_c.h; this is C, not C++. */
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lilcom_c.h"
+
+
+#define ROWS 200
+#define COLS 30
+
+
+void lilcom_c_test_float(void) {
+  static float a[ROWS][COLS], b[ROWS][COLS];
+  int64_t dims[2] = { ROWS, COLS };
+  int regression_coeffs[2] = { 0, 0 };
+  int i, j, num_axes, type;
+  int64_t shape[LILCOM_MAX_AXES];
+  size_t size, size2;
+  char *code;
+  for (i = 0; i < ROWS; i++)
+    for (j = 0; j < COLS; j++)
+      a[i][j] = sin(i * 0.1) + cos(j * 0.3) + (rand() % 100) * 0.001;
+
+  /* Find the size by giving no buffer, then compress. */
+  assert(lilcom_compress_float(&a[0][0], 2, dims, NULL, regression_coeffs,
+                               -8, 0, 0, NULL, 0, &size) ==
+         LILCOM_STATUS_BUFFER_TOO_SMALL);
+  code = malloc(size);
+  assert(lilcom_compress_float(&a[0][0], 2, dims, NULL, regression_coeffs,
+                               -8, 0, 0, code, size, &size2) ==
+         LILCOM_STATUS_OK);
+  assert(size2 == size);
+
+  assert(lilcom_get_shape(code, size, &num_axes, shape) == LILCOM_STATUS_OK);
+  assert(num_axes == 2 && shape[0] == ROWS && shape[1] == COLS);
+  assert(lilcom_get_type(code, size, &type) == LILCOM_STATUS_OK);
+  assert(type == LILCOM_TYPE_FLOAT32);
+
+  assert(lilcom_decompress_float(code, size, &b[0][0], 2, dims, NULL) ==
+         LILCOM_STATUS_OK);
+  for (i = 0; i < ROWS; i++)
+    for (j = 0; j < COLS; j++)
+      assert(fabs(a[i][j] - b[i][j]) <= pow(2.0, -9) + 1.0e-05);
+
+  /* Errors. */
+  dims[0] = ROWS + 1;
+  assert(lilcom_decompress_float(code, size, &b[0][0], 2, dims, NULL) ==
+         LILCOM_STATUS_SHAPE_MISMATCH);
+  dims[0] = ROWS;
+  assert(lilcom_decompress_float(code, size - 1, &b[0][0], 2, dims, NULL) ==
+         LILCOM_STATUS_INVALID_DATA);
+  assert(lilcom_decompress_int(code, size, LILCOM_TYPE_INT16, &b[0][0], 2,
+                               dims, NULL) == LILCOM_STATUS_WRONG_TYPE);
+  assert(lilcom_compress_float(&a[0][0], 2, dims, NULL, NULL, -8, 1024, 0,
+                               code, size, &size2) ==
+         LILCOM_STATUS_INVALID_ARGUMENT);
+  regression_coeffs[1] = 300;
+  assert(lilcom_compress_float(&a[0][0], 2, dims, NULL, regression_coeffs,
+                               -8, 0, 0, code, size, &size2) ==
+         LILCOM_STATUS_INVALID_ARGUMENT);
+  regression_coeffs[1] = 0;
+  assert(strcmp(lilcom_strerror(LILCOM_STATUS_OK), "success") == 0);
+
+  /* Lossless, with strides: compress the transpose. */
+  {
+    int64_t t_dims[2] = { COLS, ROWS }, t_strides[2] = { 1, COLS };
+    static float t[COLS][ROWS];
+    size_t t_size;
+    char *t_code;
+    lilcom_compress_float(&a[0][0], 2, t_dims, t_strides, NULL, 0,
+                          LILCOM_FLAG_LOSSLESS, 0, NULL, 0, &t_size);
+    t_code = malloc(t_size);
+    assert(lilcom_compress_float(&a[0][0], 2, t_dims, t_strides, NULL, 0,
+                                 LILCOM_FLAG_LOSSLESS, 0, t_code, t_size,
+                                 &t_size) == LILCOM_STATUS_OK);
+    assert(lilcom_decompress_float(t_code, t_size, &t[0][0], 2, t_dims,
+                                   NULL) == LILCOM_STATUS_OK);
+    for (i = 0; i < ROWS; i++)
+      for (j = 0; j < COLS; j++)
+        assert(t[j][i] == a[i][j]);
+    free(t_code);
+  }
+  free(code);
+}
+
+void lilcom_c_test_int(void) {
+  int16_t a[1000], b[1000];
+  int64_t dims[1] = { 1000 };
+  int regression_coeffs[1] = { 256 };
+  char code[4000];
+  size_t size;
+  int i;
+  for (i = 0; i < 1000; i++)
+    a[i] = (int16_t)(i * 7 - 3000 + rand() % 10);
+  assert(lilcom_compress_int(LILCOM_TYPE_INT16, a, 1, dims, NULL,
+                             regression_coeffs, 0, code, sizeof(code),
+                             &size) == LILCOM_STATUS_OK);
+  assert(lilcom_decompress_int(code, size, LILCOM_TYPE_INT16, b, 1, dims,
+                               NULL) == LILCOM_STATUS_OK);
+  assert(memcmp(a, b, sizeof(a)) == 0);
+  assert(lilcom_decompress_int(code, size, LILCOM_TYPE_INT32, b, 1, dims,
+                               NULL) == LILCOM_STATUS_WRONG_TYPE);
+}
+
+void lilcom_c_test_quantized(void) {
+  float a[1000];
+  int16_t q[1000];
+  int8_t q8[1000];
+  int64_t dims[1] = { 1000 };
+  int regression_coeffs[1] = { 256 }, tick_power;
+  char code[4000];
+  size_t size;
+  int i;
+  for (i = 0; i < 1000; i++)
+    a[i] = sin(i * 0.01) * 10.0 + (rand() % 100) * 0.01;
+  assert(lilcom_compress_float(a, 1, dims, NULL, regression_coeffs, -6, 0, 0,
+                               code, sizeof(code), &size) ==
+         LILCOM_STATUS_OK);
+  assert(lilcom_decompress_quantized(code, size, LILCOM_TYPE_INT16, q, 1,
+                                     dims, NULL, &tick_power) ==
+         LILCOM_STATUS_OK);
+  assert(tick_power == -6);
+  for (i = 0; i < 1000; i++)
+    assert(fabs(q[i] * pow(2.0, -6) - a[i]) <= pow(2.0, -7) + 1.0e-05);
+  /* +-11 is out of the range of int8 in units of 2^-6. */
+  assert(lilcom_decompress_quantized(code, size, LILCOM_TYPE_INT8, q8, 1,
+                                     dims, NULL, NULL) ==
+         LILCOM_STATUS_OUT_OF_RANGE);
+  assert(lilcom_decompress_quantized(code, size, LILCOM_TYPE_UINT16, q, 1,
+                                     dims, NULL, NULL) ==
+         LILCOM_STATUS_INVALID_ARGUMENT);
+
+  /* A coefficient of 0.5 gives values that are not multiples of the tick. */
+  regression_coeffs[0] = 128;
+  assert(lilcom_compress_float(a, 1, dims, NULL, regression_coeffs, -6, 0, 0,
+                               code, sizeof(code), &size) ==
+         LILCOM_STATUS_OK);
+  assert(lilcom_decompress_quantized(code, size, LILCOM_TYPE_INT16, q, 1,
+                                     dims, NULL, &tick_power) ==
+         LILCOM_STATUS_NOT_EXACT);
+}
+
+void lilcom_c_test_encoder(void) {
+  float rows[10 * 4], b[50][4];
+  int64_t row_dims[1] = { 4 }, dims[2] = { 50, 4 };
+  int coeffs[2] = { 0, 0 };
+  char code[2000];
+  size_t size;
+  int i, j, k;
+  lilcom_encoder *encoder = lilcom_encoder_create(2, row_dims, NULL, -10,
+                                                  LILCOM_FLAG_ARITHMETIC_CODING,
+                                                  0);
+  assert(encoder != NULL);
+  for (i = 0; i < 5; i++) {
+    for (k = 0; k < 10 * 4; k++)
+      rows[k] = (i * 40 + k) * 0.01;
+    assert(lilcom_encoder_write(encoder, rows, 10) == LILCOM_STATUS_OK);
+  }
+  assert(lilcom_encoder_finish(encoder, code, 10, &size) ==
+         LILCOM_STATUS_BUFFER_TOO_SMALL);
+  assert(size > 10 && size <= sizeof(code));
+  assert(lilcom_encoder_finish(encoder, code, sizeof(code), &size) ==
+         LILCOM_STATUS_OK);
+  lilcom_encoder_destroy(encoder);
+
+  assert(lilcom_decompress_float(code, size, &b[0][0], 2, dims, NULL) ==
+         LILCOM_STATUS_OK);
+  for (i = 0; i < 50; i++)
+    for (j = 0; j < 4; j++)
+      assert(fabs(b[i][j] - (i * 4 + j) * 0.01) <= pow(2.0, -11) + 1.0e-05);
+
+  assert(lilcom_encoder_create(0, row_dims, NULL, -10, 0, 0) == NULL);
+  coeffs[1] = -257;
+  assert(lilcom_encoder_create(2, row_dims, coeffs, -10, 0, 0) == NULL);
+
+  /* An encoder with no rows gives an empty array. */
+  encoder = lilcom_encoder_create(2, row_dims, NULL, -10, 0, 0);
+  assert(encoder != NULL);
+  assert(lilcom_encoder_finish(encoder, code, sizeof(code), &size) ==
+         LILCOM_STATUS_OK);
+  lilcom_encoder_destroy(encoder);
+  dims[0] = 0;
+  assert(size <= lilcom_compress_bound(LILCOM_TYPE_FLOAT32, 2, dims, 0));
+  assert(lilcom_decompress_float(code, size, &b[0][0], 2, dims, NULL) ==
+         LILCOM_STATUS_OK);
+}
+
+#define BOUND_SIZE 5000
+
+/* Returns a random 32-bit pattern. */
+static uint32_t lilcom_c_test_rand32(void) {
+  return ((uint32_t)rand() << 20) ^ ((uint32_t)rand() << 10) ^
+      (uint32_t)rand();
+}
+
+void lilcom_c_test_bound(void) {
+  static float a[BOUND_SIZE];
+  static int64_t b[BOUND_SIZE];
+  static char code[BOUND_SIZE * 32];
+  int64_t dims[1] = { BOUND_SIZE }, empty_dims[2] = { 3, 0 };
+  size_t size;
+  int i, arith;
+  uint32_t bits;
+  for (arith = 0; arith <= LILCOM_FLAG_ARITHMETIC_CODING; arith++) {
+    /* Random bit patterns, which are the worst case for lossless mode. */
+    for (i = 0; i < BOUND_SIZE; i++) {
+      do {
+        bits = lilcom_c_test_rand32();
+        memcpy(&a[i], &bits, sizeof(float));
+      } while (a[i] != a[i]);  /* no NaNs */
+    }
+    assert(lilcom_compress_float(a, 1, dims, NULL, NULL, 0,
+                                 LILCOM_FLAG_LOSSLESS | arith, 0, code,
+                                 sizeof(code), &size) == LILCOM_STATUS_OK);
+    assert(size <= lilcom_compress_bound(LILCOM_TYPE_FLOAT32, 1, dims,
+                                         LILCOM_FLAG_LOSSLESS | arith));
+
+    /* Zeros alternating with codes of all sizes, the worst case for sparse
+       mode. */
+    for (i = 0; i < BOUND_SIZE; i++)
+      a[i] = (i % 2 ? 0.0 : (lilcom_c_test_rand32() % 2000001) - 1000000.0);
+    assert(lilcom_compress_float(a, 1, dims, NULL, NULL, -11,
+                                 LILCOM_FLAG_SPARSE | arith, 0, code,
+                                 sizeof(code), &size) == LILCOM_STATUS_OK);
+    assert(size <= lilcom_compress_bound(LILCOM_TYPE_FLOAT32, 1, dims,
+                                         LILCOM_FLAG_SPARSE | arith));
+    assert(lilcom_compress_float(a, 1, dims, NULL, NULL, -11, arith, 0, code,
+                                 sizeof(code), &size) == LILCOM_STATUS_OK);
+    assert(size <= lilcom_compress_bound(LILCOM_TYPE_FLOAT32, 1, dims,
+                                         arith));
+
+    for (i = 0; i < BOUND_SIZE; i++)
+      b[i] = (int64_t)(((uint64_t)lilcom_c_test_rand32() << 32) |
+                       lilcom_c_test_rand32());
+    assert(lilcom_compress_int(LILCOM_TYPE_INT64, b, 1, dims, NULL, NULL,
+                               arith, code, sizeof(code), &size) ==
+           LILCOM_STATUS_OK);
+    assert(size <= lilcom_compress_bound(LILCOM_TYPE_INT64, 1, dims, arith));
+  }
+
+  /* Empty arrays need no data. */
+  assert(lilcom_compress_float(NULL, 2, empty_dims, NULL, NULL, -8, 0, 0,
+                               code, sizeof(code), &size) ==
+         LILCOM_STATUS_OK);
+  assert(size <= lilcom_compress_bound(LILCOM_TYPE_FLOAT32, 2, empty_dims,
+                                       0));
+  assert(lilcom_compress_int(LILCOM_TYPE_INT16, NULL, 2, empty_dims, NULL,
+                             NULL, 0, code, sizeof(code), &size) ==
+         LILCOM_STATUS_OK);
+  assert(size <= lilcom_compress_bound(LILCOM_TYPE_INT16, 2, empty_dims, 0));
+  assert(lilcom_compress_float(NULL, 1, dims, NULL, NULL, -8, 0, 0,
+                               code, sizeof(code), &size) ==
+         LILCOM_STATUS_INVALID_ARGUMENT);
+
+  assert(lilcom_compress_bound(LILCOM_TYPE_INT16, 1, dims,
+                               LILCOM_FLAG_SPARSE) == 0);
+  assert(lilcom_compress_bound(LILCOM_TYPE_UINT64 + 1, 1, dims, 0) == 0);
+  dims[0] = (int64_t)1 << 62;
+  assert(lilcom_compress_bound(LILCOM_TYPE_FLOAT32, 1, dims, 0) == 0);
+}
+
+int main(void) {
+  assert(lilcom_api_version() == LILCOM_C_API_VERSION);
+  lilcom_c_test_float();
+  lilcom_c_test_int();
+  lilcom_c_test_quantized();
+  lilcom_c_test_encoder();
+  lilcom_c_test_bound();
+  printf("Done\n");
+  return 0;
+}
@@ -7,13 +7,334 @@
 #include "numpy/arrayobject.h"
 #include <string.h>  // for memcpy
 
-#define LILCOM_FORMAT_VERSION 0
-#define LILCOM_HEADER_LEN 2  // Must not be changed.  Header is 'L' then
-                             // LILCOM_FORMAT_VERSION.
-
-/* The core library */
+/* The core library.  This also defines LILCOM_FORMAT_VERSION,
+   LILCOM_HEADER_LEN (the data starts with 'L' then the format version) and
+   struct LilcomHeader. */
 #include "compression.h"
+#include "batch.h"
 #include <cstring>  // for memcpy
+#include <exception>
+
+/* The core library may throw std::bad_alloc, or std::length_error if a
+   size read from corrupted data is too large for a std::vector; the
+   functions below catch std::exception and raise MemoryError for both. */
+
+
+/*
+  Returns the LILCOM_TYPE_ value (see compression.h) corresponding to the
+  dtype of the NumPy array `a`, or -1 if it is not a supported type or is
+  not in native byte order.
+ */
+static int lilcom_array_type(PyArrayObject *a) {
+  if (!PyArray_ISNOTSWAPPED(a))
+    return -1;
+  char kind = PyArray_DESCR(a)->kind;
+  int size = PyArray_ITEMSIZE(a);
+  if (kind == 'f' && size == 4)
+    return LILCOM_TYPE_FLOAT32;
+  if (kind != 'i' && kind != 'u')
+    return -1;
+  int is_unsigned = (kind == 'u');
+  switch (size) {
+    case 1: return LILCOM_TYPE_INT8 + is_unsigned;
+    case 2: return LILCOM_TYPE_INT16 + is_unsigned;
+    case 4: return LILCOM_TYPE_INT32 + is_unsigned;
+    case 8: return LILCOM_TYPE_INT64 + is_unsigned;
+    default: return -1;
+  }
+}
+
+/*
+  Releases the GIL for as long as it exists (even if an exception is
+  thrown), so that other Python threads can run while we do the codec
+  work, which does not touch Python objects.  The buffers that the codec
+  reads and writes must be kept alive by the caller (e.g. by holding a
+  Py_buffer or a reference to the array) while the GIL is released.
+ */
+class LilcomReleaseGil {
+ public:
+  LilcomReleaseGil(): state_(PyEval_SaveThread()) { }
+  ~LilcomReleaseGil() { PyEval_RestoreThread(state_); }
+ private:
+  PyThreadState *state_;
+};
+
+/*
+  The memory used by compress_float() and decompress_float() (see
+  codec_context.h), kept from one call to the next in each thread, so that
+  repeated calls on arrays of similar size do not allocate it again.  So
+  that one large array does not leave a thread holding a lot of memory,
+  lilcom_trim_context() frees any of it over LILCOM_MAX_CONTEXT_BYTES after
+  each call.
+ */
+static thread_local CompressionContext lilcom_compression_context;
+static thread_local DecompressionContext lilcom_decompression_context;
+#define LILCOM_MAX_CONTEXT_BYTES (16 << 20)
+
+template <class T>
+static void lilcom_trim_vector(std::vector<T> *v) {
+  if (v->capacity() * sizeof(T) > LILCOM_MAX_CONTEXT_BYTES)
+    std::vector<T>().swap(*v);
+}
+static void lilcom_trim_context(CompressionContext *context) {
+  lilcom_trim_vector(&(context->output));
+  lilcom_trim_vector(&(context->nonzeros));
+  lilcom_trim_vector(&(context->block_starts));
+  lilcom_trim_vector(&(context->block_lengths));
+  lilcom_trim_vector(&(context->block_codes));
+  lilcom_trim_vector(&(context->copy));
+}
+static void lilcom_trim_context(DecompressionContext *context) {
+  lilcom_trim_vector(&(context->block_starts));
+  lilcom_trim_vector(&(context->block_lengths));
+  lilcom_trim_vector(&(context->block_codes));
+}
+
+/*
+  Gets the dims and strides (in elements) of the NumPy array `a`, whose
+  elements are of type T; returns false if a stride was not a multiple of
+  the element size.
+ */
+template <class T>
+static bool lilcom_get_dims_and_strides(PyArrayObject *a, int64_t *dims,
+                                        int64_t *strides) {
+  for (int i = 0; i < PyArray_NDIM(a); i++) {
+    dims[i] = PyArray_DIM(a, i);
+    if (PyArray_STRIDE(a, i) % (npy_intp)sizeof(T) != 0)
+      return false;
+    strides[i] = PyArray_STRIDE(a, i) / (npy_intp)sizeof(T);
+  }
+  return true;
+}
+
+/*
+  Implementation of compress_int() for element type T; see its
+  documentation.
+ */
+template <class T>
+static PyObject *compress_int_typed(PyArrayObject *input,
+                                    const int *regression_coeffs,
+                                    int flags) {
+  int64_t dims[16], strides[16];
+  if (!lilcom_get_dims_and_strides<T>(input, dims, strides))
+    Py_RETURN_NONE;
+  try {
+    std::vector<char> ans;
+    {
+      LilcomReleaseGil release_gil;
+      ans = CompressInt((const T*)PyArray_DATA(input), PyArray_NDIM(input),
+                        dims, strides, regression_coeffs, flags);
+    }
+    if (ans.empty())
+      Py_RETURN_NONE;
+    return PyBytes_FromStringAndSize(&(ans[0]), ans.size());
+  } catch (const std::exception &) {
+    PyErr_SetString(PyExc_MemoryError,
+                    "Failure to allocate memory in lilcom compression");
+    return NULL;
+  }
+}
+
+/*
+  Implementation of compress_int_adaptive() for element type T; see its
+  documentation.
+ */
+template <class T>
+static PyObject *compress_int_adaptive_typed(PyArrayObject *input,
+                                             const int *regression_coeffs,
+                                             int sample_bits,
+                                             int significant_bits) {
+  int64_t dims[16], strides[16];
+  if (!lilcom_get_dims_and_strides<T>(input, dims, strides))
+    Py_RETURN_NONE;
+  try {
+    std::vector<char> ans;
+    {
+      LilcomReleaseGil release_gil;
+      ans = CompressIntAdaptive((const T*)PyArray_DATA(input),
+                                PyArray_NDIM(input), dims, strides,
+                                regression_coeffs, sample_bits,
+                                significant_bits);
+    }
+    if (ans.empty())
+      Py_RETURN_NONE;
+    return PyBytes_FromStringAndSize(&(ans[0]), ans.size());
+  } catch (const std::exception &) {
+    PyErr_SetString(PyExc_MemoryError,
+                    "Failure to allocate memory in lilcom compression");
+    return NULL;
+  }
+}
+
+/*
+  Implementation of decompress_int() for element type T; see its
+  documentation.
+ */
+template <class T>
+static PyObject *decompress_int_typed(const char *bytes_array,
+                                      Py_ssize_t length,
+                                      PyArrayObject *output) {
+  int64_t dims[16], strides[16];
+  if (!lilcom_get_dims_and_strides<T>(output, dims, strides))
+    Py_RETURN_NONE;
+  int ans;
+  try {
+    LilcomReleaseGil release_gil;
+    ans = DecompressInt(bytes_array, length, (T*)PyArray_DATA(output),
+                        PyArray_NDIM(output), dims, strides);
+  } catch (const std::exception &) {
+    PyErr_SetString(PyExc_MemoryError,
+                    "Failure to allocate memory in lilcom decompression");
+    return NULL;
+  }
+  return PyLong_FromLong(ans);
+}
+
+/*
+  Implementation of decompress_int(), after getting the data; calls
+  decompress_int_typed() for the element type of `output`.
+ */
+static PyObject *decompress_int_any(const char *bytes_array,
+                                    Py_ssize_t length,
+                                    PyArrayObject *output) {
+  switch (lilcom_array_type(output)) {
+    case LILCOM_TYPE_INT8:
+      return decompress_int_typed<int8_t>(bytes_array, length, output);
+    case LILCOM_TYPE_UINT8:
+      return decompress_int_typed<uint8_t>(bytes_array, length, output);
+    case LILCOM_TYPE_INT16:
+      return decompress_int_typed<int16_t>(bytes_array, length, output);
+    case LILCOM_TYPE_UINT16:
+      return decompress_int_typed<uint16_t>(bytes_array, length, output);
+    case LILCOM_TYPE_INT32:
+      return decompress_int_typed<int32_t>(bytes_array, length, output);
+    case LILCOM_TYPE_UINT32:
+      return decompress_int_typed<uint32_t>(bytes_array, length, output);
+    case LILCOM_TYPE_INT64:
+      return decompress_int_typed<int64_t>(bytes_array, length, output);
+    case LILCOM_TYPE_UINT64:
+      return decompress_int_typed<uint64_t>(bytes_array, length, output);
+    default:
+      Py_RETURN_NONE;
+  }
+}
+
+/*
+  Implementation of decompress_quantized() for element type T; see its
+  documentation.
+ */
+template <class T>
+static PyObject *decompress_quantized_typed(const char *bytes_array,
+                                            Py_ssize_t length,
+                                            PyArrayObject *output) {
+  int64_t dims[16], strides[16];
+  if (!lilcom_get_dims_and_strides<T>(output, dims, strides))
+    Py_RETURN_NONE;
+  int tick_power = 0;
+  int ans;
+  try {
+    LilcomReleaseGil release_gil;
+    ans = DecompressQuantized(bytes_array, length, (T*)PyArray_DATA(output),
+                              PyArray_NDIM(output), dims, strides,
+                              &tick_power);
+  } catch (const std::exception &) {
+    PyErr_SetString(PyExc_MemoryError,
+                    "Failure to allocate memory in lilcom decompression");
+    return NULL;
+  }
+  return Py_BuildValue("(ii)", ans, tick_power);
+}
+
+/*
+  Checks the `stats` arg of compress_float() or decompress_float(), which
+  may be NULL or None (meaning no statistics are wanted) or a dict.  Returns
+  1 if statistics are wanted, 0 if not, or -1 (with an exception set) if the
+  arg was invalid or lilcom was compiled without LILCOM_STATS.
+ */
+static int lilcom_check_stats(PyObject *stats) {
+  if (stats == NULL || stats == Py_None)
+    return 0;
+  if (!PyDict_Check(stats)) {
+    PyErr_SetString(PyExc_TypeError, "Expected stats to be a dict or None");
+    return -1;
+  }
+#ifdef LILCOM_STATS
+  return 1;
+#else
+  PyErr_SetString(PyExc_RuntimeError,
+                  "lilcom was compiled without LILCOM_STATS, so it cannot "
+                  "collect statistics");
+  return -1;
+#endif
+}
+
+/* Sets dict[key] = value; returns false on error. */
+static bool lilcom_set_item(PyObject *dict, const char *key, PyObject *value) {
+  if (value == NULL)
+    return false;
+  int ret = PyDict_SetItemString(dict, key, value);
+  Py_DECREF(value);
+  return ret == 0;
+}
+
+/* Returns a list of the `n` elements of `a` as Python ints, or NULL. */
+static PyObject *lilcom_int_list(const int64_t *a, int n) {
+  PyObject *ans = PyList_New(n);
+  if (ans == NULL)
+    return NULL;
+  for (int i = 0; i < n; i++) {
+    PyObject *x = PyLong_FromLongLong(a[i]);
+    if (x == NULL) {
+      Py_DECREF(ans);
+      return NULL;
+    }
+    PyList_SET_ITEM(ans, i, x);
+  }
+  return ans;
+}
+
+/*
+  Clears the dict `dict` and sets its items to the fields of `stats`, with
+  the same names (see struct CodecStats in codec_stats.h).  Returns false
+  (with an exception set) on error.
+ */
+static bool lilcom_stats_to_dict(const CodecStats &stats, PyObject *dict) {
+  PyDict_Clear(dict);
+  /* zero_run_histogram has 64 elements, but runs of 2^32 or more zeros are
+     rare enough that we only show the first 33. */
+  return lilcom_set_item(dict, "num_bits_histogram",
+                         lilcom_int_list(stats.num_bits_histogram, 33)) &&
+      lilcom_set_item(dict, "num_bits_up",
+                      PyLong_FromLongLong(stats.num_bits_up)) &&
+      lilcom_set_item(dict, "num_bits_down",
+                      PyLong_FromLongLong(stats.num_bits_down)) &&
+      lilcom_set_item(dict, "num_bits_same",
+                      PyLong_FromLongLong(stats.num_bits_same)) &&
+      lilcom_set_item(dict, "num_zero_runs",
+                      PyLong_FromLongLong(stats.num_zero_runs)) &&
+      lilcom_set_item(dict, "num_zeros_in_runs",
+                      PyLong_FromLongLong(stats.num_zeros_in_runs)) &&
+      lilcom_set_item(dict, "zero_run_histogram",
+                      lilcom_int_list(stats.zero_run_histogram, 33)) &&
+      lilcom_set_item(dict, "top_bit_savings",
+                      PyLong_FromLongLong(stats.top_bit_savings)) &&
+      lilcom_set_item(dict, "num_clipped",
+                      PyLong_FromLongLong(stats.num_clipped)) &&
+      lilcom_set_item(dict, "header_bytes",
+                      PyLong_FromLongLong(stats.header_bytes)) &&
+      lilcom_set_item(dict, "meta_bytes",
+                      PyLong_FromLongLong(stats.meta_bytes)) &&
+      lilcom_set_item(dict, "code_bytes",
+                      PyLong_FromLongLong(stats.code_bytes)) &&
+      lilcom_set_item(dict, "analysis_seconds",
+                      PyFloat_FromDouble(stats.analysis_seconds)) &&
+      lilcom_set_item(dict, "encode_seconds",
+                      PyFloat_FromDouble(stats.encode_seconds)) &&
+      lilcom_set_item(dict, "decode_seconds",
+                      PyFloat_FromDouble(stats.decode_seconds)) &&
+      lilcom_set_item(dict, "total_seconds",
+                      PyFloat_FromDouble(stats.total_seconds));
+}
 
 
 extern "C" {
@@ -24,7 +345,7 @@ extern "C" {
    The following will document this function as if it were a native
    Python function.
 
-    def compress_float(input, config):
+    def compress_float(input, meta, flags=0, significant_bits=0, stats=None):
       """
 
       Args:
@@ -43,6 +364,15 @@ extern "C" {
             documentation of `regression_coeffs` arg of
             CompressFloat(), in compression.h, for more details about
             the regression coefficients.
+       flags:  Flags that affect the compression, as defined in
+            compression.h, e.g. LILCOM_FLAG_ARITHMETIC_CODING = 1.
+       significant_bits:  Only used if flags contains
+            LILCOM_FLAG_ADAPTIVE, in which case it must be in [3,31];
+            see CompressFloat() in compression.h.
+       stats:  If a dict, it will be cleared and filled with statistics
+            about the compression (see struct CodecStats in
+            codec_stats.h).  RuntimeError is raised if lilcom was compiled
+            without LILCOM_STATS.
 
 
        Return:
@@ -60,10 +390,18 @@ static PyObject *compress_float(PyObject *self, PyObject *args, PyObject *keywds
   PyObject *meta; // List of python ints containing metadata in the form
                   // [tick_power, coeff1, coeff2.. ]
 
-  static const char *kwlist[] = {"input", "meta", NULL};
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO", (char**)kwlist,
-                                   (PyObject**)&input, &meta))
+  int flags = 0, significant_bits = 0;
+  PyObject *stats_dict = NULL;
+
+  static const char *kwlist[] = {"input", "meta", "flags", "significant_bits",
+                                 "stats", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iiO", (char**)kwlist,
+                                   (PyObject**)&input, &meta, &flags,
+                                   &significant_bits, &stats_dict))
     Py_RETURN_NONE;
+  int want_stats = lilcom_check_stats(stats_dict);
+  if (want_stats < 0)
+    return NULL;
 
   int num_axes = PyArray_NDIM(input),
     list_size = PyList_Size(meta);
@@ -73,35 +411,465 @@ static PyObject *compress_float(PyObject *self, PyObject *args, PyObject *keywds
 
   int tick_power = PyLong_AsLong(PyList_GetItem(meta, 0));
 
-  int dims[16], strides[16];
+  int64_t dims[16], strides[16];
   int regression_coeffs[16];
 
 
   for (int i = 0; i < num_axes; i++) {
     int int_coeff = PyLong_AsLong(PyList_GetItem(meta, i + 1));
-    assert(int_coeff >= -256 && int_coeff <= 256);
+    if (int_coeff < -256 || int_coeff > 256)
+      Py_RETURN_NONE;
     regression_coeffs[i] = int_coeff;
     dims[i] = PyArray_DIM(input, i);
-    strides[i] = PyArray_STRIDE(input, i) / sizeof(float);
+    strides[i] = PyArray_STRIDE(input, i) / (npy_intp)sizeof(float);
   }
 
   float *input_data = (float*)PyArray_DATA(input);
 
+  CompressionContext *context = &lilcom_compression_context;
   try {
-    std::vector<char> ans = CompressFloat(tick_power, input_data,
-					  num_axes, dims, strides,
-					  regression_coeffs);
+    CodecStats stats;
+    {
+      LilcomReleaseGil release_gil;
+      CompressFloat(context, tick_power, input_data, num_axes, dims, strides,
+                    regression_coeffs, flags, significant_bits,
+                    want_stats ? &stats : NULL);
+    }
+    const std::vector<char> &ans = context->output;
+    PyObject *ans_bytes;
     if (ans.empty()) {
       // Something went wrong.  An error message may have been printed.
+      Py_INCREF(Py_None);
+      ans_bytes = Py_None;
+    } else if (want_stats && !lilcom_stats_to_dict(stats, stats_dict)) {
+      ans_bytes = NULL;
+    } else {
+      ans_bytes = PyBytes_FromStringAndSize(&(ans[0]), ans.size());
+    }
+    lilcom_trim_context(context);
+    return ans_bytes;
+  } catch (const std::exception &) {
+    lilcom_trim_context(context);
+    PyErr_SetString(PyExc_MemoryError,
+                    "Failure to allocate memory in lilcom compression");
+    return NULL;
+  }
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def choose_tick_power(input, coeffs, max_bytes, flags=0,
+                          significant_bits=0):
+      """
+
+      Args:
+       input:  A numpy.ndarray with dtype=np.float32 and number of axes
+           in the range [1..15].  It is not modified.
+       coeffs:  A list of integers containing the regression coefficients
+           that will be used for compression, one per axis, in the same
+           format as the elements of `meta` after the first, in
+           compress_float().
+       max_bytes:  The size budget for the return value of
+           compress_float() (which includes the header).
+       flags:  The flags that will be passed to compress_float().
+       significant_bits:  The significant_bits that will be passed to
+           compress_float().
+
+       Return:
+            On success, returns the smallest tick_power in [-20,20] for
+            which the output of compress_float() would be no larger than
+            max_bytes, or 20 if there is no such tick_power.  If one of the
+            args was not right, returns None.
+      """
+ */
+static PyObject *choose_tick_power(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyArrayObject *input;
+  PyObject *coeffs;
+  long long max_bytes;
+  int flags = 0, significant_bits = 0;
+
+  static const char *kwlist[] = {"input", "coeffs", "max_bytes", "flags",
+                                 "significant_bits", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOL|ii", (char**)kwlist,
+                                   (PyObject**)&input, &coeffs, &max_bytes,
+                                   &flags, &significant_bits))
+    Py_RETURN_NONE;
+
+  int num_axes = PyArray_NDIM(input);
+  if (num_axes <= 0 || num_axes >= 16 || PyList_Size(coeffs) != num_axes)
+    Py_RETURN_NONE;
+
+  int64_t dims[16], strides[16];
+  int regression_coeffs[16];
+  for (int i = 0; i < num_axes; i++) {
+    int int_coeff = PyLong_AsLong(PyList_GetItem(coeffs, i));
+    if (int_coeff < -256 || int_coeff > 256)
+      Py_RETURN_NONE;
+    regression_coeffs[i] = int_coeff;
+    dims[i] = PyArray_DIM(input, i);
+    strides[i] = PyArray_STRIDE(input, i) / (npy_intp)sizeof(float);
+  }
+
+  int tick_power;
+  try {
+    bool ok;
+    {
+      LilcomReleaseGil release_gil;
+      ok = ChooseTickPower(max_bytes, (const float*)PyArray_DATA(input),
+                           num_axes, dims, strides, regression_coeffs,
+                           flags, &tick_power, significant_bits);
+    }
+    if (!ok)
       Py_RETURN_NONE;
+  } catch (const std::exception &) {
+    PyErr_SetString(PyExc_MemoryError,
+                    "Failure to allocate memory in lilcom rate control");
+    return NULL;
+  }
+  return PyLong_FromLong(tick_power);
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def compress_int(input, coeffs, flags=0):
+      """
+      Compresses an array of integers losslessly.
+
+      Args:
+       input:  A numpy.ndarray with an integer dtype of 8, 16, 32 or 64
+           bits, signed or unsigned, in native byte order, and number of
+           axes in the range [1..15].  It is not modified.
+       coeffs:  A list of integers containing the regression coefficients,
+           one per axis, each in [-256, 256]; see compress_float().
+       flags:  Flags that affect the compression; only
+           LILCOM_FLAG_ARITHMETIC_CODING is allowed.
+
+       Return:
+            On success, returns the compressed data as a bytes object,
+            which can be decompressed with decompress_int().  On failure
+            or if one of the args was not right, returns None.  On memory
+            allocation failure, raises MemoryError.
+      """
+ */
+static PyObject *compress_int(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyArrayObject *input;
+  PyObject *coeffs;
+  int flags = 0;
+
+  static const char *kwlist[] = {"input", "coeffs", "flags", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|i", (char**)kwlist,
+                                   (PyObject**)&input, &coeffs, &flags))
+    Py_RETURN_NONE;
+
+  int num_axes = PyArray_NDIM(input);
+  if (num_axes <= 0 || num_axes >= 16 || PyList_Size(coeffs) != num_axes)
+    Py_RETURN_NONE;
+  int regression_coeffs[16];
+  for (int i = 0; i < num_axes; i++)
+    regression_coeffs[i] = PyLong_AsLong(PyList_GetItem(coeffs, i));
+
+  switch (lilcom_array_type(input)) {
+    case LILCOM_TYPE_INT8:
+      return compress_int_typed<int8_t>(input, regression_coeffs, flags);
+    case LILCOM_TYPE_UINT8:
+      return compress_int_typed<uint8_t>(input, regression_coeffs, flags);
+    case LILCOM_TYPE_INT16:
+      return compress_int_typed<int16_t>(input, regression_coeffs, flags);
+    case LILCOM_TYPE_UINT16:
+      return compress_int_typed<uint16_t>(input, regression_coeffs, flags);
+    case LILCOM_TYPE_INT32:
+      return compress_int_typed<int32_t>(input, regression_coeffs, flags);
+    case LILCOM_TYPE_UINT32:
+      return compress_int_typed<uint32_t>(input, regression_coeffs, flags);
+    case LILCOM_TYPE_INT64:
+      return compress_int_typed<int64_t>(input, regression_coeffs, flags);
+    case LILCOM_TYPE_UINT64:
+      return compress_int_typed<uint64_t>(input, regression_coeffs, flags);
+    default:
+      Py_RETURN_NONE;
+  }
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def compress_int_adaptive(input, coeffs, sample_bits, significant_bits):
+      """
+      Compresses audio samples lossily with adaptive precision (see
+      CompressIntAdaptive() in compression.h).
+
+      Args:
+       input:  A numpy.ndarray with dtype np.int16 (for 16-bit samples) or
+           np.int32 (for 24-bit or 32-bit samples), in native byte order,
+           and number of axes in the range [1..15].  It is not modified.
+       coeffs:  A list of integers containing the regression coefficients,
+           one per axis, each in [-256, 256]; see compress_float().
+       sample_bits:  The number of bits per sample: 16, 24 or 32.
+       significant_bits:  The number of significant bits to keep in loud
+           regions, in [3, 31].
+
+       Return:
+            On success, returns the compressed data as a bytes object,
+            which can be decompressed with decompress_int().  On failure
+            or if one of the args was not right, returns None.  On memory
+            allocation failure, raises MemoryError.
+      """
+ */
+static PyObject *compress_int_adaptive(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyArrayObject *input;
+  PyObject *coeffs;
+  int sample_bits, significant_bits;
+
+  static const char *kwlist[] = {"input", "coeffs", "sample_bits",
+                                 "significant_bits", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOii", (char**)kwlist,
+                                   (PyObject**)&input, &coeffs, &sample_bits,
+                                   &significant_bits))
+    Py_RETURN_NONE;
+
+  int num_axes = PyArray_NDIM(input);
+  if (num_axes <= 0 || num_axes >= 16 || PyList_Size(coeffs) != num_axes)
+    Py_RETURN_NONE;
+  int regression_coeffs[16];
+  for (int i = 0; i < num_axes; i++)
+    regression_coeffs[i] = PyLong_AsLong(PyList_GetItem(coeffs, i));
+
+  switch (lilcom_array_type(input)) {
+    case LILCOM_TYPE_INT16:
+      return compress_int_adaptive_typed<int16_t>(
+          input, regression_coeffs, sample_bits, significant_bits);
+    case LILCOM_TYPE_INT32:
+      return compress_int_adaptive_typed<int32_t>(
+          input, regression_coeffs, sample_bits, significant_bits);
+    default:
+      Py_RETURN_NONE;
+  }
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def compress_float_layered(input, meta, num_layers, flags=0):
+      """
+      Compresses an array of floats in layers, so that it can be
+      decompressed at a coarser accuracy from a prefix of the output (see
+      CompressFloatLayered() in compression.h).
+
+      Args:
+       input:  A numpy.ndarray with dtype=np.float32 in native byte order,
+           aligned, and number of axes in the range [1..15].  It is not
+           modified.
+       meta:  A list of integers [tick_power, coeff1, coeff2, ...], as for
+           compress_float().
+       num_layers:  The number of refinement layers, in [1, 16].
+       flags:  Only LILCOM_FLAG_ARITHMETIC_CODING is allowed.
+
+       Return:
+            On success, returns the compressed data as a bytes object,
+            which can be decompressed with decompress_float() or, up to a
+            given layer, with decompress_float_layers().  On failure or if
+            one of the args was not right, returns None.  On memory
+            allocation failure, raises MemoryError.
+      """
+ */
+static PyObject *compress_float_layered(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyArrayObject *input;
+  PyObject *meta;
+  int num_layers, flags = 0;
+
+  static const char *kwlist[] = {"input", "meta", "num_layers", "flags", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOi|i", (char**)kwlist,
+                                   (PyObject**)&input, &meta, &num_layers,
+                                   &flags))
+    Py_RETURN_NONE;
+
+  int num_axes = PyArray_NDIM(input);
+  if (num_axes <= 0 || num_axes >= 16 || PyList_Size(meta) != num_axes + 1 ||
+      lilcom_array_type(input) != LILCOM_TYPE_FLOAT32 ||
+      !PyArray_ISALIGNED(input))
+    Py_RETURN_NONE;
+  int tick_power = PyLong_AsLong(PyList_GetItem(meta, 0)),
+      regression_coeffs[16];
+  for (int i = 0; i < num_axes; i++)
+    regression_coeffs[i] = PyLong_AsLong(PyList_GetItem(meta, i + 1));
+  int64_t dims[16], strides[16];
+  if (!lilcom_get_dims_and_strides<float>(input, dims, strides))
+    Py_RETURN_NONE;
+
+  try {
+    std::vector<char> ans;
+    {
+      LilcomReleaseGil release_gil;
+      ans = CompressFloatLayered(tick_power,
+                                 (const float*)PyArray_DATA(input),
+                                 num_axes, dims, strides, regression_coeffs,
+                                 num_layers, flags);
+    }
+    if (ans.empty())
+      Py_RETURN_NONE;
+    return PyBytes_FromStringAndSize(&(ans[0]), ans.size());
+  } catch (const std::exception &) {
+    PyErr_SetString(PyExc_MemoryError,
+                    "Failure to allocate memory in lilcom compression");
+    return NULL;
+  }
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def compress_float_channels(input, tick_power, flags=0):
+      """
+      Compresses an array of floats of shape (channels, samples), e.g.
+      multichannel audio, with each channel in its own stream (see
+      CompressFloatChannels() in compression.h).
+
+      Args:
+       input:  A numpy.ndarray with dtype=np.float32 in native byte order,
+           aligned, with 2 axes and any strides (e.g. the transpose of an
+           array of interleaved samples).  It is not modified.
+       tick_power:  As for compress_float().
+       flags:  Only LILCOM_FLAG_ARITHMETIC_CODING is allowed.
+
+       Return:
+            On success, returns the compressed data as a bytes object,
+            which can be decompressed with decompress_float() or, one
+            channel at a time, with decompress_float_channel().  On failure
+            or if one of the args was not right, returns None.  On memory
+            allocation failure, raises MemoryError.
+      """
+ */
+static PyObject *compress_float_channels(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyArrayObject *input;
+  int tick_power, flags = 0;
+
+  static const char *kwlist[] = {"input", "tick_power", "flags", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oi|i", (char**)kwlist,
+                                   (PyObject**)&input, &tick_power, &flags))
+    Py_RETURN_NONE;
+
+  if (PyArray_NDIM(input) != 2 ||
+      lilcom_array_type(input) != LILCOM_TYPE_FLOAT32 ||
+      !PyArray_ISALIGNED(input))
+    Py_RETURN_NONE;
+  int64_t dims[2], strides[2];
+  if (!lilcom_get_dims_and_strides<float>(input, dims, strides))
+    Py_RETURN_NONE;
+
+  try {
+    std::vector<char> ans;
+    {
+      LilcomReleaseGil release_gil;
+      ans = CompressFloatChannels(tick_power,
+                                  (const float*)PyArray_DATA(input), 2,
+                                  dims, strides, flags);
+    }
+    if (ans.empty())
+      Py_RETURN_NONE;
+    return PyBytes_FromStringAndSize(&(ans[0]), ans.size());
+  } catch (const std::exception &) {
+    PyErr_SetString(PyExc_MemoryError,
+                    "Failure to allocate memory in lilcom compression");
+    return NULL;
+  }
+}
+
+/**
+   The following will document this function as if it were a native
+   Python function.
+
+    def compress_batch(items, meta, flags=0, significant_bits=0,
+                       chunk_elements=LILCOM_BATCH_CHUNK_ELEMENTS):
+      """
+      Compresses a batch of small arrays into one bytes object (see
+      CompressFloatBatch() in batch.h).
+
+      Args:
+       items:  A list of NumPy arrays with dtype=np.float32 in native byte
+           order, C-contiguous and aligned, all with the same number of
+           axes in [1..15] and the same dims except on axis 0.  They are
+           not modified.
+       meta:  A list of python ints [tick_power, coeff1, coeff2, ...] with
+           one regression coefficient per axis, as for compress_float();
+           they are used for all the items.
+       flags, significant_bits:  As for compress_float(), except that
+           only LILCOM_FLAG_ARITHMETIC_CODING, LILCOM_FLAG_SPARSE,
+           LILCOM_FLAG_LOSSLESS and LILCOM_FLAG_ADAPTIVE are allowed.
+       chunk_elements:  The number of elements after which a chunk is
+           ended.
+
+       Return:
+            On success, returns the compressed batch as a bytes object.
+            If one of the args was not right, returns None.  On memory
+            allocation failure, raises MemoryError.
+      """
+ */
+static PyObject *compress_batch(PyObject *self, PyObject *args, PyObject *keywds) {
+  PyObject *items, *meta;
+  int flags = 0, significant_bits = 0;
+  long long chunk_elements = LILCOM_BATCH_CHUNK_ELEMENTS;
+
+  static const char *kwlist[] = {"items", "meta", "flags", "significant_bits",
+                                 "chunk_elements", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iiL", (char**)kwlist,
+                                   &items, &meta, &flags, &significant_bits,
+                                   &chunk_elements))
+    Py_RETURN_NONE;
+  if (!PyList_Check(items) || !PyList_Check(meta))
+    Py_RETURN_NONE;
+  int num_axes = PyList_Size(meta) - 1;
+  Py_ssize_t num_items = PyList_Size(items);
+  if (num_axes <= 0 || num_axes >= 16)
+    Py_RETURN_NONE;
+  int tick_power = PyLong_AsLong(PyList_GetItem(meta, 0));
+  int regression_coeffs[16];
+  for (int i = 0; i < num_axes; i++)
+    regression_coeffs[i] = PyLong_AsLong(PyList_GetItem(meta, i + 1));
+
+  try {
+    std::vector<const float*> item_data(num_items);
+    std::vector<int64_t> item_rows(num_items);
+    int64_t row_dims[16];
+    for (Py_ssize_t i = 0; i < num_items; i++) {
+      PyArrayObject *item = (PyArrayObject*)PyList_GetItem(items, i);
+      if (!PyArray_Check((PyObject*)item) ||
+          lilcom_array_type(item) != LILCOM_TYPE_FLOAT32 ||
+          PyArray_NDIM(item) != num_axes ||
+          !PyArray_IS_C_CONTIGUOUS(item) || !PyArray_ISALIGNED(item))
+        Py_RETURN_NONE;
+      for (int j = 1; j < num_axes; j++) {
+        if (i == 0)
+          row_dims[j - 1] = PyArray_DIM(item, j);
+        else if (row_dims[j - 1] != PyArray_DIM(item, j))
+          Py_RETURN_NONE;
+      }
+      item_data[i] = (const float*)PyArray_DATA(item);
+      item_rows[i] = PyArray_DIM(item, 0);
+    }
+    if (num_items == 0)
+      for (int j = 1; j < num_axes; j++)
+        row_dims[j - 1] = 0;
+
+    std::vector<char> ans;
+    {
+      LilcomReleaseGil release_gil;
+      ans = CompressFloatBatch(tick_power, num_items,
+                               (num_items ? &(item_data[0]) : NULL),
+                               (num_items ? &(item_rows[0]) : NULL),
+                               num_axes, row_dims, regression_coeffs, flags,
+                               significant_bits, chunk_elements);
     }
-    PyObject *ret = PyBytes_FromStringAndSize(NULL, LILCOM_HEADER_LEN + ans.size());
-    char* ret_data = PyBytes_AsString(ret);
-    ret_data[0] = 'L';
-    ret_data[1] = LILCOM_FORMAT_VERSION;
-    memcpy(ret_data + 2, &(ans[0]), ans.size());
-    return ret;
-  } catch (std::bad_alloc) {
+    if (ans.empty())
+      Py_RETURN_NONE;
+    return PyBytes_FromStringAndSize(&(ans[0]), ans.size());
+  } catch (const std::exception &) {
     PyErr_SetString(PyExc_MemoryError,
                     "Failure to allocate memory in lilcom compression");
     return NULL;
@@ -109,28 +877,34 @@ static PyObject *compress_float(PyObject *self, PyObject *args, PyObject *keywds
 }
 
   /*
-    Gets the bytes object as a char* pointer and length (both excluding the header);
-    returns true on success, false on failure; in that case the user should return
-    NULL and an exception will have been set.
+    Gets the buffer of `bytes_in`, which may be any object that supports
+    the buffer protocol with contiguous data (e.g. bytes, bytearray, mmap or
+    a contiguous memoryview), and checks the header of the compressed data
+    in it.  Returns true on success, in which case the caller must call
+    PyBuffer_Release(view) when it has finished with the data; returns
+    false on failure, in which case the user should return NULL and an
+    exception will have been set.
    */
-  bool lilcom_check_bytes_header(PyObject *bytes_in, char **bytes_array, Py_ssize_t *length) {
-    if (PyBytes_AsStringAndSize(bytes_in, bytes_array, length) != 0) {
-      PyErr_SetString(PyExc_ValueError, "lilcom: Expected bytes object as 1st arg");
-      return false;
-    } else if (*length <= LILCOM_HEADER_LEN) {
-      PyErr_SetString(PyExc_ValueError, "lilcom: Length of string was too short");
+  bool lilcom_get_buffer(PyObject *bytes_in, Py_buffer *view) {
+    if (PyObject_GetBuffer(bytes_in, view, PyBUF_SIMPLE) != 0) {
+      PyErr_SetString(PyExc_ValueError, "lilcom: Expected bytes-like object "
+                      "with contiguous data as 1st arg");
       return false;
-    } else if (**bytes_array != 'L') {
-      PyErr_SetString(PyExc_ValueError, "lilcom: Lilcom-compressed data must begin with L");
-      return false;
-    } else if ((*bytes_array)[1] != LILCOM_FORMAT_VERSION) {
-      PyErr_SetString(PyExc_ValueError, "lilcom: Trying to decompress data from a future format "
-                      "version (use newer code)");
+    }
+    const char *data = (const char*)view->buf;
+    const char *error = NULL;
+    if (view->len <= LILCOM_HEADER_LEN)
+      error = "lilcom: Length of string was too short";
+    else if (data[0] != 'L')
+      error = "lilcom: Lilcom-compressed data must begin with L";
+    else if (data[1] < 0 || data[1] > LILCOM_FORMAT_VERSION)
+      error = "lilcom: Trying to decompress data from a future format "
+          "version (use newer code)";
+    if (error != NULL) {
+      PyBuffer_Release(view);
+      PyErr_SetString(PyExc_ValueError, error);
       return false;
     }
-    // remove the header from what we return.
-    *bytes_array += LILCOM_HEADER_LEN;
-    *length -= LILCOM_HEADER_LEN;
     return true;
   }
 
@@ -145,7 +919,7 @@ static PyObject *compress_float(PyObject *self, PyObject *args, PyObject *keywds
 	 bytes object can be decompressed.
 
          Args:
-            `bytes_in` must be a bytes object
+            `bytes_in` must be a bytes-like object (see lilcom_get_buffer())
          Return:
             If `bytes_in` had the expected format (as compressed by compress_float),
             this function will return a tuple of ints:
@@ -154,30 +928,30 @@ static PyObject *compress_float(PyObject *self, PyObject *args, PyObject *keywds
             wrong with the argument-passing, e.g. wrong types, it will return
             None.
 
-         Will throw ValueError if the argument is not of type `bytes` or does
+         Will throw ValueError if the argument is not bytes-like or does
          not seem to be a Lilcom-compressed string of the right dimension; will
          return None if the wrong number of args was given or something went
          wrong getting the size.  """
    */
   static PyObject *get_float_matrix_shape(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
-    char *bytes_array;
-    Py_ssize_t length;
+    Py_buffer view;
     if (nargs != 1)
       Py_RETURN_NONE;
-    PyObject *bytes_in = args[0];
-    if (!lilcom_check_bytes_header(bytes_in, &bytes_array, &length))
+    if (!lilcom_get_buffer(args[0], &view))
       return NULL;
 
-    int meta[17];
-    if (GetCompressedDataShape(bytes_array, length, meta)) {
+    int64_t meta[17];
+    bool ok = GetCompressedDataShape((const char*)view.buf, view.len, meta);
+    PyBuffer_Release(&view);
+    if (ok) {
       int num_axes = meta[0];
       assert(num_axes > 0 && num_axes <= 16);  // was checked in
                                                // GetCompressedDataShape()
       PyObject *ans = PyTuple_New(num_axes);
       for (int i = 0; i < num_axes; i++) {
-        int dim = meta[i+1];
-        assert(dim > 0);  // was checked in GetCompressedDataSize()
-        PyTuple_SET_ITEM(ans, i, PyLong_FromLong(dim));
+        int64_t dim = meta[i+1];
+        assert(dim >= 0);  // was checked in GetCompressedDataSize()
+        PyTuple_SET_ITEM(ans, i, PyLong_FromLongLong(dim));
       }
       return ans;
     } else {
@@ -186,68 +960,754 @@ static PyObject *compress_float(PyObject *self, PyObject *args, PyObject *keywds
   }
 
 
+  /**
+     The following will document this function as if it were a native
+    Python function.
+
+       def peek_shape(bytes_in):
+         """
+         Return the shape of the array that was compressed into this bytes
+         object.  For data in the current format version this just reads the
+         fixed-layout header (see struct LilcomHeader in compression.h), so
+         it takes the same time however large the array is; it does not
+         check the rest of the data.
+
+         Args:
+            `bytes_in` must be a bytes-like object (see lilcom_get_buffer())
+         Return:
+            A tuple of ints (dim1, dim2, dim3 ...).  Will throw ValueError
+            if the argument is not bytes-like or does not seem to be
+            Lilcom-compressed data; will return None if the wrong number of
+            args was given.  """
+   */
+  static PyObject *peek_shape(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 1)
+      Py_RETURN_NONE;
+    Py_buffer view;
+    if (PyObject_GetBuffer(args[0], &view, PyBUF_SIMPLE) != 0) {
+      PyErr_SetString(PyExc_ValueError, "lilcom: Expected bytes-like object "
+                      "with contiguous data as 1st arg");
+      return NULL;
+    }
+    const char *data = (const char*)view.buf;
+    Py_ssize_t length = view.len;
+    LilcomHeader header;
+    if (length >= LILCOM_FIXED_HEADER_LEN) {
+      memcpy(&header, data, sizeof(header));
+      if (header.magic == 'L' && header.format_version == 2) {
+        if (header.num_axes < 1 || header.num_axes > 16 ||
+            length < LilcomHeaderLen(header.num_axes)) {
+          PyBuffer_Release(&view);
+          PyErr_SetString(PyExc_ValueError, "lilcom: Invalid header");
+          return NULL;
+        }
+        PyObject *ans = PyTuple_New(header.num_axes);
+        for (int i = 0; i < header.num_axes; i++)
+          PyTuple_SET_ITEM(ans, i, PyLong_FromLongLong(LilcomHeaderDim(data, i)));
+        PyBuffer_Release(&view);
+        return ans;
+      }
+    }
+    /* Older format versions have to be parsed. */
+    int64_t meta[17];
+    bool ok = GetCompressedDataShape(data, length, meta);
+    PyBuffer_Release(&view);
+    if (!ok) {
+      PyErr_SetString(PyExc_ValueError, "lilcom: Could not read the shape "
+                      "(is this really compressed data?)");
+      return NULL;
+    }
+    PyObject *ans = PyTuple_New(meta[0]);
+    for (int i = 0; i < meta[0]; i++)
+      PyTuple_SET_ITEM(ans, i, PyLong_FromLongLong(meta[i + 1]));
+    return ans;
+  }
+
+
+  /**
+     The following will document this function as if it were a native
+    Python function.
+
+       def get_data_type(bytes_in):
+         """
+         Return the element type of the array that was compressed into this
+         bytes object, as one of the LILCOM_TYPE_ values, e.g.
+         LILCOM_TYPE_FLOAT32 if it was compressed by compress_float().
+
+         Will throw ValueError if the argument is not bytes-like or
+         does not seem to be Lilcom-compressed data; will return None if the
+         wrong number of args was given or the type could not be read.  """
+   */
+  static PyObject *get_data_type(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    Py_buffer view;
+    if (nargs != 1)
+      Py_RETURN_NONE;
+    if (!lilcom_get_buffer(args[0], &view))
+      return NULL;
+    int type = GetCompressedDataType((const char*)view.buf, view.len);
+    PyBuffer_Release(&view);
+    if (type < 0)
+      Py_RETURN_NONE;
+    return PyLong_FromLong(type);
+  }
+
+
   /**
     The following will document this function as if it were a native Python
     function.
 
-       def decompress_float(bytes_in, array_out)
+       def decompress_float(bytes_in, array_out, stats=None)
          """
          Decompress an array of float that was compressed with compress_float()
 
 
          Args:
-            byts_in: a `bytes` object that was returned from compress_float()
+            bytes_in: a bytes-like object (see lilcom_get_buffer())
+               containing data that was returned from compress_float()
+
+            array_out: must be a writeable, aligned NumPy array with dtype
+               numpy.float32 in native byte order, and shape equal to the
+               result of calling get_float_matrix_shape() on this same
+               data.  It may have any strides that are multiples of 4.
 
-            array_out: must be a NumPy array with dtype numpy.float32, and
-               shape equal to the result of calling get_float_matrix_shape() on
-               this same bytes object.
+            stats: If a dict, it will be cleared and filled with statistics
+               about the decompression, as for compress_float().
 
          Return:
            Returns 0 on success, a nonzero code if there was a
-           failure in the decompression.
+           failure in the decompression, or None if array_out was not
+           suitable.
            raises ValueError if the args appeared to have the wrong type or
            could not be decompressed.
          """
 
    */
   static PyObject *decompress_float(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
-    char *bytes_array;
-    Py_ssize_t length;
-    if (nargs != 2)
+    if (nargs != 2 && nargs != 3)
       Py_RETURN_NONE;
     PyObject *bytes_in = args[0];
     PyArrayObject *output = (PyArrayObject*)args[1];
+    PyObject *stats_dict = (nargs == 3 ? args[2] : NULL);
+    int want_stats = lilcom_check_stats(stats_dict);
+    if (want_stats < 0)
+      return NULL;
+    if (!PyArray_Check(args[1]) ||
+        lilcom_array_type(output) != LILCOM_TYPE_FLOAT32 ||
+        !PyArray_ISWRITEABLE(output) || !PyArray_ISALIGNED(output))
+      Py_RETURN_NONE;
+    int64_t dims[16], strides[16];
+    if (PyArray_NDIM(output) > 16 ||
+        !lilcom_get_dims_and_strides<float>(output, dims, strides))
+      Py_RETURN_NONE;
 
-    if (!lilcom_check_bytes_header(bytes_in, &bytes_array, &length))
+    Py_buffer view;
+    if (!lilcom_get_buffer(bytes_in, &view))
+      return NULL;
+    CodecStats stats;
+    int ans;
+    try {
+      LilcomReleaseGil release_gil;
+      ans = DecompressFloat(&lilcom_decompression_context,
+                            (const char*)view.buf, view.len,
+                            (float*)PyArray_DATA(output),
+                            PyArray_NDIM(output), dims, strides,
+                            want_stats ? &stats : NULL);
+    } catch (const std::exception &) {
+      lilcom_trim_context(&lilcom_decompression_context);
+      PyBuffer_Release(&view);
+      PyErr_SetString(PyExc_MemoryError,
+                      "Failure to allocate memory in lilcom decompression");
       return NULL;
+    }
+    lilcom_trim_context(&lilcom_decompression_context);
+    PyBuffer_Release(&view);
+    if (want_stats && !lilcom_stats_to_dict(stats, stats_dict))
+      return NULL;
+    return PyLong_FromLong(ans);
+  }
 
-    int dims[16], strides[16];
-    int num_axes = PyArray_NDIM(output);
-    for (int i = 0; i < num_axes; i++) {
-      dims[i] = PyArray_DIM(output, i);
-      strides[i] = PyArray_STRIDE(output, i) / sizeof(float);
+
+
+  /**
+    The following will document this function as if it were a native Python
+    function.
+
+       def decompress_float_layers(bytes_in, array_out, max_layer)
+         """
+         Decompresses data that was compressed with compress_float_layered()
+         up to layer `max_layer` (see DecompressFloatLayers() in
+         compression.h); bytes_in need only contain the first
+         layer_sizes(bytes_in)[max_layer] bytes of the data.  The args are
+         otherwise as for decompress_float().
+
+         Return:
+           Returns 0 on success, a nonzero code if there was a failure in
+           the decompression, or None if array_out was not suitable.
+         """
+   */
+  static PyObject *decompress_float_layers(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 3 || !PyLong_Check(args[2]))
+      Py_RETURN_NONE;
+    PyArrayObject *output = (PyArrayObject*)args[1];
+    int max_layer = PyLong_AsLong(args[2]);
+    if (!PyArray_Check(args[1]) ||
+        lilcom_array_type(output) != LILCOM_TYPE_FLOAT32 ||
+        !PyArray_ISWRITEABLE(output) || !PyArray_ISALIGNED(output))
+      Py_RETURN_NONE;
+    int64_t dims[16], strides[16];
+    if (PyArray_NDIM(output) > 16 ||
+        !lilcom_get_dims_and_strides<float>(output, dims, strides))
+      Py_RETURN_NONE;
+
+    Py_buffer view;
+    if (!lilcom_get_buffer(args[0], &view))
+      return NULL;
+    int ans;
+    try {
+      LilcomReleaseGil release_gil;
+      ans = DecompressFloatLayers((const char*)view.buf, view.len, max_layer,
+                                  (float*)PyArray_DATA(output),
+                                  PyArray_NDIM(output), dims, strides);
+    } catch (const std::exception &) {
+      PyBuffer_Release(&view);
+      PyErr_SetString(PyExc_MemoryError,
+                      "Failure to allocate memory in lilcom decompression");
+      return NULL;
     }
+    PyBuffer_Release(&view);
+    return PyLong_FromLong(ans);
+  }
+
+
+  /**
+    The following will document this function as if it were a native Python
+    function.
+
+       def decompress_float_channel(bytes_in, channel, array_out)
+         """
+         Decompresses one channel of data that was compressed with
+         compress_float_channels() (see DecompressFloatChannel() in
+         compression.h).
+
+         Args:
+           bytes_in:  The compressed data; any object that supports the
+                   buffer protocol with contiguous data.
+           channel:  The channel, an int in [0, number of channels).
+           array_out:  A writeable NumPy array of np.float32 with one axis
+                   whose dim is the number of samples, in native byte order
+                   and aligned; it may have any stride.
 
-    int ans = DecompressFloat(bytes_array, length,
-                              (float*)PyArray_DATA(output),
-                              num_axes, dims, strides);
+         Return:
+           Returns 0 on success, a nonzero code if there was a failure in
+           the decompression (4 if the channel was out of range, 8 if the
+           data was not compressed by channel), or None if array_out was
+           not suitable.
+         """
+   */
+  static PyObject *decompress_float_channel(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 3 || !PyLong_Check(args[1]))
+      Py_RETURN_NONE;
+    int64_t channel = PyLong_AsLongLong(args[1]);
+    PyArrayObject *output = (PyArrayObject*)args[2];
+    if (!PyArray_Check(args[2]) || PyArray_NDIM(output) != 1 ||
+        lilcom_array_type(output) != LILCOM_TYPE_FLOAT32 ||
+        !PyArray_ISWRITEABLE(output) || !PyArray_ISALIGNED(output))
+      Py_RETURN_NONE;
+    int64_t dims[1], strides[1];
+    if (!lilcom_get_dims_and_strides<float>(output, dims, strides))
+      Py_RETURN_NONE;
+
+    Py_buffer view;
+    if (!lilcom_get_buffer(args[0], &view))
+      return NULL;
+    /* Check the number of samples against the header. */
+    int64_t meta[17];
+    if (!GetCompressedDataShape((const char*)view.buf, view.len, meta) ||
+        meta[0] != 2 || meta[2] != dims[0]) {
+      PyBuffer_Release(&view);
+      Py_RETURN_NONE;
+    }
+    int ans;
+    try {
+      LilcomReleaseGil release_gil;
+      ans = DecompressFloatChannel((const char*)view.buf, view.len, channel,
+                                   (float*)PyArray_DATA(output), strides[0]);
+    } catch (const std::exception &) {
+      PyBuffer_Release(&view);
+      PyErr_SetString(PyExc_MemoryError,
+                      "Failure to allocate memory in lilcom decompression");
+      return NULL;
+    }
+    PyBuffer_Release(&view);
     return PyLong_FromLong(ans);
   }
 
 
+  /**
+    The following will document this function as if it were a native Python
+    function.
+
+       def get_layer_sizes(bytes_in)
+         """
+         Takes data that was compressed with compress_float_layered(), or
+         just its header and the 8 bytes after it, and returns a list
+         whose element k is the number of bytes at the start of the data
+         that decompress_float_layers() needs to decompress it up to layer
+         k, for k = 0 (the base layer) up to the number of refinement
+         layers; or None if it is not data compressed in layers.
+         """
+   */
+  static PyObject *get_layer_sizes(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 1)
+      Py_RETURN_NONE;
+    Py_buffer view;
+    if (!lilcom_get_buffer(args[0], &view))
+      return NULL;
+    int64_t sizes[LILCOM_MAX_LAYERS + 1];
+    int num_sizes = 0;
+    /* A refinement layer of an array with no elements has no bytes, so we
+       stop once the size of the whole data is reached. */
+    int64_t total = LayerPrefixBytes((const char*)view.buf, view.len, -1);
+    if (total >= 0) {
+      do {
+        sizes[num_sizes] = LayerPrefixBytes((const char*)view.buf, view.len,
+                                            num_sizes);
+        num_sizes++;
+      } while (sizes[num_sizes - 1] < total);
+    }
+    PyBuffer_Release(&view);
+    if (total < 0)
+      Py_RETURN_NONE;
+    return lilcom_int_list(sizes, num_sizes);
+  }
+
+
+
+  /**
+    The following will document this function as if it were a native Python
+    function.
+
+       def decompress_int(bytes_in, array_out)
+         """
+         Decompress an array of integers that was compressed with
+         compress_int().
+
+         Args:
+            bytes_in: a bytes-like object (see lilcom_get_buffer())
+               containing data that was returned from compress_int()
+
+            array_out: must be a writeable, aligned NumPy array with the
+               same dtype as the array that was compressed (see
+               get_data_type()), and shape equal to the result of calling
+               get_float_matrix_shape() on this same data.
+
+         Return:
+           Returns 0 on success, a nonzero code if there was a failure in
+           the decompression, or None if array_out was not suitable.
+           Raises ValueError if bytes_in had the wrong type or did
+           not seem to be Lilcom-compressed data.
+         """
+   */
+  static PyObject *decompress_int(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 2)
+      Py_RETURN_NONE;
+    PyArrayObject *output = (PyArrayObject*)args[1];
+    if (!PyArray_Check(args[1]) || PyArray_NDIM(output) > 16 ||
+        !PyArray_ISWRITEABLE(output) || !PyArray_ISALIGNED(output))
+      Py_RETURN_NONE;
+    Py_buffer view;
+    if (!lilcom_get_buffer(args[0], &view))
+      return NULL;
+    PyObject *ans = decompress_int_any(
+        (const char*)view.buf, view.len, output);
+    PyBuffer_Release(&view);
+    return ans;
+  }
+
+
+  /**
+    The following will document this function as if it were a native Python
+    function.
+
+       def decompress_quantized(bytes_in, array_out)
+         """
+         Decompress an array of float that was compressed with
+         compress_float() to integers in units of the tick, i.e. the
+         values that decompress_float() would give divided by
+         2**tick_power (see DecompressQuantized() in compression.h).
+
+         Args:
+            bytes_in: a bytes-like object (see lilcom_get_buffer())
+               containing data that was returned from compress_float()
+
+            array_out: must be a writeable, aligned NumPy array with dtype
+               numpy.int8, numpy.int16 or numpy.int32, and shape equal to
+               the result of calling get_float_matrix_shape() on this same
+               data.
+
+         Return:
+           Returns a tuple (code, tick_power), where code is 0 on success,
+           11 if the values are not integer multiples of the tick (in which
+           case decompress_float() must be used), 12 if a value was out of
+           the range of the dtype, or another nonzero code if there was a
+           failure in the decompression; tick_power is that of the data.
+           Returns None if array_out was not suitable.  Raises ValueError
+           if bytes_in had the wrong type or did not seem to be
+           Lilcom-compressed data.
+         """
+   */
+  static PyObject *decompress_quantized(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 2)
+      Py_RETURN_NONE;
+    PyArrayObject *output = (PyArrayObject*)args[1];
+    if (!PyArray_Check(args[1]) || PyArray_NDIM(output) > 16 ||
+        !PyArray_ISWRITEABLE(output) || !PyArray_ISALIGNED(output))
+      Py_RETURN_NONE;
+    int type = lilcom_array_type(output);
+    if (type != LILCOM_TYPE_INT8 && type != LILCOM_TYPE_INT16 &&
+        type != LILCOM_TYPE_INT32)
+      Py_RETURN_NONE;
+    Py_buffer view;
+    if (!lilcom_get_buffer(args[0], &view))
+      return NULL;
+    const char *bytes_array = (const char*)view.buf;
+    PyObject *ans;
+    if (type == LILCOM_TYPE_INT8)
+      ans = decompress_quantized_typed<int8_t>(bytes_array, view.len, output);
+    else if (type == LILCOM_TYPE_INT16)
+      ans = decompress_quantized_typed<int16_t>(bytes_array, view.len, output);
+    else
+      ans = decompress_quantized_typed<int32_t>(bytes_array, view.len, output);
+    PyBuffer_Release(&view);
+    return ans;
+  }
+
+
+  /*
+    Gets the buffer of `bytes_in` and checks that it is a batch, as
+    returned by compress_batch(), and reads its shape (see GetBatchShape()
+    in batch.h).  Returns true on success, in which case the caller must
+    call PyBuffer_Release(view); returns false on failure, in which case
+    the caller should return NULL and an exception will have been set.
+   */
+  static bool lilcom_get_batch(PyObject *bytes_in, Py_buffer *view,
+                               int *num_axes, int64_t *row_dims,
+                               int64_t *num_items,
+                               std::vector<int64_t> *item_rows) {
+    if (PyObject_GetBuffer(bytes_in, view, PyBUF_SIMPLE) != 0) {
+      PyErr_SetString(PyExc_ValueError, "lilcom: Expected bytes-like object "
+                      "with contiguous data as 1st arg");
+      return false;
+    }
+    if (!GetBatchShape((const char*)view->buf, view->len, num_axes,
+                       row_dims, num_items, item_rows)) {
+      PyBuffer_Release(view);
+      PyErr_SetString(PyExc_ValueError, "lilcom: Not a valid batch (was it "
+                      "returned by compress_batch()?)");
+      return false;
+    }
+    return true;
+  }
+
+  /**
+     The following will document this function as if it were a native
+    Python function.
+
+       def get_batch_shape(bytes_in):
+         """
+         Returns the shape of the items of a batch, as returned by
+         compress_batch(), without decompressing anything.
+
+         Args:
+            bytes_in: a bytes-like object containing the batch.
+         Return:
+            A tuple (row_dims, item_rows), where row_dims is a tuple of the
+            dims of axes 1, 2, ... of the items and item_rows is a list of
+            the dim of axis 0 of each item.  Raises ValueError if bytes_in
+            is not bytes-like or not a valid batch.
+         """
+   */
+  static PyObject *get_batch_shape(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 1)
+      Py_RETURN_NONE;
+    Py_buffer view;
+    int num_axes;
+    int64_t row_dims[16], num_items;
+    std::vector<int64_t> item_rows;
+    if (!lilcom_get_batch(args[0], &view, &num_axes, row_dims, &num_items,
+                          &item_rows))
+      return NULL;
+    PyBuffer_Release(&view);
+    PyObject *dims = PyTuple_New(num_axes - 1),
+        *rows = PyList_New(num_items);
+    for (int i = 0; i + 1 < num_axes; i++)
+      PyTuple_SET_ITEM(dims, i, PyLong_FromLongLong(row_dims[i]));
+    for (int64_t i = 0; i < num_items; i++)
+      PyList_SET_ITEM(rows, i, PyLong_FromLongLong(item_rows[i]));
+    return Py_BuildValue("(NN)", dims, rows);
+  }
+
+  /**
+    The following will document this function as if it were a native Python
+    function.
+
+       def decompress_batch(bytes_in, begin, end, array_out)
+         """
+         Decompresses items [begin, end) of a batch, concatenated along
+         axis 0, into array_out (see DecompressBatchItems() in batch.h).
+
+         Args:
+            bytes_in: a bytes-like object containing data that was returned
+               from compress_batch()
+            begin, end:  The range of items, with 0 <= begin <= end <= the
+               number of items.
+            array_out: must be a writeable, aligned, C-contiguous NumPy
+               array with dtype numpy.float32 in native byte order, whose
+               dim on axis 0 is the sum of the rows of those items and
+               whose other dims are the row_dims of the batch.
+
+         Return:
+           Returns 0 on success, a nonzero code if there was a failure in
+           the decompression, or None if the range or array_out was not
+           suitable.  Raises ValueError if bytes_in had the wrong type or
+           was not a valid batch.
+         """
+   */
+  static PyObject *decompress_batch(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 4 || !PyArray_Check(args[3]))
+      Py_RETURN_NONE;
+    long long begin = PyLong_AsLongLong(args[1]),
+        end = PyLong_AsLongLong(args[2]);
+    if (PyErr_Occurred())
+      return NULL;
+    PyArrayObject *output = (PyArrayObject*)args[3];
+    if (lilcom_array_type(output) != LILCOM_TYPE_FLOAT32 ||
+        !PyArray_ISWRITEABLE(output) || !PyArray_ISALIGNED(output) ||
+        !PyArray_IS_C_CONTIGUOUS(output))
+      Py_RETURN_NONE;
+    Py_buffer view;
+    int num_axes;
+    int64_t row_dims[16], num_items;
+    std::vector<int64_t> item_rows;
+    if (!lilcom_get_batch(args[0], &view, &num_axes, row_dims, &num_items,
+                          &item_rows))
+      return NULL;
+    bool ok = (begin >= 0 && begin <= end && end <= num_items &&
+               PyArray_NDIM(output) == num_axes);
+    int64_t rows = 0;
+    for (int64_t i = begin; ok && i < end; i++)
+      rows += item_rows[i];
+    for (int i = 0; ok && i < num_axes; i++)
+      ok = (PyArray_DIM(output, i) == (i == 0 ? rows : row_dims[i - 1]));
+    if (!ok) {
+      PyBuffer_Release(&view);
+      Py_RETURN_NONE;
+    }
+    int ans;
+    try {
+      LilcomReleaseGil release_gil;
+      ans = DecompressBatchItems((const char*)view.buf, view.len, begin, end,
+                                 (float*)PyArray_DATA(output));
+    } catch (const std::exception &) {
+      PyBuffer_Release(&view);
+      return PyErr_NoMemory();
+    }
+    PyBuffer_Release(&view);
+    return PyLong_FromLong(ans);
+  }
+
+
+  /**
+    The following will document this function as if it were a native Python
+    function.
+
+       def concatenate(inputs)
+         """
+         Concatenates compressed arrays of floats and batches along axis 0
+         without decompressing them (see ConcatenateCompressed() in
+         batch.h).
+
+         Args:
+            inputs: a non-empty list of bytes-like objects, each containing
+               data returned by compress_float() or a batch, with the same
+               number of axes and the same dims except on axis 0.
+         Return:
+           Returns the batch as a bytes object, or None if an input was not
+           valid or the dims did not match.  Raises ValueError if an input
+           was not bytes-like, and MemoryError on memory allocation
+           failure.
+         """
+   */
+  static PyObject *concatenate(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 1 || !PyList_Check(args[0]) || PyList_Size(args[0]) == 0)
+      Py_RETURN_NONE;
+    Py_ssize_t num_inputs = PyList_Size(args[0]);
+    try {
+      std::vector<Py_buffer> views(num_inputs);
+      std::vector<const char*> srcs(num_inputs);
+      std::vector<int64_t> num_bytes(num_inputs);
+      Py_ssize_t num_views = 0;
+      for (; num_views < num_inputs; num_views++) {
+        Py_buffer *view = &(views[num_views]);
+        if (PyObject_GetBuffer(PyList_GET_ITEM(args[0], num_views), view,
+                               PyBUF_SIMPLE) != 0)
+          break;
+        srcs[num_views] = (const char*)view->buf;
+        num_bytes[num_views] = view->len;
+      }
+      std::vector<char> ans;
+      bool bad_alloc = false;
+      if (num_views == num_inputs) {
+        LilcomReleaseGil release_gil;
+        try {
+          ans = ConcatenateCompressed(num_inputs, &(srcs[0]), &(num_bytes[0]));
+        } catch (const std::exception &) {
+          bad_alloc = true;
+        }
+      }
+      for (Py_ssize_t i = 0; i < num_views; i++)
+        PyBuffer_Release(&(views[i]));
+      if (num_views < num_inputs) {
+        PyErr_SetString(PyExc_ValueError, "lilcom: Expected a list of "
+                        "bytes-like objects with contiguous data");
+        return NULL;
+      }
+      if (bad_alloc)
+        throw std::bad_alloc();
+      if (ans.empty())
+        Py_RETURN_NONE;
+      return PyBytes_FromStringAndSize(&(ans[0]), ans.size());
+    } catch (const std::exception &) {
+      PyErr_SetString(PyExc_MemoryError,
+                      "Failure to allocate memory in lilcom concatenation");
+      return NULL;
+    }
+  }
+
+
+  /**
+     The following will document this function as if it were a native
+    Python function.
+
+       def get_isa():
+         """
+         Returns the name of the instruction set whose variant of the
+         library is being used: 'default', 'avx2' or 'avx512' (see
+         LilcomIsa() in compression.h).
+         """
+   */
+  static PyObject *get_isa(PyObject *self, PyObject *unused) {
+    return PyUnicode_FromString(LilcomIsa());
+  }
+
+  /**
+     The following will document this function as if it were a native
+    Python function.
+
+       def set_isa(name):
+         """
+         Selects the variant of the library to use, by the name of its
+         instruction set, as for get_isa().  Returns True on success, False
+         if the name was not recognized or this CPU does not support it.
+         This is for testing and benchmarking.
+         """
+   */
+  static PyObject *set_isa(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 1 || !PyUnicode_Check(args[0])) {
+      PyErr_SetString(PyExc_TypeError, "lilcom: Expected a str as the only arg");
+      return NULL;
+    }
+    const char *name = PyUnicode_AsUTF8(args[0]);
+    if (name == NULL)
+      return NULL;
+    return PyBool_FromLong(LilcomSetIsa(name));
+  }
+
+
 
   static PyMethodDef LilcomExtensionMethods[] = {
     {"compress_float", (PyCFunction) compress_float, METH_VARARGS | METH_KEYWORDS,
      "Compresses the supplied data and returns compressed form as bytes object."},
+    {"choose_tick_power", (PyCFunction) choose_tick_power, METH_VARARGS | METH_KEYWORDS,
+     "Returns the smallest tick_power for which compress_float() would "
+     "produce no more than the specified number of bytes."},
+    {"compress_int", (PyCFunction) compress_int, METH_VARARGS | METH_KEYWORDS,
+     "Compresses the supplied array of integers losslessly and returns the "
+     "compressed form as bytes object."},
+    {"compress_int_adaptive", (PyCFunction) compress_int_adaptive, METH_VARARGS | METH_KEYWORDS,
+     "Compresses the supplied array of 16, 24 or 32-bit audio samples with "
+     "adaptive precision and returns the compressed form as bytes object."},
+    {"compress_float_layered", (PyCFunction) compress_float_layered, METH_VARARGS | METH_KEYWORDS,
+     "Compresses the supplied array of floats in layers that can be "
+     "decompressed progressively, and returns the compressed form as bytes "
+     "object."},
+    {"get_data_type", (PyCFunction) get_data_type, METH_FASTCALL,
+     "Takes a bytes object as returned from compress_float() or "
+     "compress_int(), and returns the element type of the array that was "
+     "compressed (one of the LILCOM_TYPE_ values), or None on error."},
     {"get_float_matrix_shape", (PyCFunction) get_float_matrix_shape, METH_FASTCALL,
      "Takes a bytes object as returned from compress_float(), and returns a "
      "tuple representing the shape of the array that was compressed, or "
      "None on error."},
+    {"peek_shape", (PyCFunction) peek_shape, METH_FASTCALL,
+     "Takes a bytes object as returned from compress_float() or "
+     "compress_int(), and returns a tuple representing the shape of the "
+     "array that was compressed, reading only the header."},
     {"decompress_float", (PyCFunction) decompress_float, METH_FASTCALL,
      "Takes a bytes object and an appropriately sized NumPy array of floats, "
      "with shape as given by get_float_matrix_shape(), and decompresses the "
      "data into the array.  Returns 0 on success, and a nonzero code or None "
      "on failure."},
+    {"decompress_float_layers", (PyCFunction) decompress_float_layers, METH_FASTCALL,
+     "Takes (a prefix of) a bytes object as returned from "
+     "compress_float_layered(), an appropriately sized NumPy array of floats "
+     "and a layer, and decompresses the data up to that layer into the "
+     "array.  Returns 0 on success, and a nonzero code or None on failure."},
+    {"decompress_float_channel", (PyCFunction) decompress_float_channel, METH_FASTCALL,
+     "Takes a bytes object as returned from compress_float_channels(), a "
+     "channel and a 1-d NumPy array of floats with the number of samples, "
+     "and decompresses that channel into the array.  Returns 0 on success, "
+     "and a nonzero code or None on failure."},
+    {"get_layer_sizes", (PyCFunction) get_layer_sizes, METH_FASTCALL,
+     "Takes a bytes object as returned from compress_float_layered(), and "
+     "returns a list of the number of bytes needed to decompress it up to "
+     "each layer, or None on error."},
+    {"decompress_int", (PyCFunction) decompress_int, METH_FASTCALL,
+     "Takes a bytes object as returned from compress_int() and a NumPy array "
+     "of the same dtype and shape as was compressed, and decompresses the "
+     "data into the array.  Returns 0 on success, and a nonzero code or None "
+     "on failure."},
+    {"decompress_quantized", (PyCFunction) decompress_quantized, METH_FASTCALL,
+     "Takes a bytes object as returned from compress_float() and a NumPy "
+     "array of int8, int16 or int32 of the same shape as was compressed, and "
+     "decompresses the data into the array in units of the tick.  Returns a "
+     "tuple (code, tick_power), where code is 0 on success, or None on "
+     "failure."},
+    {"compress_float_channels", (PyCFunction) compress_float_channels, METH_VARARGS | METH_KEYWORDS,
+     "Compresses the supplied 2-d array of floats (channels, samples) with "
+     "each channel in its own stream, and returns the compressed form as "
+     "bytes object."},
+    {"compress_batch", (PyCFunction) compress_batch, METH_VARARGS | METH_KEYWORDS,
+     "Compresses a list of arrays of floats with the same dims except on "
+     "axis 0 into one bytes object."},
+    {"get_batch_shape", (PyCFunction) get_batch_shape, METH_FASTCALL,
+     "Takes a bytes object as returned from compress_batch(), and returns a "
+     "tuple (row_dims, item_rows) describing the shapes of its items."},
+    {"decompress_batch", (PyCFunction) decompress_batch, METH_FASTCALL,
+     "Takes a bytes object as returned from compress_batch(), a range of "
+     "items [begin, end) and a NumPy array of floats of their concatenated "
+     "shape, and decompresses them into the array.  Returns 0 on success, "
+     "and a nonzero code or None on failure."},
+    {"concatenate", (PyCFunction) concatenate, METH_FASTCALL,
+     "Takes a list of bytes objects as returned from compress_float() or "
+     "compress_batch(), and concatenates them along axis 0 into a batch "
+     "without decompressing them."},
+    {"get_isa", (PyCFunction) get_isa, METH_NOARGS,
+     "Returns the name of the instruction set whose variant of the library "
+     "is being used: 'default', 'avx2' or 'avx512'."},
+    {"set_isa", (PyCFunction) set_isa, METH_FASTCALL,
+     "Selects the variant of the library to use by the name of its "
+     "instruction set; returns False if it is not supported."},
     {NULL, NULL, 0, NULL}
   };
 
@@ -262,7 +1722,38 @@ static PyObject *compress_float(PyObject *self, PyObject *args, PyObject *keywds
 
   PyMODINIT_FUNC PyInit_lilcom_extension(void) {
     import_array();
-    return PyModule_Create(&lilcom_extension);
+    PyObject *m = PyModule_Create(&lilcom_extension);
+    if (m == NULL)
+      return NULL;
+    /* The flags for compress_float(), from compression.h */
+    PyModule_AddIntMacro(m, LILCOM_FLAG_ARITHMETIC_CODING);
+    PyModule_AddIntMacro(m, LILCOM_FLAG_SPARSE);
+    PyModule_AddIntMacro(m, LILCOM_FLAG_CONSTANT_BLOCKS);
+    PyModule_AddIntMacro(m, LILCOM_FLAG_LOSSLESS);
+    PyModule_AddIntMacro(m, LILCOM_FLAG_ADAPTIVE);
+    PyModule_AddIntMacro(m, LILCOM_FLAG_INTEGER);
+    PyModule_AddIntMacro(m, LILCOM_FLAG_LAYERED);
+    PyModule_AddIntMacro(m, LILCOM_FLAG_CHANNELS);
+    PyModule_AddIntMacro(m, LILCOM_MAX_LAYERS);
+    PyModule_AddIntMacro(m, LILCOM_FORMAT_VERSION);
+    PyModule_AddIntMacro(m, LILCOM_FIXED_HEADER_LEN);
+    PyModule_AddIntMacro(m, LILCOM_BATCH_CHUNK_ELEMENTS);
+#ifdef LILCOM_STATS
+    PyModule_AddIntConstant(m, "LILCOM_STATS_ENABLED", 1);
+#else
+    PyModule_AddIntConstant(m, "LILCOM_STATS_ENABLED", 0);
+#endif
+    /* The element types returned by get_data_type(). */
+    PyModule_AddIntMacro(m, LILCOM_TYPE_FLOAT32);
+    PyModule_AddIntMacro(m, LILCOM_TYPE_INT8);
+    PyModule_AddIntMacro(m, LILCOM_TYPE_UINT8);
+    PyModule_AddIntMacro(m, LILCOM_TYPE_INT16);
+    PyModule_AddIntMacro(m, LILCOM_TYPE_UINT16);
+    PyModule_AddIntMacro(m, LILCOM_TYPE_INT32);
+    PyModule_AddIntMacro(m, LILCOM_TYPE_UINT32);
+    PyModule_AddIntMacro(m, LILCOM_TYPE_INT64);
+    PyModule_AddIntMacro(m, LILCOM_TYPE_UINT64);
+    return m;
   }
 
 
@@ -1,3 +1,8 @@
+import collections
+import concurrent.futures
+import os
+import threading
+
 import numpy as np
 
 from . import lilcom_extension
@@ -6,37 +11,214 @@ from . import lilcom_extension
 
 def compress(input,
              tick_power=-8,
-             do_regression=True):
+             do_regression=True,
+             max_bytes=None,
+             bits_per_element=None,
+             arithmetic_coding=False,
+             lossless=False,
+             significant_bits=None,
+             stats=None,
+             quantizable=False,
+             layers=None,
+             sample_bits=None,
+             channels=False):
   """
-  Compresses a NumPy array lossily
+  Compresses a NumPy array lossily (or losslessly, for integer arrays)
 
   Args:
-    input:   A numpy.ndarray.  May be of type np.float or np.double.
+    input:   A numpy.ndarray, or another array on the CPU: an object that
+             supports DLPack (__dlpack__, e.g. a tensor of another
+             framework), __array_interface__ or the buffer protocol (e.g.
+             a memoryview or array.array), which is viewed as a NumPy array
+             without copying (see _as_ndarray()).  May be of type np.float or
+             np.double, or of an integer type (8, 16, 32 or 64 bits, signed
+             or unsigned), in which case it is compressed losslessly and the
+             only other args that are used are do_regression and
+             arithmetic_coding; except that arrays of audio samples of type
+             np.int16 or np.int32 may be compressed lossily by giving
+             significant_bits (and sample_bits).
     tick_power:  Determines the accuracy; the input will be compressed to integer
-             multiples of 2^tick_power.
+             multiples of 2^tick_power.  Ignored if max_bytes or
+             bits_per_element is specified.
     do_regression:  If true, use regression on previous elements in the array
              (one regression coefficient per axis) to reduce the magnitudes of
              the values to compress.
+    max_bytes:  If specified, the tick_power will be chosen automatically:
+             it will be the smallest (i.e. most accurate) tick_power
+             for which the returned bytes object is no longer than this.
+             Raises ValueError if this is not possible.
+    bits_per_element:  If specified (and max_bytes is not), it is
+             equivalent to setting max_bytes to
+             ceil(bits_per_element * input.size / 8).
+    arithmetic_coding:  If true, use adaptive arithmetic coding for the
+             compressed values.  This is slower than the default
+             coding method but gives smaller output.
+    lossless:  If true, compress losslessly, so that decompress() returns
+             exactly the same values (bit for bit, including NaNs).  The
+             input must be of type np.float32 (or np.float16); tick_power
+             is ignored, and max_bytes and bits_per_element may not be
+             given.
+    significant_bits:  If specified (an int in [3,31]), use adaptive
+             precision: the accuracy given by tick_power is coarsened in
+             loud regions of the array so that about this many significant
+             bits are kept, relative to the local magnitude of the
+             prediction residuals.  This gives an error bound that is
+             roughly relative rather than absolute, and smaller output for
+             signals with a large dynamic range.  Cannot be used with
+             lossless.
+    stats:   If a dict, it will be cleared and filled with statistics about
+             the compression, to help understand the size of the output: a
+             histogram of the number of bits per code, the sizes of the
+             header and payload, timings and so on (see struct CodecStats
+             in codec_stats.h for what they all mean).  Only supported for
+             float arrays, and only if lilcom was built with LILCOM_STATS
+             (the default).
+    quantizable:  If true, the regression coefficients are rounded to
+             -1, 0 or 1, so that all the values are integer multiples of
+             2^tick_power and decompress_quantized() can decode the data
+             exactly, without going through floats.  The output may be
+             slightly larger.  Cannot be used with lossless.
+    layers:  If specified (an int in [1,16]), compress in layers, so that
+             a prefix of the output can be decompressed to a coarser
+             version of the array, e.g. for a preview (see layer_sizes()
+             and the max_layer arg of decompress()).  The first layer (the
+             base layer) has the accuracy of tick_power + layers, and each
+             of the others halves the tick, down to 2^tick_power with all
+             of them.  The output is usually only slightly larger than
+             without layers.
+             Cannot be used with lossless, significant_bits, max_bytes,
+             bits_per_element or stats.
+    sample_bits:  For integer arrays with significant_bits, the number of
+             bits per sample: 16 for np.int16, or 24 or 32 (the default)
+             for np.int32, for 24-bit audio stored in 32-bit integers.
+             The decompressed samples stay within the range of this many
+             bits.
+    channels:  If true, the input must be a 2-d float array of shape
+             (channels, samples), e.g. multichannel audio (for interleaved
+             samples, pass the transpose; it is not copied).  Each channel
+             is coded in its own stream, predicted from its previous sample
+             and from channel 0 with coefficients chosen per channel (so
+             stereo is coded roughly as mid/side), and can be decompressed
+             on its own (see the channel arg of decompress()).  Cannot be
+             used with lossless, significant_bits, max_bytes,
+             bits_per_element, stats, quantizable or layers.
   """
+  input = _as_ndarray(input)
   n_dim = len(input.shape)
 
   if not (n_dim > 0 and n_dim < 16):
     raise ValueError("Expected number of axes to be in [1,15], got: ",
                      n_dim)
 
-  input = input.astype(np.float32)
+  if channels:
+    if (lossless or significant_bits is not None or max_bytes is not None or
+        bits_per_element is not None or stats is not None or quantizable or
+        layers is not None):
+      raise ValueError("channels cannot be used with lossless, "
+                       "significant_bits, max_bytes, bits_per_element, stats, "
+                       "quantizable or layers")
+    if n_dim != 2 or input.dtype.kind != 'f':
+      raise ValueError("channels requires a 2-d float array of shape "
+                       "(channels, samples), got shape {} and dtype {}".format(
+                           input.shape, input.dtype))
+
+  if input.dtype.kind in 'iu':
+    if stats is not None:
+      raise ValueError("stats are only supported for float arrays")
+    if significant_bits is not None:
+      return compress_audio_array(input, do_regression, significant_bits,
+                                  sample_bits)
+    return compress_int_array(input, do_regression, arithmetic_coding)
+
+  if lossless:
+    if input.dtype not in (np.float32, np.float16):
+      raise ValueError("Lossless compression requires dtype np.float32, "
+                       "got: {}".format(input.dtype))
+    if max_bytes is not None or bits_per_element is not None:
+      raise ValueError("max_bytes and bits_per_element cannot be used "
+                       "with lossless compression")
+    if significant_bits is not None:
+      raise ValueError("significant_bits cannot be used with lossless "
+                       "compression")
+    if quantizable:
+      raise ValueError("quantizable cannot be used with lossless "
+                       "compression")
+  if layers is not None:
+    if (lossless or significant_bits is not None or max_bytes is not None or
+        bits_per_element is not None or stats is not None):
+      raise ValueError("layers cannot be used with lossless, significant_bits, "
+                       "max_bytes, bits_per_element or stats")
+    if not 1 <= layers <= lilcom_extension.LILCOM_MAX_LAYERS:
+      raise ValueError("Expected layers to be in [1,{}], got: {}".format(
+          lilcom_extension.LILCOM_MAX_LAYERS, layers))
+  if significant_bits is not None and not 3 <= significant_bits <= 31:
+    raise ValueError("Expected significant_bits to be in [3,31], got: {}".format(
+        significant_bits))
 
-  coeffs = regress_array(input, do_regression)
+  if not ((lossless or layers is not None or channels) and
+          input.dtype == np.float32 and
+          input.dtype.isnative and input.flags.aligned and
+          (channels or input.shape[-1] <= 1 or
+           input.strides[-1] == input.itemsize)):
+    # Lossy compression overwrites its input (see CompressFloat() in
+    # compression.h), so it always needs a copy; lossless compression
+    # and compression in layers only need one to convert the type or if
+    # the last axis is not contiguous, which CompressFloat() requires, and
+    # compression by channels only to convert the type.
+    input = input.astype(np.float32, order='C')
+
+  flags = 0
+  if arithmetic_coding:
+    flags |= lilcom_extension.LILCOM_FLAG_ARITHMETIC_CODING
+  if lossless:
+    flags |= lilcom_extension.LILCOM_FLAG_LOSSLESS
+  if significant_bits is not None:
+    flags |= lilcom_extension.LILCOM_FLAG_ADAPTIVE
+  else:
+    significant_bits = 0
+
+  if channels:
+    ans = lilcom_extension.compress_float_channels(input, tick_power, flags)
+    if not isinstance(ans, bytes):
+      raise RuntimeError("Something went wrong in compression, return value "
+                         "was ", ans)
+    return ans
+
+  if lossless:
+    coeffs = lossless_coeffs(
+        input, do_regression,
+        lambda a, int_coeffs: lilcom_extension.compress_float(
+            a, [ 0 ] + int_coeffs, flags))
+  else:
+    coeffs = regress_array(input, do_regression)
+    if quantizable:
+      coeffs = [ float(np.rint(x)) for x in coeffs ]
 
   # int_coeffs will be in [-256, 256]
   int_coeffs = [ round(x * 256) for x in coeffs ]
 
+  if max_bytes is None and bits_per_element is not None:
+    max_bytes = int(np.ceil(bits_per_element * input.size / 8))
+  if max_bytes is not None:
+    tick_power = lilcom_extension.choose_tick_power(input, int_coeffs,
+                                                    max_bytes, flags,
+                                                    significant_bits)
+    if tick_power is None:
+      raise RuntimeError("Something went wrong choosing the tick_power")
+
   meta = [ tick_power ] + int_coeffs
 
-  ans = lilcom_extension.compress_float(input, meta)
+  if layers is not None:
+    ans = lilcom_extension.compress_float_layered(input, meta, layers, flags)
+  else:
+    ans = lilcom_extension.compress_float(input, meta, flags,
+                                          significant_bits, stats)
   if not isinstance(ans, bytes):
     raise RuntimeError("Something went wrong in compression, return value was ",
                        ans);
+  if max_bytes is not None and len(ans) > max_bytes:
+    raise ValueError("Could not compress to within max_bytes={}; the "
+                     "smallest size possible is {}".format(max_bytes, len(ans)))
   return ans;
 
 
@@ -83,18 +265,181 @@ def regress_array(input, regression):
   return coeffs
 
 
-def decompress(byte_string):
+def compress_int_array(input, regression, arithmetic_coding):
+  """
+  Compresses a NumPy array of integers losslessly; see compress().
+  """
+  if not input.dtype.isnative:
+    input = input.astype(input.dtype.newbyteorder('='))
+  flags = 0
+  if arithmetic_coding:
+    flags |= lilcom_extension.LILCOM_FLAG_ARITHMETIC_CODING
+  coeffs = lossless_coeffs(
+      input, regression,
+      lambda a, int_coeffs: lilcom_extension.compress_int(a, int_coeffs,
+                                                          flags))
+  ans = lilcom_extension.compress_int(input, [ round(x * 256) for x in coeffs ],
+                                      flags)
+  if not isinstance(ans, bytes):
+    raise RuntimeError("Something went wrong in compression, return value was ",
+                       ans)
+  return ans
+
+
+def compress_audio_array(input, regression, significant_bits, sample_bits):
+  """
+  Compresses a NumPy array of 16, 24 or 32-bit audio samples with adaptive
+  precision (see CompressIntAdaptive() in compression.h); see compress().
+  """
+  if input.dtype not in (np.int16, np.int32):
+    raise ValueError("significant_bits can only be used with integer arrays "
+                     "of dtype np.int16 or np.int32, got: {}".format(
+                         input.dtype))
+  if not 3 <= significant_bits <= 31:
+    raise ValueError("Expected significant_bits to be in [3,31], got: {}".format(
+        significant_bits))
+  if sample_bits is None:
+    sample_bits = input.dtype.itemsize * 8
+  if sample_bits not in ((16,) if input.dtype == np.int16 else (24, 32)):
+    raise ValueError("Invalid sample_bits {} for dtype {}".format(
+        sample_bits, input.dtype))
+  if not input.dtype.isnative:
+    input = input.astype(input.dtype.newbyteorder('='))
+  coeffs = lossless_coeffs(
+      input, regression,
+      lambda a, int_coeffs: lilcom_extension.compress_int_adaptive(
+          a, int_coeffs, sample_bits, significant_bits))
+  ans = lilcom_extension.compress_int_adaptive(
+      input, [ round(x * 256) for x in coeffs ], sample_bits,
+      significant_bits)
+  if not isinstance(ans, bytes):
+    raise RuntimeError("Something went wrong in compression, return value was ",
+                       ans)
+  return ans
+
+
+def lossless_coeffs(input, regression, compress_fn):
+  """
+  Works out the regression coefficients to use for lossless compression (and
+  for compress_audio_array()).
+  For floats, the prediction is done on the integers that the floats are
+  mapped to (see LILCOM_FLAG_LOSSLESS in compression.h); least-squares
+  regression does not work well on those because changes of sign give huge
+  differences.  So we try predicting each element as the previous element
+  on each axis, and no prediction (and, for integer arrays, least-squares
+  regression), and choose whichever gives the smallest output on a corner
+  of the array.
+
+     @param [in] input   The array to be compressed.
+     @param [in] regression  True if we are doing regression; if false,
+                         coefficients will be all zero.
+     @param [in] compress_fn  A function taking an array and a list of
+                         integerized regression coefficients that returns
+                         the compressed array as bytes.
+
+  Returns a list of size len(input.shape) containing the regression
+  coefficients, in [-1..1].
+  """
+  num_axes = len(input.shape)
+  candidates = [ [ 0.0 ] * num_axes ]
+  if not regression or input.size == 0:
+    return candidates[0]
+  for axis in range(num_axes):
+    if input.shape[axis] > 1:
+      candidates.append([ 0.0 ] * num_axes)
+      candidates[-1][axis] = 1.0
+
+  # Take a corner of the array with at most about 16k elements.
+  dims = list(input.shape)
+  while np.prod(dims) > 16384 and max(dims) > 2:
+    axis = int(np.argmax(dims))
+    dims[axis] = max(2, dims[axis] // 2)
+  corner = np.ascontiguousarray(input[tuple(slice(0, d) for d in dims)])
+  if input.dtype.kind in 'iu':
+    candidates.append(regress_array(corner.astype(np.float64), True))
+
+  def size(coeffs):
+    return len(compress_fn(corner, [ round(x * 256) for x in coeffs ]))
+  return min(candidates, key=size)
+
+
+def peek_shape(byte_string):
+  """
+   Returns the shape of the array that was compressed into `byte_string`,
+   without decompressing it.  This only reads the header, so it is fast
+   however large the array is.
+
+   Args:
+       byte_string:    The data returned by compress() or concatenate(),
+                       as bytes or any other object that supports the
+                       buffer protocol (see decompress()).
+   Return:
+       A tuple of ints; raises ValueError if the input does not seem to be
+       compressed data.
+  """
+  _check_bytes_like(byte_string)
+  if _is_batch(byte_string):
+    row_dims, item_rows = lilcom_extension.get_batch_shape(byte_string)
+    return (sum(item_rows),) + row_dims
+  return lilcom_extension.peek_shape(byte_string)
+
+
+def decompress(byte_string, stats=None, out=None, dlpack=False,
+               max_layer=None, channel=None):
   """
    Decompresses audio data compressed by compress().
 
    Args:
-       input:    A bytes object as returned by compress()
+       input:    The data returned by compress(), as bytes or any other
+                 object that supports the buffer protocol with contiguous
+                 data, e.g. a bytearray, an mmap, or a memoryview of part
+                 of a larger buffer; it is not copied.  It may also be
+                 data returned by concatenate() or compress_batch(), which
+                 is decompressed as the concatenation of its arrays.
+       stats:    If a dict, it will be cleared and filled with statistics
+                 about the decompression, as for compress().  Only supported
+                 for float arrays that were not concatenated.
+       out:      If given, a writeable NumPy array (or np.memmap) to
+                 decompress into, instead of allocating a new one.  It must
+                 have the shape that was compressed (see peek_shape()) and
+                 exactly the dtype that decompress() would return, in native
+                 byte order; it may have any strides (e.g. it may be a
+                 slice of a larger array).  It may also be another array on
+                 the CPU that supports DLPack or __array_interface__, e.g.
+                 a tensor of another framework, which is written in place.
+       dlpack:   If true, return a DLPack capsule over the decompressed
+                 array instead of the array, for frameworks that take
+                 capsules (e.g. torch.utils.dlpack.from_dlpack()); it keeps
+                 the array alive, so nothing is copied.  (The NumPy array
+                 that is returned by default can also be passed to
+                 from_dlpack() functions, since it supports __dlpack__.)
+       max_layer: For data compressed with layers (see compress()), the
+                 layer to decompress up to: 0 for just the base layer, 1
+                 for it and the first refinement layer, and so on.  Only
+                 the first layer_sizes(byte_string)[max_layer] bytes of the
+                 data are needed, so byte_string may be just those.  If None
+                 (or more than the number of layers), all the layers are
+                 decompressed, which needs all of the data.  Ignored for
+                 other data; cannot be used with stats.
+       channel:  For data compressed with channels=True (see compress()),
+                 if given, decompress only this channel (an int), as a 1-d
+                 array of its samples; only its stream is decoded, and that
+                 of channel 0 if it is predicted from it.  The channels can
+                 be decompressed concurrently, e.g. with
+                 decompress_async(byte_string, channel=c) for each c.
+                 Cannot be used with stats or max_layer.
    Return:
-       On success returns a NumPy array of float; on failure
-       raises an exception.
+       On success returns a NumPy array of float, or of the integer type
+       that was compressed (`out`, if it was given), or a DLPack capsule
+       if dlpack is true; on failure raises an exception.
      """
-  if not isinstance(byte_string, bytes):
-    raise TypeError("Expected input to be of type `bytes`, got {}".format(type(byte_string)))
+  _check_bytes_like(byte_string)
+  if channel is not None and (stats is not None or max_layer is not None or
+                              _is_batch(byte_string)):
+    raise ValueError("channel cannot be used with stats, max_layer or "
+                     "concatenated data")
+  if _is_batch(byte_string):
+    return _decompress_concatenated(byte_string, stats, out, dlpack)
 
   shape = lilcom_extension.get_float_matrix_shape(byte_string)
 
@@ -102,15 +447,634 @@ def decompress(byte_string):
     raise ValueError("Could not work out shape of array from input: "
                      "is not really compressed data?")
 
-  ans = np.empty(shape, dtype=np.float32)
+  data_type = lilcom_extension.get_data_type(byte_string)
+  if data_type not in _dtypes:
+    raise ValueError("Could not work out type of array from input: "
+                     "is not really compressed data?")
+  if channel is not None:
+    if data_type != lilcom_extension.LILCOM_TYPE_FLOAT32 or len(shape) != 2:
+      raise ValueError("Expected data compressed with channels")
+    if not 0 <= channel < shape[0]:
+      raise ValueError("channel {} out of range for {} channels".format(
+          channel, shape[0]))
+    shape = shape[1:]
+
+  if out is None:
+    ans = np.empty(shape, dtype=_dtypes[data_type])
+  else:
+    ans = _as_ndarray(out, for_out=True)
+    _check_out(ans, shape, np.dtype(_dtypes[data_type]))
 
-  ret = lilcom_extension.decompress_float(byte_string, ans)
+  if data_type == lilcom_extension.LILCOM_TYPE_FLOAT32:
+    if channel is not None:
+      ret = lilcom_extension.decompress_float_channel(byte_string,
+                                                      int(channel), ans)
+      if ret == 8:
+        raise ValueError("Expected data compressed with channels")
+    elif max_layer is not None:
+      if stats is not None:
+        raise ValueError("stats cannot be used with max_layer")
+      ret = lilcom_extension.decompress_float_layers(byte_string, ans,
+                                                     int(max_layer))
+    elif stats is None:
+      ret = lilcom_extension.decompress_float(byte_string, ans)
+    else:
+      ret = lilcom_extension.decompress_float(byte_string, ans, stats)
+  else:
+    if stats is not None:
+      raise ValueError("stats are only supported for float arrays")
+    ret = lilcom_extension.decompress_int(byte_string, ans)
 
   if ret is None or ret != 0:
     raise ValueError("Something went wrong in decompression (likely bad data): "
-                     "decompress_float returned {}".format(ret))
+                     "decompression returned {}".format(ret))
+  elif dlpack:
+    return ans.__dlpack__()
+  else:
+    return ans if out is None else out
+
+
+def layer_sizes(byte_string):
+  """
+   Returns the sizes of the prefixes of data compressed with layers (see
+   compress()) that decompress() needs for each max_layer, e.g. to know how
+   much of a file or a network stream to read for a preview.
+
+   Args:
+       byte_string:  The data returned by compress(..., layers=L), as bytes
+                 or any other bytes-like object (see decompress()).  Only
+                 its header and the 8 bytes after it are read, so it may be
+                 just a prefix that contains them; the first 32 + 10 * ndim
+                 bytes (where ndim is the number of axes) always do.
+   Return:
+       A list of L + 1 ints, where element k is the number of bytes at the
+       start of the data that decompress(..., max_layer=k) needs; the last
+       one is the size of the whole data.  Raises ValueError if the input
+       is not data compressed with layers.
+  """
+  _check_bytes_like(byte_string)
+  ans = lilcom_extension.get_layer_sizes(byte_string)
+  if ans is None:
+    raise ValueError("Expected data compressed with layers")
+  return ans
+
+
+def decompress_quantized(byte_string, dtype=np.int16, out=None):
+  """
+   Decompresses data that was compressed by compress() from an array of
+   floats to integers in units of the tick, 2^tick_power, without
+   materializing the floats: the integers times the returned scale are the
+   values that decompress() would return.  This is for when the values are
+   going to be processed as integers anyway (e.g. quantized inference),
+   and avoids the float array and the second quantization pass.
+
+   It is exact only if the values are integer multiples of the tick, which
+   is so if the data was compressed with quantizable=True (or with
+   do_regression=False); otherwise the data is decompressed to floats and
+   rounded to the nearest multiple of the tick, which adds an error of up
+   to half a tick.
+
+   Args:
+       byte_string:  The data returned by compress(), as for decompress()
+       dtype:    The dtype of the result: np.int8, np.int16 or np.int32.
+       out:      If given, a NumPy array to decompress into, as for
+                 decompress(); it must have exactly this dtype.
+   Return:
+       Returns a tuple (ans, scale), where ans is the NumPy array of
+       integers (`out`, if it was given) and scale is 2.0**tick_power.
+       Raises ValueError if a value was out of the range of dtype, or on
+       other failures.
+  """
+  _check_bytes_like(byte_string)
+  dtype = np.dtype(dtype)
+  if dtype not in (np.int8, np.int16, np.int32):
+    raise ValueError("Expected dtype to be np.int8, np.int16 or np.int32, "
+                     "got {}".format(dtype))
+  if lilcom_extension.get_data_type(byte_string) != \
+     lilcom_extension.LILCOM_TYPE_FLOAT32:
+    raise ValueError("Expected compressed data of type np.float32")
+  shape = lilcom_extension.get_float_matrix_shape(byte_string)
+  if shape is None:
+    raise ValueError("Could not work out shape of array from input: "
+                     "is not really compressed data?")
+  if out is None:
+    ans = np.empty(shape, dtype=dtype)
+  else:
+    ans = _as_ndarray(out, for_out=True)
+    _check_out(ans, shape, dtype)
+
+  ret = lilcom_extension.decompress_quantized(byte_string, ans)
+  if ret is None:
+    raise ValueError("Something went wrong in decompression")
+  code, tick_power = ret
+  scale = 2.0 ** tick_power
+  if code == 11:
+    # Not integer multiples of the tick (see DecompressQuantized() in
+    # compression.h): requantize the floats.
+    values = np.rint(decompress(byte_string) / np.float32(scale))
+    info = np.iinfo(dtype)
+    if values.size != 0 and (values.min() < info.min or values.max() > info.max):
+      code = 12
+    else:
+      ans[...] = values
+      code = 0
+  if code == 12:
+    raise ValueError("The values are out of the range of {} in units of "
+                     "the tick {}".format(dtype, scale))
+  if code != 0:
+    raise ValueError("Something went wrong in decompression (likely bad data): "
+                     "decompression returned {}".format(code))
+  return (ans if out is None else out), scale
+
+
+def compress_batch(arrays,
+                   tick_power=-8,
+                   do_regression=True,
+                   arithmetic_coding=False,
+                   lossless=False,
+                   significant_bits=None,
+                   chunk_elements=None):
+  """
+  Compresses many small float arrays (e.g. per-utterance features, or the
+  embeddings of individual tokens) into one bytes object, much smaller than
+  compressing them one by one: consecutive arrays are compressed together
+  in chunks, so the header and the start-up cost of the coder are shared
+  and the regression works across them, while decompress_batch() can still
+  decompress any one of them without decompressing the others.
+
+  Args:
+    arrays:  A sequence of arrays of floats (as for compress()), all with the
+             same number of axes in [1,15] and the same dims except on axis
+             0, which may be different for each array (and may be 0).
+    tick_power, do_regression, arithmetic_coding, lossless,
+    significant_bits:  As for compress(); they are used for all the arrays,
+             and the regression coefficients are estimated on all of them
+             together.
+    chunk_elements:  If specified, the approximate number of elements per
+             chunk (default: lilcom_extension.LILCOM_BATCH_CHUNK_ELEMENTS,
+             8192).  Smaller chunks make decompressing one array faster but
+             the output larger.
+
+  Return:
+    A bytes object, which can be passed to decompress_batch() and
+    batch_shapes() (and to decompress(), which returns all the arrays
+    concatenated).
+  """
+  arrays = [ _as_ndarray(a) for a in arrays ]
+  if len(arrays) == 0:
+    raise ValueError("Expected at least one array")
+  n_dim = len(arrays[0].shape)
+  if not (n_dim > 0 and n_dim < 16):
+    raise ValueError("Expected number of axes to be in [1,15], got: ",
+                     n_dim)
+  for a in arrays:
+    if a.dtype.kind != 'f':
+      raise ValueError("Expected arrays of floats, got {}".format(a.dtype))
+    if a.shape[1:] != arrays[0].shape[1:]:
+      raise ValueError("Expected arrays with the same dims except on axis 0, "
+                       "got {} and {}".format(arrays[0].shape, a.shape))
+  if lossless:
+    if any(a.dtype not in (np.float32, np.float16) for a in arrays):
+      raise ValueError("Lossless compression requires dtype np.float32")
+    if significant_bits is not None:
+      raise ValueError("significant_bits cannot be used with lossless "
+                       "compression")
+  if significant_bits is not None and not 3 <= significant_bits <= 31:
+    raise ValueError("Expected significant_bits to be in [3,31], got: {}".format(
+        significant_bits))
+  if chunk_elements is None:
+    chunk_elements = lilcom_extension.LILCOM_BATCH_CHUNK_ELEMENTS
+  if chunk_elements < 1:
+    raise ValueError("Expected chunk_elements to be positive, got: {}".format(
+        chunk_elements))
+
+  # CompressFloatBatch() copies the arrays, so they don't need to be
+  # copies, just contiguous float32.
+  arrays = [ np.ascontiguousarray(a, dtype=np.float32) for a in arrays ]
+
+  flags = 0
+  if arithmetic_coding:
+    flags |= lilcom_extension.LILCOM_FLAG_ARITHMETIC_CODING
+  if lossless:
+    flags |= lilcom_extension.LILCOM_FLAG_LOSSLESS
+  if significant_bits is not None:
+    flags |= lilcom_extension.LILCOM_FLAG_ADAPTIVE
   else:
+    significant_bits = 0
+
+  all_arrays = np.concatenate(arrays)
+  if lossless:
+    coeffs = lossless_coeffs(
+        all_arrays, do_regression,
+        lambda a, int_coeffs: lilcom_extension.compress_float(
+            a, [ 0 ] + int_coeffs, flags))
+  else:
+    coeffs = regress_array(all_arrays, do_regression)
+  meta = [ tick_power ] + [ round(x * 256) for x in coeffs ]
+
+  ans = lilcom_extension.compress_batch(arrays, meta, flags, significant_bits,
+                                        chunk_elements)
+  if not isinstance(ans, bytes):
+    raise RuntimeError("Something went wrong in compression, return value was ",
+                       ans)
+  return ans
+
+
+def batch_shapes(byte_string):
+  """
+   Returns the shapes of the arrays that were compressed into `byte_string`
+   by compress_batch() (or joined by concatenate()), without decompressing
+   them, as a list of tuples of
+   ints.  Raises ValueError if the input is not such data.
+  """
+  _check_bytes_like(byte_string)
+  row_dims, item_rows = lilcom_extension.get_batch_shape(byte_string)
+  return [ (rows,) + row_dims for rows in item_rows ]
+
+
+def decompress_batch(byte_string, index=None):
+  """
+   Decompresses arrays that were compressed by compress_batch(), or
+   joined by concatenate().  Only the chunks that contain the requested
+   arrays are decompressed.
+
+   Args:
+       byte_string:  The data returned by compress_batch() or
+                 concatenate(), as bytes or any other bytes-like object
+                 (see decompress()).
+       index:    If an int, the index of the array to return (negative
+                 values count from the end, as for a list).  If a slice
+                 (with step 1), the arrays in that range are returned, as a
+                 list.  If None, all the arrays are returned, as a list.
+   Return:
+       A NumPy array of np.float32 if index is an int, else a list of them
+       (which are views of one array).  Raises IndexError if index is out of
+       range and ValueError if decompression failed.
+  """
+  _check_bytes_like(byte_string)
+  row_dims, item_rows = lilcom_extension.get_batch_shape(byte_string)
+  num_items = len(item_rows)
+  if index is None:
+    index = slice(None)
+  if isinstance(index, slice):
+    begin, end, step = index.indices(num_items)
+    if step != 1:
+      raise ValueError("Expected a slice with step 1, got {}".format(index))
+    end = max(begin, end)
+  else:
+    begin = int(index)
+    if begin < 0:
+      begin += num_items
+    if not 0 <= begin < num_items:
+      raise IndexError("Index {} out of range for a batch of {} "
+                       "arrays".format(index, num_items))
+    end = begin + 1
+
+  rows = item_rows[begin:end]
+  ans = np.empty((sum(rows),) + row_dims, dtype=np.float32)
+  ret = lilcom_extension.decompress_batch(byte_string, begin, end, ans)
+  if ret is None or ret != 0:
+    raise ValueError("Something went wrong in decompression (likely bad data): "
+                     "decompression returned {}".format(ret))
+  if not isinstance(index, slice):
     return ans
+  return np.split(ans, np.cumsum(rows[:-1])) if rows else []
+
+
+def concatenate(byte_strings):
+  """
+  Concatenates compressed arrays along axis 0 without decompressing them,
+  e.g. to build a shard of training data from per-utterance arrays.  The
+  compressed data of each one is copied unchanged and only a table of the
+  arrays is written, so this costs about as much as copying the bytes,
+  and the result decompresses to exactly the concatenation of what the
+  inputs decompress to.
+
+  Args:
+    byte_strings:  A non-empty sequence of data returned by compress() for
+             arrays of floats (with any tick_power and other options),
+             compress_batch() or concatenate(), as bytes or other
+             bytes-like objects.  They must all have the same number of
+             axes and the same dims except on axis 0.
+  Return:
+    A bytes object in the format of compress_batch().  decompress() and
+    peek_shape() treat it as the concatenated array, while
+    decompress_batch() and batch_shapes() give the arrays that were
+    concatenated separately (with the arrays of any batches that were
+    inputs).  Raises ValueError if an input is not valid or the dims do
+    not match.
+  """
+  byte_strings = list(byte_strings)
+  if len(byte_strings) == 0:
+    raise ValueError("Expected at least one input")
+  for b in byte_strings:
+    _check_bytes_like(b)
+  ans = lilcom_extension.concatenate(byte_strings)
+  if ans is None:
+    raise ValueError("Could not concatenate: the inputs must be compressed "
+                     "arrays of floats or batches, with the same dims "
+                     "except on axis 0")
+  return ans
+
+
+def _is_batch(byte_string):
+  """
+  Returns true if byte_string (which must be bytes-like) starts like a
+  batch, as returned by compress_batch() or concatenate(), rather than
+  an array returned by compress().
+  """
+  try:
+    with memoryview(byte_string).cast('B') as view:
+      return len(view) >= 2 and view[1] == ord('B')
+  except TypeError:  # Not contiguous; the extension will reject it.
+    return False
+
+
+def _decompress_concatenated(byte_string, stats, out, dlpack):
+  """
+  Implements decompress() for a batch, which is decompressed as the
+  concatenation of its arrays.
+  """
+  if stats is not None:
+    raise ValueError("stats are not supported for concatenated data")
+  row_dims, item_rows = lilcom_extension.get_batch_shape(byte_string)
+  shape = (sum(item_rows),) + row_dims
+  if out is None:
+    ans = np.empty(shape, dtype=np.float32)
+  else:
+    ans = _as_ndarray(out, for_out=True)
+    _check_out(ans, shape, np.dtype(np.float32))
+  # lilcom_extension.decompress_batch() needs a C-contiguous array.
+  dest = ans if ans.flags.c_contiguous else np.empty(shape, dtype=np.float32)
+  ret = lilcom_extension.decompress_batch(byte_string, 0, len(item_rows),
+                                          dest)
+  if ret is None or ret != 0:
+    raise ValueError("Something went wrong in decompression (likely bad data): "
+                     "decompression returned {}".format(ret))
+  if dest is not ans:
+    ans[...] = dest
+  if dlpack:
+    return ans.__dlpack__()
+  return ans if out is None else out
+
+
+class _BoundedExecutor:
+  """
+  A thread pool whose queue of pending work is bounded: submit() blocks
+  while there are max_pending calls that have not finished.  The workers
+  are Python threads, but they run in parallel because the extension
+  releases the GIL while it compresses or decompresses.
+  """
+  def __init__(self, num_workers, max_pending):
+    self.pool = concurrent.futures.ThreadPoolExecutor(
+        max_workers=num_workers, thread_name_prefix='lilcom')
+    self.slots = threading.BoundedSemaphore(max_pending)
+
+  def submit(self, fn, *args, **kwargs):
+    self.slots.acquire()
+    try:
+      future = self.pool.submit(fn, *args, **kwargs)
+    except:
+      self.slots.release()
+      raise
+    future.add_done_callback(lambda f: self.slots.release())
+    return future
+
+
+_executor = None
+_executor_lock = threading.Lock()
+
+
+def set_executor(num_workers=None, max_pending=None):
+  """
+   Configures the executor used by compress_async() and decompress_async(),
+   replacing the current one (after the work already submitted to it has
+   finished).  It is created with the defaults on first use if this is not
+   called.
+
+   Args:
+       num_workers:  The number of worker threads; defaults to the number
+                 of CPUs.
+       max_pending:  The maximum number of calls that may be submitted and
+                 not yet finished; further calls block until one finishes.
+                 Defaults to 4 * num_workers.
+  """
+  global _executor
+  executor = _make_executor(num_workers, max_pending)
+  with _executor_lock:
+    old_executor = _executor
+    _executor = executor
+  if old_executor is not None:
+    old_executor.pool.shutdown(wait=True)
+
+
+def _make_executor(num_workers, max_pending):
+  if num_workers is None:
+    num_workers = os.cpu_count() or 1
+  if max_pending is None:
+    max_pending = 4 * num_workers
+  if num_workers < 1 or max_pending < 1:
+    raise ValueError("Expected num_workers and max_pending to be positive, "
+                     "got {} and {}".format(num_workers, max_pending))
+  return _BoundedExecutor(num_workers, max_pending)
+
+
+def _get_executor():
+  global _executor
+  # The check and the creation are done together under the lock, so that
+  # threads using it for the first time at once create only one.
+  with _executor_lock:
+    if _executor is None:
+      _executor = _make_executor(None, None)
+    return _executor
+
+
+def compress_async(input, *args, **kwargs):
+  """
+   Like compress(), but runs in the background on a thread of the executor
+   (see set_executor()), and returns a concurrent.futures.Future whose
+   result will be the bytes.  In asyncio code, use
+   `await asyncio.wrap_future(lilcom.compress_async(a))`.  `input` must not
+   be modified until the future is done.  Blocks if max_pending calls are
+   already pending.
+  """
+  return _get_executor().submit(compress, input, *args, **kwargs)
+
+
+def decompress_async(byte_string, *args, **kwargs):
+  """
+   Like decompress(), but runs in the background as for compress_async(),
+   and returns a concurrent.futures.Future whose result will be the array.
+   `byte_string` (and `out`, if given) must not be modified until the
+   future is done.
+  """
+  return _get_executor().submit(decompress, byte_string, *args, **kwargs)
+
+
+class Loader:
+  """
+  Iterates over batches of compressed arrays, decompressing ahead of the
+  consumer on the threads of the executor (see set_executor()), e.g. to
+  feed a model in a training loop.  The arrays of each batch are stacked
+  along a new axis 0 and decompressed directly into one of a ring of
+  num_buffers preallocated arrays, so memory use is bounded, decompression
+  overlaps with whatever the consumer does with the previous batches, and
+  nothing is copied or pickled between processes.
+
+  The array yielded for a batch is a view of its buffer, which is reused
+  for a later batch once the next one is requested; copy it if it must be
+  kept for longer.  Each iteration over the Loader is one pass over the
+  items.
+
+  Args:
+    items:   A sequence of compressed arrays: each may be data returned by
+             compress() (or concatenate()), as bytes or another bytes-like
+             object, or a tuple (buffer, offset, num_bytes) of a bytes-like
+             object (e.g. an mmap of an archive), the offset of the data in
+             it and its size, which is viewed without copying.  They must
+             all have the same shape and dtype, which are read from the
+             header of the first one.
+    batch_size:  The number of arrays per batch.
+    num_buffers:  The number of batch buffers; up to num_buffers - 1
+             batches are decompressed ahead of the one the consumer has.
+             Must be at least 2.
+    drop_last:  If true, a last batch with fewer than batch_size arrays is
+             not yielded; if false, it is yielded as a shorter array.
+  """
+  def __init__(self, items, batch_size, num_buffers=4, drop_last=False):
+    if batch_size < 1 or num_buffers < 2:
+      raise ValueError("Expected batch_size >= 1 and num_buffers >= 2, got "
+                       "{} and {}".format(batch_size, num_buffers))
+    self.items = [ Loader._item_bytes(item) for item in items ]
+    self.batch_size = batch_size
+    self.num_buffers = num_buffers
+    self.num_batches = (len(self.items) // batch_size if drop_last else
+                        -(-len(self.items) // batch_size))
+    if self.items:
+      first = self.items[0]
+      self.item_shape = peek_shape(first)
+      self.dtype = np.dtype(np.float32 if _is_batch(first) else
+                            _dtypes.get(lilcom_extension.get_data_type(first),
+                                        np.float32))
+
+  @staticmethod
+  def _item_bytes(item):
+    if isinstance(item, tuple):
+      buffer, offset, num_bytes = item
+      view = memoryview(buffer).cast('B')
+      if offset < 0 or num_bytes < 0 or offset + num_bytes > len(view):
+        raise ValueError("Item ({}, {}) is out of range for a buffer of {} "
+                         "bytes".format(offset, num_bytes, len(view)))
+      return view[offset:offset + num_bytes]
+    _check_bytes_like(item)
+    return item
+
+  def __len__(self):
+    return self.num_batches
+
+  def __iter__(self):
+    if self.num_batches == 0:
+      return
+    executor = _get_executor()
+    buffers = np.empty((self.num_buffers, self.batch_size) + self.item_shape,
+                       dtype=self.dtype)
+    pending = collections.deque()  # The futures of each batch, in order.
+
+    def start(b):
+      dest = buffers[b % self.num_buffers]
+      items = self.items[b * self.batch_size:(b + 1) * self.batch_size]
+      pending.append([ executor.submit(decompress, item, out=dest[i])
+                       for i, item in enumerate(items) ])
+
+    try:
+      for b in range(min(self.num_buffers, self.num_batches)):
+        start(b)
+      for b in range(self.num_batches):
+        futures = pending.popleft()
+        for future in futures:
+          future.result()  # Raises the exception if decompression failed.
+        yield buffers[b % self.num_buffers][:len(futures)]
+        # The consumer has asked for the next batch, so the buffer of this
+        # one can be refilled.
+        if b + self.num_buffers < self.num_batches:
+          start(b + self.num_buffers)
+    finally:
+      # If the consumer stopped early or decompression failed, don't
+      # decompress the batches that will not be used.
+      for futures in pending:
+        for future in futures:
+          future.cancel()
+
+
+def _check_bytes_like(byte_string):
+  """
+  Raises TypeError if byte_string does not support the buffer protocol.
+  """
+  try:
+    memoryview(byte_string).release()
+  except TypeError:
+    raise TypeError("Expected input to be bytes or another bytes-like object, "
+                    "got {}".format(type(byte_string)))
+
+
+def _as_ndarray(obj, for_out=False):
+  """
+  Returns a NumPy array that views the same memory as `obj`, without
+  copying it if possible: `obj` itself if it is a NumPy array, or a view
+  of an object that supports DLPack (on the CPU), __array_interface__ or
+  the buffer protocol.  Otherwise, if for_out is false it returns
+  np.asarray(obj) (which may copy), and if it is true (for the `out` arg
+  of decompress(), which must be written in place) it raises ValueError.
+  """
+  if isinstance(obj, np.ndarray):
+    return obj
+  if hasattr(obj, '__array_interface__'):
+    return np.asarray(obj)
+  if hasattr(obj, '__dlpack__'):
+    try:
+      return np.from_dlpack(obj)
+    except (BufferError, RuntimeError, TypeError) as e:
+      raise ValueError("Could not view {} as a NumPy array through DLPack "
+                       "(is it on the CPU?): {}".format(type(obj), e))
+  if for_out:
+    try:
+      memoryview(obj).release()
+    except TypeError:
+      raise ValueError("Expected out to be a NumPy array or another "
+                       "array, got {}".format(type(obj)))
+  return np.asarray(obj)
+
+
+def _check_out(out, shape, dtype):
+  """
+  Raises ValueError if `out` is not suitable as the `out` arg of
+  decompress(), for data of this shape and dtype.
+  """
+  if not isinstance(out, np.ndarray):
+    raise ValueError("Expected out to be a NumPy array, got {}".format(type(out)))
+  if out.shape != tuple(shape):
+    raise ValueError("Expected out to have shape {}, got {}".format(
+        tuple(shape), out.shape))
+  if out.dtype != dtype or not out.dtype.isnative:
+    raise ValueError("Expected out to have dtype {} (native byte order), "
+                     "got {}".format(dtype, out.dtype))
+  if not out.flags.writeable:
+    raise ValueError("out is not writeable")
+  if not out.flags.aligned or any(s % out.itemsize != 0 for s in out.strides):
+    raise ValueError("out must be aligned, with strides that are multiples "
+                     "of the element size")
+
+
+# Maps from the element types returned by get_data_type() to NumPy dtypes.
+_dtypes = { lilcom_extension.LILCOM_TYPE_FLOAT32: np.float32,
+            lilcom_extension.LILCOM_TYPE_INT8: np.int8,
+            lilcom_extension.LILCOM_TYPE_UINT8: np.uint8,
+            lilcom_extension.LILCOM_TYPE_INT16: np.int16,
+            lilcom_extension.LILCOM_TYPE_UINT16: np.uint16,
+            lilcom_extension.LILCOM_TYPE_INT32: np.int32,
+            lilcom_extension.LILCOM_TYPE_UINT32: np.uint32,
+            lilcom_extension.LILCOM_TYPE_INT64: np.int64,
+            lilcom_extension.LILCOM_TYPE_UINT64: np.uint64 }
 
 
 
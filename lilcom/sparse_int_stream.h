@@ -0,0 +1,169 @@
+#ifndef __LILCOM__SPARSE_INT_STREAM_H_
+#define __LILCOM__SPARSE_INT_STREAM_H_ 1
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <vector>
+#include <limits>
+
+
+/**
+   This header contains SparseIntStream and ReverseSparseIntStream, which
+   are wrappers for IntStream and ReverseIntStream (or any classes with the
+   same interface, e.g. ArithIntStream) that are efficient for sequences
+   that are mostly zero.
+
+   The sequence is divided into segments, each consisting of a run of zeros
+   followed by a run of nonzero values.  For each segment we write to the
+   underlying stream the number of zeros, the number of nonzero values, and
+   then the nonzero values themselves; since they are known to be nonzero,
+   positive values are written minus one.  This means that the cost of a
+   run of zeros does not depend on its length (except logarithmically), and
+   the decoder can skip a run of zeros without reading each element.
+*/
+
+
+/**
+   class SparseIntStream encodes signed integers that are mostly zero.
+   IntStreamType would be IntStream, IntStreamSizeEstimator or
+   ArithIntStream.
+
+   See also class ReverseSparseIntStream.
+ */
+template <class IntStreamType>
+class SparseIntStream {
+ public:
+  /* Constructor.  `is` is the stream to write to; it is not owned here. */
+  SparseIntStream(IntStreamType *is): is_(is), num_zeros_(0),
+                                      finished_(false) { }
+
+  inline void Write(int32_t value) {
+    assert(!finished_);
+    if (value == 0) {
+      if (!nonzeros_.empty() || num_zeros_ == kMaxRun)
+        WriteSegment();
+      num_zeros_++;
+    } else {
+      if (nonzeros_.size() == kMaxRun)
+        WriteSegment();
+      nonzeros_.push_back(value > 0 ? value - 1 : value);
+    }
+  }
+
+  /* Exchanges the memory that this object uses to hold a run of nonzero
+     values with `*nonzeros`, so that it can be reused by later objects.
+     It must be called before the first Write() with an empty vector (e.g.
+     one that has been cleared), and may be called again after Finish() to
+     get the memory back. */
+  void SwapNonzeros(std::vector<int32_t> *nonzeros) {
+    assert(nonzeros_.empty() && nonzeros->empty());
+    nonzeros_.swap(*nonzeros);
+  }
+
+  /* Must be called after the last call to Write(), before getting the code
+     from the underlying stream. */
+  void Finish() {
+    assert(!finished_);
+    finished_ = true;
+    if (num_zeros_ != 0 || !nonzeros_.empty())
+      WriteSegment();
+  }
+
+ private:
+  /* Writes the current segment (num_zeros_ zeros followed by nonzeros_) to
+     the underlying stream. */
+  void WriteSegment() {
+    is_->Write(num_zeros_);
+    is_->Write((int32_t)nonzeros_.size());
+    for (std::vector<int32_t>::const_iterator iter = nonzeros_.begin();
+         iter != nonzeros_.end(); ++iter)
+      is_->Write(*iter);
+    num_zeros_ = 0;
+    nonzeros_.clear();
+  }
+
+  /* kMaxRun is the largest number of zeros or nonzeros in one segment,
+     so the counts can be written as int32_t. */
+  static const int32_t kMaxRun = std::numeric_limits<int32_t>::max();
+
+  IntStreamType *is_;
+  /* The number of zeros at the start of the current segment. */
+  int32_t num_zeros_;
+  /* The nonzero values in the current segment (after the zeros), already
+     modified as they will be written. */
+  std::vector<int32_t> nonzeros_;
+  bool finished_;
+};
+
+
+/*
+  This class is for decoding data encoded by class SparseIntStream.
+  ReverseIntStreamType would be ReverseIntStream or ReverseArithIntStream.
+ */
+template <class ReverseIntStreamType>
+class ReverseSparseIntStream {
+ public:
+  /* Constructor.  `ris` is the stream to read from; it is not owned here. */
+  ReverseSparseIntStream(ReverseIntStreamType *ris):
+      ris_(ris), num_zeros_(0), num_nonzeros_(0) { }
+
+  /*
+    Returns the number of zeros that the next Read() calls will return before
+    the next nonzero value (limited to the current segment, so a return value
+    of zero does not necessarily mean the next value is nonzero, if the
+    stream was not finished).  Returns -1 on failure to read (truncated or
+    corrupted stream).
+  */
+  inline int64_t NumZeros() {
+    if (num_zeros_ == 0 && num_nonzeros_ == 0 && !ReadSegment())
+      return -1;
+    return num_zeros_;
+  }
+
+  /* Skips `n` zeros; requires n <= NumZeros(). */
+  inline void SkipZeros(int64_t n) {
+    assert(n <= num_zeros_);
+    num_zeros_ -= n;
+  }
+
+  /*
+    Read in an integer that was encoded by class SparseIntStream.  Returns
+    true on success, false on failure (truncated or corrupted stream).
+  */
+  inline bool Read(int32_t *value) {
+    if (num_zeros_ == 0 && num_nonzeros_ == 0 && !ReadSegment())
+      return false;
+    if (num_zeros_ > 0) {
+      num_zeros_--;
+      *value = 0;
+      return true;
+    }
+    int32_t v;
+    if (!ris_->Read(&v))
+      return false;
+    num_nonzeros_--;
+    *value = (v >= 0 ? v + 1 : v);
+    return true;
+  }
+
+  /* Returns a pointer to one past the end of the last byte read from the
+     underlying stream. */
+  const char *NextCode() const { return ris_->NextCode(); }
+
+ private:
+  bool ReadSegment() {
+    return ris_->Read(&num_zeros_) && ris_->Read(&num_nonzeros_) &&
+        num_zeros_ >= 0 && num_nonzeros_ >= 0 &&
+        (num_zeros_ > 0 || num_nonzeros_ > 0);
+  }
+
+  ReverseIntStreamType *ris_;
+  /* The number of zeros remaining before the nonzeros in the current
+     segment. */
+  int32_t num_zeros_;
+  /* The number of nonzero values remaining in the current segment. */
+  int32_t num_nonzeros_;
+};
+
+
+#endif /* __LILCOM__SPARSE_INT_STREAM_H_ */
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <cassert>
+#include <iostream>
+#include "int_stream.h"
+#include "sparse_int_stream.h"
+
+
+/* Returns a random value that is zero with probability `zero_prob`. */
+int32_t rand_sparse(float zero_prob) {
+  if (rand() < zero_prob * RAND_MAX)
+    return 0;
+  return (rand() % 2000) - 1000;
+}
+
+void sparse_int_stream_test_read() {
+  int32_t input[1000];
+  for (int num_ints = 1; num_ints < 1000; num_ints += 11) {
+    float zero_prob = (num_ints % 10) / 10.0;
+    IntStream is;
+    SparseIntStream<IntStream> sis(&is);
+    for (int i = 0; i < num_ints; i++) {
+      input[i] = rand_sparse(zero_prob);
+      sis.Write(input[i]);
+    }
+    sis.Finish();
+    const char *code = &(is.Code()[0]),
+        *code_end = code + is.Code().size();
+
+    ReverseIntStream ris(code, code_end);
+    ReverseSparseIntStream<ReverseIntStream> rsis(&ris);
+    for (int i = 0; i < num_ints; i++) {
+      int32_t r;
+      bool ans = rsis.Read(&r);
+      assert(ans);
+      if (r != input[i]) {
+        std::cout << "Failure, " << r << " != " << input[i] << "\n";
+        exit(1);
+      }
+    }
+    assert(rsis.NextCode() == code_end);
+  }
+}
+
+void sparse_int_stream_test_skip() {
+  /* 100 zeros, 3 nonzeros, then 50 zeros. */
+  IntStream is;
+  SparseIntStream<IntStream> sis(&is);
+  for (int i = 0; i < 153; i++)
+    sis.Write(i >= 100 && i < 103 ? i : 0);
+  sis.Finish();
+  ReverseIntStream ris(&(is.Code()[0]),
+                       &(is.Code()[0]) + is.Code().size());
+  ReverseSparseIntStream<ReverseIntStream> rsis(&ris);
+  assert(rsis.NumZeros() == 100);
+  rsis.SkipZeros(60);
+  assert(rsis.NumZeros() == 40);
+  rsis.SkipZeros(40);
+  assert(rsis.NumZeros() == 0);
+  for (int i = 100; i < 103; i++) {
+    int32_t r;
+    assert(rsis.Read(&r) && r == i);
+  }
+  assert(rsis.NumZeros() == 50);
+  rsis.SkipZeros(50);
+  assert(rsis.NextCode() == &(is.Code()[0]) + is.Code().size());
+  /* The whole thing should take only a few bytes. */
+  std::cout << "Size of sparse code is " << is.Code().size() << " bytes\n";
+  assert(is.Code().size() < 16);
+}
+
+
+int main() {
+  sparse_int_stream_test_read();
+  sparse_int_stream_test_skip();
+  std::cout << "Done\n";
+}
@@ -31,15 +31,38 @@ def read(fname):
     return open(os.path.join(os.path.dirname(__file__), fname)).read()
 
 extension_mod = Extension("lilcom.lilcom_extension",
+                          # These are the sources of liblilcom (see
+                          # lilcom/CMakeLists.txt): compression.cc compiled
+                          # for several instruction sets, and the code that
+                          # chooses between them when it is first used.
                           sources=["lilcom/lilcom_extension.cc",
-                                   "lilcom/compression.cc"],
-                          # Actually it turns out that the optimization level
-                          # and debugging code makes very little difference to
-                          # the speed, so we're using options designed to
-                          # catch errors.  -ftrapv detects overflow in
-                          # signed integer arithmetic (which technically
-                          # leads to undefined behavior).
-                          extra_compile_args=["-g", "-Wall", "-UNDEBUG", "-Wno-c++11-compat-deprecated-writable-strings"], #, "-ftrapv"],
+                                   "lilcom/compression_default.cc",
+                                   "lilcom/compression_avx2.cc",
+                                   "lilcom/compression_avx512.cc",
+                                   "lilcom/cpu_dispatch.cc",
+                                   "lilcom/batch.cc"],
+                          # -ffp-contract=off is required so that those
+                          # variants give exactly the same output (see
+                          # lilcom/compression_variant.h).  Invalid input
+                          # is detected by explicit checks, not asserts, so
+                          # we compile with NDEBUG.
+                          extra_compile_args=["-O3", "-DNDEBUG", "-Wall",
+                                              "-ffp-contract=off",
+                                              "-Wno-c++11-compat-deprecated-writable-strings"],
+                          depends=["lilcom/" + f for f in [
+                              "compression.cc", "compression.h",
+                              "compression_variant.h", "codec_stats.h", "codec_context.h",
+                              "batch.h",
+                              "int_stream.h", "arith_int_stream.h",
+                              "sparse_int_stream.h", "bit_stream.h",
+                              "int_math_utils.h"]],
+                          # LILCOM_STATS lets compress() and decompress()
+                          # return statistics (see lilcom/codec_stats.h);
+                          # it costs one test per 32 codes when they are
+                          # not asked for.  Set LILCOM_NO_STATS=1 in the
+                          # environment to build without it.
+                          define_macros=([] if os.environ.get('LILCOM_NO_STATS') else
+                                         [('LILCOM_STATS', '1')]),
                           include_dirs=[numpy.get_include()])
 
 setup(
@@ -57,6 +80,9 @@ setup(
     long_description=read('README.md'),
     long_description_content_type="text/markdown",
     install_requires=['numpy'],
+    entry_points={
+        'console_scripts': [ 'lilcom-bench=lilcom.bench:main' ],
+    },
     classifiers=[
         "Development Status :: 4 - Beta",
         "Programming Language :: Python :: 3",
@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+
+import copy
+import json
+import os
+import tempfile
+
+from lilcom import bench
+
+
+def test_bench():
+    with tempfile.TemporaryDirectory() as d:
+        baseline = os.path.join(d, 'baseline.json')
+        assert bench.main([ '--scale=0.01', '--tick-powers=-8', '--reps=1',
+                            '--output=' + baseline ]) == 0
+        with open(baseline) as f:
+            results = json.load(f)
+        assert len(results['results']) == 8  # 4 corpora x regression on/off
+        for r in results['results']:
+            assert 0 < r['bytes_per_element'] < 4
+            assert r['max_error'] <= 2.0 ** -9
+
+        assert bench.compare(results, results) == []
+        worse = copy.deepcopy(results)
+        worse['results'][0]['bytes_per_element'] *= 1.1
+        worse['results'][1]['decode_mb_per_sec'] *= 0.5
+        worse['peak_rss_mb'] *= 2
+        assert len(bench.compare(worse, results)) == 3
+        # Entries missing from the baseline are not regressions.
+        assert bench.compare(worse, { 'results': [],
+                                      'peak_rss_mb': worse['peak_rss_mb'] }) == []
+
+
+def main():
+    test_bench()
+
+
+if __name__ == "__main__":
+    main()
@@ -8,9 +8,9 @@ a = np.empty((0))
 b = lilcom.compress(a)
 
 assert b[0] == 76
-assert b[1] == 0
+assert b[1] == 2
 
-print("Header begins with \"L0\"")
+print("Header begins with \"L\" then format version 2")
 
 try:
     lilcom.decompress(bytes())
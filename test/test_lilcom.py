@@ -6,10 +6,12 @@ import numpy as np
 
 for shape in [ (40,50), (3,4,5), (1,5,7), (8,1,10), (100,2,57) ]:
     a = np.random.randn(*shape)
-    for power in [ -15, -8, -6 ]:
-        b = lilcom.compress(a, power)
+    for power, arithmetic_coding in [ (-15, False), (-8, False), (-6, False),
+                                      (-15, True), (-8, True), (-6, True) ]:
+        b = lilcom.compress(a, power, arithmetic_coding=arithmetic_coding)
         a2 = lilcom.decompress(b)
-        print("len(b) = ", len(b), ", bytes per number = ", (len(b) / a.size))
+        print("arithmetic_coding = ", arithmetic_coding, ", len(b) = ", len(b),
+              ", bytes per number = ", (len(b) / a.size))
 
         diff = (a2 - a)
         mx = diff.max()
@@ -21,3 +23,553 @@ for shape in [ (40,50), (3,4,5), (1,5,7), (8,1,10), (100,2,57) ]:
                                                                         
 
 
+
+# Test rate control: the size budget should be met, and using half the
+# budget should give a coarser tick_power.
+for shape in [ (40,50), (3,4,5), (100,2,57) ]:
+    a = np.random.randn(*shape)
+    # The fixed-layout header takes 16 bytes plus 10 bytes per axis (rounded
+    # up to a multiple of 8), which the budgets must allow for.
+    header_len = 16 + 8 * a.ndim + 8 * ((a.ndim + 3) // 4)
+    for max_bytes in [ header_len + a.size // 2, header_len + a.size,
+                       header_len + 2 * a.size ]:
+        b = lilcom.compress(a, max_bytes=max_bytes)
+        print("max_bytes = ", max_bytes, ", len(b) = ", len(b))
+        assert len(b) <= max_bytes
+        # it should have used the smallest tick_power that meets the budget.
+        b_tick_power = None
+        for power in range(-20, 21):
+            if len(lilcom.compress(a, power)) <= max_bytes:
+                b_tick_power = power
+                break
+        assert lilcom.compress(a, b_tick_power) == b
+    b = lilcom.compress(a, bits_per_element=8)
+    assert len(b) <= a.size
+
+# The same for a signal whose compressed size was not monotonic in
+# tick_power (because of the automatic choice of sparse mode), which
+# misled the search.
+t = np.arange(100000)
+a = np.zeros(100000)
+a[:40000] = 100 * np.sin(t[:40000] * 0.001)
+a[40000:43000] = 0.01
+sizes = [ len(lilcom.compress(a, power)) for power in range(-20, 21) ]
+for max_bytes in [ 30000, 25000, 20000 ]:
+    b_tick_power = min(power for power in range(-20, 21)
+                       if sizes[power + 20] <= max_bytes)
+    b = lilcom.compress(a, max_bytes=max_bytes)
+    assert b == lilcom.compress(a, b_tick_power)
+
+# Test sparse mode, which is chosen automatically for arrays that are mostly
+# zero.
+for zero_prob in [ 0.5, 0.9, 0.99, 1.0 ]:
+    for shape in [ (40,50), (3,4,5), (1000,) ]:
+        a = np.random.randn(*shape) * (np.random.rand(*shape) > zero_prob)
+        for arithmetic_coding in [ False, True ]:
+            b = lilcom.compress(a, arithmetic_coding=arithmetic_coding)
+            a2 = lilcom.decompress(b)
+            print("zero_prob = ", zero_prob, ", len(b) = ", len(b),
+                  ", bytes per number = ", (len(b) / a.size))
+            assert np.abs(a2 - a).max() <= 2 ** -9 + 5.0e-05
+            if zero_prob >= 0.9:  # sparse mode reproduces zeros exactly.
+                assert (a2[a == 0] == 0).all()
+
+# Sparse mode is only chosen when it makes the output smaller: zero padding
+# of a smooth signal (which sparse mode, without regression, codes badly) can
+# only make it smaller, also beyond the proportion of zeros where sparse mode
+# is considered.
+t = np.arange(100000)
+for arithmetic_coding in [ False, True ]:
+    sizes = []
+    for num_zeros in range(50000, 70001, 2500):
+        a = np.sin(t * 0.01)
+        a[len(a) - num_zeros:] = 0.0
+        sizes.append(len(lilcom.compress(a, arithmetic_coding=arithmetic_coding)))
+    assert sizes == sorted(sizes, reverse=True), sizes
+
+# Test constant blocks, e.g. padding; these are detected automatically.
+for shape, pad_value in [ ((50, 300), 0.0), ((50, 300), 0.25), ((5000,), -3.0),
+                          ((20, 70, 1), 1.0) ]:
+    a = np.random.randn(*shape)
+    a[..., 100:] = pad_value  # pad along the last non-trivial axis
+    if len(shape) == 3:
+        a[:, 30:] = pad_value
+    a[:5] = pad_value
+    for arithmetic_coding in [ False, True ]:
+        b = lilcom.compress(a, arithmetic_coding=arithmetic_coding)
+        a2 = lilcom.decompress(b)
+        print("pad_value = ", pad_value, ", len(b) = ", len(b),
+              ", bytes per number = ", (len(b) / a.size))
+        assert np.abs(a2 - a).max() <= 2 ** -9 + 5.0e-05
+# A constant array should take hardly any space.
+b = lilcom.compress(np.full((100, 1000), 0.5))
+print("len(b) for constant array is ", len(b))
+assert len(b) < 1000
+assert (lilcom.decompress(b) == 0.5).all()
+
+# Test lossless mode.
+special = np.array([ 0.0, -0.0, np.inf, -np.inf, np.nan, 1.0e-45, -1.0e-45,
+                     3.4e+38, -3.4e+38 ], dtype=np.float32)
+for a in [ np.random.randn(300, 500).astype(np.float32),
+           np.cumsum(np.random.randn(20, 2000), axis=1).astype(np.float32),
+           np.abs(np.random.randn(10, 3, 40)).astype(np.float32),
+           np.tile(special, (5, 3)) ]:
+    for arithmetic_coding in [ False, True ]:
+        b = lilcom.compress(a, lossless=True,
+                            arithmetic_coding=arithmetic_coding)
+        a2 = lilcom.decompress(b)
+        print("Lossless: shape = ", a.shape, ", len(b) = ", len(b),
+              ", bytes per number = ", (len(b) / max(a.size, 1)))
+        assert a2.dtype == np.float32 and a2.shape == a.shape
+        assert (a2.view(np.int32) == a.view(np.int32)).all()
+        if a.size > 1000:
+            assert len(b) < 4 * a.size
+# Views whose last axis is not contiguous are copied before lossless
+# compression.
+a = np.random.randn(30, 90).astype(np.float32)
+for view in [ a[:, ::3], a[:, ::-1], a[::-2], a.T ]:
+    b = lilcom.compress(view, lossless=True)
+    assert (lilcom.decompress(b) == view).all()
+
+# Test lossless compression of integer arrays.
+for dtype in [ np.int8, np.uint8, np.int16, np.uint16, np.int32, np.uint32,
+               np.int64, np.uint64 ]:
+    info = np.iinfo(dtype)
+    extremes = np.array([ info.min, info.max, 0, 1, info.max - 1 ] * 20,
+                        dtype=dtype)
+    for a in [ np.random.randint(0, 100, size=(30, 400)).astype(dtype),
+               np.cumsum(np.random.randint(0, 5, size=(3, 4, 500)),
+                         axis=2).astype(dtype),
+               extremes, extremes.reshape(4, 25).T, np.zeros((0, 3), dtype=dtype) ]:
+        for arithmetic_coding in [ False, True ]:
+            b = lilcom.compress(a, arithmetic_coding=arithmetic_coding)
+            a2 = lilcom.decompress(b)
+            assert a2.dtype == a.dtype and a2.shape == a.shape
+            assert (a2 == a).all()
+        if a.size > 1000:
+            print("Integer: dtype = ", a.dtype, ", shape = ", a.shape,
+                  ", bytes per number = ", (len(b) / a.size))
+            assert len(b) < a.size
+
+# Test the fixed-layout header and peek_shape().
+import struct
+from lilcom import lilcom_extension
+for a, is_int in [ (np.random.randn(7, 1, 300), False),
+                   (np.zeros((5, 200)), False),
+                   (np.arange(3000, dtype=np.int64).reshape(3, 1000), True),
+                   (np.zeros((0, 4), dtype=np.int16), True) ]:
+    b = lilcom.compress(a)
+    (magic, version, data_type, num_axes, tick_power, _, flags,
+     payload_bytes) = struct.unpack_from('<cbBBbBHQ', b)
+    assert magic == b'L' and version == lilcom_extension.LILCOM_FORMAT_VERSION
+    assert num_axes == a.ndim and tick_power == (0 if is_int else -8)
+    assert (flags & lilcom_extension.LILCOM_FLAG_INTEGER != 0) == is_int
+    header_len = (lilcom_extension.LILCOM_FIXED_HEADER_LEN +
+                  8 * num_axes + 8 * ((num_axes + 3) // 4))
+    assert len(b) == header_len + payload_bytes
+    assert struct.unpack_from('<{}q'.format(num_axes), b,
+                              lilcom_extension.LILCOM_FIXED_HEADER_LEN) == a.shape
+    assert lilcom.peek_shape(b) == a.shape
+    assert lilcom.decompress(b).shape == a.shape
+    # Truncated or extended data must not decompress.
+    for bad in [ b[:-1], b + b'\0' ]:
+        try:
+            lilcom.decompress(bad)
+            assert False
+        except ValueError:
+            pass
+
+# Dims of 2^31 or more are representable; peek_shape() only reads the header,
+# so we can check this without such a large array.
+b = struct.pack('<cbBBbBHQqqhh4x', b'L', 2, lilcom_extension.LILCOM_TYPE_FLOAT32,
+                2, -8, 0, 0, 0, 3, 2 ** 33 + 1, 0, 0)
+assert lilcom.peek_shape(b) == (3, 2 ** 33 + 1)
+
+# Regression coefficients out of range are rejected, not compressed into data
+# that cannot be decompressed.
+for coeff in [ 257, 300, -40000 ]:
+    assert lilcom_extension.compress_float(np.zeros(10, dtype=np.float32),
+                                           [ -8, coeff ]) is None
+
+# Adaptive precision: with significant_bits, the error in loud regions is
+# bounded relative to the local amplitude, and the output is smaller than
+# with a fixed tick_power.
+n = 20000
+envelope = np.exp(np.linspace(-6, 4, n))
+a = (np.random.randn(n) * envelope).astype(np.float32)
+a[5000:6000] = 0.0  # a constant region, coded as constant blocks.
+for significant_bits in [ 4, 8 ]:
+    for arithmetic_coding in [ False, True ]:
+        b = lilcom.compress(a, significant_bits=significant_bits,
+                            arithmetic_coding=arithmetic_coding)
+        a2 = lilcom.decompress(b)
+        bound = np.maximum(2.0 ** -9, 2.0 ** (1 - significant_bits) * envelope)
+        assert (np.abs(a2 - a) <= bound).all()
+        assert (a2[5056:5952] == 0).all()  # the whole blocks of 64 in it
+        assert len(b) < len(lilcom.compress(a, arithmetic_coding=arithmetic_coding))
+        print("Adaptive: significant_bits = ", significant_bits,
+              ", arithmetic_coding = ", arithmetic_coding,
+              ", bytes per number = ", (len(b) / a.size))
+a = np.random.randn(50, 400) * np.logspace(-3, 3, 400)
+b = lilcom.compress(a, significant_bits=6, max_bytes=20000)
+assert len(b) <= 20000 and lilcom.decompress(b).shape == a.shape
+for bad_args in [ { 'significant_bits': 2 }, { 'significant_bits': 32 },
+                  { 'significant_bits': 8, 'lossless': True } ]:
+    try:
+        lilcom.compress(a.astype(np.float32), **bad_args)
+        assert False
+    except ValueError:
+        pass
+
+# Statistics from compress() and decompress().
+if lilcom_extension.LILCOM_STATS_ENABLED:
+    a = np.random.randn(1000, 30).astype(np.float32)
+    a[100:300] = 0.0  # constant blocks
+    a[500:600, :15] = 0.0  # runs of zero codes
+    a[5, 5] = 1.0e12  # clipped
+    stats = {}
+    b = lilcom.compress(a, stats=stats)
+    assert stats['header_bytes'] + stats['meta_bytes'] + stats['code_bytes'] == len(b)
+    assert stats['meta_bytes'] > 0 and stats['num_clipped'] == 1
+    assert stats['num_zero_runs'] > 0 and stats['num_zeros_in_runs'] > 0
+    # Each code not in a constant block has a num_bits; those that are not
+    # zero have a change in num_bits after them.
+    assert sum(stats['num_bits_histogram']) == 800 * 30
+    assert (stats['num_bits_up'] + stats['num_bits_down'] + stats['num_bits_same'] ==
+            800 * 30 - stats['num_bits_histogram'][0])
+    assert 0 < stats['encode_seconds'] <= stats['total_seconds']
+    decompress_stats = { 'old': 0 }
+    lilcom.decompress(b, stats=decompress_stats)
+    assert 'old' not in decompress_stats
+    for key in [ 'header_bytes', 'meta_bytes', 'code_bytes' ]:
+        assert decompress_stats[key] == stats[key]
+    assert 0 < decompress_stats['decode_seconds'] <= decompress_stats['total_seconds']
+
+# The variants of the library for the different instruction sets (those that
+# this CPU supports) give exactly the same output.
+isa = lilcom_extension.get_isa()
+assert isa in [ 'default', 'avx2', 'avx512' ]
+assert not lilcom_extension.set_isa('no-such-isa')
+a = np.random.randn(300, 40).astype(np.float32)
+a[100:150] = 0.0
+for kwargs in [ {}, { 'arithmetic_coding': True }, { 'significant_bits': 8 },
+                { 'lossless': True } ]:
+    outputs = []
+    for name in [ 'default', 'avx2', 'avx512' ]:
+        if lilcom_extension.set_isa(name):
+            b = lilcom.compress(a, **kwargs)
+            outputs.append((b, lilcom.decompress(b)))
+    for b, a2 in outputs[1:]:
+        assert b == outputs[0][0] and (a2 == outputs[0][1]).all()
+assert lilcom_extension.set_isa(isa)
+
+# decompress() and peek_shape() accept any bytes-like object, and
+# decompress() can write into an existing (possibly strided) array.
+a = np.random.randn(30, 20).astype(np.float32)
+b = lilcom.compress(a)
+a2 = lilcom.decompress(b)
+for b2 in [ bytearray(b), memoryview(b), np.frombuffer(b, dtype=np.uint8),
+            memoryview(b'xyz' + b)[3:] ]:
+    assert lilcom.peek_shape(b2) == a.shape
+    assert (lilcom.decompress(b2) == a2).all()
+big = np.zeros((40, 40), dtype=np.float32)
+out = big[5:35, ::2]
+assert lilcom.decompress(b, out=out) is out
+assert (big[5:35, ::2] == a2).all() and (big[:5] == 0).all() and (big[:, 1::2] == 0).all()
+read_only = np.zeros((30, 20), dtype=np.float32)
+read_only.flags.writeable = False
+for bad_out in [ np.zeros((30, 20)), np.zeros((20, 30), dtype=np.float32),
+                 np.zeros((30, 20), dtype='>f4'), read_only ]:
+    try:
+        lilcom.decompress(b, out=bad_out)
+        assert False
+    except ValueError:
+        pass
+a = np.arange(1000, dtype=np.int16)
+out = np.empty(1000, dtype=np.int16)
+lilcom.decompress(bytearray(lilcom.compress(a)), out=out)
+assert (out == a).all()
+
+# decompress_quantized() gives the values in units of the tick; it is exact
+# if the regression coefficients are -1, 0 or 1 (quantizable=True), and
+# otherwise within half a tick of decompress().
+a = np.random.randn(300, 40).astype(np.float32).cumsum(axis=0)
+a[100:120] = 0.0
+for kwargs in [ { 'quantizable': True }, { 'do_regression': False },
+                { 'quantizable': True, 'arithmetic_coding': True },
+                { 'quantizable': True, 'significant_bits': 6 } ]:
+    b = lilcom.compress(a, tick_power=-6, **kwargs)
+    for dtype in [ np.int16, np.int32 ]:
+        q, scale = lilcom.decompress_quantized(b, dtype)
+        assert q.dtype == dtype and scale == 2.0 ** -6
+        assert (q * np.float32(scale) == lilcom.decompress(b)).all()
+a = np.zeros(5000, dtype=np.float32)
+noise = np.random.randn(5000)
+for i in range(1, 5000):
+    a[i] = 0.5 * a[i - 1] + noise[i]
+b = lilcom.compress(a, tick_power=-8)
+out = np.empty((5000,), dtype=np.int32)
+q, scale = lilcom.decompress_quantized(b, np.int32, out=out)
+assert q is out and np.abs(q * scale - lilcom.decompress(b)).max() <= scale / 2
+for dtype in [ np.int8, np.float32, np.uint16 ]:
+    try:
+        lilcom.decompress_quantized(b, dtype)
+        assert False
+    except ValueError:
+        pass
+
+# compress_async() and decompress_async() give the same results as
+# compress() and decompress(), as futures, including from asyncio.
+import asyncio
+lilcom.set_executor(num_workers=2, max_pending=3)
+arrays = [ np.random.randn(200, 50).astype(np.float32) for _ in range(10) ]
+arrays.append(np.arange(1000, dtype=np.int32))
+futures = [ lilcom.compress_async(a, tick_power=-10) for a in arrays ]
+compressed = [ f.result() for f in futures ]
+assert compressed == [ lilcom.compress(a, tick_power=-10) for a in arrays ]
+futures = [ lilcom.decompress_async(b) for b in compressed ]
+for f, b in zip(futures, compressed):
+    assert (f.result() == lilcom.decompress(b)).all()
+async def compress_and_decompress(a):
+    b = await asyncio.wrap_future(lilcom.compress_async(a))
+    return await asyncio.wrap_future(lilcom.decompress_async(b))
+assert (asyncio.run(compress_and_decompress(arrays[-1])) == arrays[-1]).all()
+try:
+    lilcom.decompress_async(b'not lilcom data').result()
+    assert False
+except ValueError:
+    pass
+
+# Arrays of other frameworks are read and written in place through DLPack or
+# __array_interface__; here NumPy's own __dlpack__ stands in for them.
+class DLPackOnly:
+    def __init__(self, a):
+        self.a = a
+    def __dlpack__(self, **kwargs):
+        return self.a.__dlpack__(**kwargs)
+    def __dlpack_device__(self):
+        return self.a.__dlpack_device__()
+class ArrayInterfaceOnly:
+    def __init__(self, a):
+        self.a = a
+        self.__array_interface__ = a.__array_interface__
+a = np.random.randn(30, 20).astype(np.float32)
+for wrapper in [ DLPackOnly, ArrayInterfaceOnly ]:
+    for kwargs in [ {}, { 'lossless': True } ]:
+        a_copy = a.copy()
+        b = lilcom.compress(wrapper(a_copy), **kwargs)
+        assert b == lilcom.compress(a, **kwargs) and (a_copy == a).all()
+    out = np.zeros((30, 20), dtype=np.float32)
+    wrapped_out = wrapper(out)
+    assert lilcom.decompress(b, out=wrapped_out) is wrapped_out
+    assert (out == a).all()
+assert type(lilcom.decompress(b, dlpack=True)).__name__ == 'PyCapsule'
+try:
+    lilcom.decompress(b, out=[ 0.0 ] * 600)
+    assert False
+except ValueError:
+    pass
+
+# A batch of many small arrays is much smaller than the arrays compressed
+# one by one, and any of them can be decompressed by its index.
+arrays = [ (np.sin(np.arange(n * 16) * 0.01).reshape(n, 16) +
+            0.01 * np.random.randn(n, 16)).astype(np.float32)
+           for n in np.random.randint(0, 6, size=500) ]
+b = lilcom.compress_batch(arrays)
+assert len(b) < 0.75 * sum(len(lilcom.compress(a)) for a in arrays if a.size)
+assert lilcom.batch_shapes(b) == [ a.shape for a in arrays ]
+for i in [ 0, 17, 250, -1 ]:
+    error = np.abs(lilcom.decompress_batch(b, i) - arrays[i])
+    assert error.max(initial=0) <= 2.0 ** -9 + 1.0e-06
+all_arrays = lilcom.decompress_batch(b)
+assert len(all_arrays) == 500
+assert all(x.shape == a.shape for x, a in zip(all_arrays, arrays))
+part = lilcom.decompress_batch(b, slice(100, 300))
+assert all((x == y).all() for x, y in zip(part, all_arrays[100:300]))
+assert lilcom.decompress_batch(b, slice(3, 3)) == []
+for kwargs in [ { 'lossless': True }, { 'arithmetic_coding': True,
+                                        'chunk_elements': 100 } ]:
+    b = lilcom.compress_batch(arrays, **kwargs)
+    max_error = 0.0 if 'lossless' in kwargs else 2.0 ** -9 + 1.0e-06
+    assert all(np.abs(x - a).max(initial=0) <= max_error
+               for x, a in zip(lilcom.decompress_batch(b), arrays))
+for bad_index in [ 500, -501 ]:
+    try:
+        lilcom.decompress_batch(b, bad_index)
+        assert False
+    except IndexError:
+        pass
+for bad_data in [ lilcom.compress(np.ones((2, 16))), b[:-1] ]:
+    try:
+        lilcom.decompress_batch(bad_data, 0)
+        assert False
+    except ValueError:
+        pass
+
+# Each thread reuses its memory for compression from call to call; the output
+# must not depend on what was compressed before, on the same thread or not.
+import concurrent.futures
+arrays = [ np.random.randn(*shape).astype(np.float32)
+           for shape in [ (2000, 300), (7,), (50, 40), (2000, 300) ] ]
+arrays[2][10:30] = 0.0
+for kwargs in [ {}, { 'arithmetic_coding': True } ]:
+    ref = [ lilcom.compress(a, **kwargs) for a in arrays ]
+    assert ref[0] != ref[3]
+    assert [ lilcom.compress(a, **kwargs)
+             for a in reversed(arrays) ] == ref[::-1]
+    with concurrent.futures.ThreadPoolExecutor(4) as executor:
+        assert list(executor.map(lambda a: lilcom.compress(a, **kwargs),
+                                 arrays * 3)) == ref * 3
+        decoded = list(executor.map(lilcom.decompress, ref))
+    assert all((x == lilcom.decompress(r)).all() for x, r in zip(decoded, ref))
+
+# Concatenating compressed arrays (and batches) along axis 0 gives data that
+# decompresses to exactly the concatenation of what they decompress to.
+arrays = [ np.random.randn(n, 3, 4).astype(np.float32) for n in [ 5, 1, 20 ] ]
+pieces = [ lilcom.compress(arrays[0]),
+           lilcom.compress(arrays[1], tick_power=-4, arithmetic_coding=True),
+           lilcom.compress(arrays[2], lossless=True),
+           lilcom.compress_batch(arrays, chunk_elements=50) ]
+c = lilcom.concatenate(pieces)
+expected = np.concatenate([ lilcom.decompress(pieces[0]),
+                            lilcom.decompress(pieces[1]), arrays[2] ] +
+                          lilcom.decompress_batch(pieces[3]))
+assert lilcom.peek_shape(c) == expected.shape
+assert (lilcom.decompress(c) == expected).all()
+assert len(lilcom.batch_shapes(c)) == 6
+assert (lilcom.decompress_batch(c, 2) == arrays[2]).all()
+strided = np.zeros((expected.shape[0] * 2,) + expected.shape[1:],
+                   dtype=np.float32)[::2]
+lilcom.decompress(c, out=strided)
+assert (strided == expected).all()
+assert (lilcom.decompress(lilcom.concatenate([ bytearray(c), pieces[0] ]))
+        == np.concatenate([ expected, expected[:5] ])).all()
+for bad_inputs in [ [], [ pieces[0], lilcom.compress(np.zeros(4)) ],
+                    [ lilcom.compress(np.arange(4)) ] ]:
+    try:
+        lilcom.concatenate(bad_inputs)
+        assert False
+    except ValueError:
+        pass
+
+# Data compressed with layers decompresses from each prefix given by
+# layer_sizes() to within the error of the layers it contains.
+a = np.cumsum(np.random.randn(50, 80), axis=1).astype(np.float32)
+a_copy = a.copy()
+for kwargs in [ {}, { 'arithmetic_coding': True } ]:
+    b = lilcom.compress(a, tick_power=-6, layers=4, **kwargs)
+    assert (a == a_copy).all()  # The input is not modified.
+    sizes = lilcom.layer_sizes(b)
+    assert len(sizes) == 5 and sizes[-1] == len(b)
+    assert sizes == sorted(sizes)
+    assert lilcom.layer_sizes(b[:32 + 10 * a.ndim]) == sizes
+    for k, size in enumerate(sizes):
+        prefix = b[:size]
+        assert lilcom.peek_shape(prefix) == a.shape
+        max_error = 2.0 ** -6 * (0.5 if k == 4 else 2 ** (3 - k) + 0.5)
+        error = np.abs(lilcom.decompress(prefix, max_layer=k) - a).max()
+        assert error <= max_error + 1.0e-06, (k, error, max_error)
+    assert (lilcom.decompress(b) == lilcom.decompress(b, max_layer=4)).all()
+    q, scale = lilcom.decompress_quantized(b, np.int32)
+    assert (q * scale == lilcom.decompress(b)).all()
+    try:
+        lilcom.decompress(b[:sizes[1]])  # All the layers need all the data.
+        assert False
+    except ValueError:
+        pass
+try:
+    lilcom.layer_sizes(lilcom.compress(a))
+    assert False
+except ValueError:
+    pass
+# Views whose last axis is not contiguous are accepted, as in lossy mode.
+for view in [ a[:, ::3], a[:, ::-1], a.T ]:
+    b = lilcom.compress(view, tick_power=-6, layers=2)
+    assert (lilcom.decompress(b) == lilcom.decompress(lilcom.compress(
+        np.ascontiguousarray(view), tick_power=-6, layers=2))).all()
+
+# A Loader yields the arrays in batches, decompressed ahead on other threads,
+# whether they are given as bytes or as offsets into an archive.
+arrays = [ np.random.randn(10, 8).astype(np.float32) for _ in range(23) ]
+blobs = [ lilcom.compress(a) for a in arrays ]
+archive = bytearray(b''.join(blobs))
+offsets = np.cumsum([ 0 ] + [ len(b) for b in blobs ])
+expected = np.stack([ lilcom.decompress(b) for b in blobs ])
+for items in [ blobs, [ (archive, int(offsets[i]), len(blobs[i]))
+                        for i in range(len(blobs)) ] ]:
+    loader = lilcom.Loader(items, batch_size=4, num_buffers=3)
+    assert len(loader) == 6
+    for epoch in range(2):
+        batches = [ batch.copy() for batch in loader ]
+        assert [ len(batch) for batch in batches ] == [ 4 ] * 5 + [ 3 ]
+        assert (np.concatenate(batches) == expected).all()
+loader = lilcom.Loader(blobs, batch_size=4, drop_last=True)
+assert len(loader) == 5 and sum(len(batch) for batch in loader) == 20
+for batch in lilcom.Loader(blobs, batch_size=5, num_buffers=2):
+    break  # Stopping early cancels the batches that were decompressed ahead.
+try:
+    list(lilcom.Loader(blobs[:3] + [ lilcom.compress(np.zeros(80)) ], 2))
+    assert False
+except ValueError:
+    pass
+
+# Audio samples of 16, 24 and 32 bits compressed with significant_bits are
+# decoded exactly where quiet, and within the range of sample_bits where loud.
+t = np.arange(20000)
+for dtype, sample_bits in [ (np.int16, 16), (np.int32, 24), (np.int32, 32) ]:
+    max_value = 2 ** (sample_bits - 1) - 1
+    a = (np.sin(t * 0.01)[:, None] * np.array([ 1.0, 0.7 ]) * 1.2 * max_value +
+         np.random.randn(20000, 2) * max_value / 1000)
+    a[:2000] *= 1.0e-6 * 2 ** (32 - sample_bits)
+    a = np.clip(np.round(a), -max_value - 1, max_value).astype(dtype)
+    b = lilcom.compress(a, significant_bits=6, sample_bits=sample_bits)
+    assert len(b) < len(lilcom.compress(a))  # Smaller than lossless.
+    c = lilcom.decompress(b)
+    assert c.dtype == dtype and c.shape == a.shape
+    assert (c[:2000] == a[:2000]).all()
+    assert np.abs(c.astype(np.int64) - a).max() < max_value / 64
+    assert c.max() <= max_value and c.min() >= -max_value - 1
+for bad_kwargs in [ { 'sample_bits': 24 }, { 'significant_bits': 2 } ]:
+    try:
+        lilcom.compress(np.zeros(10, dtype=np.int16),
+                        **dict({ 'significant_bits': 8 }, **bad_kwargs))
+        assert False
+    except ValueError:
+        pass
+
+# Multichannel data is coded one stream per channel, predicted from channel 0,
+# and each channel can be decompressed on its own, also when interleaved.
+t = np.arange(20000) * 0.01
+a = np.stack([ np.sin(t), 0.8 * np.sin(t) + np.random.randn(20000) * 1.0e-3,
+               np.cos(t) ]).astype(np.float32)
+for input in [ a, np.ascontiguousarray(a.T).T ]:
+    for arithmetic_coding in [ False, True ]:
+        b = lilcom.compress(input, channels=True, tick_power=-9,
+                            arithmetic_coding=arithmetic_coding)
+        assert lilcom.peek_shape(b) == a.shape
+        d = lilcom.decompress(b)
+        assert np.abs(d - a).max() <= 2 ** -10
+        for c in range(3):
+            assert (lilcom.decompress(b, channel=c) == d[c]).all()
+            assert (lilcom.decompress_async(b, channel=c).result() == d[c]).all()
+assert len(lilcom.compress(a, channels=True)) < len(lilcom.compress(a))
+for bad in [ lambda: lilcom.compress(a[0], channels=True),
+             lambda: lilcom.compress(a, channels=True, lossless=True),
+             lambda: lilcom.decompress(b, channel=3),
+             lambda: lilcom.decompress(lilcom.compress(a), channel=0) ]:
+    try:
+        bad()
+        assert False
+    except ValueError:
+        pass
+# A number of channels too large for the data is rejected, before it is used
+# to size anything.
+b = struct.pack('<cbBBbBHQqqhh4x16x', b'L', 2, lilcom_extension.LILCOM_TYPE_FLOAT32,
+                2, -8, 0, lilcom_extension.LILCOM_FLAG_CHANNELS, 16,
+                2 ** 61 + 1, 1, 0, 0)
+assert len(b) == 56
+try:
+    lilcom.decompress(b, channel=0)
+    assert False
+except ValueError:
+    pass